@@ -850,26 +850,26 @@ installdeps() {
       apt-get install -y --no-install-recommends liblua5.3-dev
     fi
     apt-get install -y --no-install-recommends \
-      gcc cmake perl libssl-dev libid3tag0-dev libflac-dev \
+      gcc cmake perl libssl-dev libid3tag0-dev libflac-dev libjpeg-dev libpng-dev \
       build-essential pkg-config libpcre2-dev gzip jq
   elif [ -f /etc/arch-release ]
   then
     #arch
-    pacman -Sy gcc base-devel cmake perl openssl libid3tag flac lua pkgconf pcre2 gzip jq
+    pacman -Sy gcc base-devel cmake perl openssl libid3tag flac libjpeg-turbo libpng lua pkgconf pcre2 gzip jq
   elif [ -f /etc/alpine-release ]
   then
     #alpine
-    apk add cmake perl openssl-dev libid3tag-dev flac-dev lua5.4-dev \
+    apk add cmake perl openssl-dev libid3tag-dev flac-dev libjpeg-turbo-dev libpng-dev lua5.4-dev \
       alpine-sdk linux-headers pkgconf pcre2-dev gzip jq
   elif [ -f /etc/SuSE-release ]
   then
     #suse
-    zypper install gcc cmake pkgconfig perl openssl-devel libid3tag-devel flac-devel \
+    zypper install gcc cmake pkgconfig perl openssl-devel libid3tag-devel flac-devel libjpeg8-devel libpng16-devel \
       lua-devel unzip pcre2-devel gzip jq
   elif [ -f /etc/redhat-release ]
   then
     #fedora
-    yum install gcc cmake pkgconfig perl openssl-devel libid3tag-devel flac-devel \
+    yum install gcc cmake pkgconfig perl openssl-devel libid3tag-devel flac-devel libjpeg-turbo-devel libpng-devel \
       lua-devel unzip pcre2-devel gzip jq
   else
     echo_warn "Unsupported distribution detected."
@@ -882,6 +882,8 @@ installdeps() {
     echo "  - openssl (devel)"
     echo "  - flac (devel)"
     echo "  - libid3tag (devel)"
+    echo "  - libjpeg (devel)"
+    echo "  - libpng (devel)"
     echo "  - liblua5.4 or liblua5.3 (devel)"
     echo "  - libpcre2 (devel)"
   fi
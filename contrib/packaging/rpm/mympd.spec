@@ -16,6 +16,8 @@ BuildRequires:  cmake
 BuildRequires:	flac-devel
 BuildRequires:  gcc
 BuildRequires:  libid3tag-devel
+BuildRequires:  libjpeg-turbo-devel
+BuildRequires:  libpng-devel
 BuildRequires:  lua-devel
 BuildRequires:  openssl-devel
 BuildRequires:  pcre2-devel
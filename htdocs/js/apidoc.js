@@ -196,6 +196,10 @@ const APImethods = {
             }
         }
     },
+    "MYMPD_API_WORKER_LIST": {
+        "desc": "Lists the running and queued background jobs.",
+        "params": {}
+    },
     "MYMPD_API_DATABASE_SEARCH": {
         "desc": "Searches for songs in the database.",
         "params": {
@@ -1548,6 +1552,11 @@ const APImethods = {
                 "example": "off",
                 "desc": "Jukebox modes: \"off\", \"song\", \"album\""
             },
+            "jukeboxWeight": {
+                "type": APItypes.string,
+                "example": "none",
+                "desc": "Weighted selection: \"none\", \"like\", \"playCount\", \"lastPlayed\""
+            },
             "jukeboxPlaylist": {
                 "type": APItypes.string,
                 "example": "Database",
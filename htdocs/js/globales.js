@@ -1030,6 +1030,19 @@ const settingsPlaybackFields = {
         "unit": "Hours ago",
         "class": ["featAdvAlbum"]
     },
+    "jukeboxWeight": {
+        "defaultValue": "none",
+        "validValues": {
+            "none": "None",
+            "like": "Like",
+            "playCount": "Play count",
+            "lastPlayed": "Last played"
+        },
+        "inputType": "select",
+        "title": "Weighted selection",
+        "form": "modalPlaybackJukeboxCollapse",
+        "help": "helpJukeboxWeight"
+    },
     "jukeboxIgnoreHated": {
         "inputType": "checkbox",
         "defaultValue": defaults["MYMPD_JUKEBOX_IGNORE_HATED"],
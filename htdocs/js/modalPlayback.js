@@ -200,10 +200,13 @@ function toggleJukeboxSettings() {
         elHide(elGetById('modalPlaybackJukeboxLastPlayedInput').closest('.row'));
         elHide(elGetById('modalPlaybackJukeboxIgnoreHatedInput').closest('.row'));
         toggleBtnChkId('modalPlaybackJukeboxIgnoreHatedInput', false);
+        elHide(elGetById('modalPlaybackJukeboxWeightInput').closest('.row'));
+        elGetById('modalPlaybackJukeboxWeightInput').value = 'none';
     }
     else {
         elHideId('modalPlaybackPlaybackStatisticsWarn');
         elShow(elGetById('modalPlaybackJukeboxLastPlayedInput').closest('.row'));
+        elShow(elGetById('modalPlaybackJukeboxWeightInput').closest('.row'));
     }
 }
 
@@ -13,6 +13,7 @@
 #include "dist/rax/rax.h"
 #include "src/lib/config_def.h"
 #include "src/lib/filehandler.h"
+#include "src/lib/list.h"
 #include "src/lib/log.h"
 #include "src/lib/mem.h"
 #include "src/lib/mpack.h"
@@ -27,7 +28,7 @@
 #include <string.h>
 
 /**
- * myMPD saves album information in the album cache as a mpd_song struct.
+ * The mpd_worker thread aggregates the album information in a mpd_song struct.
  * Used fields:
  *   tags: tags from all songs of the album
  *   last_modified: last_modified from newest song
@@ -35,6 +36,8 @@
  *   duration_ms: the album total time in milliseconds
  *   pos: number of discs
  *   prio: number of songs
+ * The album cache itself saves this information in compact t_album structs,
+ * the strings are interned in the string pool of the album cache.
  */
 
 /**
@@ -42,6 +45,13 @@
  */
 
 static struct mpd_song *album_from_mpack_node(mpack_node_t album_node, const struct t_tags *tagcols, sds *key);
+static sds get_sort_key(sds key, const struct t_album *album, enum mpd_tag_type sort_tag);
+static void sort_index_insert(struct t_album_sort_index *sort_index, struct t_album *album);
+static void sort_indexes_insert(struct t_cache *album_cache, struct t_album *album);
+static void sort_indexes_remove(struct t_cache *album_cache, const struct t_album *album);
+static void sort_indexes_free(struct t_cache *album_cache);
+static void album_release_strings(struct t_cache *album_cache, const struct t_album *album);
+static void album_cache_compact_strings(struct t_cache *album_cache);
 
 /**
  * Public functions
@@ -108,6 +118,7 @@ bool album_cache_read(struct t_cache *album_cache, sds workdir, const struct t_a
         return false;
     }
     
+    time_t mtime = get_mtime(filepath);
     mpack_tree_t tree;
     mpack_tree_init_filename(&tree, filepath, 0);
     mpack_tree_set_error_handler(&tree, log_mpack_node_error);
@@ -160,16 +171,19 @@ bool album_cache_read(struct t_cache *album_cache, sds workdir, const struct t_a
     len = mpack_node_array_length(albums_node);
     sds key = sdsempty();
     album_cache->building = true;
-    album_cache->cache = raxNew();
+    album_cache_init(album_cache);
 
     for (size_t i = 0; i < len; i++) {
         mpack_node_t album_node = mpack_node_array_at(albums_node, i);
         struct mpd_song *album = album_from_mpack_node(album_node, album_tags, &key);
         if (album != NULL) {
-            if (raxTryInsert(album_cache->cache, (unsigned char *)key, sdslen(key), album, NULL) == 0) {
+            if (raxFind(album_cache->cache, (unsigned char *)key, sdslen(key)) != raxNotFound) {
                 MYMPD_LOG_ERROR(NULL, "Duplicate key in album cache file found: %s", key);
-                mpd_song_free(album);
             }
+            else {
+                album_cache_insert(album_cache, key, sdslen(key), album);
+            }
+            mpd_song_free(album);
         }
     }
     FREE_SDS(key);
@@ -183,6 +197,7 @@ bool album_cache_read(struct t_cache *album_cache, sds workdir, const struct t_a
         album_cache_free(album_cache);
     }
     else {
+        album_cache->mtime = mtime;
         MYMPD_LOG_INFO(NULL, "Read %lld album(s) from disc", (long long)album_cache->cache->numele);
     }
     FREE_PTR(album_tags);
@@ -234,18 +249,18 @@ bool album_cache_write(struct t_cache *album_cache, sds workdir, const struct t_
     raxStart(&iter, album_cache->cache);
     raxSeek(&iter, "^", NULL, 0);
     while (raxNext(&iter)) {
-        const struct mpd_song *album = (struct mpd_song *)iter.data;
+        const struct t_album *album = (struct t_album *)iter.data;
         mpack_build_map(&writer);
-        mpack_write_kv(&writer, "uri", mpd_song_get_uri(album));
-        mpack_write_kv(&writer, "Discs", album_get_discs(album));
-        mpack_write_kv(&writer, "Songs", album_get_song_count(album));
-        mpack_write_kv(&writer, "Duration", mpd_song_get_duration(album));
-        mpack_write_kv(&writer, "Last-Modified", (uint64_t)mpd_song_get_last_modified(album));
+        mpack_write_kv(&writer, "uri", album->uri);
+        mpack_write_kv(&writer, "Discs", album->discs);
+        mpack_write_kv(&writer, "Songs", album->songs);
+        mpack_write_kv(&writer, "Duration", album->duration);
+        mpack_write_kv(&writer, "Last-Modified", (uint64_t)album->last_modified);
         mpack_write_cstr(&writer, "AlbumId");
         mpack_write_str(&writer, (char *)iter.key, (uint32_t)iter.key_len);
         for (unsigned tagnr = 0; tagnr < album_tags->tags_len; ++tagnr) {
             enum mpd_tag_type tag = album_tags->tags[tagnr];
-            if (mpd_song_get_tag(album, tag, 0) == NULL) {
+            if (album_get_tag(album, tag, 0) == NULL) {
                 // do not write empty tags
                 continue;
             }
@@ -254,27 +269,23 @@ bool album_cache_write(struct t_cache *album_cache, sds workdir, const struct t_
                 unsigned count = 0;
                 mpack_write_cstr(&writer, mpd_tag_name(tag));
                 mpack_build_array(&writer);
-                while ((value = mpd_song_get_tag(album, tag, count)) != NULL) {
+                while ((value = album_get_tag(album, tag, count)) != NULL) {
                     mpack_write_cstr(&writer, value);
                     count++;
                 }
                 mpack_complete_array(&writer);
             }
             else {
-                mpack_write_kv(&writer, mpd_tag_name(tag), mpd_song_get_tag(album, tag, 0));
+                mpack_write_kv(&writer, mpd_tag_name(tag), album_get_tag(album, tag, 0));
             }
         }
         mpack_complete_map(&writer);
-        if (free_data == true) {
-            mpd_song_free((struct mpd_song *)iter.data);
-        }
     }
     raxStop(&iter);
     mpack_finish_array(&writer);
     mpack_complete_map(&writer);
     if (free_data == true) {
-        raxFree(album_cache->cache);
-        album_cache->cache = NULL;
+        album_cache_free(album_cache);
     }
     // finish writing
     bool rc = mpack_writer_destroy(&writer) != mpack_ok
@@ -358,9 +369,9 @@ sds album_cache_get_key(sds albumkey, const struct mpd_song *song, const struct
  * Gets the album from the album cache
  * @param album_cache pointer to t_cache struct
  * @param key the album
- * @return mpd_song struct representing the album or NULL on error
+ * @return t_album struct or NULL on error
  */
-struct mpd_song *album_cache_get_album(struct t_cache *album_cache, sds key) {
+struct t_album *album_cache_get_album(struct t_cache *album_cache, sds key) {
     if (album_cache->cache == NULL) {
         return NULL;
     }
@@ -370,7 +381,18 @@ struct mpd_song *album_cache_get_album(struct t_cache *album_cache, sds key) {
         MYMPD_LOG_ERROR(NULL, "Album for key \"%s\" not found in cache", key);
         return NULL;
     }
-    return (struct mpd_song *) data;
+    return (struct t_album *) data;
+}
+
+/**
+ * Initializes an empty album cache
+ * @param album_cache pointer to t_cache struct
+ */
+void album_cache_init(struct t_cache *album_cache) {
+    album_cache->cache = raxNew();
+    album_cache->strings = string_pool_new();
+    album_cache->strings_released = 0;
+    album_cache->sort_indexes = NULL;
 }
 
 /**
@@ -382,15 +404,290 @@ void album_cache_free(struct t_cache *album_cache) {
         return;
     }
     MYMPD_LOG_DEBUG(NULL, "Freeing album cache");
+    sort_indexes_free(album_cache);
     raxIterator iter;
     raxStart(&iter, album_cache->cache);
     raxSeek(&iter, "^", NULL, 0);
     while (raxNext(&iter)) {
-        mpd_song_free((struct mpd_song *)iter.data);
+        FREE_PTR(iter.data);
     }
     raxStop(&iter);
     raxFree(album_cache->cache);
     album_cache->cache = NULL;
+    album_cache->strings = string_pool_free(album_cache->strings);
+    album_cache->strings_released = 0;
+    album_cache->mtime = 0;
+}
+
+/**
+ * Frees a rax with mpd_song structs representing the albums
+ * @param albums rax to free
+ */
+void album_cache_free_songs(rax *albums) {
+    if (albums == NULL) {
+        return;
+    }
+    raxIterator iter;
+    raxStart(&iter, albums);
+    raxSeek(&iter, "^", NULL, 0);
+    while (raxNext(&iter)) {
+        mpd_song_free((struct mpd_song *)iter.data);
+    }
+    raxStop(&iter);
+    raxFree(albums);
+}
+
+/**
+ * Creates a compact album record from the aggregated album and inserts it in the album cache.
+ * An existing album with the same key is replaced.
+ * @param album_cache pointer to t_cache struct
+ * @param key album key
+ * @param key_len length of the album key
+ * @param album mpd_song struct representing the album
+ * @return true on success, else false
+ */
+bool album_cache_insert(struct t_cache *album_cache, const char *key, size_t key_len, const struct mpd_song *album) {
+    unsigned values_len = 0;
+    for (unsigned tag = 0; tag < MPD_TAG_COUNT; tag++) {
+        unsigned idx = 0;
+        while (mpd_song_get_tag(album, (enum mpd_tag_type)tag, idx) != NULL) {
+            idx++;
+        }
+        values_len += idx;
+    }
+    struct t_album *new_album = malloc_assert(sizeof(struct t_album) + values_len * sizeof(struct t_album_tag_value));
+    new_album->id = string_pool_add_len(album_cache->strings, key, key_len);
+    new_album->uri = string_pool_add(album_cache->strings, mpd_song_get_uri(album));
+    new_album->last_modified = mpd_song_get_last_modified(album);
+    new_album->duration = album_get_total_time(album);
+    new_album->discs = album_get_discs(album);
+    new_album->songs = album_get_song_count(album);
+    new_album->values_len = 0;
+    for (unsigned tag = 0; tag < MPD_TAG_COUNT; tag++) {
+        const char *value;
+        unsigned idx = 0;
+        while ((value = mpd_song_get_tag(album, (enum mpd_tag_type)tag, idx)) != NULL) {
+            new_album->values[new_album->values_len].tag = (enum mpd_tag_type)tag;
+            new_album->values[new_album->values_len].value = string_pool_add(album_cache->strings, value);
+            new_album->values_len++;
+            idx++;
+        }
+    }
+    void *old_data = raxFind(album_cache->cache, (unsigned char *)key, key_len);
+    if (old_data != raxNotFound) {
+        sort_indexes_remove(album_cache, (struct t_album *)old_data);
+    }
+    if (raxInsert(album_cache->cache, (unsigned char *)key, key_len, new_album, &old_data) == 0) {
+        if (errno == ENOMEM) {
+            FREE_PTR(new_album);
+            return false;
+        }
+        // album was replaced
+        album_release_strings(album_cache, (struct t_album *)old_data);
+        FREE_PTR(old_data);
+    }
+    sort_indexes_insert(album_cache, new_album);
+    return true;
+}
+
+/**
+ * Sums up the song count of all albums
+ * @param album_cache pointer to t_cache struct
+ * @return number of songs in the album cache
+ */
+unsigned long album_cache_get_song_count(struct t_cache *album_cache) {
+    if (album_cache->cache == NULL) {
+        return 0;
+    }
+    unsigned long song_count = 0;
+    raxIterator iter;
+    raxStart(&iter, album_cache->cache);
+    raxSeek(&iter, "^", NULL, 0);
+    while (raxNext(&iter)) {
+        song_count += ((struct t_album *)iter.data)->songs;
+    }
+    raxStop(&iter);
+    return song_count;
+}
+
+/**
+ * Gets the sort index for the sort tag, the index is created on first use.
+ * Iterating the index returns the albums in ascending order.
+ * @param album_cache pointer to t_cache struct
+ * @param sort_tag tag to sort by, MPD_TAG_UNKNOWN to sort by Last-Modified
+ * @return rax with the lower cased sort key as key and the album as data
+ */
+rax *album_cache_get_sort_index(struct t_cache *album_cache, enum mpd_tag_type sort_tag) {
+    for (struct t_album_sort_index *current = album_cache->sort_indexes; current != NULL; current = current->next) {
+        if (current->tag == sort_tag) {
+            return current->index;
+        }
+    }
+    MYMPD_LOG_DEBUG(NULL, "Creating album sort index for tag \"%s\"",
+        sort_tag == MPD_TAG_UNKNOWN ? "Last-Modified" : mpd_tag_name(sort_tag));
+    struct t_album_sort_index *sort_index = malloc_assert(sizeof(struct t_album_sort_index));
+    sort_index->tag = sort_tag;
+    sort_index->index = raxNew();
+    raxIterator iter;
+    raxStart(&iter, album_cache->cache);
+    raxSeek(&iter, "^", NULL, 0);
+    while (raxNext(&iter)) {
+        sort_index_insert(sort_index, (struct t_album *)iter.data);
+    }
+    raxStop(&iter);
+    sort_index->next = album_cache->sort_indexes;
+    album_cache->sort_indexes = sort_index;
+    return sort_index->index;
+}
+
+/**
+ * Creates a new and empty album cache delta
+ * @return allocated album cache delta
+ */
+struct t_album_cache_delta *album_cache_delta_new(void) {
+    struct t_album_cache_delta *delta = malloc_assert(sizeof(struct t_album_cache_delta));
+    delta->albums = raxNew();
+    delta->dirs = raxNew();
+    delta->song_count = 0;
+    reset_t_tags(&delta->tags);
+    return delta;
+}
+
+/**
+ * Frees the album cache delta
+ * @param delta pointer to album cache delta
+ * @return NULL
+ */
+void *album_cache_delta_free(struct t_album_cache_delta *delta) {
+    if (delta == NULL) {
+        return NULL;
+    }
+    album_cache_free_songs(delta->albums);
+    raxFree(delta->dirs);
+    FREE_PTR(delta);
+    return NULL;
+}
+
+/**
+ * Applies the changes from the mpd_worker thread to the album cache.
+ * Albums that were found in a changed directory but are not part of the delta
+ * are removed, all albums from the delta are inserted or replaced.
+ * The string pool is rebuilt if at least the half of it was released.
+ * @param album_cache pointer to t_cache struct
+ * @param delta pointer to album cache delta
+ * @return true if the album cache is consistent with the mpd database,
+ *         false if songs are missing or left over and the cache must be rebuilt
+ */
+bool album_cache_delta_apply(struct t_cache *album_cache, struct t_album_cache_delta *delta) {
+    if (album_cache->cache == NULL) {
+        return false;
+    }
+    // collect albums from changed directories
+    struct t_list stale;
+    list_init(&stale);
+    sds dir = sdsempty();
+    raxIterator iter;
+    if (delta->dirs->numele > 0) {
+        raxStart(&iter, album_cache->cache);
+        raxSeek(&iter, "^", NULL, 0);
+        while (raxNext(&iter)) {
+            dir = sds_replace(dir, ((struct t_album *)iter.data)->uri);
+            dir = sds_dirname(dir);
+            if (raxFind(delta->dirs, (unsigned char *)dir, sdslen(dir)) != raxNotFound &&
+                raxFind(delta->albums, iter.key, iter.key_len) == raxNotFound)
+            {
+                list_push_len(&stale, (char *)iter.key, iter.key_len, 0, NULL, 0, NULL);
+            }
+        }
+        raxStop(&iter);
+    }
+    FREE_SDS(dir);
+    // remove stale albums
+    struct t_list_node *current;
+    while ((current = list_shift_first(&stale)) != NULL) {
+        void *old_data;
+        if (raxRemove(album_cache->cache, (unsigned char *)current->key, sdslen(current->key), &old_data) == 1) {
+            sort_indexes_remove(album_cache, (struct t_album *)old_data);
+            album_release_strings(album_cache, (struct t_album *)old_data);
+            FREE_PTR(old_data);
+        }
+        list_node_free(current);
+    }
+    // insert or replace the re-aggregated albums
+    raxStart(&iter, delta->albums);
+    raxSeek(&iter, "^", NULL, 0);
+    while (raxNext(&iter)) {
+        album_cache_insert(album_cache, (char *)iter.key, iter.key_len, (struct mpd_song *)iter.data);
+    }
+    raxStop(&iter);
+    // the string pool is append only, rebuild it after many albums were removed or replaced
+    if (album_cache->strings_released >= ALBUM_CACHE_STRINGS_COMPACT_MIN &&
+        album_cache->strings_released * 2 >= album_cache->strings->bytes)
+    {
+        album_cache_compact_strings(album_cache);
+    }
+    unsigned long song_count = album_cache_get_song_count(album_cache);
+    if (song_count != delta->song_count) {
+        MYMPD_LOG_WARN(NULL, "Album cache has %lu songs, database has %lu songs", song_count, delta->song_count);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Gets a tag value of the album
+ * @param album pointer to t_album struct
+ * @param tag mpd tag type
+ * @param idx index of the tag value
+ * @return the tag value or NULL if not found
+ */
+const char *album_get_tag(const struct t_album *album, enum mpd_tag_type tag, unsigned idx) {
+    for (unsigned i = 0; i < album->values_len; i++) {
+        if (album->values[i].tag == tag) {
+            if (idx == 0) {
+                return album->values[i].value;
+            }
+            idx--;
+        }
+        else if (album->values[i].tag > tag) {
+            // tag values are ordered by tag type
+            break;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Appends a comma separated list of tag values
+ * @param album pointer to t_album struct
+ * @param tag mpd tag type to get values for
+ * @param tag_values already allocated sds string to append the values
+ * @return new sds pointer to tag_values
+ */
+sds album_get_tag_value_string(const struct t_album *album, enum mpd_tag_type tag, sds tag_values) {
+    const char *value;
+    unsigned count = 0;
+    while ((value = album_get_tag(album, tag, count)) != NULL) {
+        if (count++) {
+            tag_values = sdscatlen(tag_values, ", ", 2);
+        }
+        tag_values = sdscat(tag_values, value);
+    }
+    return tag_values;
+}
+
+/**
+ * Replaces the uri
+ * @param album_cache pointer to t_cache struct the album belongs to
+ * @param album pointer to t_album struct
+ * @param uri new uri to set
+ */
+void album_cache_set_uri(struct t_cache *album_cache, struct t_album *album, const char *uri) {
+    // the uri is part of the sort key
+    sort_indexes_remove(album_cache, album);
+    album_cache->strings_released += strlen(album->uri) + 1;
+    album->uri = string_pool_add(album_cache->strings, uri);
+    sort_indexes_insert(album_cache, album);
 }
 
 /**
@@ -538,18 +835,6 @@ bool album_cache_copy_tags(struct mpd_song *song, enum mpd_tag_type src, enum mp
     return true;
 }
 
-/**
- * Replaces the uri
- * @param album pointer to a mpd_song struct
- * @param uri new uri to set
- */
-void album_cache_set_uri(struct mpd_song *album, const char *uri) {
-    free(album->uri);
-    size_t len = strlen(uri);
-    album->uri = malloc_assert(len + 1);
-    snprintf(album->uri, len, "%s", uri);
-}
-
 /**
  * Private functions
  */
@@ -603,3 +888,125 @@ static struct mpd_song *album_from_mpack_node(mpack_node_t album_node, const str
     }
     return album;
 }
+
+/**
+ * Creates the sort key for an album.
+ * The album id is appended to get a unique key.
+ * @param key already allocated sds string to append the key
+ * @param album pointer to t_album struct
+ * @param sort_tag tag to sort by, MPD_TAG_UNKNOWN to sort by Last-Modified
+ * @return pointer to key
+ */
+static sds get_sort_key(sds key, const struct t_album *album, enum mpd_tag_type sort_tag) {
+    if (sort_tag == MPD_TAG_UNKNOWN) {
+        key = sdscatprintf(key, "%020lld::%s", (long long)album->last_modified, album->uri);
+    }
+    else {
+        key = album_get_tag_value_string(album, sort_tag, key);
+        if (sdslen(key) > 0) {
+            key = sdscatfmt(key, "::%s", album->uri);
+        }
+        else {
+            //sort tag not present, append to end of the list
+            MYMPD_LOG_WARN(NULL, "Sort tag \"%s\" not set for \"%s\"", mpd_tag_name(sort_tag), album->id);
+            key = sdscatfmt(key, "zzzzzzzzzz::%s", album->uri);
+        }
+    }
+    sds_utf8_tolower(key);
+    key = sdscatfmt(key, "::%s", album->id);
+    return key;
+}
+
+/**
+ * Inserts an album in a sort index
+ * @param sort_index pointer to the sort index
+ * @param album pointer to t_album struct
+ */
+static void sort_index_insert(struct t_album_sort_index *sort_index, struct t_album *album) {
+    sds key = get_sort_key(sdsempty(), album, sort_index->tag);
+    raxInsert(sort_index->index, (unsigned char *)key, sdslen(key), album, NULL);
+    FREE_SDS(key);
+}
+
+/**
+ * Inserts an album in all sort indexes
+ * @param album_cache pointer to t_cache struct
+ * @param album pointer to t_album struct
+ */
+static void sort_indexes_insert(struct t_cache *album_cache, struct t_album *album) {
+    for (struct t_album_sort_index *current = album_cache->sort_indexes; current != NULL; current = current->next) {
+        sort_index_insert(current, album);
+    }
+}
+
+/**
+ * Removes an album from all sort indexes
+ * @param album_cache pointer to t_cache struct
+ * @param album pointer to t_album struct
+ */
+static void sort_indexes_remove(struct t_cache *album_cache, const struct t_album *album) {
+    if (album_cache->sort_indexes == NULL) {
+        return;
+    }
+    sds key = sdsempty();
+    for (struct t_album_sort_index *current = album_cache->sort_indexes; current != NULL; current = current->next) {
+        key = get_sort_key(key, album, current->tag);
+        raxRemove(current->index, (unsigned char *)key, sdslen(key), NULL);
+        sdsclear(key);
+    }
+    FREE_SDS(key);
+}
+
+/**
+ * Frees all sort indexes
+ * @param album_cache pointer to t_cache struct
+ */
+static void sort_indexes_free(struct t_cache *album_cache) {
+    struct t_album_sort_index *current = album_cache->sort_indexes;
+    while (current != NULL) {
+        struct t_album_sort_index *next = current->next;
+        raxFree(current->index);
+        FREE_PTR(current);
+        current = next;
+    }
+    album_cache->sort_indexes = NULL;
+}
+
+/**
+ * Adds the size of the album strings to the released bytes of the string pool.
+ * Strings are shared between albums, this is the upper limit of the unused bytes.
+ * @param album_cache pointer to t_cache struct
+ * @param album album that is removed from the cache
+ */
+static void album_release_strings(struct t_cache *album_cache, const struct t_album *album) {
+    album_cache->strings_released += strlen(album->id) + strlen(album->uri) + 2;
+    for (unsigned i = 0; i < album->values_len; i++) {
+        album_cache->strings_released += strlen(album->values[i].value) + 1;
+    }
+}
+
+/**
+ * Interns the strings of all albums in a new string pool and frees the old one.
+ * The album records are not moved, the sort indexes are still valid.
+ * @param album_cache pointer to t_cache struct
+ */
+static void album_cache_compact_strings(struct t_cache *album_cache) {
+    struct t_string_pool *strings = string_pool_new();
+    raxIterator iter;
+    raxStart(&iter, album_cache->cache);
+    raxSeek(&iter, "^", NULL, 0);
+    while (raxNext(&iter)) {
+        struct t_album *album = (struct t_album *)iter.data;
+        album->id = string_pool_add(strings, album->id);
+        album->uri = string_pool_add(strings, album->uri);
+        for (unsigned i = 0; i < album->values_len; i++) {
+            album->values[i].value = string_pool_add(strings, album->values[i].value);
+        }
+    }
+    raxStop(&iter);
+    MYMPD_LOG_DEBUG(NULL, "Compacted album cache strings from %lu to %lu bytes",
+        (unsigned long)album_cache->strings->bytes, (unsigned long)strings->bytes);
+    string_pool_free(album_cache->strings);
+    album_cache->strings = strings;
+    album_cache->strings_released = 0;
+}
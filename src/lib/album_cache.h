@@ -12,6 +12,49 @@
 
 #include <stdbool.h>
 
+/**
+ * Tag value of an album
+ */
+struct t_album_tag_value {
+    enum mpd_tag_type tag;  //!< mpd tag type
+    const char *value;      //!< interned tag value
+};
+
+/**
+ * Compact album record of the album cache.
+ * All strings are interned in the string pool of the album cache.
+ */
+struct t_album {
+    const char *id;                      //!< album id, key in the album cache
+    const char *uri;                     //!< uri of the first song
+    time_t last_modified;                //!< last_modified from the newest song
+    unsigned duration;                   //!< total time in seconds
+    unsigned discs;                      //!< number of discs
+    unsigned songs;                      //!< number of songs
+    unsigned values_len;                 //!< number of tag values
+    struct t_album_tag_value values[];   //!< tag values ordered by tag type
+};
+
+/**
+ * Sorted index of the album cache.
+ * Indexes are created on first use and maintained with the album cache.
+ */
+struct t_album_sort_index {
+    enum mpd_tag_type tag;             //!< sort tag, MPD_TAG_UNKNOWN for Last-Modified
+    rax *index;                        //!< lower cased sort key -> struct t_album
+    struct t_album_sort_index *next;   //!< next sort index
+};
+
+/**
+ * Changes of the album cache created by the mpd_worker thread
+ */
+struct t_album_cache_delta {
+    rax *albums;               //!< re-aggregated albums: albumid -> struct mpd_song
+    rax *dirs;                 //!< directories with changed songs
+    unsigned long song_count;  //!< number of songs in the database that belong to an album
+    struct t_tags tags;        //!< tags used to create the albums
+};
+
 enum album_modes parse_album_mode(const char *mode_str);
 const char *lookup_album_mode(enum album_modes mode);
 
@@ -20,8 +63,21 @@ bool album_cache_read(struct t_cache *album_cache, sds workdir, const struct t_a
 bool album_cache_write(struct t_cache *album_cache, sds workdir, const struct t_tags *album_tags, const struct t_albums_config *album_config, bool free_data);
 
 sds album_cache_get_key(sds albumkey, const struct mpd_song *song, const struct t_albums_config *album_config);
-struct mpd_song *album_cache_get_album(struct t_cache *album_cache, sds key);
+struct t_album *album_cache_get_album(struct t_cache *album_cache, sds key);
+void album_cache_init(struct t_cache *album_cache);
 void album_cache_free(struct t_cache *album_cache);
+void album_cache_free_songs(rax *albums);
+bool album_cache_insert(struct t_cache *album_cache, const char *key, size_t key_len, const struct mpd_song *album);
+unsigned long album_cache_get_song_count(struct t_cache *album_cache);
+rax *album_cache_get_sort_index(struct t_cache *album_cache, enum mpd_tag_type sort_tag);
+
+struct t_album_cache_delta *album_cache_delta_new(void);
+void *album_cache_delta_free(struct t_album_cache_delta *delta);
+bool album_cache_delta_apply(struct t_cache *album_cache, struct t_album_cache_delta *delta);
+
+const char *album_get_tag(const struct t_album *album, enum mpd_tag_type tag, unsigned idx);
+sds album_get_tag_value_string(const struct t_album *album, enum mpd_tag_type tag, sds tag_values);
+void album_cache_set_uri(struct t_cache *album_cache, struct t_album *album, const char *uri);
 
 unsigned album_get_discs(const struct mpd_song *album);
 unsigned album_get_total_time(const struct mpd_song *album);
@@ -36,6 +92,5 @@ void album_cache_set_song_count(struct mpd_song *album, unsigned count);
 void album_cache_inc_song_count(struct mpd_song *album);
 bool album_cache_append_tags(struct mpd_song *album, const struct mpd_song *song, const struct t_tags *tags);
 bool album_cache_copy_tags(struct mpd_song *song, enum mpd_tag_type src, enum mpd_tag_type dst);
-void album_cache_set_uri(struct mpd_song *album, const char *uri);
 
 #endif
@@ -13,10 +13,22 @@
 #include "src/lib/msg_queue.h"
 #include "src/lib/sds_extras.h"
 
+#include <pthread.h>
 #include <string.h>
 
+/**
+ * Private definitions
+ */
+
 static const char *mympd_cmd_strs[] = { MYMPD_CMDS(GEN_STR) };
 
+static struct t_response_stream_flow *response_stream_flow_new(void);
+static enum response_stream_flow_states response_stream_flow_acquire(struct t_response_stream_flow *flow, size_t buffered);
+
+/**
+ * Public functions
+ */
+
 /**
  * Converts a string to the mympd_cmd_ids enum
  * @param cmd string to convert
@@ -104,6 +116,7 @@ bool is_mympd_only_api_method(enum mympd_cmd_ids cmd_id) {
         case MYMPD_API_HOME_ICON_LIST:
         case MYMPD_API_SCRIPT_LIST:
         case MYMPD_API_SETTINGS_GET:
+        case MYMPD_API_WORKER_LIST:
             return true;
         default:
             return false;
@@ -161,6 +174,8 @@ struct t_work_response *create_response_new(long long conn_id, long request_id,
     response->binary = sdsempty();
     response->extra = NULL;
     response->partition = sdsnew(partition);
+    response->chunk = RESPONSE_CHUNK_NONE;
+    response->flow = NULL;
     return response;
 }
 
@@ -210,6 +225,7 @@ void free_response(struct t_work_response *response) {
         FREE_SDS(response->data);
         FREE_SDS(response->binary);
         FREE_SDS(response->partition);
+        response_stream_flow_unref(response->flow);
         FREE_PTR(response);
     }
 }
@@ -223,8 +239,8 @@ void free_response(struct t_work_response *response) {
  */
 bool push_response(struct t_work_response *response, long request_id, long long conn_id) {
     if (conn_id == -2) {
-        MYMPD_LOG_DEBUG(NULL, "Push response to mympd_script_queue for thread %ld: %s", request_id, response->data);
-        return mympd_queue_push(mympd_script_queue, response, request_id);
+        MYMPD_LOG_DEBUG(NULL, "Push response to mailbox %ld: %s", request_id, response->data);
+        return mympd_mailbox_push(mympd_script_mailboxes, response, request_id);
     }
     if (conn_id > -1) {
         MYMPD_LOG_DEBUG(NULL, "Push response to queue for connection %lld: %s", conn_id, response->data);
@@ -233,3 +249,179 @@ bool push_response(struct t_work_response *response, long request_id, long long
     free_response(response);
     return true;
 }
+
+/**
+ * Initializes a response stream for a request.
+ * Only responses for webserver connections are streamed.
+ * @param stream pointer to the stream struct to initialize
+ * @param request the request the ids are copied
+ */
+void response_stream_init(struct t_response_stream *stream, struct t_work_request *request) {
+    stream->conn_id = request->conn_id;
+    stream->id = request->id;
+    stream->cmd_id = request->cmd_id;
+    stream->partition = request->partition;
+    stream->started = false;
+    stream->flow = NULL;
+}
+
+/**
+ * Sends the buffer as fragment to the webserver if it exceeds JSONRPC_CHUNK_SIZE.
+ * The producer never waits for the client: while RESPONSE_STREAM_FRAGMENTS_MAX fragments
+ * are not written to the socket the buffer is kept and grows, the stream is aborted
+ * if it exceeds RESPONSE_STREAM_BUFFER_MAX. The buffer is also discarded if the
+ * connection was closed.
+ * @param stream pointer to the stream struct, NULL disables streaming
+ * @param buffer the response buffer
+ * @return the buffer, an empty buffer if it was sent or discarded
+ */
+sds response_stream_push(struct t_response_stream *stream, sds buffer) {
+    if (stream == NULL ||
+        stream->conn_id <= 0 ||
+        sdslen(buffer) < JSONRPC_CHUNK_SIZE)
+    {
+        return buffer;
+    }
+    if (stream->flow == NULL) {
+        stream->flow = response_stream_flow_new();
+    }
+    switch(response_stream_flow_acquire(stream->flow, sdslen(buffer))) {
+        case RESPONSE_STREAM_FLOW_SEND:
+            break;
+        case RESPONSE_STREAM_FLOW_HOLD:
+            return buffer;
+        case RESPONSE_STREAM_FLOW_CLOSED:
+            sdsclear(buffer);
+            return buffer;
+    }
+    struct t_work_response *response = create_response_new(stream->conn_id, stream->id, stream->cmd_id, stream->partition);
+    FREE_SDS(response->data);
+    response->data = buffer;
+    response->chunk = stream->started == false
+        ? RESPONSE_CHUNK_FIRST
+        : RESPONSE_CHUNK_NEXT;
+    response->flow = response_stream_flow_ref(stream->flow);
+    stream->started = true;
+    mympd_queue_push(web_server_queue, response, 0);
+    return sdsempty();
+}
+
+/**
+ * Gets the transfer type for the final response of a stream
+ * and releases the flow control of the producer.
+ * @param stream pointer to the stream struct
+ * @param rc false if the request failed
+ * @return the transfer type
+ */
+enum response_chunk_types response_stream_end(struct t_response_stream *stream, bool rc) {
+    if (stream->flow != NULL) {
+        pthread_mutex_lock(&stream->flow->mutex);
+        if (stream->flow->closed == true) {
+            rc = false;
+        }
+        pthread_mutex_unlock(&stream->flow->mutex);
+        response_stream_flow_unref(stream->flow);
+        stream->flow = NULL;
+    }
+    if (stream->started == false) {
+        return RESPONSE_CHUNK_NONE;
+    }
+    return rc == true
+        ? RESPONSE_CHUNK_LAST
+        : RESPONSE_CHUNK_ABORT;
+}
+
+/**
+ * Adds a reference to the flow control of a stream
+ * @param flow pointer to the flow control struct
+ * @return the flow control struct
+ */
+struct t_response_stream_flow *response_stream_flow_ref(struct t_response_stream_flow *flow) {
+    pthread_mutex_lock(&flow->mutex);
+    flow->refs++;
+    pthread_mutex_unlock(&flow->mutex);
+    return flow;
+}
+
+/**
+ * Removes a reference from the flow control of a stream and frees it
+ * if it was the last reference
+ * @param flow pointer to the flow control struct, can be NULL
+ */
+void response_stream_flow_unref(struct t_response_stream_flow *flow) {
+    if (flow == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&flow->mutex);
+    flow->refs--;
+    unsigned refs = flow->refs;
+    pthread_mutex_unlock(&flow->mutex);
+    if (refs == 0) {
+        pthread_mutex_destroy(&flow->mutex);
+        FREE_PTR(flow);
+    }
+}
+
+/**
+ * Releases fragments that the webserver has written to the socket
+ * @param flow pointer to the flow control struct
+ * @param fragments number of fragments to release
+ * @param closed true if the connection is gone
+ */
+void response_stream_flow_release(struct t_response_stream_flow *flow, unsigned fragments, bool closed) {
+    pthread_mutex_lock(&flow->mutex);
+    flow->in_flight = fragments < flow->in_flight
+        ? flow->in_flight - fragments
+        : 0;
+    if (closed == true) {
+        flow->closed = true;
+    }
+    pthread_mutex_unlock(&flow->mutex);
+}
+
+/**
+ * Private functions
+ */
+
+/**
+ * Mallocs and initializes the flow control for a stream,
+ * the producer holds the first reference
+ * @return the flow control struct
+ */
+static struct t_response_stream_flow *response_stream_flow_new(void) {
+    struct t_response_stream_flow *flow = malloc_assert(sizeof(struct t_response_stream_flow));
+    pthread_mutex_init(&flow->mutex, NULL);
+    flow->in_flight = 0;
+    flow->closed = false;
+    flow->refs = 1;
+    return flow;
+}
+
+/**
+ * Checks for a free fragment slot, does not wait
+ * @param flow pointer to the flow control struct
+ * @param buffered length of the buffer that is not yet sent
+ * @return RESPONSE_STREAM_FLOW_SEND if a fragment can be sent,
+ *         RESPONSE_STREAM_FLOW_HOLD if the buffer should be kept,
+ *         RESPONSE_STREAM_FLOW_CLOSED if the stream is closed
+ */
+static enum response_stream_flow_states response_stream_flow_acquire(struct t_response_stream_flow *flow, size_t buffered) {
+    enum response_stream_flow_states state = RESPONSE_STREAM_FLOW_SEND;
+    pthread_mutex_lock(&flow->mutex);
+    if (flow->closed == true) {
+        state = RESPONSE_STREAM_FLOW_CLOSED;
+    }
+    else if (flow->in_flight < RESPONSE_STREAM_FRAGMENTS_MAX) {
+        flow->in_flight++;
+    }
+    else if (buffered < RESPONSE_STREAM_BUFFER_MAX) {
+        state = RESPONSE_STREAM_FLOW_HOLD;
+    }
+    else {
+        MYMPD_LOG_WARN(NULL, "Client does not read the streamed response, aborting it");
+        flow->closed = true;
+        state = RESPONSE_STREAM_FLOW_CLOSED;
+    }
+    pthread_mutex_unlock(&flow->mutex);
+    return state;
+}
@@ -10,6 +10,7 @@
 #include "dist/sds/sds.h"
 #include "src/lib/list.h"
 
+#include <pthread.h>
 #include <stdbool.h>
 
 /**
@@ -25,6 +26,7 @@
     X(INTERNAL_API_ALBUMCACHE_CREATED) \
     X(INTERNAL_API_ALBUMCACHE_ERROR) \
     X(INTERNAL_API_ALBUMCACHE_SKIPPED) \
+    X(INTERNAL_API_ALBUMCACHE_UPDATED) \
     X(INTERNAL_API_SCRIPT_INIT) \
     X(INTERNAL_API_SCRIPT_POST_EXECUTE) \
     X(INTERNAL_API_STATE_SAVE) \
@@ -192,6 +194,7 @@
     X(MYMPD_API_WEBRADIO_FAVORITE_LIST) \
     X(MYMPD_API_WEBRADIO_FAVORITE_RM) \
     X(MYMPD_API_WEBRADIO_FAVORITE_SAVE) \
+    X(MYMPD_API_WORKER_LIST) \
     X(TOTAL_API_COUNT)
 
 /**
@@ -219,17 +222,62 @@ struct t_work_request {
     sds partition;             //!< mpd partition
 };
 
+/**
+ * Transfer types of api responses
+ */
+enum response_chunk_types {
+    RESPONSE_CHUNK_NONE = 0,  //!< complete response
+    RESPONSE_CHUNK_FIRST,     //!< first fragment of a chunked response
+    RESPONSE_CHUNK_NEXT,      //!< further fragment of a chunked response
+    RESPONSE_CHUNK_LAST,      //!< last fragment of a chunked response
+    RESPONSE_CHUNK_ABORT      //!< the response failed after fragments were sent
+};
+
+/**
+ * Result of the flow control check for a fragment of a streamed response
+ */
+enum response_stream_flow_states {
+    RESPONSE_STREAM_FLOW_SEND,    //!< send the fragment
+    RESPONSE_STREAM_FLOW_HOLD,    //!< too many fragments in flight, keep the buffer
+    RESPONSE_STREAM_FLOW_CLOSED   //!< stream is closed or aborted, discard the buffer
+};
+
+/**
+ * Flow control for a streamed response, shared by the producer and the webserver.
+ * The producer holds back fragments while too many are not yet written to the socket.
+ */
+struct t_response_stream_flow {
+    pthread_mutex_t mutex;  //!< mutex for this struct
+    unsigned in_flight;     //!< fragments pushed but not yet written to the socket
+    bool closed;            //!< true if the connection is gone, the producer discards further fragments
+    unsigned refs;          //!< reference count
+};
+
 /**
  * Struct for work responses in the queue
  */
 struct t_work_response {
+    long long conn_id;                //!< mongoose connection id
+    long id;                          //!< the jsonrpc id
+    enum mympd_cmd_ids cmd_id;        //!< the jsonrpc method as enum
+    sds data;                         //!< full jsonrpc response or a fragment of it
+    sds binary;                       //!< binary data for the response
+    void *extra;                      //!< extra data for the response
+    sds partition;                    //!< mpd partition
+    enum response_chunk_types chunk;  //!< transfer type of the response
+    struct t_response_stream_flow *flow; //!< flow control of a streamed response, NULL if not streamed
+};
+
+/**
+ * State of a jsonrpc response that is streamed in fragments to the webserver
+ */
+struct t_response_stream {
     long long conn_id;         //!< mongoose connection id
     long id;                   //!< the jsonrpc id
     enum mympd_cmd_ids cmd_id; //!< the jsonrpc method as enum
-    sds data;                  //!< full jsonrpc response
-    sds binary;                //!< binary data for the response
-    void *extra;               //!< extra data for the response
-    sds partition;             //!< mpd partition
+    const char *partition;     //!< mpd partition
+    bool started;              //!< true if fragments were already sent
+    struct t_response_stream_flow *flow; //!< flow control, created with the first fragment
 };
 
 /**
@@ -271,5 +319,11 @@ struct t_work_request *create_request(long long conn_id, long request_id, enum m
 void free_request(struct t_work_request *request);
 void free_response(struct t_work_response *response);
 bool push_response(struct t_work_response *response, long request_id, long long conn_id);
+void response_stream_init(struct t_response_stream *stream, struct t_work_request *request);
+sds response_stream_push(struct t_response_stream *stream, sds buffer);
+enum response_chunk_types response_stream_end(struct t_response_stream *stream, bool rc);
+struct t_response_stream_flow *response_stream_flow_ref(struct t_response_stream_flow *flow);
+void response_stream_flow_unref(struct t_response_stream_flow *flow);
+void response_stream_flow_release(struct t_response_stream_flow *flow, unsigned fragments, bool closed);
 
 #endif
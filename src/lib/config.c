@@ -135,6 +135,7 @@ void mympd_config_defaults(struct t_config *config) {
     config->save_caches = startup_getenv_bool("MYMPD_SAVE_CACHES", CFG_MYMPD_SAVE_CACHES, config->first_startup);
     config->mympd_uri = startup_getenv_string("MYMPD_URI", CFG_MYMPD_URI, vcb_isname, config->first_startup);
     config->stickers = startup_getenv_bool("MYMPD_STICKERS", CFG_MYMPD_STICKERS, config->first_startup);
+    config->smartpls_threads = startup_getenv_int("MYMPD_SMARTPLS_THREADS", CFG_MYMPD_SMARTPLS_THREADS, SMARTPLS_THREADS_MIN, SMARTPLS_THREADS_MAX, config->first_startup);
 
     sds album_mode_str = startup_getenv_string("MYMPD_ALBUM_MODE", CFG_MYMPD_ALBUM_MODE, vcb_isname, config->first_startup);
     config->albums.mode = parse_album_mode(album_mode_str);
@@ -181,6 +182,7 @@ bool mympd_config_rw(struct t_config *config, bool write) {
     config->save_caches = state_file_rw_bool(config->workdir, DIR_WORK_CONFIG, "save_caches", config->save_caches, write);
     config->mympd_uri = state_file_rw_string_sds(config->workdir, DIR_WORK_CONFIG, "mympd_uri", config->mympd_uri, vcb_isname, write);
     config->stickers = state_file_rw_bool(config->workdir, DIR_WORK_CONFIG, "stickers", config->stickers, write);
+    config->smartpls_threads = state_file_rw_int(config->workdir, DIR_WORK_CONFIG, "smartpls_threads", config->smartpls_threads, SMARTPLS_THREADS_MIN, SMARTPLS_THREADS_MAX, write);
 
     sds album_mode_str = state_file_rw_string(config->workdir, DIR_WORK_CONFIG, "album_mode", lookup_album_mode(config->albums.mode), vcb_isname, write);
     config->albums.mode = parse_album_mode(album_mode_str);
@@ -46,6 +46,7 @@ struct t_config {
     int covercache_keep_days;       //!< expiration time for covercache files
     int http_port;                  //!< http port to listen
     int loglevel;                   //!< loglevel
+    int smartpls_threads;           //!< number of mpd connections to update smart playlists
     int ssl_port;                   //!< https port to listen
     sds acl;                        //!< IPv4 ACL string
     sds cachedir;                   //!< cache directory
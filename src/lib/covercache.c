@@ -7,16 +7,67 @@
 #include "compile_time.h"
 #include "src/lib/covercache.h"
 
+#include "dist/rax/rax.h"
 #include "src/lib/filehandler.h"
 #include "src/lib/log.h"
+#include "src/lib/mem.h"
 #include "src/lib/mimetype.h"
 #include "src/lib/sds_extras.h"
 
 #include <dirent.h>
 #include <errno.h>
+#include <pthread.h>
+#include <string.h>
 #include <sys/stat.h>
 #include <time.h>
 
+/**
+ * Private definitions
+ */
+
+/**
+ * Cached results of cover lookups expire after this time (seconds)
+ */
+#define COVERCACHE_LOOKUP_TTL 3600
+
+/**
+ * Maximum number of cached lookup results, the cache is cleared if it is full
+ */
+#define COVERCACHE_LOOKUPS_MAX 10000
+
+/**
+ * Entry of the covercache index and the lookup cache
+ */
+struct t_covercache_entry {
+    sds filepath;    //!< full path of the image, empty if no image is available
+    time_t expires;  //!< expiration time, 0 = does not expire
+};
+
+/**
+ * In-memory index of the covercache directory and cached cover lookups.
+ * It is shared by the webserver, mympd_api and coverextract threads.
+ */
+struct t_covercache_index {
+    pthread_mutex_t mutex;  //!< protects the index
+    rax *files;             //!< covercache files, key is the covercache basename
+    rax *lookups;           //!< lookup results, key is size:offset:uri
+};
+
+static struct t_covercache_index covercache_index = {
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+    .files = NULL,
+    .lookups = NULL
+};
+
+static bool write_file(sds cachedir, const char *uri, const char *mime_type, sds binary, int offset, bool thumbnail);
+static sds get_files_key(const char *uri, int offset, bool thumbnail);
+static sds get_lookups_key(const char *uri, int offset, unsigned size);
+static void index_set(rax *index, sds key, const char *filepath, time_t expires);
+static void index_free(rax *index);
+
+/**
+ * Public functions
+ */
 
 /**
  * Writes the coverimage (as binary buffer) to the covercache,
@@ -29,23 +80,20 @@
  * @return true on success else false
  */
 bool covercache_write_file(sds cachedir, const char *uri, const char *mime_type, sds binary, int offset) {
-    if (mime_type[0] == '\0') {
-        MYMPD_LOG_WARN(NULL, "Covercache file for \"%s\" not written, mime_type is empty", uri);
-        return false;
-    }
-    const char *ext = get_ext_by_mime_type(mime_type);
-    if (ext == NULL) {
-        MYMPD_LOG_WARN(NULL, "Covercache file for \"%s\" not written, could not determine file extension", uri);
-        return false;
-    }
-    MYMPD_LOG_DEBUG(NULL, "Writing covercache for \"%s\"", uri);
-    sds filename = sds_hash_sha1(uri);
-    sds filepath = sdscatfmt(sdsempty(), "%S/%s/%S-%i.%s", cachedir, DIR_CACHE_COVER, filename, offset, ext);
-    MYMPD_LOG_DEBUG(NULL, "Writing covercache file \"%s\"", filepath);
-    bool rc = write_data_to_file(filepath, binary, sdslen(binary));
-    FREE_SDS(filename);
-    FREE_SDS(filepath);
-    return rc;
+    return write_file(cachedir, uri, mime_type, binary, offset, false);
+}
+
+/**
+ * Writes the thumbnail of a coverimage to the covercache
+ * @param cachedir covercache directory
+ * @param uri uri of the song for the cover
+ * @param mime_type mime_type of binary buffer
+ * @param binary binary data to save
+ * @param offset number of the coverimage
+ * @return true on success else false
+ */
+bool covercache_write_thumbnail(sds cachedir, const char *uri, const char *mime_type, sds binary, int offset) {
+    return write_file(cachedir, uri, mime_type, binary, offset, true);
 }
 
 /**
@@ -85,13 +133,289 @@ int covercache_clear(sds cachedir, int keepdays) {
             rc = rm_file(filepath);
             if (rc == true) {
                 num_deleted++;
+                //remove the file from the index
+                const char *ext = strrchr(next_file->d_name, '.');
+                size_t key_len = ext != NULL
+                    ? (size_t)(ext - next_file->d_name)
+                    : strlen(next_file->d_name);
+                pthread_mutex_lock(&covercache_index.mutex);
+                struct t_covercache_entry *entry;
+                if (covercache_index.files != NULL &&
+                    raxRemove(covercache_index.files, (unsigned char *)next_file->d_name, key_len, (void **)&entry) == 1)
+                {
+                    FREE_SDS(entry->filepath);
+                    FREE_PTR(entry);
+                }
+                pthread_mutex_unlock(&covercache_index.mutex);
             }
         }
     }
     closedir(covercache_dir);
     FREE_SDS(filepath);
+    covercache_lookup_clear();
 
     MYMPD_LOG_NOTICE(NULL, "Deleted %d files from covercache", num_deleted);
     FREE_SDS(covercache);
     return rc == true ? num_deleted : -1;
 }
+
+/**
+ * Reads the covercache directory into the in-memory index
+ * @param cachedir covercache directory
+ */
+void covercache_index_init(sds cachedir) {
+    rax *files = raxNew();
+    sds covercache = sdscatfmt(sdsempty(), "%S/%s", cachedir, DIR_CACHE_COVER);
+    errno = 0;
+    DIR *covercache_dir = opendir(covercache);
+    if (covercache_dir != NULL) {
+        struct dirent *next_file;
+        sds filepath = sdsempty();
+        while ((next_file = readdir(covercache_dir)) != NULL ) {
+            if (next_file->d_type != DT_REG) {
+                continue;
+            }
+            const char *ext = strrchr(next_file->d_name, '.');
+            if (ext == NULL) {
+                continue;
+            }
+            sdsclear(filepath);
+            filepath = sdscatfmt(filepath, "%S/%s", covercache, next_file->d_name);
+            sds key = sdsnewlen(next_file->d_name, (size_t)(ext - next_file->d_name));
+            index_set(files, key, filepath, 0);
+            FREE_SDS(key);
+        }
+        closedir(covercache_dir);
+        FREE_SDS(filepath);
+    }
+    else {
+        MYMPD_LOG_ERROR(NULL, "Error opening directory \"%s\"", covercache);
+        MYMPD_LOG_ERRNO(NULL, errno);
+    }
+    MYMPD_LOG_INFO(NULL, "Indexed %llu covercache files", (unsigned long long)raxSize(files));
+    FREE_SDS(covercache);
+    pthread_mutex_lock(&covercache_index.mutex);
+    index_free(covercache_index.files);
+    index_free(covercache_index.lookups);
+    covercache_index.files = files;
+    covercache_index.lookups = raxNew();
+    pthread_mutex_unlock(&covercache_index.mutex);
+}
+
+/**
+ * Frees the covercache index and the lookup cache
+ */
+void covercache_index_free(void) {
+    pthread_mutex_lock(&covercache_index.mutex);
+    index_free(covercache_index.files);
+    index_free(covercache_index.lookups);
+    covercache_index.files = NULL;
+    covercache_index.lookups = NULL;
+    pthread_mutex_unlock(&covercache_index.mutex);
+}
+
+/**
+ * Gets the covercache file from the index
+ * @param uri uri of the song for the cover
+ * @param offset number of the coverimage
+ * @param thumbnail true = get the thumbnail
+ * @param filepath pointer to sds string to append the full path of the file
+ * @return true if found, else false
+ */
+bool covercache_index_get(const char *uri, int offset, bool thumbnail, sds *filepath) {
+    sds key = get_files_key(uri, offset, thumbnail);
+    bool rc = false;
+    pthread_mutex_lock(&covercache_index.mutex);
+    void *data = covercache_index.files != NULL
+        ? raxFind(covercache_index.files, (unsigned char *)key, sdslen(key))
+        : raxNotFound;
+    if (data != raxNotFound) {
+        struct t_covercache_entry *entry = (struct t_covercache_entry *)data;
+        *filepath = sdscatsds(*filepath, entry->filepath);
+        rc = true;
+    }
+    pthread_mutex_unlock(&covercache_index.mutex);
+    FREE_SDS(key);
+    return rc;
+}
+
+/**
+ * Caches the result of a cover lookup
+ * @param uri uri of the song for the cover
+ * @param offset number of the coverimage
+ * @param size albumart size
+ * @param filepath full path of the found image or NULL if no image is available
+ */
+void covercache_lookup_set(const char *uri, int offset, unsigned size, const char *filepath) {
+    sds key = get_lookups_key(uri, offset, size);
+    pthread_mutex_lock(&covercache_index.mutex);
+    if (covercache_index.lookups != NULL) {
+        if (raxSize(covercache_index.lookups) >= COVERCACHE_LOOKUPS_MAX) {
+            MYMPD_LOG_DEBUG(NULL, "Cover lookup cache is full, clearing it");
+            index_free(covercache_index.lookups);
+            covercache_index.lookups = raxNew();
+        }
+        index_set(covercache_index.lookups, key, (filepath != NULL ? filepath : ""),
+            time(NULL) + COVERCACHE_LOOKUP_TTL);
+    }
+    pthread_mutex_unlock(&covercache_index.mutex);
+    FREE_SDS(key);
+}
+
+/**
+ * Gets a cached cover lookup result
+ * @param uri uri of the song for the cover
+ * @param offset number of the coverimage
+ * @param size albumart size
+ * @param filepath pointer to sds string to append the full path of a found image
+ * @return the lookup result
+ */
+enum covercache_lookup_result covercache_lookup_get(const char *uri, int offset, unsigned size, sds *filepath) {
+    sds key = get_lookups_key(uri, offset, size);
+    enum covercache_lookup_result rc = COVERCACHE_LOOKUP_UNKNOWN;
+    pthread_mutex_lock(&covercache_index.mutex);
+    void *data = covercache_index.lookups != NULL
+        ? raxFind(covercache_index.lookups, (unsigned char *)key, sdslen(key))
+        : raxNotFound;
+    if (data != raxNotFound) {
+        struct t_covercache_entry *entry = (struct t_covercache_entry *)data;
+        if (entry->expires < time(NULL)) {
+            raxRemove(covercache_index.lookups, (unsigned char *)key, sdslen(key), NULL);
+            FREE_SDS(entry->filepath);
+            FREE_PTR(entry);
+        }
+        else if (sdslen(entry->filepath) == 0) {
+            rc = COVERCACHE_LOOKUP_MISSING;
+        }
+        else {
+            *filepath = sdscatsds(*filepath, entry->filepath);
+            rc = COVERCACHE_LOOKUP_FOUND;
+        }
+    }
+    pthread_mutex_unlock(&covercache_index.mutex);
+    FREE_SDS(key);
+    return rc;
+}
+
+/**
+ * Clears the cached cover lookups,
+ * e.g. after a database change or the change of the cover settings
+ */
+void covercache_lookup_clear(void) {
+    pthread_mutex_lock(&covercache_index.mutex);
+    if (covercache_index.lookups != NULL) {
+        MYMPD_LOG_DEBUG(NULL, "Clearing the cover lookup cache");
+        index_free(covercache_index.lookups);
+        covercache_index.lookups = raxNew();
+    }
+    pthread_mutex_unlock(&covercache_index.mutex);
+}
+
+/**
+ * Private functions
+ */
+
+/**
+ * Writes the image to the covercache and adds it to the index
+ * @param cachedir covercache directory
+ * @param uri uri of the song for the cover
+ * @param mime_type mime_type of binary buffer
+ * @param binary binary data to save
+ * @param offset number of the coverimage
+ * @param thumbnail true = image is a thumbnail
+ * @return true on success else false
+ */
+static bool write_file(sds cachedir, const char *uri, const char *mime_type, sds binary, int offset, bool thumbnail) {
+    if (mime_type[0] == '\0') {
+        MYMPD_LOG_WARN(NULL, "Covercache file for \"%s\" not written, mime_type is empty", uri);
+        return false;
+    }
+    const char *ext = get_ext_by_mime_type(mime_type);
+    if (ext == NULL) {
+        MYMPD_LOG_WARN(NULL, "Covercache file for \"%s\" not written, could not determine file extension", uri);
+        return false;
+    }
+    MYMPD_LOG_DEBUG(NULL, "Writing covercache for \"%s\"", uri);
+    sds key = get_files_key(uri, offset, thumbnail);
+    sds filepath = sdscatfmt(sdsempty(), "%S/%s/%S.%s", cachedir, DIR_CACHE_COVER, key, ext);
+    MYMPD_LOG_DEBUG(NULL, "Writing covercache file \"%s\"", filepath);
+    bool rc = write_data_to_file(filepath, binary, sdslen(binary));
+    if (rc == true) {
+        pthread_mutex_lock(&covercache_index.mutex);
+        if (covercache_index.files != NULL) {
+            index_set(covercache_index.files, key, filepath, 0);
+        }
+        pthread_mutex_unlock(&covercache_index.mutex);
+    }
+    FREE_SDS(key);
+    FREE_SDS(filepath);
+    return rc;
+}
+
+/**
+ * Creates the key for the covercache files index,
+ * it is the basename of the covercache file
+ * @param uri uri of the song for the cover
+ * @param offset number of the coverimage
+ * @param thumbnail true = key for the thumbnail
+ * @return newly allocated sds string
+ */
+static sds get_files_key(const char *uri, int offset, bool thumbnail) {
+    sds key = sds_hash_sha1(uri);
+    key = sdscatfmt(key, "-%i", offset);
+    if (thumbnail == true) {
+        key = sdscat(key, "-thumb");
+    }
+    return key;
+}
+
+/**
+ * Creates the key for the lookup cache
+ * @param uri uri of the song for the cover
+ * @param offset number of the coverimage
+ * @param size albumart size
+ * @return newly allocated sds string
+ */
+static sds get_lookups_key(const char *uri, int offset, unsigned size) {
+    return sdscatfmt(sdsempty(), "%u:%i:%s", size, offset, uri);
+}
+
+/**
+ * Inserts or replaces an entry.
+ * The index mutex must be locked.
+ * @param index the rax tree
+ * @param key the key
+ * @param filepath full path of the image
+ * @param expires expiration time, 0 = does not expire
+ */
+static void index_set(rax *index, sds key, const char *filepath, time_t expires) {
+    struct t_covercache_entry *entry = malloc_assert(sizeof(struct t_covercache_entry));
+    entry->filepath = sdsnew(filepath);
+    entry->expires = expires;
+    struct t_covercache_entry *old;
+    if (raxInsert(index, (unsigned char *)key, sdslen(key), entry, (void **)&old) == 0) {
+        //replaced an existing entry
+        FREE_SDS(old->filepath);
+        FREE_PTR(old);
+    }
+}
+
+/**
+ * Frees the rax tree and its entries
+ * @param index the rax tree
+ */
+static void index_free(rax *index) {
+    if (index == NULL) {
+        return;
+    }
+    raxIterator iter;
+    raxStart(&iter, index);
+    raxSeek(&iter, "^", NULL, 0);
+    while (raxNext(&iter)) {
+        struct t_covercache_entry *entry = (struct t_covercache_entry *)iter.data;
+        FREE_SDS(entry->filepath);
+        FREE_PTR(entry);
+    }
+    raxStop(&iter);
+    raxFree(index);
+}
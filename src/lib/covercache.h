@@ -11,6 +11,22 @@
 
 #include <stdbool.h>
 
+/**
+ * Results of the cover lookup cache
+ */
+enum covercache_lookup_result {
+    COVERCACHE_LOOKUP_UNKNOWN,   //!< no cached result
+    COVERCACHE_LOOKUP_FOUND,     //!< image found
+    COVERCACHE_LOOKUP_MISSING    //!< no image available
+};
+
 bool covercache_write_file(sds cachedir, const char *uri, const char *mime_type, sds binary, int offset);
+bool covercache_write_thumbnail(sds cachedir, const char *uri, const char *mime_type, sds binary, int offset);
 int covercache_clear(sds cachedir, int keepdays);
+void covercache_index_init(sds cachedir);
+void covercache_index_free(void);
+bool covercache_index_get(const char *uri, int offset, bool thumbnail, sds *filepath);
+void covercache_lookup_set(const char *uri, int offset, unsigned size, const char *filepath);
+enum covercache_lookup_result covercache_lookup_get(const char *uri, int offset, unsigned size, sds *filepath);
+void covercache_lookup_clear(void);
 #endif
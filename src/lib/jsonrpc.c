@@ -10,6 +10,7 @@
 #include "dist/mjson/mjson.h"
 #include "src/lib/api.h"
 #include "src/lib/log.h"
+#include "src/lib/mem.h"
 #include "src/lib/sds_extras.h"
 #include "src/lib/sticker.h"
 #include "src/mpd_client/tags.h"
@@ -25,6 +26,56 @@
 /**
  * private definitions
  */
+
+/**
+ * A direct child of a json object or array
+ */
+struct t_json_token {
+    const char *key;    //!< pointer to the quoted key, NULL for array elements
+    int klen;           //!< length of the quoted key
+    const char *value;  //!< pointer to the value
+    int vlen;           //!< length of the value
+    int vtype;          //!< mjson token type of the value
+};
+
+/**
+ * Growable array of json tokens
+ */
+struct t_json_tokens {
+    struct t_json_token *tokens;  //!< the tokens
+    size_t len;                   //!< number of tokens
+    size_t size;                  //!< allocated number of tokens
+};
+
+/**
+ * State of the tokenizer callback
+ */
+struct t_json_tokenizer {
+    struct t_json_tokens *tokens;  //!< tokens to populate
+    int depth;                     //!< current nesting depth
+    int koff;                      //!< offset of the last key at depth 1
+    int klen;                      //!< length of the last key at depth 1
+    int voff;                      //!< offset of the current object or array at depth 1
+};
+
+/**
+ * Index of the $.params children of the current request.
+ * It is created once per request, json_get_* functions are resolving
+ * $.params paths against it instead of rescanning the request.
+ */
+struct t_json_index {
+    const char *json;             //!< the indexed json string, NULL if no index exists
+    size_t len;                   //!< length of the indexed json string
+    struct t_json_tokens params;  //!< the children of $.params
+};
+
+static _Thread_local struct t_json_index json_index;
+
+static int json_find(sds s, const char *path, const char **p, int *n);
+static bool json_get_number(sds s, const char *path, double *value);
+static bool json_tokenize(const char *p, int n, struct t_json_tokens *tokens);
+static int json_tokenize_cb(int ev, const char *s, int off, int len, void *userdata);
+static void json_tokens_clear(struct t_json_tokens *tokens);
 static bool icb_json_get_tag(const char *path, sds key, sds value, int vtype, validate_callback vcb, void *userdata, struct t_jsonrpc_parse_error *error);
 static bool icb_json_get_tag_value(const char *path, sds key, sds value, int vtype, validate_callback vcb, void *userdata, struct t_jsonrpc_parse_error *error);
 static bool json_get_string_unescape(sds s, const char *path, size_t min, size_t max, sds *result, validate_callback vcb, struct t_jsonrpc_parse_error *error);
@@ -659,9 +710,11 @@ sds json_get_cols_as_string(sds s, sds cols, bool *rc) {
  * @return true on success else false
  */
 bool json_get_bool(sds s, const char *path, bool *result, struct t_jsonrpc_parse_error *error) {
-    int v = 0;
-    if (mjson_get_bool(s, (int)sdslen(s), path, &v) != 0) {
-        *result = v == 1 ? true : false;
+    int vtype = json_find(s, path, NULL, NULL);
+    if (vtype == MJSON_TOK_TRUE ||
+        vtype == MJSON_TOK_FALSE)
+    {
+        *result = vtype == MJSON_TOK_TRUE ? true : false;
         return true;
     }
     set_parse_error(error, path, "", "JSON path \"%s\" not found", path);
@@ -709,7 +762,7 @@ bool json_get_int(sds s, const char *path, int min, int max, int *result, struct
  */
 bool json_get_time_max(sds s, const char *path, time_t *result, struct t_jsonrpc_parse_error *error) {
     double value;
-    if (mjson_get_number(s, (int)sdslen(s), path, &value) != 0) {
+    if (json_get_number(s, path, &value) == true) {
         if (value >= 0 && value <= (double)JSONRPC_LLONG_MAX) {
             time_t value_time = (time_t)value;
             *result = value_time;
@@ -747,7 +800,7 @@ bool json_get_long_max(sds s, const char *path, long *result, struct t_jsonrpc_p
  */
 bool json_get_long(sds s, const char *path, long min, long max, long *result, struct t_jsonrpc_parse_error *error) {
     double value;
-    if (mjson_get_number(s, (int)sdslen(s), path, &value) != 0) {
+    if (json_get_number(s, path, &value) == true) {
         long value_long = (long)value;
         if (value_long >= min && value_long <= max) {
             *result = value_long;
@@ -785,7 +838,7 @@ bool json_get_llong_max(sds s, const char *path, long long *result, struct t_jso
  */
 bool json_get_llong(sds s, const char *path, long long min, long long max, long long *result, struct t_jsonrpc_parse_error *error) {
     double value;
-    if (mjson_get_number(s, (int)sdslen(s), path, &value) != 0) {
+    if (json_get_number(s, path, &value) == true) {
         long long value_llong = (long long)value;
         if (value_llong >= min && value_llong <= max) {
             *result = value_llong;
@@ -823,7 +876,7 @@ bool json_get_uint_max(sds s, const char *path, unsigned *result, struct t_jsonr
  */
 bool json_get_uint(sds s, const char *path, unsigned min, unsigned max, unsigned *result, struct t_jsonrpc_parse_error *error) {
     double value;
-    if (mjson_get_number(s, (int)sdslen(s), path, &value) != 0) {
+    if (json_get_number(s, path, &value) == true) {
         if (value >= min && value <= max) {
             *result = (unsigned)value;
             return true;
@@ -915,7 +968,7 @@ bool json_iterate_object(sds s, const char *path, iterate_callback icb, void *ic
     }
     const char *p;
     int n;
-    int otype = mjson_find(s, (int)sdslen(s), path, &p, &n);
+    int otype = json_find(s, path, &p, &n);
     if (otype != MJSON_TOK_OBJECT &&
         otype != MJSON_TOK_ARRAY)
     {
@@ -927,60 +980,64 @@ bool json_iterate_object(sds s, const char *path, iterate_callback icb, void *ic
         //empty object/array
         return true;
     }
+    //tokenize the object/array in one pass
+    struct t_json_tokens tokens = { NULL, 0, 0 };
+    if (json_tokenize(p, n, &tokens) == false) {
+        set_parse_error(error, path, "", "Invalid json for JSON path \"%s\"", path);
+        json_tokens_clear(&tokens);
+        return false;
+    }
     //iterable object/array
     sds value = sdsempty();
     sds key = sdsempty();
     int i = 0;
-    int koff = 0;
-    int klen = 0;
-    int voff = 0;
-    int vlen = 0;
-    int vtype = 0;
-    int off = 0;
-    for (off = 0; (off = mjson_next(p, n, off, &koff, &klen, &voff, &vlen, &vtype)) != 0;) {
+    bool rc = true;
+    for (size_t j = 0; j < tokens.len; j++) {
+        const struct t_json_token *token = &tokens.tokens[j];
+        int klen = token->klen;
+        int vlen = token->vlen;
+        int vtype = token->vtype;
         if (klen > JSONRPC_KEY_MAX) {
             set_parse_error(error, path, key, "Key in JSON path \"%s\" is too long", path);
-            FREE_SDS(value);
-            FREE_SDS(key);
-            return false;
+            rc = false;
+            break;
         }
         if (klen > 2) {
-            if (sds_json_unescape(p + koff + 1, (size_t)(klen - 2), &key) == false ||
+            if (sds_json_unescape(token->key + 1, (size_t)(klen - 2), &key) == false ||
                 vcb_isalnum(value) == false)
             {
                 set_parse_error(error, path, key, "Validation of key in path \"%s\" has failed. Key must be alphanumeric.", path);
-                FREE_SDS(value);
-                FREE_SDS(key);
-                return false;
+                rc = false;
+                break;
             }
         }
         if (vlen > JSONRPC_STR_MAX) {
             set_parse_error(error, path, key, "Value for key \"%s\" in JSON path \"%s\" is too long", key, path);
-            FREE_SDS(value);
-            FREE_SDS(key);
-            return false;
+            rc = false;
+            break;
         }
         switch(vtype) {
             case MJSON_TOK_STRING:
                 if (vlen > 2) {
-                    if (sds_json_unescape(p + voff + 1, (size_t)(vlen - 2), &value) == false) {
+                    if (sds_json_unescape(token->value + 1, (size_t)(vlen - 2), &value) == false) {
                         set_parse_error(error, path, key, "JSON unescape error for value for key \"%s\" in JSON path \"%s\" has failed", key, path);
-                        FREE_SDS(value);
-                        FREE_SDS(key);
-                        return false;
+                        rc = false;
+                        break;
                     }
                 }
                 break;
             case MJSON_TOK_INVALID:
             case MJSON_TOK_NULL:
                 set_parse_error(error, path, key, "Invalid json value type: %s", get_mjson_toktype_name(vtype));
-                FREE_SDS(value);
-                FREE_SDS(key);
-                return false;
+                rc = false;
+                break;
             default:
-                value = sdscatlen(value, p + voff, (size_t)vlen);
+                value = sdscatlen(value, token->value, (size_t)vlen);
                 break;
         }
+        if (rc == false) {
+            break;
+        }
         if (sdslen(key) == 0) {
             //array - fallback to parent key
             const char *key_ptr = strrchr(path, '.');
@@ -990,9 +1047,8 @@ bool json_iterate_object(sds s, const char *path, iterate_callback icb, void *ic
         }
         if (icb(path, key, value, vtype, vcb, icb_userdata, error) == false) {
             MYMPD_LOG_WARN(NULL, "Iteration callback for path \"%s\" has failed", path);
-            FREE_SDS(value);
-            FREE_SDS(key);
-            return false;
+            rc = false;
+            break;
         }
 
         sdsclear(value);
@@ -1005,7 +1061,8 @@ bool json_iterate_object(sds s, const char *path, iterate_callback icb, void *ic
     }
     FREE_SDS(value);
     FREE_SDS(key);
-    return true;
+    json_tokens_clear(&tokens);
+    return rc;
 }
 
 /**
@@ -1188,6 +1245,37 @@ bool json_get_tags(sds s, const char *path, struct t_tags *tags, int max_element
     return json_iterate_object(s, path, icb_json_get_tag, tags, NULL, max_elements, error);
 }
 
+/**
+ * Creates the index of the $.params children for a request in one pass.
+ * The json_get_* functions are resolving $.params paths for this string
+ * against the index until json_index_clear is called.
+ * The string must not be modified while the index exists.
+ * @param s json request to index
+ */
+void json_index_create(sds s) {
+    json_index_clear();
+    const char *p;
+    int n;
+    if (mjson_find(s, (int)sdslen(s), "$.params", &p, &n) == MJSON_TOK_OBJECT &&
+        json_tokenize(p, n, &json_index.params) == false)
+    {
+        // invalid json, fallback to mjson
+        json_tokens_clear(&json_index.params);
+        return;
+    }
+    json_index.json = s;
+    json_index.len = sdslen(s);
+}
+
+/**
+ * Clears the index of the current thread
+ */
+void json_index_clear(void) {
+    json_tokens_clear(&json_index.params);
+    json_index.json = NULL;
+    json_index.len = 0;
+}
+
 /**
  * Searches for a key in json object
  * @param s json object to search
@@ -1196,7 +1284,7 @@ bool json_get_tags(sds s, const char *path, struct t_tags *tags, int max_element
 bool json_find_key(sds s, const char *path) {
     const char *p;
     int n;
-    int vtype = mjson_find(s, (int)sdslen(s), path, &p, &n);
+    int vtype = json_find(s, path, &p, &n);
     return vtype == MJSON_TOK_INVALID ? false : true;
 }
 
@@ -1208,7 +1296,7 @@ bool json_find_key(sds s, const char *path) {
 sds json_get_key_as_sds(sds s, const char *path) {
     const char *p;
     int n;
-    if (mjson_find(s, (int)sdslen(s), path, &p, &n) == MJSON_TOK_INVALID) {
+    if (json_find(s, path, &p, &n) == MJSON_TOK_INVALID) {
         return false;
     }
     return sdsnewlen(p, (size_t)n);
@@ -1332,6 +1420,164 @@ static void set_parse_error(struct t_jsonrpc_parse_error *error, const char *pat
     va_end(args);
 }
 
+/**
+ * Finds the value for a json path.
+ * $.params paths are resolved against the index if it was created for s,
+ * else the json string is scanned by mjson.
+ * @param s json string
+ * @param path mjson path expression
+ * @param p pointer to set to the value, can be NULL
+ * @param n pointer to set to the length of the value, can be NULL
+ * @return mjson token type of the value, MJSON_TOK_INVALID if not found
+ */
+static int json_find(sds s, const char *path, const char **p, int *n) {
+    if (json_index.json != s ||
+        json_index.len != sdslen(s) ||
+        strncmp(path, "$.params.", 9) != 0)
+    {
+        return mjson_find(s, (int)sdslen(s), path, p, n);
+    }
+    const char *key = path + 9;
+    size_t key_len = strcspn(key, ".[");
+    for (size_t i = 0; i < json_index.params.len; i++) {
+        const struct t_json_token *token = &json_index.params.tokens[i];
+        if ((size_t)token->klen - 2 != key_len ||
+            memcmp(token->key + 1, key, key_len) != 0)
+        {
+            continue;
+        }
+        if (key[key_len] == '\0') {
+            if (p != NULL) {
+                *p = token->value;
+            }
+            if (n != NULL) {
+                *n = token->vlen;
+            }
+            return token->vtype;
+        }
+        // resolve the rest of the path relative to the value
+        sds sub_path = sdscatfmt(sdsempty(), "$%s", key + key_len);
+        int vtype = mjson_find(token->value, token->vlen, sub_path, p, n);
+        FREE_SDS(sub_path);
+        return vtype;
+    }
+    return MJSON_TOK_INVALID;
+}
+
+/**
+ * Gets a number by json path
+ * @param s json string
+ * @param path mjson path expression
+ * @param value pointer to double with the result
+ * @return true on success, else false
+ */
+static bool json_get_number(sds s, const char *path, double *value) {
+    const char *p;
+    int n;
+    if (json_find(s, path, &p, &n) != MJSON_TOK_NUMBER) {
+        return false;
+    }
+    return mjson_get_number(p, n, "$", value) != 0;
+}
+
+/**
+ * Collects the direct children of a json object or array in one pass.
+ * This is linear in contrast to iterating with mjson_next.
+ * @param p json object or array
+ * @param n length of p
+ * @param tokens already initialized tokens struct to populate
+ * @return true on success, false on invalid json
+ */
+static bool json_tokenize(const char *p, int n, struct t_json_tokens *tokens) {
+    struct t_json_tokenizer tokenizer = {
+        .tokens = tokens,
+        .depth = 0,
+        .koff = 0,
+        .klen = 0,
+        .voff = 0
+    };
+    return mjson(p, n, json_tokenize_cb, &tokenizer) > 0;
+}
+
+/**
+ * mjson callback for json_tokenize
+ * @param ev mjson event: token type or character
+ * @param s json string
+ * @param off offset of the token
+ * @param len length of the token
+ * @param userdata pointer to t_json_tokenizer struct
+ * @return 0 to continue parsing
+ */
+static int json_tokenize_cb(int ev, const char *s, int off, int len, void *userdata) {
+    struct t_json_tokenizer *tokenizer = (struct t_json_tokenizer *)userdata;
+    int vtype = MJSON_TOK_INVALID;
+    switch (ev) {
+        case '{':
+        case '[':
+            if (tokenizer->depth == 1) {
+                tokenizer->voff = off;
+            }
+            tokenizer->depth++;
+            return 0;
+        case '}':
+        case ']':
+            tokenizer->depth--;
+            if (tokenizer->depth != 1) {
+                return 0;
+            }
+            // end of a nested object or array
+            vtype = ev == '}'
+                ? MJSON_TOK_OBJECT
+                : MJSON_TOK_ARRAY;
+            len = off + len - tokenizer->voff;
+            off = tokenizer->voff;
+            break;
+        case ',':
+        case ':':
+            return 0;
+        case MJSON_TOK_KEY:
+            if (tokenizer->depth == 1) {
+                tokenizer->koff = off;
+                tokenizer->klen = len;
+            }
+            return 0;
+        default:
+            if (tokenizer->depth != 1) {
+                return 0;
+            }
+            vtype = ev;
+            break;
+    }
+    // value at depth 1
+    struct t_json_tokens *tokens = tokenizer->tokens;
+    if (tokens->len == tokens->size) {
+        tokens->size = tokens->size == 0
+            ? 16
+            : tokens->size * 2;
+        tokens->tokens = realloc_assert(tokens->tokens, tokens->size * sizeof(struct t_json_token));
+    }
+    struct t_json_token *token = &tokens->tokens[tokens->len++];
+    token->key = tokenizer->klen > 0
+        ? s + tokenizer->koff
+        : NULL;
+    token->klen = tokenizer->klen;
+    token->value = s + off;
+    token->vlen = len;
+    token->vtype = vtype;
+    tokenizer->klen = 0;
+    return 0;
+}
+
+/**
+ * Frees the tokens and resets the struct
+ * @param tokens tokens struct to clear
+ */
+static void json_tokens_clear(struct t_json_tokens *tokens) {
+    FREE_PTR(tokens->tokens);
+    tokens->len = 0;
+    tokens->size = 0;
+}
+
 /**
  * Helper function to get a string from a json object
  * Enclosing quotes are removed and string is unescaped
@@ -1350,7 +1596,7 @@ static bool json_get_string_unescape(sds s, const char *path, size_t min, size_t
     }
     const char *p;
     int n;
-    int vtype = mjson_find(s, (int)sdslen(s), path, &p, &n);
+    int vtype = json_find(s, path, &p, &n);
     if (vtype != MJSON_TOK_STRING) {
         *result = NULL;
         set_parse_error(error, path, "", "JSON path \"%s\" not found or value is not string type, found type is \"%s\"",
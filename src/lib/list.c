@@ -7,6 +7,7 @@
 #include "compile_time.h"
 #include "src/lib/list.h"
 
+#include "dist/rax/rax.h"
 #include "dist/utf8/utf8.h"
 #include "src/lib/filehandler.h"
 #include "src/lib/log.h"
@@ -14,6 +15,7 @@
 #include "src/lib/random.h"
 #include "src/lib/sds_extras.h"
 
+#include <stdint.h>
 #include <string.h>
 
 /**
@@ -34,6 +36,149 @@ void list_init(struct t_list *l) {
     l->length = 0;
     l->head = NULL;
     l->tail = NULL;
+    l->index = NULL;
+}
+
+/**
+ * Index for the keys and values of a list,
+ * it counts the nodes for each key and value_p.
+ */
+struct t_list_index {
+    rax *keys;    //!< key -> number of nodes
+    rax *values;  //!< value_p -> number of nodes
+};
+
+/**
+ * Increments the counter for a string in an index tree
+ * @param tree index tree
+ * @param str string to count
+ */
+static void list_index_inc(rax *tree, sds str) {
+    void *data = raxFind(tree, (unsigned char *)str, sdslen(str));
+    uintptr_t count = data == raxNotFound
+        ? 1
+        : (uintptr_t)data + 1;
+    raxInsert(tree, (unsigned char *)str, sdslen(str), (void *)count, NULL);
+}
+
+/**
+ * Decrements the counter for a string in an index tree
+ * @param tree index tree
+ * @param str string to uncount
+ */
+static void list_index_dec(rax *tree, sds str) {
+    void *data = raxFind(tree, (unsigned char *)str, sdslen(str));
+    if (data == raxNotFound) {
+        return;
+    }
+    uintptr_t count = (uintptr_t)data;
+    if (count > 1) {
+        raxInsert(tree, (unsigned char *)str, sdslen(str), (void *)(count - 1), NULL);
+    }
+    else {
+        raxRemove(tree, (unsigned char *)str, sdslen(str), NULL);
+    }
+}
+
+/**
+ * Adds a node to the list index
+ * @param l list
+ * @param n node to add
+ */
+static void list_index_add(struct t_list *l, struct t_list_node *n) {
+    if (l->index == NULL) {
+        return;
+    }
+    list_index_inc(l->index->keys, n->key);
+    if (n->value_p != NULL) {
+        list_index_inc(l->index->values, n->value_p);
+    }
+}
+
+/**
+ * Removes a node from the list index
+ * @param l list
+ * @param n node to remove
+ */
+static void list_index_remove(struct t_list *l, struct t_list_node *n) {
+    if (l->index == NULL) {
+        return;
+    }
+    list_index_dec(l->index->keys, n->key);
+    if (n->value_p != NULL) {
+        list_index_dec(l->index->values, n->value_p);
+    }
+}
+
+/**
+ * Frees the list index
+ * @param l list
+ */
+static void list_index_free(struct t_list *l) {
+    if (l->index == NULL) {
+        return;
+    }
+    raxFree(l->index->keys);
+    raxFree(l->index->values);
+    FREE_PTR(l->index);
+}
+
+/**
+ * Creates an index for the keys and values of the list.
+ * The index is kept up to date by all list functions
+ * and freed by list_clear and list_free.
+ * Does nothing if the index already exists.
+ * @param l list
+ */
+void list_index_create(struct t_list *l) {
+    if (l->index != NULL) {
+        return;
+    }
+    l->index = malloc_assert(sizeof(struct t_list_index));
+    l->index->keys = raxNew();
+    l->index->values = raxNew();
+    struct t_list_node *current = l->head;
+    while (current != NULL) {
+        list_index_add(l, current);
+        current = current->next;
+    }
+}
+
+/**
+ * Checks if a node with this key exists.
+ * Uses the index if it exists.
+ * @param l list
+ * @param key key to check
+ * @return true if key exists, else false
+ */
+bool list_has_key(const struct t_list *l, const char *key) {
+    if (l->index != NULL) {
+        return raxFind(l->index->keys, (unsigned char *)key, strlen(key)) != raxNotFound;
+    }
+    return list_get_node(l, key) != NULL;
+}
+
+/**
+ * Checks if a node with this value_p exists.
+ * Uses the index if it exists.
+ * @param l list
+ * @param value_p value to check
+ * @return true if value exists, else false
+ */
+bool list_has_value_p(const struct t_list *l, const char *value_p) {
+    if (l->index != NULL) {
+        return raxFind(l->index->values, (unsigned char *)value_p, strlen(value_p)) != raxNotFound;
+    }
+    struct t_list_node *current = l->head;
+    while (current != NULL) {
+        if (current->value_p != NULL &&
+            strcmp(current->value_p, value_p) == 0)
+        {
+            return true;
+        }
+        current = current->next;
+    }
+    return false;
 }
 
 /**
@@ -69,6 +214,7 @@ void list_clear_user_data(struct t_list *l, user_data_callback free_cb) {
         current = current->next;
         list_node_free_user_data(tmp, free_cb);
     }
+    list_index_free(l);
     list_init(l);
 }
 
@@ -116,6 +262,11 @@ void list_free_cb_ptr_user_data(struct t_list_node *current) {
  * @return int index of the key, -1 if not found
  */
 int list_get_node_idx(const struct t_list *l, const char *key) {
+    if (l->index != NULL &&
+        list_has_key(l, key) == false)
+    {
+        return -1;
+    }
     struct t_list_node *current = l->head;
     int i = 0;
     while (current != NULL) {
@@ -135,6 +286,11 @@ int list_get_node_idx(const struct t_list *l, const char *key) {
  * @return pointer to list node
  */
 struct t_list_node *list_get_node(const struct t_list *l, const char *key) {
+    if (l->index != NULL &&
+        list_has_key(l, key) == false)
+    {
+        return NULL;
+    }
     struct t_list_node *current = l->head;
     while (current != NULL) {
         if (strcmp(current->key, key) == 0) {
@@ -229,6 +385,7 @@ bool list_move_item_pos(struct t_list *l, long from, long to) {
     }
 
     l->length++;
+    list_index_add(l, node);
 
     return true;
 }
@@ -321,6 +478,7 @@ bool list_push_len(struct t_list *l, const char *key, size_t key_len, long long
     n->value_p = value_p != NULL ? sdsnewlen(value_p, value_len) : NULL;
     n->user_data = user_data;
     n->next = NULL;
+    list_index_add(l, n);
 
     if (l->head == NULL) {
         //first entry in the list
@@ -354,6 +512,7 @@ bool list_insert(struct t_list *l, const char *key, long long value_i,
     n->value_i = value_i;
     n->value_p = value_p != NULL ? sdsnew(value_p) : NULL;
     n->user_data = user_data;
+    list_index_add(l, n);
 
     //switch head pointer
     n->next = l->head;
@@ -447,6 +606,7 @@ bool list_replace_len_user_data(struct t_list *l, long idx, const char *key, siz
         return false;
     }
     struct t_list_node *current = list_node_at(l, idx);
+    list_index_remove(l, current);
 
     current->key = sds_replacelen(current->key, key, key_len);
     current->value_i = value_i;
@@ -456,6 +616,7 @@ bool list_replace_len_user_data(struct t_list *l, long idx, const char *key, siz
     else if (current->value_p != NULL) {
         FREE_SDS(current->value_p);
     }
+    list_index_add(l, current);
     if (current->user_data != NULL &&
         free_cb != NULL)
     {
@@ -570,6 +731,7 @@ struct t_list_node *list_node_extract(struct t_list *l, long idx) {
         l->tail = previous;
     }
     l->length--;
+    list_index_remove(l, current);
 
     //null out this node's next value since it's not part of a list anymore
     current->next = NULL;
@@ -662,34 +824,87 @@ static bool list_sort_cmp_key(struct t_list_node *current, struct t_list_node *n
 }
 
 /**
- * The list sorting function.
- * Note that the sort is not very efficient, use it only for short lists.
+ * Merges two sorted node chains, nodes that compare equal keep their order
+ * @param a first sorted chain, its nodes are sorted before equal nodes of b
+ * @param b second sorted chain
+ * @param direction sort direction
+ * @param sort_cb compare function
+ * @return head of the merged chain
+ */
+static struct t_list_node *list_sort_merge(struct t_list_node *a, struct t_list_node *b,
+        enum list_sort_direction direction, list_sort_callback sort_cb)
+{
+    struct t_list_node head;
+    struct t_list_node *tail = &head;
+    while (a != NULL &&
+           b != NULL)
+    {
+        if (sort_cb(a, b, direction) == true) {
+            tail->next = b;
+            b = b->next;
+        }
+        else {
+            tail->next = a;
+            a = a->next;
+        }
+        tail = tail->next;
+    }
+    tail->next = a != NULL
+        ? a
+        : b;
+    return head.next;
+}
+
+/**
+ * Stable bottom-up merge sort for the list nodes.
+ * runs[i] holds a sorted chain of 2^i nodes, every new node is merged
+ * with the runs like a binary counter.
+ * @param l pointer to list to sort
+ * @param direction sort direction
+ * @param sort_cb compare function
+ */
+static void list_sort_nodes(struct t_list *l, enum list_sort_direction direction, list_sort_callback sort_cb) {
+    struct t_list_node *runs[64] = { NULL };
+    struct t_list_node *current = l->head;
+    while (current != NULL) {
+        struct t_list_node *carry = current;
+        current = current->next;
+        carry->next = NULL;
+        unsigned i = 0;
+        for (; runs[i] != NULL; i++) {
+            carry = list_sort_merge(runs[i], carry, direction, sort_cb);
+            runs[i] = NULL;
+        }
+        runs[i] = carry;
+    }
+    // runs with a higher index hold the earlier nodes
+    struct t_list_node *sorted = NULL;
+    for (unsigned i = 0; i < 64; i++) {
+        if (runs[i] != NULL) {
+            sorted = list_sort_merge(runs[i], sorted, direction, sort_cb);
+        }
+    }
+    l->head = sorted;
+}
+
+/**
+ * The list sorting function, a stable merge sort
  * @param l pointer to list to sort
  * @param direction sort direction
  * @param sort_cb compare function
  * @return true on success, else false
  */
 bool list_sort_by_callback(struct t_list *l, enum list_sort_direction direction, list_sort_callback sort_cb) {
-    int swapped;
-    struct t_list_node *ptr1;
-    struct t_list_node *lptr = NULL;
-
     if (l->head == NULL) {
         return false;
     }
-
-    do {
-        swapped = 0;
-        ptr1 = l->head;
-        while (ptr1->next != lptr) {
-            if (sort_cb(ptr1, ptr1->next, direction) == true) {
-                list_swap_item(ptr1, ptr1->next);
-                swapped = 1;
-            }
-            ptr1 = ptr1->next;
-        }
-        lptr = ptr1;
-    } while (swapped);
+    list_sort_nodes(l, direction, sort_cb);
+    // find the new tail
+    struct t_list_node *current = l->head;
+    while (current->next != NULL) {
+        current = current->next;
+    }
+    l->tail = current;
     return true;
 }
 
@@ -22,13 +22,19 @@ struct t_list_node {
     struct t_list_node *next;  //!< pointer to next node
 };
 
+/**
+ * Optional index for the keys and values of a list
+ */
+struct t_list_index;
+
 /**
  * List struct itself
  */
 struct t_list {
-    long length;               //!< length of the list
-    struct t_list_node *head;  //!< pointer to first node
-    struct t_list_node *tail;  //!< pointer to last node
+    long length;                 //!< length of the list
+    struct t_list_node *head;    //!< pointer to first node
+    struct t_list_node *tail;    //!< pointer to last node
+    struct t_list_index *index;  //!< optional key and value_p index, NULL if not created
 };
 
 enum list_sort_direction {
@@ -49,6 +55,9 @@ void *list_free_user_data(struct t_list *l, user_data_callback free_cb);
 void list_free_cb_ignore_user_data(struct t_list_node *current);
 void list_free_cb_sds_user_data(struct t_list_node *current);
 void list_free_cb_ptr_user_data(struct t_list_node *current);
+void list_index_create(struct t_list *l);
+bool list_has_key(const struct t_list *l, const char *key);
+bool list_has_value_p(const struct t_list *l, const char *value_p);
 void *list_node_free_user_data(struct t_list_node *n, user_data_callback free_cb);
 void *list_node_free(struct t_list_node *n);
 
@@ -7,12 +7,17 @@
 #include "compile_time.h"
 #include "src/lib/msg_queue.h"
 
+#include "src/lib/album_cache.h"
 #include "src/lib/api.h"
 #include "src/lib/log.h"
 #include "src/lib/lua_mympd_state.h"
 #include "src/lib/mem.h"
+#include "src/lib/sticker_cache.h"
 
 #include <errno.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
 
 /*
  Message queue implementation to transfer messages between threads asynchronously
@@ -20,9 +25,12 @@
 
 //private definitions
 static void free_queue_node(struct t_mympd_msg *n, enum mympd_queue_types type);
+static void free_data(void *data, enum mympd_queue_types type);
 static void free_queue_node_extra(void *extra, enum mympd_cmd_ids cmd_id);
 static int unlock_mutex(pthread_mutex_t *mutex);
 static void set_wait_time(int timeout, struct timespec *max_wait);
+static void event_set(struct t_mympd_queue *queue);
+static void event_clear(struct t_mympd_queue *queue);
 
 //public functions
 
@@ -41,6 +49,20 @@ struct t_mympd_queue *mympd_queue_create(const char *name, enum mympd_queue_type
     queue->type = type;
     queue->mutex = (pthread_mutex_t)PTHREAD_MUTEX_INITIALIZER;
     queue->wakeup = (pthread_cond_t)PTHREAD_COND_INITIALIZER;
+    queue->event_pending = false;
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, queue->event_fd) != 0) {
+        MYMPD_LOG_ERROR(NULL, "Can not create socket pair for queue \"%s\"", name);
+        MYMPD_LOG_ERRNO(NULL, errno);
+        queue->event_fd[0] = -1;
+        queue->event_fd[1] = -1;
+    }
+    else {
+        for (int i = 0; i < 2; i++) {
+            int flags = fcntl(queue->event_fd[i], F_GETFL, 0);
+            fcntl(queue->event_fd[i], F_SETFL, flags | O_NONBLOCK);
+            fcntl(queue->event_fd[i], F_SETFD, FD_CLOEXEC);
+        }
+    }
     return queue;
 }
 
@@ -50,6 +72,11 @@ struct t_mympd_queue *mympd_queue_create(const char *name, enum mympd_queue_type
  */
 void *mympd_queue_free(struct t_mympd_queue *queue) {
     mympd_queue_expire(queue, 0);
+    for (int i = 0; i < 2; i++) {
+        if (queue->event_fd[i] > -1) {
+            close(queue->event_fd[i]);
+        }
+    }
     FREE_PTR(queue);
     return NULL;
 }
@@ -82,6 +109,7 @@ bool mympd_queue_push(struct t_mympd_queue *queue, void *data, long id) {
         queue->tail->next = new_node;
         queue->tail = new_node;
     }
+    event_set(queue);
     if (unlock_mutex(&queue->mutex) != 0) {
         return false;
     }
@@ -96,7 +124,8 @@ bool mympd_queue_push(struct t_mympd_queue *queue, void *data, long id) {
 /**
  * Gets the first entry or the entry with specific id
  * @param queue pointer to the queue
- * @param timeout timeout in ms to wait for a queue entry, 0 to wait infinite
+ * @param timeout timeout in ms to wait for a queue entry, 0 to wait infinite,
+ *                negative value to return immediately
  * @param id 0 for first entry or specific id
  * @return t_work_request or t_work_response
  */
@@ -109,6 +138,11 @@ void *mympd_queue_shift(struct t_mympd_queue *queue, int timeout, long id) {
     }
     //check and wait for entries
     if (queue->length == 0) {
+        if (timeout < 0) {
+            //do not wait
+            unlock_mutex(&queue->mutex);
+            return NULL;
+        }
         if (timeout > 0) {
             struct timespec max_wait = {0, 0};
             set_wait_time(timeout, &max_wait);
@@ -156,6 +190,9 @@ void *mympd_queue_shift(struct t_mympd_queue *queue, int timeout, long id) {
 
                 FREE_PTR(current);
                 queue->length--;
+                if (queue->length == 0) {
+                    event_clear(queue);
+                }
                 unlock_mutex(&queue->mutex);
                 return data;
             }
@@ -219,11 +256,174 @@ int mympd_queue_expire(struct t_mympd_queue *queue, time_t max_age) {
             }
         }
     }
-
+    if (queue->length == 0) {
+        event_clear(queue);
+    }
     unlock_mutex(&queue->mutex);
     return expired_count;
 }
 
+/**
+ * Returns the file descriptor to poll for new queue entries.
+ * It is readable while the queue has entries, use it with POLLIN.
+ * @param queue pointer to the queue
+ * @return file descriptor or -1 on error
+ */
+int mympd_queue_event_fd(struct t_mympd_queue *queue) {
+    return queue->event_fd[0];
+}
+
+/**
+ * Creates a thread safe registry for mailboxes
+ * @param name description of the registry
+ * @return pointer to allocated and initialized mailboxes struct
+ */
+struct t_mympd_mailboxes *mympd_mailboxes_create(const char *name) {
+    struct t_mympd_mailboxes *mailboxes = malloc_assert(sizeof(struct t_mympd_mailboxes));
+    mailboxes->length = 0;
+    mailboxes->head = NULL;
+    mailboxes->mutex = (pthread_mutex_t)PTHREAD_MUTEX_INITIALIZER;
+    mailboxes->name = name;
+    return mailboxes;
+}
+
+/**
+ * Frees the mailbox registry and undelivered messages.
+ * The mailboxes itself are owned by the waiting threads.
+ * @param mailboxes pointer to the registry
+ */
+void *mympd_mailboxes_free(struct t_mympd_mailboxes *mailboxes) {
+    struct t_mympd_mailbox *current = mailboxes->head;
+    while (current != NULL) {
+        if (current->data != NULL) {
+            free_data(current->data, QUEUE_TYPE_RESPONSE);
+            current->data = NULL;
+        }
+        current = current->next;
+    }
+    FREE_PTR(mailboxes);
+    return NULL;
+}
+
+/**
+ * Initializes a mailbox and registers it.
+ * Open the mailbox before the request is sent to not miss the response.
+ * @param mailboxes pointer to the registry
+ * @param mailbox mailbox to register
+ * @param id id of the awaited message
+ */
+void mympd_mailbox_open(struct t_mympd_mailboxes *mailboxes, struct t_mympd_mailbox *mailbox, long id) {
+    mailbox->id = id;
+    mailbox->data = NULL;
+    mailbox->wakeup = (pthread_cond_t)PTHREAD_COND_INITIALIZER;
+    int rc = pthread_mutex_lock(&mailboxes->mutex);
+    if (rc != 0) {
+        MYMPD_LOG_ERROR(NULL, "Error in pthread_mutex_lock: %d", rc);
+        assert(NULL);
+    }
+    mailbox->next = mailboxes->head;
+    mailboxes->head = mailbox;
+    mailboxes->length++;
+    unlock_mutex(&mailboxes->mutex);
+}
+
+/**
+ * Unregisters a mailbox and frees an undelivered message
+ * @param mailboxes pointer to the registry
+ * @param mailbox mailbox to unregister
+ */
+void mympd_mailbox_close(struct t_mympd_mailboxes *mailboxes, struct t_mympd_mailbox *mailbox) {
+    int rc = pthread_mutex_lock(&mailboxes->mutex);
+    if (rc != 0) {
+        MYMPD_LOG_ERROR(NULL, "Error in pthread_mutex_lock: %d", rc);
+        assert(NULL);
+    }
+    struct t_mympd_mailbox **current = &mailboxes->head;
+    while (*current != NULL) {
+        if (*current == mailbox) {
+            *current = mailbox->next;
+            mailboxes->length--;
+            break;
+        }
+        current = &(*current)->next;
+    }
+    unlock_mutex(&mailboxes->mutex);
+    if (mailbox->data != NULL) {
+        free_data(mailbox->data, QUEUE_TYPE_RESPONSE);
+        mailbox->data = NULL;
+    }
+    pthread_cond_destroy(&mailbox->wakeup);
+}
+
+/**
+ * Delivers a message to the mailbox with the given id and wakes up its owner.
+ * Only the owner of the mailbox is woken up.
+ * The message is freed if no mailbox waits for it.
+ * @param mailboxes pointer to the registry
+ * @param data struct t_work_response
+ * @param id id of the message
+ * @return true if the message was delivered, else false
+ */
+bool mympd_mailbox_push(struct t_mympd_mailboxes *mailboxes, void *data, long id) {
+    int rc = pthread_mutex_lock(&mailboxes->mutex);
+    if (rc != 0) {
+        MYMPD_LOG_ERROR(NULL, "Error in pthread_mutex_lock: %d", rc);
+        free_data(data, QUEUE_TYPE_RESPONSE);
+        return false;
+    }
+    struct t_mympd_mailbox *current = mailboxes->head;
+    while (current != NULL) {
+        if (current->id == id &&
+            current->data == NULL)
+        {
+            current->data = data;
+            rc = pthread_cond_signal(&current->wakeup);
+            if (rc != 0) {
+                MYMPD_LOG_ERROR(NULL, "Error in pthread_cond_signal: %d", rc);
+            }
+            unlock_mutex(&mailboxes->mutex);
+            return true;
+        }
+        current = current->next;
+    }
+    unlock_mutex(&mailboxes->mutex);
+    MYMPD_LOG_WARN(NULL, "No open mailbox in \"%s\" for id %ld, discarding message", mailboxes->name, id);
+    free_data(data, QUEUE_TYPE_RESPONSE);
+    return false;
+}
+
+/**
+ * Waits for the message of a mailbox
+ * @param mailboxes pointer to the registry
+ * @param mailbox the mailbox opened by this thread
+ * @param timeout timeout in ms to wait for the message
+ * @return t_work_response or NULL on timeout
+ */
+void *mympd_mailbox_wait(struct t_mympd_mailboxes *mailboxes, struct t_mympd_mailbox *mailbox, int timeout) {
+    int rc = pthread_mutex_lock(&mailboxes->mutex);
+    if (rc != 0) {
+        MYMPD_LOG_ERROR(NULL, "Error in pthread_mutex_lock: %d", rc);
+        assert(NULL);
+    }
+    struct timespec max_wait = {0, 0};
+    set_wait_time(timeout, &max_wait);
+    while (mailbox->data == NULL) {
+        errno = 0;
+        rc = pthread_cond_timedwait(&mailbox->wakeup, &mailboxes->mutex, &max_wait);
+        if (rc != 0) {
+            if (rc != ETIMEDOUT) {
+                MYMPD_LOG_ERROR(NULL, "Error in pthread_cond_timedwait: %d", rc);
+                MYMPD_LOG_ERRNO(NULL, errno);
+            }
+            break;
+        }
+    }
+    void *data = mailbox->data;
+    mailbox->data = NULL;
+    unlock_mutex(&mailboxes->mutex);
+    return data;
+}
+
 //privat functions
 
 /**
@@ -232,20 +432,28 @@ int mympd_queue_expire(struct t_mympd_queue *queue, time_t max_age) {
  * @param type type of the queue QUEUE_TYPE_REQUEST or QUEUE_TYPE_RESPONSE
  */
 static void free_queue_node(struct t_mympd_msg *node, enum mympd_queue_types type) {
-    //free data
+    free_data(node->data, type);
+    //free the node itself
+    FREE_PTR(node);
+}
+
+/**
+ * Frees a t_work_request or t_work_response struct including the extra data
+ * @param data t_work_request or t_work_response
+ * @param type type of the data QUEUE_TYPE_REQUEST or QUEUE_TYPE_RESPONSE
+ */
+static void free_data(void *data, enum mympd_queue_types type) {
     if (type == QUEUE_TYPE_REQUEST) {
-        struct t_work_request *request = node->data;
+        struct t_work_request *request = data;
         free_queue_node_extra(request->extra, request->cmd_id);
         free_request(request);
     }
     else {
         //QUEUE_TYPE_RESPONSE
-        struct t_work_response *response = node->data;
+        struct t_work_response *response = data;
         free_queue_node_extra(response->extra, response->cmd_id);
         free_response(response);
     }
-    //free the node itself
-    FREE_PTR(node);
 }
 
 /**
@@ -261,6 +469,16 @@ static void free_queue_node_extra(void *extra, enum mympd_cmd_ids cmd_id) {
     if (cmd_id == INTERNAL_API_SCRIPT_INIT) {
         lua_mympd_state_free(extra);
     }
+    else if (cmd_id == INTERNAL_API_ALBUMCACHE_CREATED) {
+        album_cache_free(extra);
+        FREE_PTR(extra);
+    }
+    else if (cmd_id == INTERNAL_API_ALBUMCACHE_UPDATED) {
+        album_cache_delta_free(extra);
+    }
+    else if (cmd_id == INTERNAL_API_STICKERCACHE_CREATED) {
+        sticker_cache_free_rax(extra);
+    }
     else {
         FREE_PTR(extra);
     }
@@ -284,7 +502,6 @@ static int unlock_mutex(pthread_mutex_t *mutex) {
  * @param max_wait timespec struct to populate
  */
 static void set_wait_time(int timeout, struct timespec *max_wait) {
-    timeout = timeout * 1000;
     errno = 0;
     if (clock_gettime(CLOCK_REALTIME, max_wait) == -1) {
         MYMPD_LOG_ERROR(NULL, "Error getting realtime");
@@ -292,11 +509,41 @@ static void set_wait_time(int timeout, struct timespec *max_wait) {
         assert(NULL);
     }
     //timeout in ms
-    if (max_wait->tv_nsec <= (999999999 - timeout)) {
-        max_wait->tv_nsec += timeout;
-    }
-    else {
+    max_wait->tv_sec += timeout / 1000;
+    max_wait->tv_nsec += (long)(timeout % 1000) * 1000000;
+    if (max_wait->tv_nsec > 999999999) {
         max_wait->tv_sec += 1;
-        max_wait->tv_nsec = timeout - (999999999 - max_wait->tv_nsec);
+        max_wait->tv_nsec -= 1000000000;
+    }
+}
+
+/**
+ * Makes the event socket readable, queue mutex must be locked
+ * @param queue pointer to the queue
+ */
+static void event_set(struct t_mympd_queue *queue) {
+    if (queue->event_pending == true ||
+        queue->event_fd[1] == -1)
+    {
+        return;
+    }
+    const char c = 1;
+    if (write(queue->event_fd[1], &c, 1) == 1) {
+        queue->event_pending = true;
+    }
+}
+
+/**
+ * Drains the event socket, queue mutex must be locked
+ * @param queue pointer to the queue
+ */
+static void event_clear(struct t_mympd_queue *queue) {
+    if (queue->event_pending == false) {
+        return;
+    }
+    char buf[16];
+    while (read(queue->event_fd[0], buf, sizeof(buf)) > 0) {
+        //discard the wakeup bytes
     }
+    queue->event_pending = false;
 }
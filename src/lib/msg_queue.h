@@ -37,6 +37,30 @@ struct t_mympd_queue {
     pthread_cond_t wakeup;        //!< condition variable for the mutex
     const char *name;             //!< descriptive name
     enum mympd_queue_types type;  //!< the queue type (request or response)
+    int event_fd[2];              //!< socket pair, the first socket is readable while the queue has entries
+    bool event_pending;           //!< true if a wakeup byte was written to the socket pair
+};
+
+/**
+ * Mailbox for exactly one message.
+ * It is owned by the waiting thread and registered in a t_mympd_mailboxes struct.
+ */
+struct t_mympd_mailbox {
+    long id;                        //!< id of the awaited message
+    void *data;                     //!< the delivered message or NULL
+    pthread_cond_t wakeup;          //!< signaled on delivery, uses the mutex of the registry
+    struct t_mympd_mailbox *next;   //!< pointer to next registered mailbox
+};
+
+/**
+ * Thread safe registry of mailboxes for t_work_response messages,
+ * messages are delivered by id
+ */
+struct t_mympd_mailboxes {
+    int length;                     //!< number of registered mailboxes
+    struct t_mympd_mailbox *head;   //!< pointer to first mailbox
+    pthread_mutex_t mutex;          //!< the mutex
+    const char *name;               //!< descriptive name
 };
 
 struct t_mympd_queue *mympd_queue_create(const char *name, enum mympd_queue_types type);
@@ -44,4 +68,12 @@ void *mympd_queue_free(struct t_mympd_queue *queue);
 bool mympd_queue_push(struct t_mympd_queue *queue, void *data, long id);
 void *mympd_queue_shift(struct t_mympd_queue *queue, int timeout, long id);
 int mympd_queue_expire(struct t_mympd_queue *queue, time_t max_age);
+int mympd_queue_event_fd(struct t_mympd_queue *queue);
+
+struct t_mympd_mailboxes *mympd_mailboxes_create(const char *name);
+void *mympd_mailboxes_free(struct t_mympd_mailboxes *mailboxes);
+void mympd_mailbox_open(struct t_mympd_mailboxes *mailboxes, struct t_mympd_mailbox *mailbox, long id);
+void mympd_mailbox_close(struct t_mympd_mailboxes *mailboxes, struct t_mympd_mailbox *mailbox);
+bool mympd_mailbox_push(struct t_mympd_mailboxes *mailboxes, void *data, long id);
+void *mympd_mailbox_wait(struct t_mympd_mailboxes *mailboxes, struct t_mympd_mailbox *mailbox, int timeout);
 #endif
@@ -11,7 +11,9 @@
 #include "src/lib/mem.h"
 #include "src/lib/sds_extras.h"
 #include "src/lib/utility.h"
+#include "src/mpd_client/jukebox_pool.h"
 #include "src/mpd_client/presets.h"
+#include "src/mpd_client/search_local.h"
 #include "src/mympd_api/home.h"
 #include "src/mympd_api/last_played.h"
 #include "src/mympd_api/timer.h"
@@ -101,6 +103,7 @@ void mympd_state_default(struct t_mympd_state *mympd_state, struct t_config *con
     // do not use the shared mpd_state - we can connect to another mpd server for stickers
     mympd_state->stickerdb->mpd_state = malloc_assert(sizeof(struct t_mpd_state));
     mpd_state_default(mympd_state->stickerdb->mpd_state, mympd_state);
+    sticker_cache_init(&mympd_state->sticker_cache);
     //triggers;
     list_init(&mympd_state->trigger_list);
     //home icons
@@ -132,6 +135,7 @@ void mympd_state_free(struct t_mympd_state *mympd_state) {
     //stickerdb
     mpd_state_free(mympd_state->stickerdb->mpd_state);
     partition_state_free(mympd_state->stickerdb);
+    sticker_cache_free(&mympd_state->sticker_cache);
     //sds
     FREE_SDS(mympd_state->tag_list_search);
     FREE_SDS(mympd_state->tag_list_browse);
@@ -191,6 +195,11 @@ void mpd_state_default(struct t_mpd_state *mpd_state, struct t_mympd_state *mymp
     //album cache
     mpd_state->album_cache.building = false;
     mpd_state->album_cache.cache = NULL;
+    mpd_state->album_cache.mtime = 0;
+    mpd_state->album_cache.strings = NULL;
+    mpd_state->album_cache.strings_released = 0;
+    mpd_state->album_cache.sort_indexes = NULL;
+    mpd_state->search_filter_cache = search_filter_cache_new();
     //init last played songs list
     mpd_state->last_played_count = MYMPD_LAST_PLAYED_COUNT;
     //booklet name
@@ -220,6 +229,7 @@ void mpd_state_features_disable(struct t_mpd_state *mpd_state) {
     mpd_state->feat_consume_oneshot = false;
     mpd_state->feat_playlist_dir_auto = false;
     mpd_state->feat_starts_with = false;
+    mpd_state->feat_db_added = false;
     mpd_state->feat_pcre = true;
 }
 
@@ -235,6 +245,7 @@ void mpd_state_free(struct t_mpd_state *mpd_state) {
     FREE_SDS(mpd_state->playlist_directory_value);
     //caches
     album_cache_free(&mpd_state->album_cache);
+    search_filter_cache_free(mpd_state->search_filter_cache);
     //struct itself
     FREE_PTR(mpd_state);
 }
@@ -280,7 +291,9 @@ void partition_state_default(struct t_partition_state *partition_state, const ch
     //jukebox
     list_init(&partition_state->jukebox_queue);
     list_init(&partition_state->jukebox_queue_tmp);
+    partition_state->jukebox_pool = NULL;
     partition_state->jukebox_mode = JUKEBOX_OFF;
+    partition_state->jukebox_weight = JUKEBOX_WEIGHT_NONE;
     partition_state->jukebox_playlist = sdsnew(MYMPD_JUKEBOX_PLAYLIST);
     partition_state->jukebox_unique_tag.tags_len = 1;
     partition_state->jukebox_unique_tag.tags[0] = MYMPD_JUKEBOX_UNIQUE_TAG;
@@ -334,6 +347,7 @@ void partition_state_free(struct t_partition_state *partition_state) {
     //do not use jukebox_clear wrapper to prevent obsolet notification
     list_clear(&partition_state->jukebox_queue);
     list_clear(&partition_state->jukebox_queue_tmp);
+    partition_state->jukebox_pool = jukebox_pool_free(partition_state->jukebox_pool);
     //lists
     list_clear(&partition_state->last_played);
     list_clear(&partition_state->preset_list);
@@ -12,10 +12,14 @@
 #include "dist/sds/sds.h"
 #include "src/lib/config_def.h"
 #include "src/lib/list.h"
+#include "src/lib/sticker_cache.h"
+#include "src/lib/string_pool.h"
 #include "src/lib/tags.h"
 #include <poll.h>
 #include <time.h>
 
+struct t_jukebox_pool;
+
 /**
  * Jukebox state
  */
@@ -26,6 +30,17 @@ enum jukebox_modes {
     JUKEBOX_UNKNOWN     //!< jukebox mode is unknown
 };
 
+/**
+ * Jukebox sampling weights
+ */
+enum jukebox_weights {
+    JUKEBOX_WEIGHT_NONE,         //!< uniform random selection
+    JUKEBOX_WEIGHT_LIKE,         //!< prefer loved songs
+    JUKEBOX_WEIGHT_PLAY_COUNT,   //!< prefer often played songs
+    JUKEBOX_WEIGHT_LAST_PLAYED,  //!< prefer songs not played for a long time
+    JUKEBOX_WEIGHT_UNKNOWN       //!< jukebox weight is unknown
+};
+
 /**
  * MPD connection states
  */
@@ -43,8 +58,12 @@ enum mpd_conn_states {
  * Holds cache information
  */
 struct t_cache {
-    bool building;  //!< true if the mpd_worker thread is creating the cache
-    rax *cache;     //!< pointer to the cache
+    bool building;                  //!< true if the mpd_worker thread is creating the cache
+    rax *cache;                     //!< pointer to the cache
+    time_t mtime;                   //!< timestamp of the database state the cache reflects
+    struct t_string_pool *strings;  //!< interned strings referenced by the cache entries
+    size_t strings_released;        //!< bytes of string references released since the string pool was built
+    struct t_album_sort_index *sort_indexes;  //!< sort indexes of the album cache, created on demand
 };
 
 /**
@@ -88,9 +107,11 @@ struct t_mpd_state {
     bool feat_consume_oneshot;          //!< mpd supports consume oneshot mode
     bool feat_playlist_dir_auto;        //!< mpd supports autodetection of playlist directory
     bool feat_starts_with;              //!< mpd supports starts_with filter expression
+    bool feat_db_added;                 //!< mpd supports the added-since filter expression
     bool feat_pcre;                     //!< mpd supports pcre for filter expressions
     //caches
     struct t_cache album_cache;         //!< the album cache created by the mpd_worker thread
+    struct t_search_filter_cache *search_filter_cache;  //!< compiled search expressions for local filtering
     //lists
     long last_played_count;             //!< number of songs to keep in the last played list (disk + memory)
     sds booklet_name;                   //!< name of the booklet files
@@ -131,6 +152,7 @@ struct t_partition_state {
     bool player_error;                     //!< signals mpd player error condition
     //jukebox
     enum jukebox_modes jukebox_mode;       //!< the jukebox mode
+    enum jukebox_weights jukebox_weight;   //!< the jukebox sampling weight
     sds jukebox_playlist;                  //!< playlist from which the jukebox queue is generated
     long jukebox_queue_length;             //!< how many songs should the mpd queue have
     long jukebox_last_played;              //!< only add songs with last_played state older than this timestamp
@@ -138,6 +160,7 @@ struct t_partition_state {
     bool jukebox_enforce_unique;           //!< flag indicating if unique constraint is enabled
     struct t_list jukebox_queue;           //!< the jukebox queue itself
     struct t_list jukebox_queue_tmp;       //!< temporary jukebox queue for the add random to queue function
+    struct t_jukebox_pool *jukebox_pool;   //!< candidate songs for the jukebox, NULL if not created
     bool jukebox_ignore_hated;             //!< ignores hated songs for the jukebox mode
     sds jukebox_filter_include;            //!< mpd search filter to include songs / albums
     sds jukebox_filter_exclude;            //!< mpd search filter to exclude songs / albums
@@ -184,8 +207,10 @@ struct t_timer_list {
     long long last_id;                   //!< highest timer id in the list
     int active;                          //!< number of enabled timers
     struct t_list list;                  //!< timer definition
-    struct pollfd ufds[LIST_TIMER_MAX];  //!< timerfds to poll
-    nfds_t ufds_len;                     //!< number of fds in ufds
+    int fd;                              //!< timerfd armed for the next expiring timer, -1 if not created
+    struct t_list_node **heap;           //!< min-heap of scheduled timers ordered by expiration time
+    size_t heap_len;                     //!< number of scheduled timers
+    size_t heap_size;                    //!< allocated size of the heap
 };
 
 /**
@@ -206,7 +231,8 @@ struct t_mympd_state {
     struct t_mpd_state *mpd_state;                //!< mpd state shared across partitions
     struct t_partition_state *partition_state;    //!< list of partition states
     struct t_partition_state *stickerdb;          //!< states for stickerdb connection
-    struct pollfd fds[MPD_CONNECTION_MAX];        //!< mpd connection fds
+    struct t_sticker_cache sticker_cache;         //!< the sticker cache created by the mpd_worker thread
+    struct pollfd fds[MPD_CONNECTION_MAX + 3];  //!< mpd connection fds followed by the wakeup fds
     nfds_t nfds;                                  //!< number of mpd connection fds
     struct t_timer_list timer_list;               //!< list of timers
     struct t_list home_list;                      //!< list of home icons
@@ -46,3 +46,28 @@ long randrange(long lower, long upper) {
     return 0;
 }
 #endif
+
+/**
+ * Random bytes for randdouble, fetched in blocks
+ * to avoid the RAND_bytes overhead for each number.
+ */
+static _Thread_local uint64_t rand_buf[256];
+static _Thread_local size_t rand_buf_pos = 256;
+
+/**
+ * Generates a double type random number in the range (0, 1]
+ * @return random number
+ */
+double randdouble(void) {
+    if (rand_buf_pos == 256) {
+        if (RAND_bytes((unsigned char *)rand_buf, sizeof(rand_buf)) != 1) {
+            MYMPD_LOG_ERROR(NULL, "Error generating random number");
+            assert(NULL);
+            return 1;
+        }
+        rand_buf_pos = 0;
+    }
+    uint64_t buf = rand_buf[rand_buf_pos++];
+    // use the upper 53 bits, the precision of a double
+    return (double)((buf >> 11) + 1) / 9007199254740992.0;
+}
@@ -10,4 +10,5 @@
 #include <inttypes.h>
 
 long randrange(long lower, long upper);
+double randdouble(void);
 #endif
@@ -15,6 +15,12 @@
 #include <openssl/sha.h>
 #include <string.h>
 
+#if defined(__SSE2__)
+    #include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    #include <arm_neon.h>
+#endif
+
 #define HEXTOI(x) ((x) >= '0' && (x) <= '9' ? (x) - '0' : (x) - 'W')
 
 /**
@@ -184,6 +190,58 @@ void sds_utf8_tolower(sds s) {
     }
 }
 
+/**
+ * Gets the length of the leading run of chars that need no json escaping.
+ * These are all chars except control chars, double quote and backslash.
+ * Scans 16 bytes at once with SSE2 or NEON if available.
+ * @param p string to scan
+ * @param len length of the string
+ * @return length of the leading safe run
+ */
+static size_t json_safe_len(const char *p, size_t len) {
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i control = _mm_set1_epi8(0x1f);
+    for (; i + 16 <= len; i += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)(const void *)(p + i));
+        // unsigned compare: chunk <= 0x1f if max(chunk, 0x1f) == 0x1f
+        __m128i unsafe = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)),
+            _mm_cmpeq_epi8(_mm_max_epu8(chunk, control), control));
+        int mask = _mm_movemask_epi8(unsafe);
+        if (mask != 0) {
+            return i + (size_t)__builtin_ctz((unsigned)mask);
+        }
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    const uint8x16_t quote = vdupq_n_u8('"');
+    const uint8x16_t backslash = vdupq_n_u8('\\');
+    const uint8x16_t control = vdupq_n_u8(0x20);
+    for (; i + 16 <= len; i += 16) {
+        uint8x16_t chunk = vld1q_u8((const uint8_t *)p + i);
+        uint8x16_t unsafe = vorrq_u8(
+            vorrq_u8(vceqq_u8(chunk, quote), vceqq_u8(chunk, backslash)),
+            vcltq_u8(chunk, control));
+        if (vmaxvq_u8(unsafe) != 0) {
+            // the scalar loop finds the position
+            break;
+        }
+    }
+#endif
+    for (; i < len; i++) {
+        unsigned char c = (unsigned char)p[i];
+        if (c < 0x20 ||
+            c == '"' ||
+            c == '\\')
+        {
+            break;
+        }
+    }
+    return i;
+}
+
 /**
  * Append to the sds string "s" a json escaped string
  * After the call, the modified sds string is no longer valid and all the
@@ -197,9 +255,20 @@ sds sds_catjson_plain(sds s, const char *p, size_t len) {
     /* To avoid continuous reallocations, let's start with a buffer that
      * can hold at least stringlength + 10 chars. */
     s = sdsMakeRoomFor(s, len + 10);
-    while (len--) {
+    while (len > 0) {
+        // copy runs of chars that need no escaping at once
+        size_t safe_len = json_safe_len(p, len);
+        if (safe_len > 0) {
+            s = sdscatlen(s, p, safe_len);
+            p += safe_len;
+            len -= safe_len;
+            if (len == 0) {
+                break;
+            }
+        }
         s = sds_catjsonchar(s, *p);
         p++;
+        len--;
     }
     return s;
 }
@@ -214,15 +283,8 @@ sds sds_catjson_plain(sds s, const char *p, size_t len) {
  * @return modified sds string
  */
 sds sds_catjson(sds s, const char *p, size_t len) {
-    /* To avoid continuous reallocations, let's start with a buffer that
-     * can hold at least stringlength + 10 chars. */
-    s = sdsMakeRoomFor(s, len + 10);
-
     s = sdscatlen(s, "\"", 1);
-    while (len--) {
-        s = sds_catjsonchar(s, *p);
-        p++;
-    }
+    s = sds_catjson_plain(s, p, len);
     return sdscatlen(s, "\"", 1);
 }
 
@@ -0,0 +1,324 @@
+/*
+ SPDX-License-Identifier: GPL-3.0-or-later
+ myMPD (c) 2018-2023 Juergen Mang <mail@jcgames.de>
+ https://github.com/jcorporation/mympd
+*/
+
+#include "compile_time.h"
+#include "src/lib/sticker_cache.h"
+
+#include "dist/mpack/mpack.h"
+#include "src/lib/filehandler.h"
+#include "src/lib/log.h"
+#include "src/lib/mem.h"
+#include "src/lib/mpack.h"
+#include "src/lib/sds_extras.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+/**
+ * Private definitions
+ */
+
+static long long *get_entry(rax *cache, const char *uri, size_t uri_len);
+static void set_defaults(long long *values);
+
+/**
+ * Public functions
+ */
+
+/**
+ * Initializes the sticker cache struct
+ * @param sticker_cache pointer to the sticker cache
+ */
+void sticker_cache_init(struct t_sticker_cache *sticker_cache) {
+    sticker_cache->cache = NULL;
+    sticker_cache->building = false;
+    sticker_cache->outdated = false;
+    sticker_cache->own_writes = 0;
+    list_init(&sticker_cache->pending);
+}
+
+/**
+ * Frees the cached stickers and pending writes
+ * @param sticker_cache pointer to the sticker cache
+ */
+void sticker_cache_free(struct t_sticker_cache *sticker_cache) {
+    sticker_cache_free_rax(sticker_cache->cache);
+    sticker_cache->cache = NULL;
+    list_clear(&sticker_cache->pending);
+}
+
+/**
+ * Replaces the cached stickers with a freshly created cache.
+ * Own writes that were done while the cache was built are applied to the new cache.
+ * @param sticker_cache pointer to the sticker cache
+ * @param cache new cache, the sticker cache takes ownership
+ */
+void sticker_cache_replace(struct t_sticker_cache *sticker_cache, rax *cache) {
+    sticker_cache_free_rax(sticker_cache->cache);
+    sticker_cache->cache = cache;
+    struct t_list_node *current;
+    while ((current = list_shift_first(&sticker_cache->pending)) != NULL) {
+        enum mympd_sticker_types type = sticker_name_parse(current->value_p);
+        if (type != STICKER_UNKNOWN) {
+            sticker_cache_insert(cache, current->key, sdslen(current->key), type, current->value_i);
+        }
+        list_node_free(current);
+    }
+}
+
+/**
+ * Populates the sticker struct from the cache.
+ * Songs without a cache entry have no stickers set.
+ * @param sticker_cache pointer to the sticker cache
+ * @param uri song uri
+ * @param sticker pointer to t_sticker struct to populate
+ * @return true if the cache is available, else false
+ */
+bool sticker_cache_get(const struct t_sticker_cache *sticker_cache, const char *uri, struct t_sticker *sticker) {
+    if (sticker_cache->cache == NULL) {
+        return false;
+    }
+    sticker_struct_init(sticker);
+    void *data = raxFind(sticker_cache->cache, (unsigned char *)uri, strlen(uri));
+    if (data != raxNotFound) {
+        memcpy(sticker->mympd, data, sizeof(sticker->mympd));
+    }
+    return true;
+}
+
+/**
+ * Gets a single sticker value from the cache
+ * @param sticker_cache pointer to the sticker cache
+ * @param uri song uri
+ * @param type myMPD sticker type
+ * @return the sticker value or its default
+ */
+long long sticker_cache_get_value(const struct t_sticker_cache *sticker_cache, const char *uri, enum mympd_sticker_types type) {
+    if (sticker_cache->cache != NULL) {
+        void *data = raxFind(sticker_cache->cache, (unsigned char *)uri, strlen(uri));
+        if (data != raxNotFound) {
+            return ((long long *)data)[type];
+        }
+    }
+    return type == STICKER_LIKE
+        ? STICKER_LIKE_NEUTRAL
+        : 0;
+}
+
+/**
+ * Sets a sticker value in the cache
+ * @param sticker_cache pointer to the sticker cache
+ * @param uri song uri
+ * @param type myMPD sticker type
+ * @param value sticker value
+ */
+void sticker_cache_set(struct t_sticker_cache *sticker_cache, const char *uri, enum mympd_sticker_types type, long long value) {
+    if (sticker_cache->cache != NULL) {
+        sticker_cache_insert(sticker_cache->cache, uri, strlen(uri), type, value);
+    }
+    if (sticker_cache->building == true) {
+        // the mpd_worker thread could have read the old value
+        list_push(&sticker_cache->pending, uri, value, sticker_name_lookup(type), NULL);
+    }
+}
+
+/**
+ * Sets a sticker value in a cache tree
+ * @param cache the cache tree
+ * @param uri song uri
+ * @param uri_len length of the uri
+ * @param type myMPD sticker type
+ * @param value sticker value
+ */
+void sticker_cache_insert(rax *cache, const char *uri, size_t uri_len, enum mympd_sticker_types type, long long value) {
+    long long *values = get_entry(cache, uri, uri_len);
+    values[type] = value;
+}
+
+/**
+ * Frees a sticker cache tree
+ * @param cache the cache tree
+ */
+void sticker_cache_free_rax(rax *cache) {
+    if (cache == NULL) {
+        return;
+    }
+    raxIterator iter;
+    raxStart(&iter, cache);
+    raxSeek(&iter, "^", NULL, 0);
+    while (raxNext(&iter)) {
+        FREE_PTR(iter.data);
+    }
+    raxStop(&iter);
+    raxFree(cache);
+}
+
+/**
+ * Reads the sticker cache from disc
+ * @param sticker_cache pointer to the sticker cache
+ * @param workdir myMPD working directory
+ * @return bool true on success, else false
+ */
+bool sticker_cache_read(struct t_sticker_cache *sticker_cache, sds workdir) {
+    sds filepath = sdscatfmt(sdsempty(), "%S/%s/%s", workdir, DIR_WORK_TAGS, FILENAME_STICKERCACHE);
+    if (testfile_read(filepath) == false) {
+        FREE_SDS(filepath);
+        return false;
+    }
+    mpack_tree_t tree;
+    mpack_tree_init_filename(&tree, filepath, 0);
+    mpack_tree_set_error_handler(&tree, log_mpack_node_error);
+    FREE_SDS(filepath);
+    mpack_tree_parse(&tree);
+    mpack_node_t root = mpack_tree_root(&tree);
+
+    rax *cache = raxNew();
+    mpack_node_t stickers_node = mpack_node_map_cstr(root, "stickers");
+    size_t len = mpack_node_array_length(stickers_node);
+    for (size_t i = 0; i < len; i++) {
+        mpack_node_t sticker_node = mpack_node_array_at(stickers_node, i);
+        mpack_node_t uri_node = mpack_node_map_cstr(sticker_node, "uri");
+        const char *uri = mpack_node_str(uri_node);
+        size_t uri_len = mpack_node_strlen(uri_node);
+        if (uri == NULL ||
+            uri_len == 0)
+        {
+            break;
+        }
+        long long *values = get_entry(cache, uri, uri_len);
+        for (unsigned type = 0; type < STICKER_COUNT; type++) {
+            mpack_node_t value_node = mpack_node_map_cstr_optional(sticker_node, sticker_name_lookup((enum mympd_sticker_types)type));
+            if (mpack_node_is_missing(value_node) == false) {
+                values[type] = (long long)mpack_node_i64(value_node);
+            }
+        }
+    }
+    // clean up and check for errors
+    bool rc = mpack_tree_destroy(&tree) != mpack_ok
+        ? false
+        : true;
+    if (rc == false) {
+        MYMPD_LOG_ERROR(NULL, "Reading sticker cache failed, discarding cache");
+        sticker_cache_free_rax(cache);
+        sticker_cache_remove(workdir);
+        return false;
+    }
+    sticker_cache_free_rax(sticker_cache->cache);
+    sticker_cache->cache = cache;
+    MYMPD_LOG_INFO(NULL, "Read stickers for %llu song(s) from disc", (unsigned long long)cache->numele);
+    return true;
+}
+
+/**
+ * Saves the sticker cache to disc in mpack format
+ * @param cache the cache tree to save
+ * @param workdir myMPD working directory
+ * @return bool true on success, else false
+ */
+bool sticker_cache_write(rax *cache, sds workdir) {
+    if (cache == NULL) {
+        MYMPD_LOG_DEBUG(NULL, "Sticker cache is NULL not saving anything");
+        return true;
+    }
+    MYMPD_LOG_INFO(NULL, "Saving sticker cache to disc");
+    mpack_writer_t writer;
+    sds tmp_file = sdscatfmt(sdsempty(), "%S/%s/%s.XXXXXX", workdir, DIR_WORK_TAGS, FILENAME_STICKERCACHE);
+    FILE *fp = open_tmp_file(tmp_file);
+    if (fp == NULL) {
+        FREE_SDS(tmp_file);
+        return false;
+    }
+    // init mpack
+    mpack_writer_init_stdfile(&writer, fp, true);
+    mpack_writer_set_error_handler(&writer, log_mpack_write_error);
+    mpack_build_map(&writer);
+    mpack_write_cstr(&writer, "stickers");
+    mpack_start_array(&writer, (uint32_t)cache->numele);
+    raxIterator iter;
+    raxStart(&iter, cache);
+    raxSeek(&iter, "^", NULL, 0);
+    while (raxNext(&iter)) {
+        const long long *values = (long long *)iter.data;
+        mpack_build_map(&writer);
+        mpack_write_cstr(&writer, "uri");
+        mpack_write_str(&writer, (char *)iter.key, (uint32_t)iter.key_len);
+        for (unsigned type = 0; type < STICKER_COUNT; type++) {
+            mpack_write_kv(&writer, sticker_name_lookup((enum mympd_sticker_types)type), (int64_t)values[type]);
+        }
+        mpack_complete_map(&writer);
+    }
+    raxStop(&iter);
+    mpack_finish_array(&writer);
+    mpack_complete_map(&writer);
+    // finish writing
+    bool rc = mpack_writer_destroy(&writer) != mpack_ok
+        ? false
+        : true;
+    if (rc == false) {
+        rm_file(tmp_file);
+        MYMPD_LOG_ERROR(NULL, "An error occurred encoding the data");
+        FREE_SDS(tmp_file);
+        return false;
+    }
+    // rename tmp file
+    sds filepath = sdscatlen(sdsempty(), tmp_file, sdslen(tmp_file) - 7);
+    errno = 0;
+    if (rename(tmp_file, filepath) == -1) {
+        MYMPD_LOG_ERROR(NULL, "Rename file from \"%s\" to \"%s\" failed", tmp_file, filepath);
+        MYMPD_LOG_ERRNO(NULL, errno);
+        rm_file(tmp_file);
+        rc = false;
+    }
+    FREE_SDS(filepath);
+    FREE_SDS(tmp_file);
+    return rc;
+}
+
+/**
+ * Removes the sticker cache file
+ * @param workdir myMPD working directory
+ * @return bool true on success, else false
+ */
+bool sticker_cache_remove(sds workdir) {
+    sds filepath = sdscatfmt(sdsempty(), "%S/%s/%s", workdir, DIR_WORK_TAGS, FILENAME_STICKERCACHE);
+    int rc = try_rm_file(filepath);
+    FREE_SDS(filepath);
+    return rc == RM_FILE_ERROR
+        ? false
+        : true;
+}
+
+/**
+ * Private functions
+ */
+
+/**
+ * Gets or creates the cache entry for a song
+ * @param cache the cache tree
+ * @param uri song uri
+ * @param uri_len length of the uri
+ * @return pointer to the array of sticker values
+ */
+static long long *get_entry(rax *cache, const char *uri, size_t uri_len) {
+    void *data = raxFind(cache, (unsigned char *)uri, uri_len);
+    if (data != raxNotFound) {
+        return (long long *)data;
+    }
+    long long *values = malloc_assert(sizeof(long long) * STICKER_COUNT);
+    set_defaults(values);
+    raxInsert(cache, (unsigned char *)uri, uri_len, values, NULL);
+    return values;
+}
+
+/**
+ * Sets the default sticker values
+ * @param values array of sticker values
+ */
+static void set_defaults(long long *values) {
+    memset(values, 0, sizeof(long long) * STICKER_COUNT);
+    values[STICKER_LIKE] = STICKER_LIKE_NEUTRAL;
+}
@@ -0,0 +1,43 @@
+/*
+ SPDX-License-Identifier: GPL-3.0-or-later
+ myMPD (c) 2018-2023 Juergen Mang <mail@jcgames.de>
+ https://github.com/jcorporation/mympd
+*/
+
+#ifndef MYMPD_STICKER_CACHE_H
+#define MYMPD_STICKER_CACHE_H
+
+#include "dist/rax/rax.h"
+#include "dist/sds/sds.h"
+#include "src/lib/list.h"
+#include "src/lib/sticker.h"
+
+#include <stdbool.h>
+
+/**
+ * In-memory cache of the myMPD song stickers.
+ * It is created by the mpd_worker thread and owned by the mympd_api thread.
+ */
+struct t_sticker_cache {
+    rax *cache;             //!< song uri -> array of STICKER_COUNT values, NULL if not available
+    bool building;          //!< true if the mpd_worker thread is creating the cache
+    bool outdated;          //!< stickers were changed by another client while the cache was built
+    unsigned own_writes;    //!< number of sticker writes from myMPD that are not acknowledged by an idle event
+    struct t_list pending;  //!< own writes while the cache is built, they are applied to the new cache
+};
+
+void sticker_cache_init(struct t_sticker_cache *sticker_cache);
+void sticker_cache_free(struct t_sticker_cache *sticker_cache);
+void sticker_cache_replace(struct t_sticker_cache *sticker_cache, rax *cache);
+bool sticker_cache_get(const struct t_sticker_cache *sticker_cache, const char *uri, struct t_sticker *sticker);
+long long sticker_cache_get_value(const struct t_sticker_cache *sticker_cache, const char *uri, enum mympd_sticker_types type);
+void sticker_cache_set(struct t_sticker_cache *sticker_cache, const char *uri, enum mympd_sticker_types type, long long value);
+
+void sticker_cache_insert(rax *cache, const char *uri, size_t uri_len, enum mympd_sticker_types type, long long value);
+void sticker_cache_free_rax(rax *cache);
+
+bool sticker_cache_read(struct t_sticker_cache *sticker_cache, sds workdir);
+bool sticker_cache_write(rax *cache, sds workdir);
+bool sticker_cache_remove(sds workdir);
+
+#endif
@@ -0,0 +1,185 @@
+/*
+ SPDX-License-Identifier: GPL-3.0-or-later
+ myMPD (c) 2018-2023 Juergen Mang <mail@jcgames.de>
+ https://github.com/jcorporation/mympd
+*/
+
+#include "compile_time.h"
+#include "src/lib/string_pool.h"
+
+#include "src/lib/mem.h"
+
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * Private definitions
+ */
+
+#define STRING_POOL_SLOTS_INITIAL 1024
+#define STRING_POOL_BLOCK_SIZE 65536
+
+static uint64_t string_hash(const char *value, size_t len);
+static void string_pool_grow(struct t_string_pool *pool);
+static const char *string_pool_store(struct t_string_pool *pool, const char *value, size_t len);
+
+/**
+ * Public functions
+ */
+
+/**
+ * Creates a new and empty string pool
+ * @return allocated string pool
+ */
+struct t_string_pool *string_pool_new(void) {
+    struct t_string_pool *pool = malloc_assert(sizeof(struct t_string_pool));
+    pool->slots_len = STRING_POOL_SLOTS_INITIAL;
+    pool->slots = malloc_assert(pool->slots_len * sizeof(const char *));
+    memset(pool->slots, 0, pool->slots_len * sizeof(const char *));
+    pool->count = 0;
+    pool->bytes = 0;
+    pool->blocks = NULL;
+    return pool;
+}
+
+/**
+ * Frees the string pool and all interned strings
+ * @param pool pointer to string pool
+ * @return NULL
+ */
+void *string_pool_free(struct t_string_pool *pool) {
+    if (pool == NULL) {
+        return NULL;
+    }
+    struct t_string_pool_block *block = pool->blocks;
+    while (block != NULL) {
+        struct t_string_pool_block *next = block->next;
+        FREE_PTR(block);
+        block = next;
+    }
+    FREE_PTR(pool->slots);
+    FREE_PTR(pool);
+    return NULL;
+}
+
+/**
+ * Interns a null terminated string
+ * @param pool pointer to string pool
+ * @param value string to intern
+ * @return pointer to the interned string, it is valid until the pool is freed
+ */
+const char *string_pool_add(struct t_string_pool *pool, const char *value) {
+    return string_pool_add_len(pool, value, strlen(value));
+}
+
+/**
+ * Interns a string
+ * @param pool pointer to string pool
+ * @param value string to intern
+ * @param len length of the string
+ * @return pointer to the interned string, it is valid until the pool is freed
+ */
+const char *string_pool_add_len(struct t_string_pool *pool, const char *value, size_t len) {
+    size_t mask = pool->slots_len - 1;
+    size_t idx = (size_t)string_hash(value, len) & mask;
+    while (pool->slots[idx] != NULL) {
+        const char *interned = pool->slots[idx];
+        if (strncmp(interned, value, len) == 0 &&
+            interned[len] == '\0')
+        {
+            return interned;
+        }
+        idx = (idx + 1) & mask;
+    }
+    const char *interned = string_pool_store(pool, value, len);
+    pool->slots[idx] = interned;
+    pool->count++;
+    if (pool->count * 2 >= pool->slots_len) {
+        // keep the load factor below 0.5
+        string_pool_grow(pool);
+    }
+    return interned;
+}
+
+/**
+ * Private functions
+ */
+
+/**
+ * FNV-1a hash function
+ * @param value string to hash
+ * @param len length of the string
+ * @return the hash
+ */
+static uint64_t string_hash(const char *value, size_t len) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (unsigned char)value[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+/**
+ * Doubles the size of the hash table
+ * @param pool pointer to string pool
+ */
+static void string_pool_grow(struct t_string_pool *pool) {
+    size_t slots_len = pool->slots_len * 2;
+    size_t mask = slots_len - 1;
+    const char **slots = malloc_assert(slots_len * sizeof(const char *));
+    memset(slots, 0, slots_len * sizeof(const char *));
+    for (size_t i = 0; i < pool->slots_len; i++) {
+        if (pool->slots[i] == NULL) {
+            continue;
+        }
+        size_t idx = (size_t)string_hash(pool->slots[i], strlen(pool->slots[i])) & mask;
+        while (slots[idx] != NULL) {
+            idx = (idx + 1) & mask;
+        }
+        slots[idx] = pool->slots[i];
+    }
+    FREE_PTR(pool->slots);
+    pool->slots = slots;
+    pool->slots_len = slots_len;
+}
+
+/**
+ * Copies the string to the memory blocks of the pool
+ * @param pool pointer to string pool
+ * @param value string to copy
+ * @param len length of the string
+ * @return pointer to the copy
+ */
+static const char *string_pool_store(struct t_string_pool *pool, const char *value, size_t len) {
+    struct t_string_pool_block *block = pool->blocks;
+    if (len + 1 > STRING_POOL_BLOCK_SIZE) {
+        // dedicated block for a large string, keep the current block for small strings
+        block = malloc_assert(sizeof(struct t_string_pool_block) + len + 1);
+        block->size = len + 1;
+        block->used = 0;
+        if (pool->blocks != NULL) {
+            block->next = pool->blocks->next;
+            pool->blocks->next = block;
+        }
+        else {
+            block->next = NULL;
+            pool->blocks = block;
+        }
+    }
+    else if (block == NULL ||
+        block->size - block->used < len + 1)
+    {
+        block = malloc_assert(sizeof(struct t_string_pool_block) + STRING_POOL_BLOCK_SIZE);
+        block->size = STRING_POOL_BLOCK_SIZE;
+        block->used = 0;
+        block->next = pool->blocks;
+        pool->blocks = block;
+    }
+    char *interned = block->data + block->used;
+    memcpy(interned, value, len);
+    interned[len] = '\0';
+    block->used += len + 1;
+    pool->bytes += len + 1;
+    return interned;
+}
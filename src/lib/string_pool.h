@@ -0,0 +1,39 @@
+/*
+ SPDX-License-Identifier: GPL-3.0-or-later
+ myMPD (c) 2018-2023 Juergen Mang <mail@jcgames.de>
+ https://github.com/jcorporation/mympd
+*/
+
+#ifndef MYMPD_STRING_POOL_H
+#define MYMPD_STRING_POOL_H
+
+#include <stddef.h>
+
+/**
+ * Memory block for the interned strings
+ */
+struct t_string_pool_block {
+    struct t_string_pool_block *next;  //!< pointer to the next block
+    size_t size;                       //!< size of the data
+    size_t used;                       //!< used bytes of the data
+    char data[];                       //!< the strings
+};
+
+/**
+ * Pool of interned strings.
+ * Each distinct string is stored only once, strings are freed with the pool.
+ */
+struct t_string_pool {
+    const char **slots;                  //!< open addressing hash table of the strings
+    size_t slots_len;                    //!< number of slots, always a power of two
+    size_t count;                        //!< number of strings in the pool
+    size_t bytes;                        //!< size of all strings including the null terminators
+    struct t_string_pool_block *blocks;  //!< memory blocks holding the strings
+};
+
+struct t_string_pool *string_pool_new(void);
+void *string_pool_free(struct t_string_pool *pool);
+const char *string_pool_add(struct t_string_pool *pool, const char *value);
+const char *string_pool_add_len(struct t_string_pool *pool, const char *value, size_t len);
+
+#endif
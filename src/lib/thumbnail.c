@@ -0,0 +1,367 @@
+/*
+ SPDX-License-Identifier: GPL-3.0-or-later
+ myMPD (c) 2018-2023 Juergen Mang <mail@jcgames.de>
+ https://github.com/jcorporation/mympd
+*/
+
+#include "compile_time.h"
+#include "src/lib/thumbnail.h"
+
+#include "src/lib/log.h"
+#include "src/lib/mem.h"
+
+#include <string.h>
+
+//optional includes
+#ifdef MYMPD_ENABLE_LIBJPEG
+    #include <setjmp.h>
+    #include <stdio.h>
+    #include <jpeglib.h>
+#endif
+
+#ifdef MYMPD_ENABLE_LIBPNG
+    #include <png.h>
+#endif
+
+/**
+ * Private definitions
+ */
+
+#ifdef MYMPD_ENABLE_LIBJPEG
+
+/**
+ * Maximum number of pixels of a decoded image
+ */
+#define THUMBNAIL_PIXELS_MAX 50000000
+
+/**
+ * Decoded image with 3 bytes (RGB) per pixel
+ */
+struct t_thumbnail_image {
+    unsigned char *pixels;  //!< pixel data
+    unsigned width;         //!< width in pixels
+    unsigned height;        //!< height in pixels
+    bool scaled;            //!< true if the image was already scaled down while decoding
+};
+
+/**
+ * Error manager for libjpeg that returns to the caller instead of exiting
+ */
+struct t_jpeg_error {
+    struct jpeg_error_mgr pub;  //!< libjpeg error manager
+    jmp_buf setjmp_buffer;      //!< return point
+};
+
+static void jpeg_error_exit(j_common_ptr cinfo);
+static void jpeg_output_message(j_common_ptr cinfo);
+static bool decode_jpeg(sds binary, unsigned max_size, struct t_thumbnail_image *image);
+#ifdef MYMPD_ENABLE_LIBPNG
+    static bool decode_png(sds binary, struct t_thumbnail_image *image);
+#endif
+static void downscale(const struct t_thumbnail_image *src, unsigned max_size, struct t_thumbnail_image *dst);
+static bool encode_jpeg(const struct t_thumbnail_image *image, sds *thumbnail);
+
+#endif
+
+/**
+ * Public functions
+ */
+
+/**
+ * Checks if thumbnails can be created for this image type
+ * @param mime_type mime type of the image
+ * @return true if supported, else false
+ */
+bool thumbnail_is_supported(const char *mime_type) {
+    #ifdef MYMPD_ENABLE_LIBJPEG
+        if (strcmp(mime_type, "image/jpeg") == 0) {
+            return true;
+        }
+        #ifdef MYMPD_ENABLE_LIBPNG
+            if (strcmp(mime_type, "image/png") == 0) {
+                return true;
+            }
+        #endif
+    #else
+        (void) mime_type;
+    #endif
+    return false;
+}
+
+/**
+ * Creates a jpeg thumbnail that fits in a max_size x max_size square.
+ * Images that are already small enough are copied unchanged.
+ * @param binary the image
+ * @param mime_type mime type of the image
+ * @param max_size maximum width and height of the thumbnail
+ * @param thumbnail pointer to already allocated sds string to append the thumbnail
+ * @return true on success, else false
+ */
+bool thumbnail_create(sds binary, const char *mime_type, unsigned max_size, sds *thumbnail) {
+    #ifdef MYMPD_ENABLE_LIBJPEG
+        struct t_thumbnail_image image = {NULL, 0, 0, false};
+        bool rc = false;
+        if (strcmp(mime_type, "image/jpeg") == 0) {
+            rc = decode_jpeg(binary, max_size, &image);
+        }
+        #ifdef MYMPD_ENABLE_LIBPNG
+            else if (strcmp(mime_type, "image/png") == 0) {
+                rc = decode_png(binary, &image);
+            }
+        #endif
+        if (rc == false) {
+            return false;
+        }
+        if (image.width <= max_size &&
+            image.height <= max_size)
+        {
+            if (image.scaled == true) {
+                //scaled by libjpeg to the requested size
+                rc = encode_jpeg(&image, thumbnail);
+                FREE_PTR(image.pixels);
+                return rc;
+            }
+            MYMPD_LOG_DEBUG(NULL, "Image is already small enough (%ux%u)", image.width, image.height);
+            FREE_PTR(image.pixels);
+            *thumbnail = sdscatsds(*thumbnail, binary);
+            return true;
+        }
+        struct t_thumbnail_image scaled;
+        downscale(&image, max_size, &scaled);
+        MYMPD_LOG_DEBUG(NULL, "Scaled image from %ux%u to %ux%u", image.width, image.height, scaled.width, scaled.height);
+        FREE_PTR(image.pixels);
+        rc = encode_jpeg(&scaled, thumbnail);
+        FREE_PTR(scaled.pixels);
+        return rc;
+    #else
+        (void) binary;
+        (void) mime_type;
+        (void) max_size;
+        (void) thumbnail;
+        return false;
+    #endif
+}
+
+/**
+ * Private functions
+ */
+
+#ifdef MYMPD_ENABLE_LIBJPEG
+
+/**
+ * Replaces the libjpeg error_exit function that terminates the process
+ * @param cinfo libjpeg struct
+ */
+static void jpeg_error_exit(j_common_ptr cinfo) {
+    struct t_jpeg_error *err = (struct t_jpeg_error *)cinfo->err;
+    char buffer[JMSG_LENGTH_MAX];
+    (*cinfo->err->format_message)(cinfo, buffer);
+    MYMPD_LOG_WARN(NULL, "Error processing image: %s", buffer);
+    longjmp(err->setjmp_buffer, 1);
+}
+
+/**
+ * Redirects libjpeg warnings to the debug log
+ * @param cinfo libjpeg struct
+ */
+static void jpeg_output_message(j_common_ptr cinfo) {
+    char buffer[JMSG_LENGTH_MAX];
+    (*cinfo->err->format_message)(cinfo, buffer);
+    MYMPD_LOG_DEBUG(NULL, "libjpeg: %s", buffer);
+}
+
+/**
+ * Decodes a jpeg image.
+ * Large images are already scaled down by libjpeg while decoding,
+ * but not below max_size.
+ * @param binary the image
+ * @param max_size the requested thumbnail size
+ * @param image pointer to the struct for the decoded image
+ * @return true on success, else false
+ */
+static bool decode_jpeg(sds binary, unsigned max_size, struct t_thumbnail_image *image) {
+    struct jpeg_decompress_struct cinfo;
+    struct t_jpeg_error jerr;
+    cinfo.err = jpeg_std_error(&jerr.pub);
+    jerr.pub.error_exit = jpeg_error_exit;
+    jerr.pub.output_message = jpeg_output_message;
+    if (setjmp(jerr.setjmp_buffer)) {
+        jpeg_destroy_decompress(&cinfo);
+        FREE_PTR(image->pixels);
+        return false;
+    }
+    jpeg_create_decompress(&cinfo);
+    jpeg_mem_src(&cinfo, (const unsigned char *)binary, (unsigned long)sdslen(binary));
+    jpeg_read_header(&cinfo, TRUE);
+    if (cinfo.jpeg_color_space == JCS_CMYK ||
+        cinfo.jpeg_color_space == JCS_YCCK)
+    {
+        MYMPD_LOG_DEBUG(NULL, "CMYK jpeg images are not supported");
+        jpeg_destroy_decompress(&cinfo);
+        return false;
+    }
+    cinfo.out_color_space = JCS_RGB;
+    //let libjpeg scale down by 1/2, 1/4 or 1/8 while decoding
+    unsigned longest = cinfo.image_width > cinfo.image_height
+        ? cinfo.image_width
+        : cinfo.image_height;
+    cinfo.scale_num = 1;
+    cinfo.scale_denom = 1;
+    while (cinfo.scale_denom < 8 &&
+           longest / (cinfo.scale_denom * 2) >= max_size)
+    {
+        cinfo.scale_denom *= 2;
+    }
+    jpeg_start_decompress(&cinfo);
+    if ((size_t)cinfo.output_width * cinfo.output_height > THUMBNAIL_PIXELS_MAX) {
+        MYMPD_LOG_WARN(NULL, "Image is too large (%ux%u)", cinfo.output_width, cinfo.output_height);
+        jpeg_destroy_decompress(&cinfo);
+        return false;
+    }
+    image->width = cinfo.output_width;
+    image->height = cinfo.output_height;
+    image->scaled = cinfo.scale_denom > 1;
+    size_t stride = (size_t)image->width * 3;
+    image->pixels = malloc_assert(stride * image->height);
+    while (cinfo.output_scanline < cinfo.output_height) {
+        JSAMPROW row = image->pixels + (size_t)cinfo.output_scanline * stride;
+        jpeg_read_scanlines(&cinfo, &row, 1);
+    }
+    jpeg_finish_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+    return true;
+}
+
+#ifdef MYMPD_ENABLE_LIBPNG
+/**
+ * Decodes a png image,
+ * transparent pixels are composed on a white background
+ * @param binary the image
+ * @param image pointer to the struct for the decoded image
+ * @return true on success, else false
+ */
+static bool decode_png(sds binary, struct t_thumbnail_image *image) {
+    png_image png;
+    memset(&png, 0, sizeof(png));
+    png.version = PNG_IMAGE_VERSION;
+    if (png_image_begin_read_from_memory(&png, binary, sdslen(binary)) == 0) {
+        MYMPD_LOG_WARN(NULL, "Error processing image: %s", png.message);
+        return false;
+    }
+    if ((size_t)png.width * png.height > THUMBNAIL_PIXELS_MAX) {
+        MYMPD_LOG_WARN(NULL, "Image is too large (%ux%u)", png.width, png.height);
+        png_image_free(&png);
+        return false;
+    }
+    png.format = PNG_FORMAT_RGB;
+    image->width = png.width;
+    image->height = png.height;
+    image->scaled = false;
+    image->pixels = malloc_assert(PNG_IMAGE_SIZE(png));
+    png_color background = {255, 255, 255};
+    if (png_image_finish_read(&png, &background, image->pixels, 0, NULL) == 0) {
+        MYMPD_LOG_WARN(NULL, "Error processing image: %s", png.message);
+        png_image_free(&png);
+        FREE_PTR(image->pixels);
+        return false;
+    }
+    return true;
+}
+#endif
+
+/**
+ * Scales the image down with a box filter, the aspect ratio is preserved
+ * @param src the source image
+ * @param max_size maximum width and height of the scaled image
+ * @param dst pointer to the struct for the scaled image
+ */
+static void downscale(const struct t_thumbnail_image *src, unsigned max_size, struct t_thumbnail_image *dst) {
+    if (src->width >= src->height) {
+        dst->width = max_size;
+        dst->height = (unsigned)((size_t)src->height * max_size / src->width);
+    }
+    else {
+        dst->height = max_size;
+        dst->width = (unsigned)((size_t)src->width * max_size / src->height);
+    }
+    if (dst->width == 0) {
+        dst->width = 1;
+    }
+    if (dst->height == 0) {
+        dst->height = 1;
+    }
+    size_t src_stride = (size_t)src->width * 3;
+    dst->scaled = true;
+    dst->pixels = malloc_assert((size_t)dst->width * dst->height * 3);
+    unsigned char *out = dst->pixels;
+    for (unsigned y = 0; y < dst->height; y++) {
+        size_t y0 = (size_t)y * src->height / dst->height;
+        size_t y1 = (size_t)(y + 1) * src->height / dst->height;
+        if (y1 == y0) {
+            y1 = y0 + 1;
+        }
+        for (unsigned x = 0; x < dst->width; x++) {
+            size_t x0 = (size_t)x * src->width / dst->width;
+            size_t x1 = (size_t)(x + 1) * src->width / dst->width;
+            if (x1 == x0) {
+                x1 = x0 + 1;
+            }
+            size_t sum[3] = {0, 0, 0};
+            for (size_t sy = y0; sy < y1; sy++) {
+                const unsigned char *in = src->pixels + sy * src_stride + x0 * 3;
+                for (size_t sx = x0; sx < x1; sx++) {
+                    sum[0] += in[0];
+                    sum[1] += in[1];
+                    sum[2] += in[2];
+                    in += 3;
+                }
+            }
+            size_t count = (y1 - y0) * (x1 - x0);
+            *out++ = (unsigned char)(sum[0] / count);
+            *out++ = (unsigned char)(sum[1] / count);
+            *out++ = (unsigned char)(sum[2] / count);
+        }
+    }
+}
+
+/**
+ * Encodes the image as jpeg
+ * @param image the image
+ * @param thumbnail pointer to already allocated sds string to append the jpeg image
+ * @return true on success, else false
+ */
+static bool encode_jpeg(const struct t_thumbnail_image *image, sds *thumbnail) {
+    struct jpeg_compress_struct cinfo;
+    struct t_jpeg_error jerr;
+    unsigned char *buffer = NULL;
+    unsigned long buffer_len = 0;
+    cinfo.err = jpeg_std_error(&jerr.pub);
+    jerr.pub.error_exit = jpeg_error_exit;
+    jerr.pub.output_message = jpeg_output_message;
+    if (setjmp(jerr.setjmp_buffer)) {
+        jpeg_destroy_compress(&cinfo);
+        FREE_PTR(buffer);
+        return false;
+    }
+    jpeg_create_compress(&cinfo);
+    jpeg_mem_dest(&cinfo, &buffer, &buffer_len);
+    cinfo.image_width = image->width;
+    cinfo.image_height = image->height;
+    cinfo.input_components = 3;
+    cinfo.in_color_space = JCS_RGB;
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, COVERCACHE_THUMBNAIL_QUALITY, TRUE);
+    jpeg_start_compress(&cinfo, TRUE);
+    size_t stride = (size_t)image->width * 3;
+    while (cinfo.next_scanline < cinfo.image_height) {
+        JSAMPROW row = image->pixels + (size_t)cinfo.next_scanline * stride;
+        jpeg_write_scanlines(&cinfo, &row, 1);
+    }
+    jpeg_finish_compress(&cinfo);
+    jpeg_destroy_compress(&cinfo);
+    *thumbnail = sdscatlen(*thumbnail, buffer, buffer_len);
+    FREE_PTR(buffer);
+    return true;
+}
+
+#endif
@@ -0,0 +1,17 @@
+/*
+ SPDX-License-Identifier: GPL-3.0-or-later
+ myMPD (c) 2018-2023 Juergen Mang <mail@jcgames.de>
+ https://github.com/jcorporation/mympd
+*/
+
+#ifndef MYMPD_THUMBNAIL_H
+#define MYMPD_THUMBNAIL_H
+
+#include "dist/sds/sds.h"
+
+#include <stdbool.h>
+
+bool thumbnail_is_supported(const char *mime_type);
+bool thumbnail_create(sds binary, const char *mime_type, unsigned max_size, sds *thumbnail);
+
+#endif
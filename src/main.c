@@ -13,6 +13,7 @@
 #include "src/lib/cert.h"
 #include "src/lib/config.h"
 #include "src/lib/config_def.h"
+#include "src/lib/covercache.h"
 #include "src/lib/env.h"
 #include "src/lib/filehandler.h"
 #include "src/lib/handle_options.h"
@@ -37,6 +38,15 @@
     #include <FLAC/export.h>
 #endif
 
+#ifdef MYMPD_ENABLE_LIBJPEG
+    #include <stdio.h>
+    #include <jpeglib.h>
+#endif
+
+#ifdef MYMPD_ENABLE_LIBPNG
+    #include <png.h>
+#endif
+
 #include <grp.h>
 #include <openssl/opensslv.h>
 #include <pthread.h>
@@ -64,13 +74,12 @@ const char *__asan_default_options(void) {
 #endif
 
 //global variables
-_Atomic int worker_threads;
 //signal handler
 sig_atomic_t s_signal_received;
 //message queues
 struct t_mympd_queue *web_server_queue;
 struct t_mympd_queue *mympd_api_queue;
-struct t_mympd_queue *mympd_script_queue;
+struct t_mympd_mailboxes *mympd_script_mailboxes;
 
 /**
  * Signal handler that stops myMPD on SIGTERM and SIGINT and saves
@@ -85,7 +94,6 @@ static void mympd_signal_handler(int sig_num) {
             s_signal_received = sig_num;
             //Wakeup queue loops
             pthread_cond_signal(&mympd_api_queue->wakeup);
-            pthread_cond_signal(&mympd_script_queue->wakeup);
             pthread_cond_signal(&web_server_queue->wakeup);
             MYMPD_LOG_NOTICE(NULL, "Signal \"%s\" received, exiting", (sig_num == SIGTERM ? "SIGTERM" : "SIGINT"));
             break;
@@ -350,7 +358,6 @@ int main(int argc, char **argv) {
     #endif
 
     //set initial states
-    worker_threads = 0;
     s_signal_received = 0;
     struct t_config *config = NULL;
     struct t_mg_user_data *mg_user_data = NULL;
@@ -373,7 +380,7 @@ int main(int argc, char **argv) {
 
     mympd_api_queue = mympd_queue_create("mympd_api_queue", QUEUE_TYPE_REQUEST);
     web_server_queue = mympd_queue_create("web_server_queue", QUEUE_TYPE_RESPONSE);
-    mympd_script_queue = mympd_queue_create("mympd_script_queue", QUEUE_TYPE_RESPONSE);
+    mympd_script_mailboxes = mympd_mailboxes_create("mympd_script_mailboxes");
 
     //mympd config defaults
     config = malloc_assert(sizeof(struct t_config));
@@ -474,6 +481,12 @@ int main(int argc, char **argv) {
     #ifdef MYMPD_ENABLE_FLAC
         MYMPD_LOG_INFO(NULL, "FLAC %d.%d.%d", FLAC_API_VERSION_CURRENT, FLAC_API_VERSION_REVISION, FLAC_API_VERSION_AGE);
     #endif
+    #ifdef MYMPD_ENABLE_LIBJPEG
+        MYMPD_LOG_INFO(NULL, "Libjpeg %d", JPEG_LIB_VERSION);
+    #endif
+    #ifdef MYMPD_ENABLE_LIBPNG
+        MYMPD_LOG_INFO(NULL, "Libpng %s", PNG_LIBPNG_VER_STRING);
+    #endif
 
     //set signal handler
     if (set_signal_handler(SIGTERM) == false ||
@@ -532,6 +545,9 @@ int main(int argc, char **argv) {
         smartpls_default(config->workdir);
     }
 
+    //read the covercache directory
+    covercache_index_init(config->cachedir);
+
     //Create working threads
     //mympd api
     MYMPD_LOG_NOTICE(NULL, "Starting mympd api thread");
@@ -581,7 +597,10 @@ int main(int argc, char **argv) {
     //free queues
     mympd_queue_free(web_server_queue);
     mympd_queue_free(mympd_api_queue);
-    mympd_queue_free(mympd_script_queue);
+    mympd_mailboxes_free(mympd_script_mailboxes);
+
+    //free covercache index
+    covercache_index_free();
 
     //free config
     mympd_config_free(config);
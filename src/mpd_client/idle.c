@@ -8,6 +8,7 @@
 #include "src/mpd_client/idle.h"
 
 #include "dist/libmympdclient/include/mpd/client.h"
+#include "src/lib/covercache.h"
 #include "src/lib/jsonrpc.h"
 #include "src/lib/log.h"
 #include "src/lib/msg_queue.h"
@@ -16,6 +17,7 @@
 #include "src/mpd_client/connection.h"
 #include "src/mpd_client/errorhandler.h"
 #include "src/mpd_client/jukebox.h"
+#include "src/mpd_client/jukebox_pool.h"
 #include "src/mpd_client/partitions.h"
 #include "src/mpd_client/queue.h"
 #include "src/mpd_client/stickerdb.h"
@@ -34,9 +36,20 @@
  */
 
 static void mpd_client_idle_partition(struct t_partition_state *partition_state,
-        bool mpd_idle_event_waiting, struct t_work_request *request);
+        bool mpd_idle_event_waiting, struct t_work_request **requests, unsigned requests_len);
+static unsigned get_requests(struct t_work_request **requests);
+static unsigned get_partition_requests(struct t_partition_state *partition_state,
+        struct t_work_request **requests, unsigned requests_len, struct t_work_request **batch);
+static void handle_request_disconnected(struct t_partition_state *partition_state, struct t_work_request *request);
 static void mpd_client_parse_idle(struct t_partition_state *partition_state, unsigned idle_bitmask);
 static bool update_mympd_caches(struct t_mympd_state *mympd_state, time_t timeout);
+static nfds_t add_wakeup_fds(struct t_mympd_state *mympd_state);
+
+/**
+ * Maximum time to wait for events in ms,
+ * time based housekeeping runs at least at this interval
+ */
+#define IDLE_POLL_TIMEOUT 250
 
 /**
  * Public functions
@@ -48,16 +61,16 @@ static bool update_mympd_caches(struct t_mympd_state *mympd_state, time_t timeou
  * @param mympd_state pointer to the mympd state struct
  */
 void mpd_client_idle(struct t_mympd_state *mympd_state) {
-    //poll all mpd connection fds
+    //poll all mpd connection fds, the mympd_api_queue, the stickerdb connection and the timers
     partitions_get_fds(mympd_state);
-    if (mympd_state->nfds > 0) {
-        int pollrc = poll(mympd_state->fds, mympd_state->nfds, 50);
-        if (pollrc < 0) {
-            MYMPD_LOG_ERROR(NULL, "Error polling mpd connection");
-        }
+    nfds_t nfds = add_wakeup_fds(mympd_state);
+    int pollrc = poll(mympd_state->fds, nfds, IDLE_POLL_TIMEOUT);
+    if (pollrc < 0) {
+        MYMPD_LOG_ERROR(NULL, "Error polling mpd connection");
     }
-    //check the mympd_api_queue
-    struct t_work_request *request = mympd_queue_shift(mympd_api_queue, 50, 0);
+    //get a batch of requests from the mympd_api_queue
+    struct t_work_request *requests[API_REQUESTS_PER_LOOP];
+    unsigned requests_len = get_requests(requests);
     //iterate through all partitions
     struct t_partition_state *partition_state = mympd_state->partition_state;
     int i = 0;
@@ -73,19 +86,14 @@ void mpd_client_idle(struct t_mympd_state *mympd_state) {
         else {
             mpd_idle_event_waiting = false;
         }
-        if (request != NULL &&
-            strcmp(request->partition, partition_state->name) == 0)
-        {
-            //API request is for this partition
-            mpd_client_idle_partition(partition_state, mpd_idle_event_waiting, request);
-            request = NULL;
-        }
-        else {
-            mpd_client_idle_partition(partition_state, mpd_idle_event_waiting, NULL);
-        }
+        mpd_client_idle_partition(partition_state, mpd_idle_event_waiting, requests, requests_len);
     } while ((partition_state = partition_state->next) != NULL);
     //cleanup
-    if (request != NULL) {
+    for (unsigned j = 0; j < requests_len; j++) {
+        struct t_work_request *request = requests[j];
+        if (request == NULL) {
+            continue;
+        }
         //request was for unknown partition, discard it
         MYMPD_LOG_WARN(NULL, "Discarding request for unknown partition \"%s\"", request->partition);
         if (request->conn_id > -1) {
@@ -103,36 +111,133 @@ void mpd_client_idle(struct t_mympd_state *mympd_state) {
  * Private functions
  */
 
+/**
+ * Shifts a batch of requests from the mympd_api_queue.
+ * Stops at API_REQUESTS_PER_LOOP requests or if a partition reaches
+ * API_REQUESTS_PER_PARTITION requests, the remaining requests are
+ * handled in the next iteration.
+ * @param requests array of API_REQUESTS_PER_LOOP elements to fill
+ * @return number of requests
+ */
+static unsigned get_requests(struct t_work_request **requests) {
+    unsigned requests_len = 0;
+    while (requests_len < API_REQUESTS_PER_LOOP) {
+        struct t_work_request *request = mympd_queue_shift(mympd_api_queue, -1, 0);
+        if (request == NULL) {
+            break;
+        }
+        requests[requests_len] = request;
+        requests_len++;
+        unsigned partition_count = 0;
+        for (unsigned i = 0; i < requests_len; i++) {
+            if (strcmp(requests[i]->partition, request->partition) == 0) {
+                partition_count++;
+            }
+        }
+        if (partition_count == API_REQUESTS_PER_PARTITION) {
+            //give the other partitions a chance
+            break;
+        }
+    }
+    if (requests_len > 1) {
+        MYMPD_LOG_DEBUG(NULL, "Handling %u api requests", requests_len);
+    }
+    return requests_len;
+}
+
+/**
+ * Moves the requests for a partition to the batch
+ * @param partition_state pointer to the partition state
+ * @param requests requests shifted from the mympd_api_queue
+ * @param requests_len length of the requests array
+ * @param batch array to fill with the requests for this partition
+ * @return number of requests in the batch
+ */
+static unsigned get_partition_requests(struct t_partition_state *partition_state,
+        struct t_work_request **requests, unsigned requests_len, struct t_work_request **batch)
+{
+    unsigned batch_len = 0;
+    for (unsigned i = 0; i < requests_len; i++) {
+        if (requests[i] != NULL &&
+            strcmp(requests[i]->partition, partition_state->name) == 0)
+        {
+            batch[batch_len] = requests[i];
+            batch_len++;
+            requests[i] = NULL;
+        }
+    }
+    return batch_len;
+}
+
+/**
+ * Handles an api request for a partition that is not connected
+ * @param partition_state pointer to the partition state
+ * @param request api request
+ */
+static void handle_request_disconnected(struct t_partition_state *partition_state, struct t_work_request *request) {
+    if (is_mympd_only_api_method(request->cmd_id) == true) {
+        //request that are handled without a mpd connection
+        MYMPD_LOG_DEBUG(partition_state->name, "Handle request \"%s\" (mpd disconnected)", get_cmd_id_method_name(request->cmd_id));
+        mympd_api_handler(partition_state, request);
+        return;
+    }
+    //other requests not allowed
+    if (request->conn_id > -1) {
+        struct t_work_response *response = create_response(request);
+        response->data = jsonrpc_respond_message(response->data, request->cmd_id, request->id,
+            JSONRPC_FACILITY_MPD, JSONRPC_SEVERITY_ERROR, "MPD disconnected");
+        MYMPD_LOG_DEBUG(partition_state->name, "Send http response to connection %lld: %s", request->conn_id, response->data);
+        mympd_queue_push(web_server_queue, response, 0);
+    }
+    free_request(request);
+}
+
+/**
+ * Appends the fds that should wakeup the mympd_api thread to the partition fds.
+ * The timer and stickerdb fds are checked after the poll returns.
+ * @param mympd_state pointer to the mympd state struct
+ * @return number of fds to poll
+ */
+static nfds_t add_wakeup_fds(struct t_mympd_state *mympd_state) {
+    nfds_t nfds = mympd_state->nfds;
+    mympd_state->fds[nfds].fd = mympd_queue_event_fd(mympd_api_queue);
+    mympd_state->fds[nfds].events = POLLIN;
+    nfds++;
+    if (mympd_state->mpd_state->feat_stickers == true &&
+        mympd_state->stickerdb->conn != NULL &&
+        mympd_state->stickerdb->conn_state == MPD_CONNECTED)
+    {
+        mympd_state->fds[nfds].fd = mpd_connection_get_fd(mympd_state->stickerdb->conn);
+        mympd_state->fds[nfds].events = POLLIN;
+        nfds++;
+    }
+    if (mympd_state->timer_list.heap_len > 0) {
+        mympd_state->fds[nfds].fd = mympd_state->timer_list.fd;
+        mympd_state->fds[nfds].events = POLLIN;
+        nfds++;
+    }
+    return nfds;
+}
+
 /**
  * This function handles api requests and mpd events per partition.
+ * All requests for the partition are handled in one noidle/idle cycle.
  * @param partition_state pointer to the partition state
  * @param mpd_idle_event_waiting true if mpd idle event is waiting, else false
- * @param request api request
+ * @param requests api requests, requests for this partition are set to NULL
+ * @param requests_len length of the requests array
  */
 static void mpd_client_idle_partition(struct t_partition_state *partition_state,
-        bool mpd_idle_event_waiting, struct t_work_request *request)
+        bool mpd_idle_event_waiting, struct t_work_request **requests, unsigned requests_len)
 {
+    struct t_work_request *batch[API_REQUESTS_PER_PARTITION];
+    unsigned batch_len = get_partition_requests(partition_state, requests, requests_len, batch);
     //Handle api requests if mpd is not connected
-    if (partition_state->conn_state != MPD_CONNECTED &&
-        request != NULL)
-    {
-        if (is_mympd_only_api_method(request->cmd_id) == true) {
-            //request that are handled without a mpd connection
-            MYMPD_LOG_DEBUG(partition_state->name, "Handle request \"%s\" (mpd disconnected)", get_cmd_id_method_name(request->cmd_id));
-            mympd_api_handler(partition_state, request);
+    if (partition_state->conn_state != MPD_CONNECTED) {
+        for (unsigned i = 0; i < batch_len; i++) {
+            handle_request_disconnected(partition_state, batch[i]);
         }
-        else {
-            //other requests not allowed
-            if (request->conn_id > -1) {
-                struct t_work_response *response = create_response(request);
-                response->data = jsonrpc_respond_message(response->data, request->cmd_id, request->id,
-                    JSONRPC_FACILITY_MPD, JSONRPC_SEVERITY_ERROR, "MPD disconnected");
-                MYMPD_LOG_DEBUG(partition_state->name, "Send http response to connection %lld: %s", request->conn_id, response->data);
-                mympd_queue_push(web_server_queue, response, 0);
-            }
-            free_request(request);
-        }
-        request = NULL;
+        batch_len = 0;
     }
 
     switch (partition_state->conn_state) {
@@ -243,7 +348,7 @@ static void mpd_client_idle_partition(struct t_partition_state *partition_state,
             }
             //check if we need to exit the idle mode
             if (mpd_idle_event_waiting == true ||             //idle event waiting
-                request != NULL ||                            //api was called
+                batch_len > 0 ||                              //api was called
                 jukebox_add_song == true ||                   //jukebox trigger
                 set_played == true ||                         //play state of song must be set
                 partition_state->set_conn_options == true)    //connection options must be set
@@ -288,12 +393,17 @@ static void mpd_client_idle_partition(struct t_partition_state *partition_state,
                 if (jukebox_add_song == true) {
                     jukebox_run(partition_state);
                 }
-                //an api request is there
-                if (request != NULL) {
-                    //Handle request
-                    MYMPD_LOG_DEBUG(partition_state->name, "Handle API request \"%s\"", get_cmd_id_method_name(request->cmd_id));
-                    mympd_api_handler(partition_state, request);
+                //handle the api requests
+                for (unsigned i = 0; i < batch_len; i++) {
+                    if (partition_state->conn_state == MPD_CONNECTED) {
+                        MYMPD_LOG_DEBUG(partition_state->name, "Handle API request \"%s\"", get_cmd_id_method_name(batch[i]->cmd_id));
+                        mympd_api_handler(partition_state, batch[i]);
+                    }
+                    else {
+                        handle_request_disconnected(partition_state, batch[i]);
+                    }
                 }
+                batch_len = 0;
                 //re-enter idle mode
                 if (partition_state->conn_state == MPD_CONNECTED) {
                     MYMPD_LOG_DEBUG(partition_state->name, "Entering mpd idle mode");
@@ -311,6 +421,10 @@ static void mpd_client_idle_partition(struct t_partition_state *partition_state,
         default:
             MYMPD_LOG_ERROR(partition_state->name, "Invalid mpd connection state");
     }
+    //requests not handled because the connection failed
+    for (unsigned i = 0; i < batch_len; i++) {
+        handle_request_disconnected(partition_state, batch[i]);
+    }
 }
 
 /**
@@ -334,12 +448,17 @@ static void mpd_client_parse_idle(struct t_partition_state *partition_state, uns
                     //database has changed - global event
                     MYMPD_LOG_INFO(partition_state->name, "MPD database has changed");
                     buffer = jsonrpc_event(buffer, JSONRPC_EVENT_UPDATE_DATABASE);
+                    //images could have been added or removed
+                    covercache_lookup_clear();
                     //add timer for cache updates
                     update_mympd_caches(partition_state->mympd_state, 10);
+                    //the jukebox candidates must be refetched
+                    jukebox_pool_invalidate(partition_state->mympd_state, false);
                     break;
                 case MPD_IDLE_STORED_PLAYLIST:
                     //a playlist has changed - global event
                     buffer = jsonrpc_event(buffer, JSONRPC_EVENT_UPDATE_STORED_PLAYLIST);
+                    jukebox_pool_invalidate(partition_state->mympd_state, true);
                     break;
                 case MPD_IDLE_UPDATE:
                     //database update has started or is finished - global event
@@ -467,7 +586,9 @@ static void mpd_client_parse_idle(struct t_partition_state *partition_state, uns
  * @return true on success else false
  */
 static bool update_mympd_caches(struct t_mympd_state *mympd_state, time_t timeout) {
-    if (mympd_state->mpd_state->feat_tags == false) {
+    if (mympd_state->mpd_state->feat_tags == false &&
+        mympd_state->mpd_state->feat_stickers == false)
+    {
         MYMPD_LOG_DEBUG(NULL, "Caches are disabled");
         return true;
     }
@@ -17,7 +17,9 @@
 #include "src/lib/mympd_state.h"
 #include "src/lib/random.h"
 #include "src/lib/sds_extras.h"
+#include "src/lib/sticker_cache.h"
 #include "src/mpd_client/errorhandler.h"
+#include "src/mpd_client/jukebox_pool.h"
 #include "src/mpd_client/queue.h"
 #include "src/mpd_client/search.h"
 #include "src/mpd_client/search_local.h"
@@ -38,20 +40,30 @@ static bool jukebox_run_fill_jukebox_queue(struct t_partition_state *partition_s
         long add_songs, enum jukebox_modes jukebox_mode, const char *playlist, bool manual);
 static bool jukebox_fill_jukebox_queue(struct t_partition_state *partition_state,
         long add_songs, enum jukebox_modes jukebox_mode, const char *playlist, bool manual);
-static bool add_album_to_queue(struct t_partition_state *partition_state, struct mpd_song *album);
+static bool add_album_to_queue(struct t_partition_state *partition_state, struct t_album *album);
+static struct t_jukebox_pool *jukebox_pool_create(struct t_partition_state *partition_state, const char *playlist);
 static long fill_jukebox_queue_songs(struct t_partition_state *partition_state, long add_songs,
         const char *playlist, bool manual, struct t_list *queue_list, struct t_list *add_list);
 static long fill_jukebox_queue_albums(struct t_partition_state *partition_state, long add_albums,
         bool manual, struct t_list *queue_list, struct t_list *add_list);
 
-static bool check_min_duration(const struct mpd_song *song, unsigned min_duration);
+static bool check_min_duration(unsigned duration, unsigned min_duration);
 static bool check_expression(const struct mpd_song *song, struct t_tags *tags,
-        struct t_list *include_expr_list, struct t_list *exclude_expr_list);
-static bool check_not_hated(rax *stickers_like, const char *uri, bool jukebox_ignore_hated);
-static bool check_last_played(rax *stickers_last_played, const char *uri, time_t since);
+        struct t_search_filter *include_filter, struct t_search_filter *exclude_filter);
+static bool check_album_expression(const struct t_album *album, struct t_tags *tags,
+        struct t_search_filter *include_filter, struct t_search_filter *exclude_filter);
+static bool check_not_hated(const struct t_sticker_cache *sticker_cache, rax *stickers_like,
+        const char *uri, bool jukebox_ignore_hated);
+static bool check_last_played(const struct t_sticker_cache *sticker_cache, rax *stickers_last_played,
+        const char *uri, time_t since);
 static long check_unique_tag(struct t_partition_state *partition_state, const char *uri,
         const char *value, bool manual, struct t_list *queue_list);
 static bool add_uri_constraint_or_expression(sds include_expression, struct t_partition_state *partition_state);
+static void fetch_pool_stickers(struct t_partition_state *partition_state, struct t_jukebox_pool *pool);
+static long long get_sticker_value(const struct t_sticker_cache *sticker_cache, rax *stickers,
+        const char *uri, enum mympd_sticker_types type);
+static double get_weight(enum jukebox_weights jukebox_weight, const struct t_sticker_cache *sticker_cache,
+        const struct t_jukebox_pool *pool, const char *uri, time_t now);
 
 enum jukebox_uniq_result {
     JUKEBOX_UNIQ_IN_QUEUE = -2,
@@ -99,6 +111,48 @@ const char *jukebox_mode_lookup(enum jukebox_modes mode) {
     return NULL;
 }
 
+/**
+ * Parses the string to the jukebox weight
+ * @param str string to parse
+ * @return jukebox weight
+ */
+enum jukebox_weights jukebox_weight_parse(const char *str) {
+    if (strcmp(str, "none") == 0) {
+        return JUKEBOX_WEIGHT_NONE;
+    }
+    if (strcmp(str, "like") == 0) {
+        return JUKEBOX_WEIGHT_LIKE;
+    }
+    if (strcmp(str, "playCount") == 0) {
+        return JUKEBOX_WEIGHT_PLAY_COUNT;
+    }
+    if (strcmp(str, "lastPlayed") == 0) {
+        return JUKEBOX_WEIGHT_LAST_PLAYED;
+    }
+    return JUKEBOX_WEIGHT_UNKNOWN;
+}
+
+/**
+ * Returns the jukebox weight as string
+ * @param weight the jukebox weight
+ * @return jukebox weight as string
+ */
+const char *jukebox_weight_lookup(enum jukebox_weights weight) {
+    switch (weight) {
+        case JUKEBOX_WEIGHT_NONE:
+            return "none";
+        case JUKEBOX_WEIGHT_LIKE:
+            return "like";
+        case JUKEBOX_WEIGHT_PLAY_COUNT:
+            return "playCount";
+        case JUKEBOX_WEIGHT_LAST_PLAYED:
+            return "lastPlayed";
+        case JUKEBOX_WEIGHT_UNKNOWN:
+            return NULL;
+    }
+    return NULL;
+}
+
 /**
  * Clears the jukebox queue of all partitions.
  * @param mympd_state pointer to central myMPD state.
@@ -257,7 +311,7 @@ bool jukebox_add_to_queue(struct t_partition_state *partition_state, long add_so
             }
         }
         else {
-            bool rc = add_album_to_queue(partition_state, (struct mpd_song *)current->user_data);
+            bool rc = add_album_to_queue(partition_state, (struct t_album *)current->user_data);
             if (rc == true) {
                 MYMPD_LOG_NOTICE(partition_state->name, "Jukebox adding album: %s - %s", current->value_p, current->key);
                 added++;
@@ -308,7 +362,7 @@ bool jukebox_add_to_queue(struct t_partition_state *partition_state, long add_so
  * @param album album to add
  * @return true on success, else false
  */
-static bool add_album_to_queue(struct t_partition_state *partition_state, struct mpd_song *album) {
+static bool add_album_to_queue(struct t_partition_state *partition_state, struct t_album *album) {
     sds expression = get_search_expression_album(partition_state->mpd_state->tag_albumartist, album,
         &partition_state->mympd_state->config->albums);
     if (mpd_search_add_db_songs(partition_state->conn, true) &&
@@ -488,6 +542,10 @@ static bool jukebox_fill_jukebox_queue(struct t_partition_state *partition_state
         &partition_state->jukebox_queue :
         &partition_state->jukebox_queue_tmp;
 
+    //index the lists for the unique tag constraint
+    list_index_create(queue_list);
+    list_index_create(add_list);
+
     if (jukebox_mode == JUKEBOX_ADD_SONG) {
         added = fill_jukebox_queue_songs(partition_state, add_songs, playlist, manual, queue_list, add_list);
     }
@@ -539,22 +597,37 @@ static long fill_jukebox_queue_albums(struct t_partition_state *partition_state,
 
     long skipno = 0;
     long lineno = 1;
-    time_t since = time(NULL);
-    since = since - (partition_state->jukebox_last_played * 3600);
+    time_t now = time(NULL);
+    time_t since = now - (partition_state->jukebox_last_played * 3600);
     sds albumid = sdsempty();
     rax *stickers_last_played = NULL;
+    const struct t_sticker_cache *sticker_cache = NULL;
+    // weighted sampling uses the stickers of the album uri, this is only supported in advanced album mode
+    struct t_jukebox_pool *pool = NULL;
     if (partition_state->mympd_state->config->albums.mode == ALBUM_MODE_ADV &&
         partition_state->mpd_state->feat_stickers == true)
     {
-        stickers_last_played = stickerdb_find_stickers_by_name(partition_state->mympd_state->stickerdb, "lastPlayed");
+        if (partition_state->jukebox_weight != JUKEBOX_WEIGHT_NONE) {
+            pool = jukebox_pool_new("Database");
+        }
+        if (partition_state->mympd_state->sticker_cache.cache != NULL) {
+            sticker_cache = &partition_state->mympd_state->sticker_cache;
+        }
+        else if (pool != NULL) {
+            fetch_pool_stickers(partition_state, pool);
+            stickers_last_played = pool->stickers_last_played;
+        }
+        else {
+            stickers_last_played = stickerdb_find_stickers_by_name(partition_state->mympd_state->stickerdb, "lastPlayed");
+        }
     }
 
-    //parse mpd search expression
-    struct t_list *include_expr_list = sdslen(partition_state->jukebox_filter_include) > 0
-        ? parse_search_expression_to_list(partition_state->jukebox_filter_include)
+    //get the compiled search expressions
+    struct t_search_filter *include_filter = sdslen(partition_state->jukebox_filter_include) > 0
+        ? search_filter_cache_get(partition_state->mpd_state->search_filter_cache, partition_state->jukebox_filter_include)
         : NULL;
-    struct t_list *exclude_expr_list = sdslen(partition_state->jukebox_filter_exclude) > 0
-        ? parse_search_expression_to_list(partition_state->jukebox_filter_exclude)
+    struct t_search_filter *exclude_filter = sdslen(partition_state->jukebox_filter_exclude) > 0
+        ? search_filter_cache_get(partition_state->mpd_state->search_filter_cache, partition_state->jukebox_filter_exclude)
         : NULL;
 
     sds tag_value = sdsempty();
@@ -562,17 +635,27 @@ static long fill_jukebox_queue_albums(struct t_partition_state *partition_state,
     raxStart(&iter, partition_state->mpd_state->album_cache.cache);
     raxSeek(&iter, "^", NULL, 0);
     while (raxNext(&iter)) {
-        struct mpd_song *album= (struct mpd_song *)iter.data;
+        struct t_album *album = (struct t_album *)iter.data;
         sdsclear(albumid);
         albumid = sdscatlen(albumid, (char *)iter.key, iter.key_len);
         sdsclear(tag_value);
-        tag_value = mpd_client_get_tag_value_string(album, partition_state->jukebox_unique_tag.tags[0], tag_value);
+        tag_value = album_get_tag_value_string(album, partition_state->jukebox_unique_tag.tags[0], tag_value);
 
         // we use the song uri in the album cache for enforcing last_played constraint,
         // because we do not know when an album was last played fully, this only supported in advanced album mode
-        if ((partition_state->mympd_state->config->albums.mode == ALBUM_MODE_SIMPLE ||
-             check_last_played(stickers_last_played, mpd_song_get_uri(album), since) == true) &&
-            check_expression(album, &partition_state->mpd_state->tags_mpd, include_expr_list, exclude_expr_list) == true &&
+        if (pool != NULL &&
+            check_last_played(sticker_cache, stickers_last_played, album->uri, since) == true &&
+            check_album_expression(album, &partition_state->mpd_state->tags_mpd, include_filter, exclude_filter) == true)
+        {
+            // collect the candidates and their sampling keys in one pass, the unique tag is checked while drawing
+            jukebox_pool_add(pool, albumid, tag_value, 0);
+            jukebox_pool_set_weight(pool, pool->len - 1, get_weight(partition_state->jukebox_weight, sticker_cache, pool, album->uri, now));
+            lineno++;
+        }
+        else if (pool == NULL &&
+            (partition_state->mympd_state->config->albums.mode == ALBUM_MODE_SIMPLE ||
+             check_last_played(sticker_cache, stickers_last_played, album->uri, since) == true) &&
+            check_album_expression(album, &partition_state->mpd_state->tags_mpd, include_filter, exclude_filter) == true &&
             check_unique_tag(partition_state, albumid, tag_value, manual, queue_list) == JUKEBOX_UNIQ_IS_UNIQ)
         {
             if (randrange(0, lineno) < add_albums) {
@@ -599,84 +682,72 @@ static long fill_jukebox_queue_albums(struct t_partition_state *partition_state,
             skipno++;
         }
     }
-    FREE_SDS(albumid);
-    FREE_SDS(tag_value);
     raxStop(&iter);
-    free_search_expression_list(include_expr_list);
-    free_search_expression_list(exclude_expr_list);
-    if (stickers_last_played != NULL) {
+    if (pool != NULL) {
+        // draw the albums in descending key order
+        long add_list_len = add_list->length + add_albums;
+        jukebox_pool_weighted_init(pool);
+        for (size_t i = 0; i < pool->len && add_list->length < add_list_len; i++) {
+            const struct t_jukebox_candidate *candidate = jukebox_pool_pick_weighted(pool, i);
+            if (check_unique_tag(partition_state, candidate->uri, candidate->tag_value, manual, queue_list) == JUKEBOX_UNIQ_IS_UNIQ) {
+                albumid = sds_replace(albumid, candidate->uri);
+                struct t_album *album = album_cache_get_album(&partition_state->mpd_state->album_cache, albumid);
+                if (list_push(add_list, albumid, (long long)i, candidate->tag_value, album) == false) {
+                    MYMPD_LOG_ERROR(partition_state->name, "Can't push jukebox_queue element");
+                }
+            }
+            else {
+                skipno++;
+            }
+        }
+        jukebox_pool_free(pool);
+    }
+    else if (stickers_last_played != NULL) {
         stickerdb_free_find_result(stickers_last_played);
     }
+    FREE_SDS(albumid);
+    FREE_SDS(tag_value);
     MYMPD_LOG_DEBUG(partition_state->name, "Jukebox iterated through %ld albums, skipped %ld", lineno, skipno);
     return (int)add_list->length;
 }
 
 /**
- * Adds songs to the jukebox queue
+ * Creates the jukebox candidate pool from the database or a playlist.
+ * The pool contains all songs matching the jukebox filter expressions.
  * @param partition_state pointer to myMPD partition state
- * @param add_songs number of songs to add
- * @param playlist playlist from which songs are added
- * @param manual false = normal jukebox operation
- *               true = create separate jukebox queue and add songs to queue once
- * @param queue_list list of current songs in mpd queue and last played
- * @param add_list jukebox queue to add the songs
- * @return true on success, else false
+ * @param playlist playlist from which songs are added or "Database"
+ * @return newly allocated pool or NULL on error
  */
-static long fill_jukebox_queue_songs(struct t_partition_state *partition_state, long add_songs, const char *playlist,
-        bool manual, struct t_list *queue_list, struct t_list *add_list)
-{
-    unsigned start = 0;
-    unsigned end = start + MPD_RESULTS_MAX;
-    long skipno = 0;
-    long lineno = 1;
-    time_t since = time(NULL) - (partition_state->jukebox_last_played * 3600);
-
-    long start_length = 0;
-    long add_list_expected_len = add_songs;
-    if (manual == false) {
-        start_length = partition_state->jukebox_queue.length;
-        add_songs = (long)MYMPD_JUKEBOX_INTERNAL_SONG_QUEUE_LENGTH - start_length;
-        add_list_expected_len = MYMPD_JUKEBOX_INTERNAL_SONG_QUEUE_LENGTH;
-        if (add_songs <= 0) {
-            return 0;
-        }
-    }
+static struct t_jukebox_pool *jukebox_pool_create(struct t_partition_state *partition_state, const char *playlist) {
     bool from_database = strcmp(playlist, "Database") == 0
         ? true
         : false;
-    bool rc = true;
-    sds tag_value = sdsempty();
-    rax *stickers_last_played = NULL;
-    rax *stickers_like = NULL;
-    if (partition_state->mpd_state->feat_stickers == true) {
-        MYMPD_LOG_DEBUG(partition_state->name, "Fetching lastPlayed stickers");
-        stickers_last_played = stickerdb_find_stickers_by_name(partition_state->mympd_state->stickerdb, "lastPlayed");
-        if (partition_state->jukebox_ignore_hated == true) {
-            MYMPD_LOG_DEBUG(partition_state->name, "Fetching stickers for hated songs");
-            stickers_like = stickerdb_find_stickers_by_name_value(partition_state->mympd_state->stickerdb, "like", "=", "0");
-        }
-    }
-    //parse mpd search expression
-    struct t_list *include_expr_list = sdslen(partition_state->jukebox_filter_include) > 0
-        ? parse_search_expression_to_list(partition_state->jukebox_filter_include)
+    //get the compiled search expressions
+    struct t_search_filter *include_filter = sdslen(partition_state->jukebox_filter_include) > 0
+        ? search_filter_cache_get(partition_state->mpd_state->search_filter_cache, partition_state->jukebox_filter_include)
         : NULL;
-    struct t_list *exclude_expr_list = sdslen(partition_state->jukebox_filter_exclude) > 0
-        ? parse_search_expression_to_list(partition_state->jukebox_filter_exclude)
+    struct t_search_filter *exclude_filter = sdslen(partition_state->jukebox_filter_exclude) > 0
+        ? search_filter_cache_get(partition_state->mpd_state->search_filter_cache, partition_state->jukebox_filter_exclude)
         : NULL;
 
-    if (include_expr_list == NULL) {
+    if (include_filter == NULL) {
         MYMPD_LOG_DEBUG(NULL, "Include expression is empty");
     }
-    if (exclude_expr_list == NULL) {
+    if (exclude_filter == NULL) {
         MYMPD_LOG_DEBUG(NULL, "Exclude expression is empty");
     }
 
+    struct t_jukebox_pool *pool = jukebox_pool_new(playlist);
+    unsigned start = 0;
+    unsigned received;
+    bool rc = true;
+    sds tag_value = sdsempty();
     do {
         MYMPD_LOG_DEBUG(partition_state->name, "Jukebox: iterating through source, start: %u", start);
         if (from_database == true) {
             if (mpd_search_db_songs(partition_state->conn, false) == false ||
                 add_uri_constraint_or_expression(partition_state->jukebox_filter_include, partition_state) == false ||
-                mpd_search_add_window(partition_state->conn, start, end) == false)
+                mpd_search_add_window(partition_state->conn, start, start + MPD_RESULTS_MAX) == false)
             {
                 MYMPD_LOG_ERROR(partition_state->name, "Error creating MPD search command");
                 mpd_search_cancel(partition_state->conn);
@@ -690,40 +761,14 @@ static long fill_jukebox_queue_songs(struct t_partition_state *partition_state,
                 MYMPD_LOG_ERROR(partition_state->name, "Error in response to command: mpd_send_list_playlist_meta");
             }
         }
+        received = 0;
         struct mpd_song *song;
         while ((song = mpd_recv_song(partition_state->conn)) != NULL) {
-            sdsclear(tag_value);
-            tag_value = mpd_client_get_tag_value_string(song, partition_state->jukebox_unique_tag.tags[0], tag_value);
-            const char *uri = mpd_song_get_uri(song);
-
-            if (check_min_duration(song, partition_state->jukebox_min_song_duration) == true &&
-                check_last_played(stickers_last_played, uri, since) == true &&
-                check_not_hated(stickers_like, uri, partition_state->jukebox_ignore_hated) == true &&
-                check_expression(song, &partition_state->mpd_state->tags_mpd, include_expr_list, exclude_expr_list) == true &&
-                check_unique_tag(partition_state, uri, tag_value, manual, queue_list) == JUKEBOX_UNIQ_IS_UNIQ)
-            {
-                if (randrange(0, lineno) < add_songs) {
-                    if (add_list->length < add_list_expected_len) {
-                        // append to fill the queue
-                        if (list_push(add_list, uri, lineno, tag_value, NULL) == false) {
-                            MYMPD_LOG_ERROR(partition_state->name, "Can't push jukebox_queue element");
-                        }
-                    }
-                    else {
-                        // replace at start_length + random position
-                        // existing entries should not be touched
-                        long pos = add_songs > 1
-                            ? start_length + randrange(0, add_songs - 1)
-                            : 0;
-                        if (list_replace(add_list, pos, uri, lineno, tag_value, NULL) == false) {
-                            MYMPD_LOG_ERROR(partition_state->name, "Can't replace jukebox_queue element pos %ld", pos);
-                        }
-                    }
-                }
-                lineno++;
-            }
-            else {
-                skipno++;
+            received++;
+            if (check_expression(song, &partition_state->mpd_state->tags_mpd, include_filter, exclude_filter) == true) {
+                sdsclear(tag_value);
+                tag_value = mpd_client_get_tag_value_string(song, partition_state->jukebox_unique_tag.tags[0], tag_value);
+                jukebox_pool_add(pool, mpd_song_get_uri(song), tag_value, mpd_song_get_duration(song));
             }
             mpd_song_free(song);
         }
@@ -732,29 +777,122 @@ static long fill_jukebox_queue_songs(struct t_partition_state *partition_state,
             rc = false;
             break;
         }
-        start = end;
-        end = end + MPD_RESULTS_MAX;
-    } while (from_database == true && lineno + skipno > (long)start);
-    stickerdb_free_find_result(stickers_last_played);
-    stickerdb_free_find_result(stickers_like);
-    free_search_expression_list(include_expr_list);
-    free_search_expression_list(exclude_expr_list);
+        start += MPD_RESULTS_MAX;
+    } while (from_database == true && received == MPD_RESULTS_MAX);
     FREE_SDS(tag_value);
-    MYMPD_LOG_DEBUG(partition_state->name, "Jukebox iterated through %ld songs, skipped %ld", lineno, skipno);
-    return rc == false
-        ? -1
-        : (int)add_list->length;
+    if (rc == false) {
+        jukebox_pool_free(pool);
+        return NULL;
+    }
+    MYMPD_LOG_INFO(partition_state->name, "Jukebox candidate pool for \"%s\" created with %lu songs", playlist, (unsigned long)pool->len);
+    return pool;
+}
+
+/**
+ * Adds songs to the jukebox queue.
+ * Songs are drawn randomly from the candidate pool until enough songs
+ * are matching the last played, hated and unique tag constraints.
+ * The draws are weighted by stickers if a jukebox weight is set.
+ * @param partition_state pointer to myMPD partition state
+ * @param add_songs number of songs to add
+ * @param playlist playlist from which songs are added
+ * @param manual false = normal jukebox operation
+ *               true = create separate jukebox queue and add songs to queue once
+ * @param queue_list list of current songs in mpd queue and last played
+ * @param add_list jukebox queue to add the songs
+ * @return number of songs in the jukebox queue or -1 on error
+ */
+static long fill_jukebox_queue_songs(struct t_partition_state *partition_state, long add_songs, const char *playlist,
+        bool manual, struct t_list *queue_list, struct t_list *add_list)
+{
+    long add_list_expected_len = add_songs;
+    if (manual == false) {
+        add_songs = (long)MYMPD_JUKEBOX_INTERNAL_SONG_QUEUE_LENGTH - partition_state->jukebox_queue.length;
+        add_list_expected_len = MYMPD_JUKEBOX_INTERNAL_SONG_QUEUE_LENGTH;
+        if (add_songs <= 0) {
+            return 0;
+        }
+    }
+
+    //get the candidate pool, a pool for another playlist than the jukebox playlist is only temporary
+    struct t_jukebox_pool *pool = partition_state->jukebox_pool;
+    bool tmp_pool = false;
+    if (pool == NULL ||
+        strcmp(pool->source, playlist) != 0)
+    {
+        pool = jukebox_pool_create(partition_state, playlist);
+        if (pool == NULL) {
+            return -1;
+        }
+        if (strcmp(playlist, partition_state->jukebox_playlist) == 0) {
+            jukebox_pool_free(partition_state->jukebox_pool);
+            partition_state->jukebox_pool = pool;
+        }
+        else {
+            tmp_pool = true;
+        }
+    }
+
+    const struct t_sticker_cache *sticker_cache = NULL;
+    if (partition_state->mpd_state->feat_stickers == true &&
+        partition_state->mympd_state->sticker_cache.cache != NULL)
+    {
+        MYMPD_LOG_DEBUG(partition_state->name, "Using the sticker cache");
+        sticker_cache = &partition_state->mympd_state->sticker_cache;
+    }
+    else if (partition_state->mpd_state->feat_stickers == true &&
+             pool->stickers_fetched == false)
+    {
+        fetch_pool_stickers(partition_state, pool);
+    }
+
+    time_t now = time(NULL);
+    time_t since = now - (partition_state->jukebox_last_played * 3600);
+    bool weighted = partition_state->jukebox_weight != JUKEBOX_WEIGHT_NONE &&
+        partition_state->mpd_state->feat_stickers == true;
+    if (weighted == true) {
+        // one pass over the pool to set the sampling keys
+        for (size_t j = 0; j < pool->len; j++) {
+            double weight = get_weight(partition_state->jukebox_weight, sticker_cache, pool, pool->candidates[j].uri, now);
+            jukebox_pool_set_weight(pool, j, weight);
+        }
+        jukebox_pool_weighted_init(pool);
+    }
+    long skipno = 0;
+    size_t i = 0;
+    for (; i < pool->len && add_list->length < add_list_expected_len; i++) {
+        const struct t_jukebox_candidate *candidate = weighted == true
+            ? jukebox_pool_pick_weighted(pool, i)
+            : jukebox_pool_pick(pool, i);
+        if (check_min_duration(candidate->duration, partition_state->jukebox_min_song_duration) == true &&
+            check_last_played(sticker_cache, pool->stickers_last_played, candidate->uri, since) == true &&
+            check_not_hated(sticker_cache, pool->stickers_like, candidate->uri, partition_state->jukebox_ignore_hated) == true &&
+            check_unique_tag(partition_state, candidate->uri, candidate->tag_value, manual, queue_list) == JUKEBOX_UNIQ_IS_UNIQ)
+        {
+            if (list_push(add_list, candidate->uri, (long long)i, candidate->tag_value, NULL) == false) {
+                MYMPD_LOG_ERROR(partition_state->name, "Can't push jukebox_queue element");
+            }
+        }
+        else {
+            skipno++;
+        }
+    }
+    MYMPD_LOG_DEBUG(partition_state->name, "Jukebox drew %lu of %lu songs, skipped %ld", (unsigned long)i, (unsigned long)pool->len, skipno);
+    if (tmp_pool == true) {
+        jukebox_pool_free(pool);
+    }
+    return add_list->length;
 }
 
 /**
  * Checks for minimum duration constraint for songs
- * @param song mpd song struct to check
+ * @param duration song duration
  * @param min_duration the minimum duration
  * @return if song is longer then min_duration true, else false
  */
-static bool check_min_duration(const struct mpd_song *song, unsigned min_duration) {
+static bool check_min_duration(unsigned duration, unsigned min_duration) {
     return min_duration > 0
-        ? mpd_song_get_duration(song) > min_duration
+        ? duration > min_duration
         : true;
 }
 
@@ -778,23 +916,23 @@ static long check_unique_tag(struct t_partition_state *partition_state, const ch
     }
 
     // check mpd queue and last_played
-    struct t_list_node *current = queue_list->head;
-    while(current != NULL) {
-        if (strcmp(current->key, uri) == 0) {
-            return JUKEBOX_UNIQ_IN_QUEUE;
-        }
-        if (value != NULL &&
-            strcmp(current->value_p, value) == 0)
-        {
-            return JUKEBOX_UNIQ_IN_QUEUE;
-        }
-        current = current->next;
+    if (list_has_key(queue_list, uri) == true ||
+        (value != NULL && list_has_value_p(queue_list, value) == true))
+    {
+        return JUKEBOX_UNIQ_IN_QUEUE;
     }
 
     // check internal jukebox queue
-    current = manual == false
-        ? partition_state->jukebox_queue.head
-        : partition_state->jukebox_queue_tmp.head;
+    struct t_list *jukebox_queue = manual == false
+        ? &partition_state->jukebox_queue
+        : &partition_state->jukebox_queue_tmp;
+    if (list_has_key(jukebox_queue, uri) == false &&
+        (value == NULL || list_has_value_p(jukebox_queue, value) == false))
+    {
+        return JUKEBOX_UNIQ_IS_UNIQ;
+    }
+    // get the position of the match
+    struct t_list_node *current = jukebox_queue->head;
     long i = 0;
     while (current != NULL) {
         if (strcmp(current->key, uri) == 0) {
@@ -815,24 +953,51 @@ static long check_unique_tag(struct t_partition_state *partition_state, const ch
  * Checks if the song matches the expression lists
  * @param song song to apply the expressions
  * @param tags tags to search
- * @param include_expr_list include expression list
- * @param exclude_expr_list exclude expression list
+ * @param include_filter compiled include expression
+ * @param exclude_filter compiled exclude expression
  * @return true if song should be included, else false
  */
 static bool check_expression(const struct mpd_song *song, struct t_tags *tags,
-        struct t_list *include_expr_list, struct t_list *exclude_expr_list)
+        struct t_search_filter *include_filter, struct t_search_filter *exclude_filter)
 {
     // first check exclude expression
-    if (exclude_expr_list != NULL &&
-        search_song_expression(song, exclude_expr_list, tags) == true)
+    if (exclude_filter != NULL &&
+        search_song_expression(song, exclude_filter, tags) == true)
     {
         // exclude expression matches
         return false;
     }
     // exclude expression not matched, try include expression
-    if (include_expr_list != NULL) {
+    if (include_filter != NULL) {
         // exclude overwrites include
-        return search_song_expression(song, include_expr_list, tags);
+        return search_song_expression(song, include_filter, tags);
+    }
+    // no include expression, include all
+    return true;
+}
+
+/**
+ * Checks if album matches include and not matches exclude expression
+ * @param album album to check
+ * @param tags tags to search
+ * @param include_filter compiled include expression
+ * @param exclude_filter compiled exclude expression
+ * @return true if album matches, else false
+ */
+static bool check_album_expression(const struct t_album *album, struct t_tags *tags,
+        struct t_search_filter *include_filter, struct t_search_filter *exclude_filter)
+{
+    // first check exclude expression
+    if (exclude_filter != NULL &&
+        search_album_expression(album, exclude_filter, tags) == true)
+    {
+        // exclude expression matches
+        return false;
+    }
+    // exclude expression not matched, try include expression
+    if (include_filter != NULL) {
+        // exclude overwrites include
+        return search_album_expression(album, include_filter, tags);
     }
     // no include expression, include all
     return true;
@@ -840,15 +1005,22 @@ static bool check_expression(const struct mpd_song *song, struct t_tags *tags,
 
 /**
  * Checks if the song is not hated and jukebox_ignore_hated is true
- * @param stickers_like like stickers
+ * @param sticker_cache the sticker cache or NULL if not available
+ * @param stickers_like like stickers, used if the sticker cache is not available
  * @param uri uri to check against the stickers_like
  * @param jukebox_ignore_hated ignore hated value
  * @return true if song is not hated, else false
  */
-static bool check_not_hated(rax *stickers_like, const char *uri, bool jukebox_ignore_hated) {
-    if (stickers_like == NULL ||
-        jukebox_ignore_hated == false)
-    {
+static bool check_not_hated(const struct t_sticker_cache *sticker_cache, rax *stickers_like,
+        const char *uri, bool jukebox_ignore_hated)
+{
+    if (jukebox_ignore_hated == false) {
+        return true;
+    }
+    if (sticker_cache != NULL) {
+        return sticker_cache_get_value(sticker_cache, uri, STICKER_LIKE) != STICKER_LIKE_HATE;
+    }
+    if (stickers_like == NULL) {
         return true;
     }
     void *sticker_value_hated = raxFind(stickers_like, (unsigned char *)uri, strlen(uri));
@@ -861,12 +1033,18 @@ static bool check_not_hated(rax *stickers_like, const char *uri, bool jukebox_ig
 
 /**
  * Checks if the songs last_played time is older then since
- * @param stickers_last_played last_played stickers
+ * @param sticker_cache the sticker cache or NULL if not available
+ * @param stickers_last_played last_played stickers, used if the sticker cache is not available
  * @param uri uri to check against the stickers_last_played
  * @param since timestamp to check against
  * @return true if songs last_played time is older then since, else false
  */
-static bool check_last_played(rax *stickers_last_played, const char *uri, time_t since) {
+static bool check_last_played(const struct t_sticker_cache *sticker_cache, rax *stickers_last_played,
+        const char *uri, time_t since)
+{
+    if (sticker_cache != NULL) {
+        return sticker_cache_get_value(sticker_cache, uri, STICKER_LAST_PLAYED) < (long long)since;
+    }
     if (stickers_last_played == NULL) {
         return true;
     }
@@ -889,3 +1067,100 @@ static bool add_uri_constraint_or_expression(sds include_expression, struct t_pa
     }
     return mpd_search_add_expression(partition_state->conn, include_expression);
 }
+
+/**
+ * Fetches the stickers for the jukebox constraints and weights into the pool.
+ * This is only used if the sticker cache is not available.
+ * @param partition_state pointer to myMPD partition state
+ * @param pool candidate pool
+ */
+static void fetch_pool_stickers(struct t_partition_state *partition_state, struct t_jukebox_pool *pool) {
+    MYMPD_LOG_DEBUG(partition_state->name, "Fetching lastPlayed stickers");
+    pool->stickers_last_played = stickerdb_find_stickers_by_name(partition_state->mympd_state->stickerdb, "lastPlayed");
+    if (partition_state->jukebox_weight == JUKEBOX_WEIGHT_LIKE) {
+        MYMPD_LOG_DEBUG(partition_state->name, "Fetching like stickers");
+        pool->stickers_like = stickerdb_find_stickers_by_name(partition_state->mympd_state->stickerdb, "like");
+    }
+    else if (partition_state->jukebox_ignore_hated == true) {
+        MYMPD_LOG_DEBUG(partition_state->name, "Fetching stickers for hated songs");
+        pool->stickers_like = stickerdb_find_stickers_by_name_value(partition_state->mympd_state->stickerdb, "like", "=", "0");
+    }
+    if (partition_state->jukebox_weight == JUKEBOX_WEIGHT_PLAY_COUNT) {
+        MYMPD_LOG_DEBUG(partition_state->name, "Fetching playCount stickers");
+        pool->stickers_play_count = stickerdb_find_stickers_by_name(partition_state->mympd_state->stickerdb, "playCount");
+    }
+    pool->stickers_fetched = true;
+}
+
+/**
+ * Gets a sticker value from the sticker cache or the fetched stickers
+ * @param sticker_cache the sticker cache or NULL if not available
+ * @param stickers fetched stickers, used if the sticker cache is not available
+ * @param uri song uri
+ * @param type myMPD sticker type
+ * @return the sticker value or its default
+ */
+static long long get_sticker_value(const struct t_sticker_cache *sticker_cache, rax *stickers,
+        const char *uri, enum mympd_sticker_types type)
+{
+    if (sticker_cache != NULL) {
+        return sticker_cache_get_value(sticker_cache, uri, type);
+    }
+    void *sticker_value = stickers != NULL
+        ? raxFind(stickers, (unsigned char *)uri, strlen(uri))
+        : raxNotFound;
+    if (sticker_value == raxNotFound) {
+        return type == STICKER_LIKE
+            ? STICKER_LIKE_NEUTRAL
+            : 0;
+    }
+    return strtoll((sds)sticker_value, NULL, 10);
+}
+
+/**
+ * Calculates the sampling weight of a song
+ * @param jukebox_weight the jukebox weight mode
+ * @param sticker_cache the sticker cache or NULL if not available
+ * @param pool candidate pool with the fetched stickers
+ * @param uri song uri
+ * @param now current timestamp
+ * @return the sampling weight
+ */
+static double get_weight(enum jukebox_weights jukebox_weight, const struct t_sticker_cache *sticker_cache,
+        const struct t_jukebox_pool *pool, const char *uri, time_t now)
+{
+    switch (jukebox_weight) {
+        case JUKEBOX_WEIGHT_LIKE: {
+            // each like level multiplies the weight
+            long long like = get_sticker_value(sticker_cache, pool->stickers_like, uri, STICKER_LIKE);
+            return like == STICKER_LIKE_LOVE
+                ? JUKEBOX_WEIGHT_LIKE_FACTOR
+                : like == STICKER_LIKE_HATE
+                    ? 1.0 / JUKEBOX_WEIGHT_LIKE_FACTOR
+                    : 1.0;
+        }
+        case JUKEBOX_WEIGHT_PLAY_COUNT: {
+            long long play_count = get_sticker_value(sticker_cache, pool->stickers_play_count, uri, STICKER_PLAY_COUNT);
+            return play_count > 0
+                ? 1.0 + (double)play_count
+                : 1.0;
+        }
+        case JUKEBOX_WEIGHT_LAST_PLAYED: {
+            // days since last played, never played songs get the maximum
+            long long last_played = get_sticker_value(sticker_cache, pool->stickers_last_played, uri, STICKER_LAST_PLAYED);
+            long long days = ((long long)now - last_played) / 86400;
+            if (days > JUKEBOX_WEIGHT_LAST_PLAYED_MAX ||
+                last_played == 0)
+            {
+                days = JUKEBOX_WEIGHT_LAST_PLAYED_MAX;
+            }
+            return days > 0
+                ? 1.0 + (double)days
+                : 1.0;
+        }
+        case JUKEBOX_WEIGHT_NONE:
+        case JUKEBOX_WEIGHT_UNKNOWN:
+            break;
+    }
+    return 1.0;
+}
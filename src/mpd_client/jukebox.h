@@ -11,6 +11,8 @@
 
 enum jukebox_modes jukebox_mode_parse(const char *str);
 const char *jukebox_mode_lookup(enum jukebox_modes mode);
+enum jukebox_weights jukebox_weight_parse(const char *str);
+const char *jukebox_weight_lookup(enum jukebox_weights weight);
 void jukebox_clear_all(struct t_mympd_state *mympd_state);
 bool jukebox_run(struct t_partition_state *partition_state);
 bool jukebox_add_to_queue(struct t_partition_state *partition_state, long add_songs,
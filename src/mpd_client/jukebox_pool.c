@@ -0,0 +1,243 @@
+/*
+ SPDX-License-Identifier: GPL-3.0-or-later
+ myMPD (c) 2018-2023 Juergen Mang <mail@jcgames.de>
+ https://github.com/jcorporation/mympd
+*/
+
+#include "compile_time.h"
+#include "src/mpd_client/jukebox_pool.h"
+
+#include "src/lib/log.h"
+#include "src/lib/mem.h"
+#include "src/lib/random.h"
+#include "src/lib/sds_extras.h"
+#include "src/mpd_client/stickerdb.h"
+
+#include <math.h>
+#include <string.h>
+
+/**
+ * Private definitions
+ */
+
+static void heap_sift_down(struct t_jukebox_candidate *heap, size_t len, size_t pos);
+static void swap_candidates(struct t_jukebox_candidate *a, struct t_jukebox_candidate *b);
+
+/**
+ * Public functions
+ */
+
+/**
+ * Creates an empty candidate pool
+ * @param source playlist name or "Database"
+ * @return newly allocated pool
+ */
+struct t_jukebox_pool *jukebox_pool_new(const char *source) {
+    struct t_jukebox_pool *pool = malloc_assert(sizeof(struct t_jukebox_pool));
+    pool->source = sdsnew(source);
+    pool->candidates = NULL;
+    pool->len = 0;
+    pool->size = 0;
+    pool->strings = string_pool_new();
+    pool->stickers_fetched = false;
+    pool->stickers_last_played = NULL;
+    pool->stickers_like = NULL;
+    pool->stickers_play_count = NULL;
+    return pool;
+}
+
+/**
+ * Frees the candidate pool
+ * @param pool pointer to the pool, can be NULL
+ * @return NULL
+ */
+void *jukebox_pool_free(struct t_jukebox_pool *pool) {
+    if (pool == NULL) {
+        return NULL;
+    }
+    jukebox_pool_clear_stickers(pool);
+    FREE_SDS(pool->source);
+    FREE_PTR(pool->candidates);
+    string_pool_free(pool->strings);
+    FREE_PTR(pool);
+    return NULL;
+}
+
+/**
+ * Adds a song to the candidate pool
+ * @param pool candidate pool
+ * @param uri song uri
+ * @param tag_value value of the unique tag
+ * @param duration song duration in seconds
+ */
+void jukebox_pool_add(struct t_jukebox_pool *pool, const char *uri, const char *tag_value, unsigned duration) {
+    if (pool->len == pool->size) {
+        pool->size = pool->size == 0
+            ? 1024
+            : pool->size * 2;
+        pool->candidates = realloc_assert(pool->candidates, pool->size * sizeof(struct t_jukebox_candidate));
+    }
+    struct t_jukebox_candidate *candidate = &pool->candidates[pool->len];
+    candidate->uri = string_pool_add(pool->strings, uri);
+    candidate->tag_value = string_pool_add(pool->strings, tag_value);
+    candidate->duration = duration;
+    candidate->key = 0;
+    pool->len++;
+}
+
+/**
+ * Picks the i-th song of a random permutation of the pool.
+ * This is one step of a Fisher-Yates shuffle, call it with i = 0, 1, 2, ...
+ * to draw songs without repetition. Drawing k songs costs O(k).
+ * @param pool candidate pool
+ * @param i draw number, must be lower than the pool length
+ * @return the drawn candidate
+ */
+const struct t_jukebox_candidate *jukebox_pool_pick(struct t_jukebox_pool *pool, size_t i) {
+    if (i + 1 >= pool->len) {
+        //last draw, randrange needs a range of at least two values
+        return &pool->candidates[i];
+    }
+    size_t j = (size_t)randrange((long)i, (long)pool->len - 1);
+    if (j != i) {
+        swap_candidates(&pool->candidates[i], &pool->candidates[j]);
+    }
+    return &pool->candidates[i];
+}
+
+/**
+ * Sets the sampling key of a candidate for weighted draws.
+ * The key is log(u) / weight with u uniform in (0, 1], this is the
+ * A-Res algorithm from Efraimidis and Spirakis. Drawing the candidates
+ * in descending key order is a weighted random sampling without replacement.
+ * @param pool candidate pool
+ * @param i index of the candidate
+ * @param weight weight of the candidate, candidates with weight 0 are drawn last
+ */
+void jukebox_pool_set_weight(struct t_jukebox_pool *pool, size_t i, double weight) {
+    pool->candidates[i].key = weight > 0
+        ? log(randdouble()) / weight
+        : -INFINITY;
+}
+
+/**
+ * Orders the candidates as max-heap by their sampling keys.
+ * Call it after the weights of all candidates are set.
+ * @param pool candidate pool
+ */
+void jukebox_pool_weighted_init(struct t_jukebox_pool *pool) {
+    if (pool->len < 2) {
+        return;
+    }
+    size_t pos = pool->len / 2;
+    while (pos > 0) {
+        pos--;
+        heap_sift_down(pool->candidates, pool->len, pos);
+    }
+}
+
+/**
+ * Picks the candidate with the i-th highest sampling key.
+ * Call it with i = 0, 1, 2, ... after jukebox_pool_weighted_init.
+ * Drawn candidates are moved to the end of the pool, drawing k songs costs O(k log n).
+ * @param pool candidate pool
+ * @param i draw number, must be lower than the pool length
+ * @return the drawn candidate
+ */
+const struct t_jukebox_candidate *jukebox_pool_pick_weighted(struct t_jukebox_pool *pool, size_t i) {
+    size_t heap_len = pool->len - i;
+    swap_candidates(&pool->candidates[0], &pool->candidates[heap_len - 1]);
+    heap_sift_down(pool->candidates, heap_len - 1, 0);
+    return &pool->candidates[heap_len - 1];
+}
+
+/**
+ * Frees the cached sticker maps of the pool
+ * @param pool candidate pool
+ */
+void jukebox_pool_clear_stickers(struct t_jukebox_pool *pool) {
+    stickerdb_free_find_result(pool->stickers_last_played);
+    stickerdb_free_find_result(pool->stickers_like);
+    stickerdb_free_find_result(pool->stickers_play_count);
+    pool->stickers_last_played = NULL;
+    pool->stickers_like = NULL;
+    pool->stickers_play_count = NULL;
+    pool->stickers_fetched = false;
+}
+
+/**
+ * Frees the candidate pools of all partitions
+ * @param mympd_state pointer to central myMPD state
+ * @param playlists_only true = free only pools created from a playlist
+ */
+void jukebox_pool_invalidate(struct t_mympd_state *mympd_state, bool playlists_only) {
+    struct t_partition_state *partition_state = mympd_state->partition_state;
+    while (partition_state != NULL) {
+        if (partition_state->jukebox_pool != NULL &&
+            (playlists_only == false ||
+             strcmp(partition_state->jukebox_pool->source, "Database") != 0))
+        {
+            MYMPD_LOG_DEBUG(partition_state->name, "Invalidating jukebox candidate pool");
+            partition_state->jukebox_pool = jukebox_pool_free(partition_state->jukebox_pool);
+        }
+        partition_state = partition_state->next;
+    }
+}
+
+/**
+ * Frees the cached sticker maps of the candidate pools of all partitions
+ * @param mympd_state pointer to central myMPD state
+ */
+void jukebox_pool_invalidate_stickers(struct t_mympd_state *mympd_state) {
+    struct t_partition_state *partition_state = mympd_state->partition_state;
+    while (partition_state != NULL) {
+        if (partition_state->jukebox_pool != NULL) {
+            jukebox_pool_clear_stickers(partition_state->jukebox_pool);
+        }
+        partition_state = partition_state->next;
+    }
+}
+
+/**
+ * Private functions
+ */
+
+/**
+ * Restores the max-heap property downwards from pos
+ * @param heap the candidates ordered as heap
+ * @param len number of candidates in the heap
+ * @param pos position to start
+ */
+static void heap_sift_down(struct t_jukebox_candidate *heap, size_t len, size_t pos) {
+    while (true) {
+        size_t largest = pos;
+        size_t left = 2 * pos + 1;
+        size_t right = left + 1;
+        if (left < len &&
+            heap[left].key > heap[largest].key)
+        {
+            largest = left;
+        }
+        if (right < len &&
+            heap[right].key > heap[largest].key)
+        {
+            largest = right;
+        }
+        if (largest == pos) {
+            return;
+        }
+        swap_candidates(&heap[pos], &heap[largest]);
+        pos = largest;
+    }
+}
+
+/**
+ * Swaps two candidates
+ * @param a first candidate
+ * @param b second candidate
+ */
+static void swap_candidates(struct t_jukebox_candidate *a, struct t_jukebox_candidate *b) {
+    struct t_jukebox_candidate tmp = *a;
+    *a = *b;
+    *b = tmp;
+}
@@ -0,0 +1,54 @@
+/*
+ SPDX-License-Identifier: GPL-3.0-or-later
+ myMPD (c) 2018-2023 Juergen Mang <mail@jcgames.de>
+ https://github.com/jcorporation/mympd
+*/
+
+#ifndef MYMPD_JUKEBOX_POOL_H
+#define MYMPD_JUKEBOX_POOL_H
+
+#include "dist/rax/rax.h"
+#include "dist/sds/sds.h"
+#include "src/lib/mympd_state.h"
+#include "src/lib/string_pool.h"
+
+#include <stdbool.h>
+
+/**
+ * A song that can be added by the jukebox
+ */
+struct t_jukebox_candidate {
+    const char *uri;        //!< song uri, interned in the pool strings
+    const char *tag_value;  //!< value of the unique tag, interned in the pool strings
+    unsigned duration;      //!< song duration in seconds
+    double key;             //!< sampling key for weighted draws
+};
+
+/**
+ * Songs from the jukebox source that are matching the jukebox filters.
+ * The pool is created once and invalidated by database, playlist and jukebox settings changes.
+ */
+struct t_jukebox_pool {
+    sds source;                              //!< playlist name or "Database"
+    struct t_jukebox_candidate *candidates;  //!< candidate songs
+    size_t len;                              //!< number of candidate songs
+    size_t size;                             //!< allocated size of candidates
+    struct t_string_pool *strings;           //!< interned uris and tag values
+    bool stickers_fetched;                   //!< true if the sticker maps are fetched
+    rax *stickers_last_played;               //!< lastPlayed stickers, only used without sticker cache
+    rax *stickers_like;                      //!< like stickers, only used without sticker cache
+    rax *stickers_play_count;                //!< playCount stickers, only used without sticker cache
+};
+
+struct t_jukebox_pool *jukebox_pool_new(const char *source);
+void *jukebox_pool_free(struct t_jukebox_pool *pool);
+void jukebox_pool_add(struct t_jukebox_pool *pool, const char *uri, const char *tag_value, unsigned duration);
+const struct t_jukebox_candidate *jukebox_pool_pick(struct t_jukebox_pool *pool, size_t i);
+void jukebox_pool_set_weight(struct t_jukebox_pool *pool, size_t i, double weight);
+void jukebox_pool_weighted_init(struct t_jukebox_pool *pool);
+const struct t_jukebox_candidate *jukebox_pool_pick_weighted(struct t_jukebox_pool *pool, size_t i);
+void jukebox_pool_clear_stickers(struct t_jukebox_pool *pool);
+void jukebox_pool_invalidate(struct t_mympd_state *mympd_state, bool playlists_only);
+void jukebox_pool_invalidate_stickers(struct t_mympd_state *mympd_state);
+
+#endif
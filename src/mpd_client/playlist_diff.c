@@ -0,0 +1,279 @@
+/*
+ SPDX-License-Identifier: GPL-3.0-or-later
+ myMPD (c) 2018-2023 Juergen Mang <mail@jcgames.de>
+ https://github.com/jcorporation/mympd
+*/
+
+#include "compile_time.h"
+#include "src/mpd_client/playlist_diff.h"
+
+#include "dist/rax/rax.h"
+#include "src/lib/mem.h"
+
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * Private definitions
+ */
+
+static size_t mark_lis(const size_t *seq, size_t len, bool *in_lis);
+static void add_edit(struct t_playlist_edits *edits, enum playlist_edit_types type,
+        size_t pos, size_t to, const char *uri);
+
+/**
+ * Public functions
+ */
+
+/**
+ * Initializes the edits struct
+ * @param edits pointer to the edits struct
+ */
+void playlist_edits_init(struct t_playlist_edits *edits) {
+    edits->edits = NULL;
+    edits->len = 0;
+    edits->size = 0;
+}
+
+/**
+ * Frees the edits
+ * @param edits pointer to the edits struct
+ */
+void playlist_edits_clear(struct t_playlist_edits *edits) {
+    FREE_PTR(edits->edits);
+    edits->len = 0;
+    edits->size = 0;
+}
+
+/**
+ * Calculates the edits to transform the current playlist into the target playlist.
+ * Songs that are not in the target are deleted, the songs of the longest
+ * increasing subsequence stay in place, all other songs are moved and the
+ * missing songs are added.
+ * @param current list of the current song uris
+ * @param target list of the target song uris
+ * @param max_edits maximum number of edits
+ * @param edits pointer to an initialized edits struct to populate
+ * @return true on success, false if more than max_edits edits are needed
+ */
+bool playlist_diff(const struct t_list *current, const struct t_list *target, size_t max_edits,
+        struct t_playlist_edits *edits)
+{
+    size_t current_len = (size_t)current->length;
+    size_t target_len = (size_t)target->length;
+    // target uris and a chain of equal uris for duplicates
+    const char **uris = malloc_assert(sizeof(char *) * (target_len + 1));
+    size_t *next = malloc_assert(sizeof(size_t) * (target_len + 1));
+    size_t i = 0;
+    for (struct t_list_node *node = target->head; node != NULL; node = node->next, i++) {
+        uris[i] = node->key;
+    }
+    // maps an uri to its first unassigned target position + 1
+    rax *first = raxNew();
+    for (i = target_len; i-- > 0;) {
+        size_t len = strlen(uris[i]);
+        void *data = raxFind(first, (unsigned char *)uris[i], len);
+        next[i] = data == raxNotFound
+            ? 0
+            : (size_t)(uintptr_t)data;
+        raxInsert(first, (unsigned char *)uris[i], len, (void *)(uintptr_t)(i + 1), NULL);
+    }
+    // assign the target positions to the current songs
+    size_t *kept = malloc_assert(sizeof(size_t) * (current_len + 1));
+    bool *deleted = malloc_assert(sizeof(bool) * (current_len + 1));
+    size_t kept_len = 0;
+    size_t j = 0;
+    for (struct t_list_node *node = current->head; node != NULL; node = node->next, j++) {
+        size_t len = sdslen(node->key);
+        void *data = raxFind(first, (unsigned char *)node->key, len);
+        if (data == raxNotFound ||
+            data == NULL)
+        {
+            deleted[j] = true;
+            continue;
+        }
+        size_t t = (size_t)(uintptr_t)data - 1;
+        raxInsert(first, (unsigned char *)node->key, len, (void *)(uintptr_t)next[t], NULL);
+        deleted[j] = false;
+        kept[kept_len++] = t;
+    }
+    raxFree(first);
+    bool *placed = malloc_assert(sizeof(bool) * (kept_len + 1));
+    size_t lis_len = mark_lis(kept, kept_len, placed);
+    size_t count = (current_len - kept_len) + (kept_len - lis_len) + (target_len - kept_len);
+    if (count > max_edits) {
+        FREE_PTR(uris);
+        FREE_PTR(next);
+        FREE_PTR(kept);
+        FREE_PTR(deleted);
+        FREE_PTR(placed);
+        return false;
+    }
+    // deletes from the end to keep the positions valid
+    for (j = current_len; j-- > 0;) {
+        if (deleted[j] == true) {
+            add_edit(edits, PLAYLIST_EDIT_DELETE, j, 0, NULL);
+        }
+    }
+    // target position -> state: 0 = missing, 1 = kept, 2 = kept and placed
+    unsigned char *state = malloc_assert(sizeof(unsigned char) * (target_len + 1));
+    memset(state, 0, target_len + 1);
+    for (j = 0; j < kept_len; j++) {
+        state[kept[j]] = placed[j] == true
+            ? 2
+            : 1;
+    }
+    // move each song outside the subsequence behind its placed predecessor
+    for (size_t t = 0; t < target_len; t++) {
+        if (state[t] != 1) {
+            continue;
+        }
+        size_t from = 0;
+        size_t dest = 0;
+        for (j = 0; j < kept_len; j++) {
+            if (kept[j] == t) {
+                from = j;
+            }
+            else if (state[kept[j]] == 2 &&
+                kept[j] < t)
+            {
+                dest = j + 1;
+            }
+        }
+        size_t to = from < dest
+            ? dest - 1
+            : dest;
+        if (from < to) {
+            memmove(&kept[from], &kept[from + 1], sizeof(size_t) * (to - from));
+        }
+        else if (from > to) {
+            memmove(&kept[to + 1], &kept[to], sizeof(size_t) * (from - to));
+        }
+        kept[to] = t;
+        state[t] = 2;
+        if (from != to) {
+            add_edit(edits, PLAYLIST_EDIT_MOVE, from, to, NULL);
+        }
+    }
+    // all songs are in target order, add the missing songs
+    for (size_t t = 0; t < target_len; t++) {
+        if (state[t] == 0) {
+            add_edit(edits, PLAYLIST_EDIT_ADD, t, 0, uris[t]);
+        }
+    }
+    FREE_PTR(uris);
+    FREE_PTR(next);
+    FREE_PTR(kept);
+    FREE_PTR(deleted);
+    FREE_PTR(placed);
+    FREE_PTR(state);
+    return true;
+}
+
+/**
+ * Checks if both playlists contain the same songs, the order is ignored
+ * @param current list of the current song uris
+ * @param target list of the target song uris
+ * @return true if the songs are the same, else false
+ */
+bool playlist_same_songs(const struct t_list *current, const struct t_list *target) {
+    if (current->length != target->length) {
+        return false;
+    }
+    // uri -> number of occurrences in the target
+    rax *counts = raxNew();
+    for (struct t_list_node *node = target->head; node != NULL; node = node->next) {
+        void *data = raxFind(counts, (unsigned char *)node->key, sdslen(node->key));
+        size_t count = data == raxNotFound
+            ? 1
+            : (size_t)(uintptr_t)data + 1;
+        raxInsert(counts, (unsigned char *)node->key, sdslen(node->key), (void *)(uintptr_t)count, NULL);
+    }
+    bool rc = true;
+    for (struct t_list_node *node = current->head; node != NULL; node = node->next) {
+        void *data = raxFind(counts, (unsigned char *)node->key, sdslen(node->key));
+        if (data == raxNotFound ||
+            data == NULL)
+        {
+            rc = false;
+            break;
+        }
+        raxInsert(counts, (unsigned char *)node->key, sdslen(node->key), (void *)((uintptr_t)data - 1), NULL);
+    }
+    raxFree(counts);
+    return rc;
+}
+
+/**
+ * Private functions
+ */
+
+/**
+ * Marks the longest strictly increasing subsequence
+ * @param seq sequence of unique values
+ * @param len length of the sequence
+ * @param in_lis array of len to mark the members of the subsequence
+ * @return length of the subsequence
+ */
+static size_t mark_lis(const size_t *seq, size_t len, bool *in_lis) {
+    if (len == 0) {
+        return 0;
+    }
+    // tails[k]: index of the smallest tail of all increasing subsequences with length k + 1
+    size_t *tails = malloc_assert(sizeof(size_t) * len);
+    size_t *prev = malloc_assert(sizeof(size_t) * len);
+    size_t lis_len = 0;
+    for (size_t i = 0; i < len; i++) {
+        size_t lo = 0;
+        size_t hi = lis_len;
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo) / 2;
+            if (seq[tails[mid]] < seq[i]) {
+                lo = mid + 1;
+            }
+            else {
+                hi = mid;
+            }
+        }
+        prev[i] = lo > 0
+            ? tails[lo - 1]
+            : SIZE_MAX;
+        tails[lo] = i;
+        if (lo == lis_len) {
+            lis_len++;
+        }
+        in_lis[i] = false;
+    }
+    size_t k = tails[lis_len - 1];
+    for (size_t n = lis_len; n > 0; n--) {
+        in_lis[k] = true;
+        k = prev[k];
+    }
+    FREE_PTR(tails);
+    FREE_PTR(prev);
+    return lis_len;
+}
+
+/**
+ * Appends an edit
+ * @param edits pointer to the edits struct
+ * @param type edit operation
+ * @param pos position of the song
+ * @param to new position for moves
+ * @param uri song uri for adds
+ */
+static void add_edit(struct t_playlist_edits *edits, enum playlist_edit_types type,
+        size_t pos, size_t to, const char *uri)
+{
+    if (edits->len == edits->size) {
+        edits->size = edits->size == 0
+            ? 64
+            : edits->size * 2;
+        edits->edits = realloc_assert(edits->edits, sizeof(struct t_playlist_edit) * edits->size);
+    }
+    struct t_playlist_edit *edit = &edits->edits[edits->len++];
+    edit->type = type;
+    edit->pos = (unsigned)pos;
+    edit->to = (unsigned)to;
+    edit->uri = uri;
+}
@@ -0,0 +1,49 @@
+/*
+ SPDX-License-Identifier: GPL-3.0-or-later
+ myMPD (c) 2018-2023 Juergen Mang <mail@jcgames.de>
+ https://github.com/jcorporation/mympd
+*/
+
+#ifndef MYMPD_PLAYLIST_DIFF_H
+#define MYMPD_PLAYLIST_DIFF_H
+
+#include "src/lib/list.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * Playlist edit operations
+ */
+enum playlist_edit_types {
+    PLAYLIST_EDIT_DELETE,  //!< delete the song at pos
+    PLAYLIST_EDIT_MOVE,    //!< move the song at pos to position to
+    PLAYLIST_EDIT_ADD      //!< add uri at pos
+};
+
+/**
+ * A single playlist edit, positions are valid after all previous edits are applied
+ */
+struct t_playlist_edit {
+    enum playlist_edit_types type;  //!< edit operation
+    unsigned pos;                   //!< position of the song
+    unsigned to;                    //!< new position for PLAYLIST_EDIT_MOVE
+    const char *uri;                //!< song uri for PLAYLIST_EDIT_ADD, points to the key of the target list node
+};
+
+/**
+ * Edits that transform a playlist into another
+ */
+struct t_playlist_edits {
+    struct t_playlist_edit *edits;  //!< the edits in the order to apply
+    size_t len;                     //!< number of edits
+    size_t size;                    //!< allocated size of edits
+};
+
+void playlist_edits_init(struct t_playlist_edits *edits);
+void playlist_edits_clear(struct t_playlist_edits *edits);
+bool playlist_diff(const struct t_list *current, const struct t_list *target, size_t max_edits,
+        struct t_playlist_edits *edits);
+bool playlist_same_songs(const struct t_list *current, const struct t_list *target);
+
+#endif
@@ -8,6 +8,8 @@
 #include "src/mpd_client/playlists.h"
 
 #include "dist/rax/rax.h"
+#include "src/lib/api.h"
+#include "src/lib/jsonrpc.h"
 #include "src/lib/log.h"
 #include "src/lib/random.h"
 #include "src/lib/rax_extras.h"
@@ -20,6 +22,7 @@
 
 #include <stdbool.h>
 #include <string.h>
+#include <time.h>
 
 /**
  * Private definitions
@@ -28,39 +31,19 @@
 static bool playlist_sort(struct t_partition_state *partition_state, const char *playlist, const char *tagstr, bool sortdesc, sds *error);
 static bool replace_playlist(struct t_partition_state *partition_state, const char *new_pl,
         const char *to_replace_pl, sds *error);
+static bool playlist_delete_positions(struct t_partition_state *partition_state, const char *playlist,
+        struct t_list *positions, sds *error);
+static bool playlist_get_entries(struct t_partition_state *partition_state, const char *playlist,
+        struct t_list *plist, rax *uris, sds *error);
+static long playlist_check_entries(struct t_partition_state *partition_state, const char *playlist,
+        struct t_list *plist, rax *missing, bool remove, sds *error);
+static void free_plist_node(struct t_list_node *current);
+static void send_progress(bool removing, const char *playlist, long count, long total, time_t *last_notify);
 
 /**
  * Public functions
  */
 
-/**
- * Returns the playlists last modification time
- * @param partition_state pointer to partition specific states
- * @param playlist name of the playlist to check
- * @return last modification time
- */
-time_t mpd_client_get_playlist_mtime(struct t_partition_state *partition_state, const char *playlist) {
-    time_t mtime = 0;
-    if (mpd_send_list_playlists(partition_state->conn)) {
-        struct mpd_playlist *pl;
-        while ((pl = mpd_recv_playlist(partition_state->conn)) != NULL) {
-            const char *plpath = mpd_playlist_get_path(pl);
-            if (strcmp(plpath, playlist) == 0) {
-                mtime = mpd_playlist_get_last_modified(pl);
-                mpd_playlist_free(pl);
-                break;
-            }
-            mpd_playlist_free(pl);
-        }
-    }
-    mpd_response_finish(partition_state->conn);
-    if (mympd_check_error_and_recover(partition_state, NULL, "mpd_send_list_playlists") == false) {
-        return 0;
-    }
-
-    return mtime;
-}
-
 /**
  * Deduplicates all static playlists
  * @param partition_state pointer to partition state
@@ -123,16 +106,18 @@ long mpd_client_playlist_dedup(struct t_partition_state *partition_state, const
     }
 
     long rc = duplicates.length;
-    if (remove == true) {
-        struct t_list_node *current = duplicates.head;
-        while (current != NULL) {
-            mpd_run_playlist_delete(partition_state->conn, playlist, (unsigned)current->value_i);
-            if (mympd_check_error_and_recover(partition_state, error, "mpd_run_playlist_delete") == false) {
-                rc = -1;
-                break;
+    if (remove == true &&
+        duplicates.length > 0)
+    {
+        if (playlist_delete_positions(partition_state, playlist, &duplicates, error) == false) {
+            rc = -1;
+        }
+        else {
+            struct t_list_node *current = duplicates.head;
+            while (current != NULL) {
+                MYMPD_LOG_WARN(MPD_PARTITION_DEFAULT, "Playlist \"%s\": duplicate entry \"%s\" removed", playlist, current->key);
+                current = current->next;
             }
-            MYMPD_LOG_WARN(MPD_PARTITION_DEFAULT, "Playlist \"%s\": duplicate entry \"%s\" removed", playlist, current->key);
-            current = current -> next;
         }
     }
     list_clear(&duplicates);
@@ -140,7 +125,8 @@ long mpd_client_playlist_dedup(struct t_partition_state *partition_state, const
 }
 
 /**
- * Validates all entries from all static playlists
+ * Validates all entries from all static playlists.
+ * The entries of all playlists are checked against one listing of the mpd database.
  * @param partition_state pointer to partition state
  * @param remove true = remove invalid songs, else count invalid songs
  * @param error pointer to an already allocated sds string for the error message
@@ -154,21 +140,40 @@ long mpd_client_playlist_validate_all(struct t_partition_state *partition_state,
         list_clear(&plists);
         return -1;
     }
-    long result = 0;
-    struct t_list_node *current;
-    while ((current = list_shift_first(&plists)) != NULL) {
-        long rc = mpd_client_playlist_validate(partition_state, current->key, remove, error);
-        if (rc > -1) {
-            result += rc;
+    //read all playlists and collect their uris
+    rax *missing = raxNew();
+    struct t_list_node *current = plists.head;
+    while (current != NULL) {
+        struct t_list *plist = list_new();
+        if (playlist_get_entries(partition_state, current->key, plist, missing, error) == true) {
+            current->user_data = plist;
         }
-        list_node_free(current);
+        else {
+            list_free(plist);
+        }
+        current = current->next;
     }
-    list_clear(&plists);
+    long result = -1;
+    if (mpd_client_filter_existing_songs(partition_state, missing, NULL, error) == true) {
+        result = 0;
+        current = plists.head;
+        while (current != NULL) {
+            if (current->user_data != NULL) {
+                long rc = playlist_check_entries(partition_state, current->key, (struct t_list *)current->user_data, missing, remove, error);
+                if (rc > -1) {
+                    result += rc;
+                }
+            }
+            current = current->next;
+        }
+    }
+    list_clear_user_data(&plists, free_plist_node);
+    raxFree(missing);
     return result;
 }
 
 /**
- * Validates the playlist entries
+ * Validates the playlist entries against one listing of the mpd database
  * @param partition_state pointer to partition state
  * @param playlist playlist to check
  * @param remove true = remove invalid songs, else count invalid songs
@@ -176,60 +181,17 @@ long mpd_client_playlist_validate_all(struct t_partition_state *partition_state,
  * @return -1 on error, else number of removed songs
  */
 long mpd_client_playlist_validate(struct t_partition_state *partition_state, const char *playlist, bool remove, sds *error) {
-    //get the whole playlist
     struct t_list plist;
     list_init(&plist);
-    struct mpd_song *song;
-    long pos = 0;
-    if (mpd_send_list_playlist(partition_state->conn, playlist)) {
-        while ((song = mpd_recv_song(partition_state->conn)) != NULL) {
-            //reverse the playlist
-            list_insert(&plist, mpd_song_get_uri(song), pos, NULL, NULL);
-            mpd_song_free(song);
-            pos++;
-        }
-    }
-    mpd_response_finish(partition_state->conn);
-    if (mympd_check_error_and_recover(partition_state, error, "mpd_send_list_playlist") == false) {
-        list_clear(&plist);
-        return -1;
-    }
-
-    disable_all_mpd_tags(partition_state);
-    //check each entry
-    struct t_list_node *current = plist.head;
-    long rc = 0;
-    while (current != NULL) {
-        if (is_streamuri(current->key) == false) {
-            if (mpd_send_list_meta(partition_state->conn, current->key) == false ||
-                mpd_response_finish(partition_state->conn) == false)
-            {
-                //entry not found
-                //silently clear the error if song is not found
-                if (mpd_connection_clear_error(partition_state->conn) == false ||
-                    mpd_response_finish(partition_state->conn) == false)
-                {
-                    rc = -1;
-                    break;
-                }
-                if (remove == true) {
-                    mpd_run_playlist_delete(partition_state->conn, playlist, (unsigned)current->value_i);
-                    if (mympd_check_error_and_recover(partition_state, error, "mpd_run_playlist_delete") == false) {
-                        rc = -1;
-                        break;
-                    }
-                    MYMPD_LOG_WARN(MPD_PARTITION_DEFAULT, "Playlist \"%s\": %s removed", playlist, current->key);
-                }
-                else {
-                    MYMPD_LOG_WARN(MPD_PARTITION_DEFAULT, "Playlist \"%s\": %s not found", playlist, current->key);
-                }
-                rc++;
-            }
-        }
-        current = current -> next;
+    rax *missing = raxNew();
+    long rc = -1;
+    if (playlist_get_entries(partition_state, playlist, &plist, missing, error) == true &&
+        mpd_client_filter_existing_songs(partition_state, missing, playlist, error) == true)
+    {
+        rc = playlist_check_entries(partition_state, playlist, &plist, missing, remove, error);
     }
     list_clear(&plist);
-    enable_mpd_tags(partition_state, &partition_state->mpd_state->tags_mympd);
+    raxFree(missing);
     return rc;
 }
 
@@ -384,6 +346,209 @@ bool mpd_client_get_all_playlists(struct t_partition_state *partition_state, str
     return true;
 }
 
+/**
+ * Gets all playlists with their last modification time.
+ * @param partition_state pointer to partition state
+ * @param l pointer to list to populate, the value_i is the last modification time
+ * @param error pointer to an already allocated sds string for the error message
+ * @return true on success, else false
+ */
+bool mpd_client_get_all_playlists_mtime(struct t_partition_state *partition_state, struct t_list *l, sds *error) {
+    if (mpd_send_list_playlists(partition_state->conn)) {
+        struct mpd_playlist *pl;
+        while ((pl = mpd_recv_playlist(partition_state->conn)) != NULL) {
+            list_push(l, mpd_playlist_get_path(pl), (long long)mpd_playlist_get_last_modified(pl), NULL, NULL);
+            mpd_playlist_free(pl);
+        }
+    }
+    mpd_response_finish(partition_state->conn);
+    return mympd_check_error_and_recover(partition_state, error, "mpd_send_list_playlists");
+}
+
+/**
+ * Gets the song uris of a playlist.
+ * @param partition_state pointer to partition state
+ * @param playlist the playlist
+ * @param l pointer to list to populate
+ * @param error pointer to an already allocated sds string for the error message
+ * @return true on success, else false
+ */
+bool mpd_client_get_playlist_uris(struct t_partition_state *partition_state, const char *playlist, struct t_list *l, sds *error) {
+    if (mpd_send_list_playlist(partition_state->conn, playlist)) {
+        struct mpd_song *song;
+        while ((song = mpd_recv_song(partition_state->conn)) != NULL) {
+            list_push(l, mpd_song_get_uri(song), 0, NULL, NULL);
+            mpd_song_free(song);
+        }
+    }
+    mpd_response_finish(partition_state->conn);
+    return mympd_check_error_and_recover(partition_state, error, "mpd_send_list_playlist");
+}
+
+/**
+ * Applies the edits calculated by playlist_diff to a playlist.
+ * Uses command lists to send MPD_COMMANDS_MAX commands at once.
+ * Consecutive deletes are sent as range deletes if supported by MPD.
+ * @param partition_state pointer to partition state
+ * @param playlist the playlist
+ * @param edits the edits to apply
+ * @param length current length of the playlist
+ * @param error pointer to an already allocated sds string for the error message
+ * @return true on success, else false
+ */
+bool mpd_client_playlist_apply_edits(struct t_partition_state *partition_state, const char *playlist,
+        const struct t_playlist_edits *edits, long length, sds *error)
+{
+    //playlistadd with position requires mpd 0.23.1
+    bool add_to = mpd_connection_cmp_server_version(partition_state->conn, 0, 23, 1) >= 0;
+    size_t i = 0;
+    while (i < edits->len) {
+        bool rc = true;
+        if (mpd_command_list_begin(partition_state->conn, false) == true) {
+            for (size_t j = 0; i < edits->len && j < MPD_COMMANDS_MAX; i++, j++) {
+                const struct t_playlist_edit *edit = &edits->edits[i];
+                switch(edit->type) {
+                    case PLAYLIST_EDIT_DELETE: {
+                        //deletes are in descending order, consecutive positions are merged to a range
+                        unsigned start = edit->pos;
+                        unsigned end = edit->pos + 1;
+                        if (partition_state->mpd_state->feat_playlist_rm_range == true) {
+                            while (i + 1 < edits->len &&
+                                edits->edits[i + 1].type == PLAYLIST_EDIT_DELETE &&
+                                edits->edits[i + 1].pos + 1 == start)
+                            {
+                                i++;
+                                start--;
+                            }
+                        }
+                        rc = end - start > 1
+                            ? mpd_send_playlist_delete_range(partition_state->conn, playlist, start, end)
+                            : mpd_send_playlist_delete(partition_state->conn, playlist, start);
+                        length -= (long)(end - start);
+                        break;
+                    }
+                    case PLAYLIST_EDIT_MOVE:
+                        rc = mpd_send_playlist_move(partition_state->conn, playlist, edit->pos, edit->to);
+                        break;
+                    case PLAYLIST_EDIT_ADD:
+                        if (edit->pos == (unsigned)length) {
+                            rc = mpd_send_playlist_add(partition_state->conn, playlist, edit->uri);
+                        }
+                        else if (add_to == true) {
+                            rc = mpd_send_playlist_add_to(partition_state->conn, playlist, edit->uri, edit->pos);
+                        }
+                        else {
+                            rc = mpd_send_playlist_add(partition_state->conn, playlist, edit->uri) &&
+                                mpd_send_playlist_move(partition_state->conn, playlist, (unsigned)length, edit->pos);
+                        }
+                        length++;
+                        break;
+                }
+                if (rc == false) {
+                    mympd_set_mpd_failure(partition_state, "Error adding command to command list");
+                    break;
+                }
+            }
+            mpd_client_command_list_end_check(partition_state);
+        }
+        mpd_response_finish(partition_state->conn);
+        if (mympd_check_error_and_recover(partition_state, error, "mpd_send_playlist_edit") == false ||
+            rc == false)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+/**
+ * Removes the uris that exist in the mpd database from the set,
+ * the remaining uris are missing.
+ * Only the top-level directories that contain uris of the set are listed.
+ * @param partition_state pointer to partition state
+ * @param uris set of song uris to check
+ * @param playlist playlist name for progress notifications or NULL
+ * @param error pointer to an already allocated sds string for the error message
+ * @return true on success, else false
+ */
+bool mpd_client_filter_existing_songs(struct t_partition_state *partition_state, rax *uris, const char *playlist, sds *error) {
+    if (uris->numele == 0) {
+        return true;
+    }
+    long total = (long)uris->numele;
+    time_t last_notify = time(NULL);
+    //top-level directories of the uris
+    rax *dirs = raxNew();
+    raxIterator iter;
+    raxStart(&iter, uris);
+    raxSeek(&iter, "^", NULL, 0);
+    while (raxNext(&iter)) {
+        const unsigned char *slash = memchr(iter.key, '/', iter.key_len);
+        if (slash != NULL) {
+            raxTryInsert(dirs, iter.key, (size_t)(slash - iter.key), NULL, NULL);
+        }
+    }
+    raxStop(&iter);
+    //songs in the root directory and the existing top-level directories
+    disable_all_mpd_tags(partition_state);
+    struct t_list list_dirs;
+    list_init(&list_dirs);
+    struct mpd_entity *entity;
+    if (mpd_send_list_meta(partition_state->conn, "")) {
+        while ((entity = mpd_recv_entity(partition_state->conn)) != NULL) {
+            if (mpd_entity_get_type(entity) == MPD_ENTITY_TYPE_SONG) {
+                const char *uri = mpd_song_get_uri(mpd_entity_get_song(entity));
+                raxRemove(uris, (unsigned char *)uri, strlen(uri), NULL);
+            }
+            else if (mpd_entity_get_type(entity) == MPD_ENTITY_TYPE_DIRECTORY) {
+                const char *path = mpd_directory_get_path(mpd_entity_get_directory(entity));
+                if (raxFind(dirs, (unsigned char *)path, strlen(path)) != raxNotFound) {
+                    list_push(&list_dirs, path, 0, NULL, NULL);
+                }
+            }
+            mpd_entity_free(entity);
+        }
+    }
+    mpd_response_finish(partition_state->conn);
+    raxFree(dirs);
+    bool rc = mympd_check_error_and_recover(partition_state, NULL, "mpd_send_list_meta");
+    enable_mpd_tags(partition_state, &partition_state->mpd_state->tags_mympd);
+    if (rc == false) {
+        list_clear(&list_dirs);
+        if (error != NULL) {
+            *error = sdscat(*error, "Error validating playlist");
+        }
+        return false;
+    }
+    //list the song uris of the top-level directories
+    struct t_list_node *current = list_dirs.head;
+    while (current != NULL &&
+        uris->numele > 0)
+    {
+        if (mpd_send_list_all(partition_state->conn, current->key)) {
+            struct mpd_pair *pair;
+            while ((pair = mpd_recv_pair_named(partition_state->conn, "file")) != NULL) {
+                raxRemove(uris, (unsigned char *)pair->value, strlen(pair->value), NULL);
+                mpd_return_pair(partition_state->conn, pair);
+            }
+        }
+        mpd_response_finish(partition_state->conn);
+        if (mympd_check_error_and_recover(partition_state, NULL, "mpd_send_list_all") == false) {
+            if (error != NULL) {
+                *error = sdscat(*error, "Error validating playlist");
+            }
+            rc = false;
+            break;
+        }
+        if (playlist != NULL) {
+            send_progress(false, playlist, total - (long)uris->numele, total, &last_notify);
+        }
+        current = current->next;
+    }
+    list_clear(&list_dirs);
+    return rc;
+}
 
 /**
  * Private functions
@@ -553,3 +718,177 @@ static bool replace_playlist(struct t_partition_state *partition_state, const ch
     FREE_SDS(backup_pl);
     return mympd_check_error_and_recover(partition_state, error, "mpd_run_rename");
 }
+
+/**
+ * Removes entries from a playlist with pipelined commands.
+ * Adjacent positions are merged to ranges if mpd supports it.
+ * @param partition_state pointer to partition state
+ * @param playlist playlist to modify
+ * @param positions list of entries, value_i is the position, must be sorted in descending order
+ * @param error pointer to an already allocated sds string for the error message
+ * @return true on success, else false
+ */
+static bool playlist_delete_positions(struct t_partition_state *partition_state, const char *playlist,
+        struct t_list *positions, sds *error)
+{
+    struct t_list_node *current = positions->head;
+    long removed = 0;
+    time_t last_notify = time(NULL);
+    while (current != NULL) {
+        if (mpd_command_list_begin(partition_state->conn, false)) {
+            long cmds = 0;
+            while (current != NULL &&
+                cmds < MPD_COMMANDS_MAX)
+            {
+                //descending order, removing an entry does not shift the following positions
+                unsigned end = (unsigned)current->value_i + 1;
+                unsigned start = (unsigned)current->value_i;
+                long count = 1;
+                if (partition_state->mpd_state->feat_playlist_rm_range == true) {
+                    while (current->next != NULL &&
+                        current->next->value_i == (long long)start - 1)
+                    {
+                        current = current->next;
+                        start--;
+                        count++;
+                    }
+                }
+                bool rc = end - start > 1
+                    ? mpd_send_playlist_delete_range(partition_state->conn, playlist, start, end)
+                    : mpd_send_playlist_delete(partition_state->conn, playlist, start);
+                if (rc == false) {
+                    mympd_set_mpd_failure(partition_state, "Error adding command to command list mpd_send_playlist_delete");
+                    break;
+                }
+                removed += count;
+                cmds++;
+                current = current->next;
+            }
+            mpd_client_command_list_end_check(partition_state);
+        }
+        mpd_response_finish(partition_state->conn);
+        if (mympd_check_error_and_recover(partition_state, error, "mpd_send_playlist_delete") == false) {
+            return false;
+        }
+        send_progress(true, playlist, removed, positions->length, &last_notify);
+    }
+    return true;
+}
+
+/**
+ * Gets the entries of a playlist in descending position order
+ * @param partition_state pointer to partition state
+ * @param playlist playlist name
+ * @param plist list to populate, key is the uri and value_i the position
+ * @param uris if not NULL the uris of the songs are added to this set, stream uris are skipped
+ * @param error pointer to an already allocated sds string for the error message
+ * @return true on success, else false
+ */
+static bool playlist_get_entries(struct t_partition_state *partition_state, const char *playlist,
+        struct t_list *plist, rax *uris, sds *error)
+{
+    struct mpd_song *song;
+    long pos = 0;
+    if (mpd_send_list_playlist(partition_state->conn, playlist)) {
+        while ((song = mpd_recv_song(partition_state->conn)) != NULL) {
+            const char *uri = mpd_song_get_uri(song);
+            //reverse the playlist
+            list_insert(plist, uri, pos, NULL, NULL);
+            if (uris != NULL &&
+                is_streamuri(uri) == false)
+            {
+                raxTryInsert(uris, (unsigned char *)uri, strlen(uri), NULL, NULL);
+            }
+            mpd_song_free(song);
+            pos++;
+        }
+    }
+    mpd_response_finish(partition_state->conn);
+    return mympd_check_error_and_recover(partition_state, error, "mpd_send_list_playlist");
+}
+
+/**
+ * Counts or removes the playlist entries that are missing in the mpd database
+ * @param partition_state pointer to partition state
+ * @param playlist playlist name
+ * @param plist playlist entries in descending position order
+ * @param missing set of missing song uris
+ * @param remove true = remove invalid songs, else count invalid songs
+ * @param error pointer to an already allocated sds string for the error message
+ * @return -1 on error, else number of invalid songs
+ */
+static long playlist_check_entries(struct t_partition_state *partition_state, const char *playlist,
+        struct t_list *plist, rax *missing, bool remove, sds *error)
+{
+    struct t_list invalid;
+    list_init(&invalid);
+    struct t_list_node *current = plist->head;
+    while (current != NULL) {
+        if (raxFind(missing, (unsigned char *)current->key, sdslen(current->key)) != raxNotFound) {
+            list_push(&invalid, current->key, current->value_i, NULL, NULL);
+        }
+        current = current->next;
+    }
+    long rc = invalid.length;
+    if (remove == true &&
+        invalid.length > 0)
+    {
+        //invalid list is in descending position order
+        if (playlist_delete_positions(partition_state, playlist, &invalid, error) == false) {
+            rc = -1;
+        }
+    }
+    if (rc > 0) {
+        current = invalid.head;
+        while (current != NULL) {
+            if (remove == true) {
+                MYMPD_LOG_WARN(MPD_PARTITION_DEFAULT, "Playlist \"%s\": %s removed", playlist, current->key);
+            }
+            else {
+                MYMPD_LOG_WARN(MPD_PARTITION_DEFAULT, "Playlist \"%s\": %s not found", playlist, current->key);
+            }
+            current = current->next;
+        }
+    }
+    list_clear(&invalid);
+    return rc;
+}
+
+/**
+ * Callback function for freeing a list node with a playlist as user_data
+ * @param current pointer to list node
+ */
+static void free_plist_node(struct t_list_node *current) {
+    if (current->user_data != NULL) {
+        list_free((struct t_list *)current->user_data);
+    }
+}
+
+/**
+ * Sends a progress notification for long running playlist jobs, at most one per second
+ * @param removing true if entries are removed, false if entries are checked
+ * @param playlist playlist name
+ * @param count processed entries
+ * @param total number of entries
+ * @param last_notify pointer to the time of the last notification
+ */
+static void send_progress(bool removing, const char *playlist, long count, long total, time_t *last_notify) {
+    time_t now = time(NULL);
+    if (count == total ||
+        now == *last_notify)
+    {
+        return;
+    }
+    *last_notify = now;
+    sds count_str = sdsfromlonglong((long long)count);
+    sds total_str = sdsfromlonglong((long long)total);
+    sds buffer = removing == true
+        ? jsonrpc_notify_phrase(sdsempty(), JSONRPC_FACILITY_PLAYLIST, JSONRPC_SEVERITY_INFO, "Updating playlist %{plist}: %{count} of %{total} entries removed",
+            6, "plist", playlist, "count", count_str, "total", total_str)
+        : jsonrpc_notify_phrase(sdsempty(), JSONRPC_FACILITY_PLAYLIST, JSONRPC_SEVERITY_INFO, "Validating playlist %{plist}: %{count} of %{total} entries checked",
+            6, "plist", playlist, "count", count_str, "total", total_str);
+    ws_notify(buffer, MPD_PARTITION_ALL);
+    FREE_SDS(buffer);
+    FREE_SDS(count_str);
+    FREE_SDS(total_str);
+}
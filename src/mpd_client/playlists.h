@@ -7,7 +7,9 @@
 #ifndef MYMPD_MPD_CLIENT_PLAYLISTS_H
 #define MYMPD_MPD_CLIENT_PLAYLISTS_H
 
+#include "dist/rax/rax.h"
 #include "src/lib/mympd_state.h"
+#include "src/mpd_client/playlist_diff.h"
 
 enum playlist_types {
     PLTYPE_ALL = 0,
@@ -16,7 +18,6 @@ enum playlist_types {
     PLTYPE_SMARTPLS_ONLY = 3
 };
 
-time_t mpd_client_get_playlist_mtime(struct t_partition_state *partition_state, const char *playlist);
 bool mpd_client_playlist_clear(struct t_partition_state *partition_state, const char *plist, sds *error);
 bool mpd_client_playlist_shuffle(struct t_partition_state *partition_state, const char *uri, sds *error);
 bool mpd_client_playlist_sort(struct t_partition_state *partition_state, const char *uri, const char *tagstr, bool sortdesc, sds *error);
@@ -26,4 +27,9 @@ long mpd_client_playlist_validate_all(struct t_partition_state *partition_state,
 long mpd_client_playlist_dedup(struct t_partition_state *partition_state, const char *playlist, bool remove, sds *error);
 long mpd_client_playlist_dedup_all(struct t_partition_state *partition_state, bool remove, sds *error);
 bool mpd_client_get_all_playlists(struct t_partition_state *partition_state, struct t_list *l, bool smartpls, sds *error);
+bool mpd_client_get_all_playlists_mtime(struct t_partition_state *partition_state, struct t_list *l, sds *error);
+bool mpd_client_get_playlist_uris(struct t_partition_state *partition_state, const char *playlist, struct t_list *l, sds *error);
+bool mpd_client_playlist_apply_edits(struct t_partition_state *partition_state, const char *playlist,
+        const struct t_playlist_edits *edits, long length, sds *error);
+bool mpd_client_filter_existing_songs(struct t_partition_state *partition_state, rax *uris, const char *playlist, sds *error);
 #endif
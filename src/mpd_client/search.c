@@ -15,8 +15,8 @@
 #include <string.h>
 
 //private definitions
-static sds append_search_expression_album(enum mpd_tag_type tag_albumartist, struct mpd_song *album,
-        const struct t_albums_config *album_config, sds expression);
+static sds append_search_expression_album(enum mpd_tag_type tag_albumartist, const void *album,
+        tag_value_getter getter, const struct t_albums_config *album_config, sds expression);
 static bool add_search_whence_param(struct t_partition_state *partition_state, unsigned to, unsigned whence);
 
 //public functions
@@ -50,6 +50,58 @@ bool mpd_client_search_add_to_plist(struct t_partition_state *partition_state, c
     return mympd_check_error_and_recover(partition_state, error, "mpd_search_add_db_songs_to_playlist");
 }
 
+/**
+ * Searches the mpd database for songs by expression and returns only the uris
+ * @param partition_state pointer to partition specific states
+ * @param expression mpd search expression
+ * @param sort tag to sort
+ * @param sortdesc false = ascending, true = descending
+ * @param uris already initialized list to append the song uris
+ * @param error pointer to already allocated sds string for the error message
+ *              or NULL to return no response
+ * @return true on success else false
+ */
+bool mpd_client_search_uris(struct t_partition_state *partition_state, const char *expression,
+        const char *sort, bool sortdesc, struct t_list *uris, sds *error)
+{
+    //only the uris are needed
+    disable_all_mpd_tags(partition_state);
+    unsigned start = 0;
+    unsigned received;
+    bool rc = true;
+    do {
+        if (mpd_search_db_songs(partition_state->conn, false) == false ||
+            mpd_search_add_expression(partition_state->conn, expression) == false ||
+            mpd_client_add_search_sort_param(partition_state, sort, sortdesc, true) == false ||
+            mpd_search_add_window(partition_state->conn, start, start + MPD_RESULTS_MAX) == false)
+        {
+            mpd_search_cancel(partition_state->conn);
+            if (error != NULL) {
+                *error = sdscat(*error, "Error creating MPD search command");
+            }
+            rc = false;
+            break;
+        }
+        received = 0;
+        if (mpd_search_commit(partition_state->conn)) {
+            struct mpd_song *song;
+            while ((song = mpd_recv_song(partition_state->conn)) != NULL) {
+                list_push(uris, mpd_song_get_uri(song), 0, NULL, NULL);
+                mpd_song_free(song);
+                received++;
+            }
+        }
+        mpd_response_finish(partition_state->conn);
+        if (mympd_check_error_and_recover(partition_state, error, "mpd_search_db_songs") == false) {
+            rc = false;
+            break;
+        }
+        start += MPD_RESULTS_MAX;
+    } while (received == MPD_RESULTS_MAX);
+    enable_mpd_tags(partition_state, &partition_state->mpd_state->tags_mympd);
+    return rc;
+}
+
 /**
  * Searches the mpd database for songs by expression and adds the result to the queue
  * @param partition_state pointer to partition specific states
@@ -85,15 +137,31 @@ bool mpd_client_search_add_to_queue(struct t_partition_state *partition_state, c
 /**
  * Creates a mpd search expression to find all songs in an album
  * @param tag_albumartist albumartist tag
- * @param album mpd_song struct representing the album
+ * @param album t_album struct from the album cache
  * @param album_config album configuration
  * @return newly allocated sds string
  */
-sds get_search_expression_album(enum mpd_tag_type tag_albumartist, struct mpd_song *album,
+sds get_search_expression_album(enum mpd_tag_type tag_albumartist, const struct t_album *album,
         const struct t_albums_config *album_config)
 {
     sds expression = sdsnewlen("(", 1);
-    expression = append_search_expression_album(tag_albumartist, album, album_config, expression);
+    expression = append_search_expression_album(tag_albumartist, album, mpd_client_album_tag_getter, album_config, expression);
+    expression = sdscatlen(expression, ")", 1);
+    return expression;
+}
+
+/**
+ * Creates a mpd search expression to find all songs in the album of a song
+ * @param tag_albumartist albumartist tag
+ * @param song mpd_song struct
+ * @param album_config album configuration
+ * @return newly allocated sds string
+ */
+sds get_search_expression_song_album(enum mpd_tag_type tag_albumartist, const struct mpd_song *song,
+        const struct t_albums_config *album_config)
+{
+    sds expression = sdsnewlen("(", 1);
+    expression = append_search_expression_album(tag_albumartist, song, mpd_client_song_tag_getter, album_config, expression);
     expression = sdscatlen(expression, ")", 1);
     return expression;
 }
@@ -101,16 +169,16 @@ sds get_search_expression_album(enum mpd_tag_type tag_albumartist, struct mpd_so
 /**
  * Creates a mpd search expression to find all songs in one cd of an album
  * @param tag_albumartist albumartist tag
- * @param album mpd_song struct representing the album
+ * @param album t_album struct from the album cache
  * @param disc disc number
  * @param album_config album configuration
  * @return newly allocated sds string
  */
-sds get_search_expression_album_disc(enum mpd_tag_type tag_albumartist, struct mpd_song *album,
+sds get_search_expression_album_disc(enum mpd_tag_type tag_albumartist, const struct t_album *album,
         const char *disc, const struct t_albums_config *album_config)
 {
     sds expression = sdsnewlen("(", 1);
-    expression = append_search_expression_album(tag_albumartist, album, album_config, expression);
+    expression = append_search_expression_album(tag_albumartist, album, mpd_client_album_tag_getter, album_config, expression);
     //and for cd
     expression = sdscat(expression, " AND ");
     expression = escape_mpd_search_expression(expression, "Disc", "==", disc);
@@ -128,13 +196,24 @@ sds get_search_expression_album_disc(enum mpd_tag_type tag_albumartist, struct m
  */
 sds escape_mpd_search_expression(sds buffer, const char *tag, const char *operator, const char *value) {
     buffer = sdscatfmt(buffer, "(%s %s '", tag, operator);
+    buffer = escape_mpd_search_value(buffer, value);
+    buffer = sdscatlen(buffer, "')", 2);
+    return buffer;
+}
+
+/**
+ * Escapes a value for a mpd search expression
+ * @param buffer already allocated sds string to append
+ * @param value search value
+ * @return pointer to buffer
+ */
+sds escape_mpd_search_value(sds buffer, const char *value) {
     for (size_t i = 0;  i < strlen(value); i++) {
         if (value[i] == '\\' || value[i] == '\'') {
             buffer = sdscatlen(buffer, "\\", 1);
         }
         buffer = sds_catchar(buffer, value[i]);
     }
-    buffer = sdscatlen(buffer, "')", 2);
     return buffer;
 }
 
@@ -179,24 +258,25 @@ bool mpd_client_add_search_sort_param(struct t_partition_state *partition_state,
 /**
  * Creates a mpd search expression to find all songs in one album
  * @param tag_albumartist albumartist tag
- * @param album mpd_song struct representing the album
+ * @param album t_album or mpd_song struct
+ * @param getter callback to get the tag values from the album
  * @param album_config album configuration
  * @param expression already allocated sds string to append the expression
  * @return pointer to expression
  */
-static sds append_search_expression_album(enum mpd_tag_type tag_albumartist, struct mpd_song *album,
-        const struct t_albums_config *album_config, sds expression)
+static sds append_search_expression_album(enum mpd_tag_type tag_albumartist, const void *album,
+        tag_value_getter getter, const struct t_albums_config *album_config, sds expression)
 {
     unsigned count = 0;
     const char *value;
     //search for all artists
-    while ((value = mpd_song_get_tag(album, tag_albumartist, count)) != NULL) {
+    while ((value = getter(album, tag_albumartist, count)) != NULL) {
         expression = escape_mpd_search_expression(expression, mpd_tag_name(tag_albumartist), "==", value);
         expression = sdscat(expression, " AND ");
         count++;
     }
     //and for album
-    value = mpd_song_get_tag(album, MPD_TAG_ALBUM, 0);
+    value = getter(album, MPD_TAG_ALBUM, 0);
     if (value != NULL) {
         expression = escape_mpd_search_expression(expression, "Album", "==", value);
     }
@@ -205,7 +285,7 @@ static sds append_search_expression_album(enum mpd_tag_type tag_albumartist, str
     }
     //optionally append group tag
     if (album_config->group_tag != MPD_TAG_UNKNOWN) {
-        value = mpd_song_get_tag(album, album_config->group_tag, 0);
+        value = getter(album, album_config->group_tag, 0);
         if (value != NULL) {
             expression = sdscat(expression, " AND ");
             expression = escape_mpd_search_expression(expression, mpd_tag_name(album_config->group_tag),
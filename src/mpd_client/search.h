@@ -7,6 +7,7 @@
 #ifndef MYMPD_MPD_CLIENT_SEARCH_H
 #define MYMPD_MPD_CLIENT_SEARCH_H
 
+#include "src/lib/album_cache.h"
 #include "src/lib/mympd_state.h"
 
 bool mpd_client_search_add_to_plist(struct t_partition_state *partition_state, const char *expression,
@@ -14,10 +15,15 @@ bool mpd_client_search_add_to_plist(struct t_partition_state *partition_state, c
 bool mpd_client_search_add_to_queue(struct t_partition_state *partition_state, const char *expression,
         unsigned to, enum mpd_position_whence whence, const char *sort, bool sortdesc, sds *error);
 
+bool mpd_client_search_uris(struct t_partition_state *partition_state, const char *expression,
+        const char *sort, bool sortdesc, struct t_list *uris, sds *error);
 bool mpd_client_add_search_sort_param(struct t_partition_state *partition_state, const char *sort, bool sortdesc, bool check_version);
-sds get_search_expression_album(enum mpd_tag_type tag_albumartist, struct mpd_song *album,
+sds get_search_expression_album(enum mpd_tag_type tag_albumartist, const struct t_album *album,
         const struct t_albums_config *album_config);
-sds get_search_expression_album_disc(enum mpd_tag_type tag_albumartist, struct mpd_song *album,
+sds get_search_expression_song_album(enum mpd_tag_type tag_albumartist, const struct mpd_song *song,
+        const struct t_albums_config *album_config);
+sds get_search_expression_album_disc(enum mpd_tag_type tag_albumartist, const struct t_album *album,
         const char *disc, const struct t_albums_config *album_config);
 sds escape_mpd_search_expression(sds buffer, const char *tag, const char *operator, const char *value);
+sds escape_mpd_search_value(sds buffer, const char *value);
 #endif
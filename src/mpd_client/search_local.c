@@ -12,6 +12,7 @@
 #include "src/lib/mem.h"
 #include "src/lib/sds_extras.h"
 #include "src/lib/utility.h"
+#include "src/mpd_client/tags.h"
 
 #define PCRE2_CODE_UNIT_WIDTH 8
 #include <pcre2.h>
@@ -34,19 +35,75 @@ enum search_operators {
 };
 
 /**
- * Struct to hold a parsed search expression triple
+ * Node types of the compiled search expression
  */
-struct t_search_expression {
-    int tag;                   //!< tag to search in
-    enum search_operators op;  //!< search operator
-    sds value;                 //!< value to match
-    pcre2_code *re_compiled;   //!< compiled regex if operator is a regex
+enum search_node_types {
+    SEARCH_NODE_MATCH,
+    SEARCH_NODE_AND,
+    SEARCH_NODE_OR,
+    SEARCH_NODE_NOT
 };
 
-static void *free_search_expression(struct t_search_expression *expr);
-static void free_search_expression_node(struct t_list_node *current);
+struct t_search_match;
+
+/**
+ * Compare function of a search operator
+ * @param match the compiled search expression triple
+ * @param value the lower cased tag value
+ * @param value_len length of the tag value
+ * @return true if the value matches, else false
+ */
+typedef bool (*search_cmp)(const struct t_search_match *match, const char *value, size_t value_len);
+
+/**
+ * Compiled search expression triple
+ */
+struct t_search_match {
+    int tag;                        //!< tag to search in, -2 for any tag
+    enum search_operators op;       //!< search operator
+    bool negated;                   //!< true for the negated operators != and !~
+    search_cmp cmp;                 //!< compare function for the operator
+    sds value;                      //!< lower cased value to match
+    pcre2_code *re_compiled;        //!< compiled regex if operator is a regex
+    pcre2_match_data *match_data;   //!< match data for the compiled regex
+};
+
+/**
+ * Node of the compiled search expression
+ */
+struct t_search_node {
+    enum search_node_types type;       //!< node type
+    struct t_search_match match;       //!< expression triple for SEARCH_NODE_MATCH
+    struct t_search_node **children;   //!< child nodes for SEARCH_NODE_AND, SEARCH_NODE_OR and SEARCH_NODE_NOT
+    unsigned children_len;             //!< number of child nodes
+};
+
+/**
+ * Parser state
+ */
+struct t_search_parser {
+    const char *p;    //!< current position
+    const char *end;  //!< end of the expression
+};
+
+static struct t_search_node *parse_sequence(struct t_search_parser *parser);
+static struct t_search_node *parse_operand(struct t_search_parser *parser);
+static struct t_search_node *parse_match(struct t_search_parser *parser);
+static bool parse_keyword(struct t_search_parser *parser, const char *keyword);
+static void parse_skip_spaces(struct t_search_parser *parser);
+static struct t_search_node *search_node_new(enum search_node_types type);
+static void search_node_add_child(struct t_search_node *node, struct t_search_node *child);
+static void *search_node_free(struct t_search_node *node);
+static bool search_node_eval(struct t_search_filter *filter, const struct t_search_node *node,
+        const void *entity, tag_value_getter getter, const struct t_tags *tag_types);
+static bool search_match_eval(struct t_search_filter *filter, const struct t_search_match *match,
+        const void *entity, tag_value_getter getter, const struct t_tags *tag_types);
+static sds casefold_value(sds buffer, const char *value);
+static bool cmp_equal(const struct t_search_match *match, const char *value, size_t value_len);
+static bool cmp_starts_with(const struct t_search_match *match, const char *value, size_t value_len);
+static bool cmp_contains(const struct t_search_match *match, const char *value, size_t value_len);
+static bool cmp_regex(const struct t_search_match *match, const char *value, size_t value_len);
 static pcre2_code *compile_regex(char *regex_str);
-static bool cmp_regex(pcre2_code *re_compiled, const char *value);
 
 /**
  * Public functions
@@ -89,266 +146,588 @@ bool search_mpd_song(const struct mpd_song *song, sds searchstr, const struct t_
 }
 
 /**
- * Parses a mpd search expression
+ * Compiles a search expression.
+ * Supported is the mpd filter syntax with the additional OR operator.
+ * AND binds stronger than OR.
  * @param expression mpd search expression
- * @return list of the expression
- */
-struct t_list *parse_search_expression_to_list(sds expression) {
-    struct t_list *expr_list = list_new();
-    int count = 0;
-    sds *tokens = sdssplitlen(expression, (ssize_t)sdslen(expression), ") AND (", 7, &count);
-    sds tag = sdsempty();
-    sds op = sdsempty();
-    for (int j = 0; j < count; j++) {
-        sdstrim(tokens[j], "() ");
-        sdsclear(tag);
-        sdsclear(op);
-        struct t_search_expression *expr = malloc_assert(sizeof(struct t_search_expression));
-        expr->value = sdsempty();
-        expr->re_compiled = NULL;
-        char *p = tokens[j];
-        char *end = p + sdslen(tokens[j]) - 1; //ignore concluding apostrophe
-        //tag
-        while (p < end) {
-            if (*p == ' ') {
-                break;
-            }
-            tag = sds_catchar(tag, *p);
-            p++;
+ * @return the compiled search expression, an empty expression matches all,
+ *         an invalid expression matches nothing
+ */
+struct t_search_filter *search_filter_new(const char *expression) {
+    struct t_search_filter *filter = malloc_assert(sizeof(struct t_search_filter));
+    filter->expression = sdsnew(expression);
+    filter->scratch = sdsempty();
+    filter->root = NULL;
+    struct t_search_parser parser = {
+        .p = expression,
+        .end = expression + strlen(expression)
+    };
+    parse_skip_spaces(&parser);
+    if (parser.p == parser.end) {
+        return filter;
+    }
+    filter->root = parse_sequence(&parser);
+    parse_skip_spaces(&parser);
+    if (filter->root == NULL ||
+        parser.p != parser.end)
+    {
+        MYMPD_LOG_ERROR(NULL, "Can not parse search expression: \"%s\"", expression);
+        search_node_free(filter->root);
+        //an empty OR node matches nothing
+        filter->root = search_node_new(SEARCH_NODE_OR);
+    }
+    return filter;
+}
+
+/**
+ * Frees the compiled search expression
+ * @param filter pointer to the compiled search expression
+ * @return NULL
+ */
+void *search_filter_free(struct t_search_filter *filter) {
+    if (filter == NULL) {
+        return NULL;
+    }
+    search_node_free(filter->root);
+    FREE_SDS(filter->expression);
+    FREE_SDS(filter->scratch);
+    FREE_PTR(filter);
+    return NULL;
+}
+
+/**
+ * Creates a new cache for compiled search expressions
+ * @return pointer to the allocated cache
+ */
+struct t_search_filter_cache *search_filter_cache_new(void) {
+    struct t_search_filter_cache *cache = malloc_assert(sizeof(struct t_search_filter_cache));
+    for (unsigned i = 0; i < SEARCH_FILTER_CACHE_SIZE; i++) {
+        cache->filters[i] = NULL;
+    }
+    cache->next = 0;
+    return cache;
+}
+
+/**
+ * Frees the cache and all compiled search expressions
+ * @param cache pointer to the cache
+ * @return NULL
+ */
+void *search_filter_cache_free(struct t_search_filter_cache *cache) {
+    if (cache == NULL) {
+        return NULL;
+    }
+    for (unsigned i = 0; i < SEARCH_FILTER_CACHE_SIZE; i++) {
+        search_filter_free(cache->filters[i]);
+    }
+    FREE_PTR(cache);
+    return NULL;
+}
+
+/**
+ * Gets the compiled search expression from the cache or compiles and caches it.
+ * The oldest entry is replaced if the cache is full.
+ * The returned filter is owned by the cache, it is valid until the
+ * next SEARCH_FILTER_CACHE_SIZE - 1 calls of this function.
+ * @param cache pointer to the cache
+ * @param expression mpd search expression
+ * @return the compiled search expression
+ */
+struct t_search_filter *search_filter_cache_get(struct t_search_filter_cache *cache, const char *expression) {
+    for (unsigned i = 0; i < SEARCH_FILTER_CACHE_SIZE; i++) {
+        if (cache->filters[i] != NULL &&
+            strcmp(cache->filters[i]->expression, expression) == 0)
+        {
+            return cache->filters[i];
         }
-        if (p + 1 >= end) {
-            MYMPD_LOG_ERROR(NULL, "Can not parse search expression");
-            free_search_expression(expr);
+    }
+    search_filter_free(cache->filters[cache->next]);
+    struct t_search_filter *filter = search_filter_new(expression);
+    cache->filters[cache->next] = filter;
+    cache->next = (cache->next + 1) % SEARCH_FILTER_CACHE_SIZE;
+    return filter;
+}
+
+/**
+ * Matches a song against the compiled search expression
+ * @param song pointer to mpd song struct
+ * @param filter the compiled search expression
+ * @param tag_types tags for special "any" tag in expression
+ * @return expression result
+ */
+bool search_song_expression(const struct mpd_song *song, struct t_search_filter *filter, const struct t_tags *tag_types) {
+    if (filter->root == NULL) {
+        return true;
+    }
+    return search_node_eval(filter, filter->root, song, mpd_client_song_tag_getter, tag_types);
+}
+
+/**
+ * Matches an album against the compiled search expression
+ * @param album pointer to t_album struct
+ * @param filter the compiled search expression
+ * @param tag_types tags for special "any" tag in expression
+ * @return expression result
+ */
+bool search_album_expression(const struct t_album *album, struct t_search_filter *filter, const struct t_tags *tag_types) {
+    if (filter->root == NULL) {
+        return true;
+    }
+    return search_node_eval(filter, filter->root, album, mpd_client_album_tag_getter, tag_types);
+}
+
+/**
+ * Private functions
+ */
+
+/**
+ * Parses a sequence of operands joined by AND or OR
+ * @param parser pointer to the parser state
+ * @return the parsed node or NULL on error
+ */
+static struct t_search_node *parse_sequence(struct t_search_parser *parser) {
+    struct t_search_node *operand = parse_operand(parser);
+    if (operand == NULL) {
+        return NULL;
+    }
+    struct t_search_node *or_node = NULL;
+    struct t_search_node *and_node = NULL;
+    struct t_search_node *current = operand;
+    while (true) {
+        parse_skip_spaces(parser);
+        bool is_and = parse_keyword(parser, "AND");
+        bool is_or = is_and == false && parse_keyword(parser, "OR");
+        if (is_and == false &&
+            is_or == false)
+        {
             break;
         }
-        expr->tag = mpd_tag_name_parse(tag);
-        if (expr->tag == -1 &&
-            strcmp(tag, "any") == 0)
-        {
-            expr->tag = -2;
+        operand = parse_operand(parser);
+        if (operand == NULL) {
+            search_node_free(current);
+            search_node_free(and_node);
+            search_node_free(or_node);
+            return NULL;
         }
-        //skip space
-        p++;
-        //operator
-        while (p < end) {
-            if (*p == ' ') {
-                break;
+        if (is_and == true) {
+            if (and_node == NULL) {
+                and_node = search_node_new(SEARCH_NODE_AND);
+                search_node_add_child(and_node, current);
             }
-            op = sds_catchar(op, *p);
-            p++;
+            search_node_add_child(and_node, operand);
+            current = NULL;
         }
-        if (p + 2 >= end) {
-            MYMPD_LOG_ERROR(NULL, "Can not parse search expression");
-            free_search_expression(expr);
-            break;
-        }
-        if (strcmp(op, "contains") == 0) { expr->op = SEARCH_OP_CONTAINS; }
-        else if (strcmp(op, "starts_with") == 0) { expr->op = SEARCH_OP_STARTS_WITH; }
-        else if (strcmp(op, "==") == 0) { expr->op = SEARCH_OP_EQUAL; }
-        else if (strcmp(op, "!=") == 0) { expr->op = SEARCH_OP_NOT_EQUAL; }
-        else if (strcmp(op, "=~") == 0) { expr->op = SEARCH_OP_REGEX; }
-        else if (strcmp(op, "!~") == 0) { expr->op = SEARCH_OP_NOT_REGEX; }
         else {
-            MYMPD_LOG_ERROR(NULL, "Unknown search operator: \"%s\"", op);
-            free_search_expression(expr);
-            break;
-        }
-        //skip space and apostrophe
-        p = p + 2;
-        //value
-        while (p < end) {
-            if (*p == '\\') {
-                if (p + 1 >= end) {
-                    //escape char should not be the last
-                    break;
-                }
-                //skip escaping backslash
-                p++;
+            if (or_node == NULL) {
+                or_node = search_node_new(SEARCH_NODE_OR);
             }
-            expr->value = sds_catchar(expr->value, *p);
-            p++;
+            search_node_add_child(or_node, and_node != NULL ? and_node : current);
+            and_node = NULL;
+            current = operand;
+        }
+    }
+    struct t_search_node *last = and_node != NULL ? and_node : current;
+    if (or_node == NULL) {
+        return last;
+    }
+    search_node_add_child(or_node, last);
+    return or_node;
+}
+
+/**
+ * Parses an operand: a parenthesized expression, a negated expression or a triple
+ * @param parser pointer to the parser state
+ * @return the parsed node or NULL on error
+ */
+static struct t_search_node *parse_operand(struct t_search_parser *parser) {
+    parse_skip_spaces(parser);
+    if (parser->p == parser->end) {
+        return NULL;
+    }
+    if (*parser->p != '(') {
+        return parse_match(parser);
+    }
+    parser->p++;
+    parse_skip_spaces(parser);
+    struct t_search_node *node;
+    if (parser->p < parser->end &&
+        *parser->p == '!')
+    {
+        parser->p++;
+        struct t_search_node *child = parse_operand(parser);
+        if (child == NULL) {
+            return NULL;
+        }
+        node = search_node_new(SEARCH_NODE_NOT);
+        search_node_add_child(node, child);
+    }
+    else {
+        node = parse_sequence(parser);
+        if (node == NULL) {
+            return NULL;
         }
-        //push to list
-        if (expr->op == SEARCH_OP_REGEX ||
-            expr->op == SEARCH_OP_NOT_REGEX)
+    }
+    parse_skip_spaces(parser);
+    if (parser->p == parser->end ||
+        *parser->p != ')')
+    {
+        search_node_free(node);
+        return NULL;
+    }
+    parser->p++;
+    return node;
+}
+
+/**
+ * Parses a triple of tag, operator and quoted value
+ * @param parser pointer to the parser state
+ * @return the parsed node or NULL on error
+ */
+static struct t_search_node *parse_match(struct t_search_parser *parser) {
+    const char *tag = parser->p;
+    while (parser->p < parser->end && *parser->p != ' ') {
+        parser->p++;
+    }
+    size_t tag_len = (size_t)(parser->p - tag);
+    parse_skip_spaces(parser);
+    const char *op = parser->p;
+    while (parser->p < parser->end && *parser->p != ' ') {
+        parser->p++;
+    }
+    size_t op_len = (size_t)(parser->p - op);
+    parse_skip_spaces(parser);
+    if (tag_len == 0 ||
+        op_len == 0 ||
+        parser->p == parser->end ||
+        (*parser->p != '\'' && *parser->p != '"'))
+    {
+        return NULL;
+    }
+    struct t_search_node *node = search_node_new(SEARCH_NODE_MATCH);
+    struct t_search_match *match = &node->match;
+    sds tag_name = sdsnewlen(tag, tag_len);
+    match->tag = mpd_tag_name_parse(tag_name);
+    if (match->tag == MPD_TAG_UNKNOWN &&
+        strcmp(tag_name, "any") == 0)
+    {
+        match->tag = -2;
+    }
+    FREE_SDS(tag_name);
+    if (op_len == 8 && strncmp(op, "contains", 8) == 0) {
+        match->op = SEARCH_OP_CONTAINS;
+        match->cmp = cmp_contains;
+    }
+    else if (op_len == 11 && strncmp(op, "starts_with", 11) == 0) {
+        match->op = SEARCH_OP_STARTS_WITH;
+        match->cmp = cmp_starts_with;
+    }
+    else if (op_len == 2 && strncmp(op, "==", 2) == 0) {
+        match->op = SEARCH_OP_EQUAL;
+        match->cmp = cmp_equal;
+    }
+    else if (op_len == 2 && strncmp(op, "!=", 2) == 0) {
+        match->op = SEARCH_OP_NOT_EQUAL;
+        match->cmp = cmp_equal;
+        match->negated = true;
+    }
+    else if (op_len == 2 && strncmp(op, "=~", 2) == 0) {
+        match->op = SEARCH_OP_REGEX;
+        match->cmp = cmp_regex;
+    }
+    else if (op_len == 2 && strncmp(op, "!~", 2) == 0) {
+        match->op = SEARCH_OP_NOT_REGEX;
+        match->cmp = cmp_regex;
+        match->negated = true;
+    }
+    else {
+        MYMPD_LOG_ERROR(NULL, "Unknown search operator: \"%.*s\"", (int)op_len, op);
+        search_node_free(node);
+        return NULL;
+    }
+    //value
+    const char quote = *parser->p;
+    parser->p++;
+    while (parser->p < parser->end && *parser->p != quote) {
+        if (*parser->p == '\\' &&
+            parser->p + 1 < parser->end)
         {
-            //is regex, compile
-            expr->re_compiled = compile_regex(expr->value);
+            //skip escaping backslash
+            parser->p++;
+        }
+        match->value = sds_catchar(match->value, *parser->p);
+        parser->p++;
+    }
+    if (parser->p == parser->end) {
+        //missing closing quote
+        search_node_free(node);
+        return NULL;
+    }
+    parser->p++;
+    if (match->cmp == cmp_regex) {
+        match->re_compiled = compile_regex(match->value);
+        if (match->re_compiled != NULL) {
+            match->match_data = pcre2_match_data_create_from_pattern(match->re_compiled, NULL);
         }
-        list_push(expr_list, "", 0, NULL, expr);
-        MYMPD_LOG_DEBUG(NULL, "Parsed expression tag: \"%s\", op: \"%s\", value:\"%s\"", tag, op, expr->value);
     }
-    FREE_SDS(tag);
-    FREE_SDS(op);
-    sdsfreesplitres(tokens, count);
-    return expr_list;
+    else {
+        utf8lwr(match->value);
+    }
+    MYMPD_LOG_DEBUG(NULL, "Parsed expression tag: \"%.*s\", op: \"%.*s\", value:\"%s\"",
+        (int)tag_len, tag, (int)op_len, op, match->value);
+    return node;
 }
 
 /**
- * Frees the search expression list
- * @param expr_list pointer to the list
+ * Consumes a keyword followed by a space or an opening parenthesis
+ * @param parser pointer to the parser state
+ * @param keyword keyword to consume
+ * @return true if the keyword was consumed, else false
  */
-void *free_search_expression_list(struct t_list *expr_list) {
-    if (expr_list == NULL) {
+static bool parse_keyword(struct t_search_parser *parser, const char *keyword) {
+    size_t len = strlen(keyword);
+    if ((size_t)(parser->end - parser->p) <= len ||
+        strncmp(parser->p, keyword, len) != 0 ||
+        (parser->p[len] != ' ' && parser->p[len] != '('))
+    {
+        return false;
+    }
+    parser->p += len;
+    return true;
+}
+
+/**
+ * Skips spaces
+ * @param parser pointer to the parser state
+ */
+static void parse_skip_spaces(struct t_search_parser *parser) {
+    while (parser->p < parser->end && *parser->p == ' ') {
+        parser->p++;
+    }
+}
+
+/**
+ * Creates a new search expression node
+ * @param type node type
+ * @return the allocated node
+ */
+static struct t_search_node *search_node_new(enum search_node_types type) {
+    struct t_search_node *node = malloc_assert(sizeof(struct t_search_node));
+    node->type = type;
+    node->match.tag = MPD_TAG_UNKNOWN;
+    node->match.op = SEARCH_OP_EQUAL;
+    node->match.negated = false;
+    node->match.cmp = NULL;
+    node->match.value = sdsempty();
+    node->match.re_compiled = NULL;
+    node->match.match_data = NULL;
+    node->children = NULL;
+    node->children_len = 0;
+    return node;
+}
+
+/**
+ * Appends a child node
+ * @param node parent node
+ * @param child node to append
+ */
+static void search_node_add_child(struct t_search_node *node, struct t_search_node *child) {
+    node->children = realloc_assert(node->children, (node->children_len + 1) * sizeof(struct t_search_node *));
+    node->children[node->children_len] = child;
+    node->children_len++;
+}
+
+/**
+ * Frees a search expression node and its children
+ * @param node node to free
+ * @return NULL
+ */
+static void *search_node_free(struct t_search_node *node) {
+    if (node == NULL) {
         return NULL;
     }
-    return list_free_user_data(expr_list, free_search_expression_node);
+    for (unsigned i = 0; i < node->children_len; i++) {
+        search_node_free(node->children[i]);
+    }
+    FREE_PTR(node->children);
+    FREE_SDS(node->match.value);
+    if (node->match.match_data != NULL) {
+        pcre2_match_data_free(node->match.match_data);
+    }
+    if (node->match.re_compiled != NULL) {
+        pcre2_code_free(node->match.re_compiled);
+    }
+    FREE_PTR(node);
+    return NULL;
 }
 
 /**
- * Searches for a string in mpd tag values
- * @param song pointer to mpd song struct
- * @param expr_list expression list returned by parse_search_expression
+ * Evaluates a node of the compiled search expression
+ * @param filter the compiled search expression
+ * @param node node to evaluate
+ * @param entity pointer to a mpd song or album
+ * @param getter callback to get the tag values from the entity
  * @param tag_types tags for special "any" tag in expression
  * @return expression result
  */
-bool search_song_expression(const struct mpd_song *song, const struct t_list *expr_list, const struct t_tags *tag_types) {
-    struct t_tags one_tag;
-    one_tag.tags_len = 1;
-    struct t_list_node *current = expr_list->head;
-    while (current != NULL) {
-        struct t_search_expression *expr = (struct t_search_expression *)current->user_data;
-        one_tag.tags[0] = (enum mpd_tag_type)expr->tag;
-        const struct t_tags *tags = expr->tag == -2
-            ? tag_types  //any - use all browse tags
-            : &one_tag;  //use only selected tag
-
-        bool rc = false;
-        for (size_t i = 0; i < tags->tags_len; i++) {
-            rc = true;
-            unsigned j = 0;
-            const char *value = NULL;
-            while ((value = mpd_song_get_tag(song, tags->tags[i], j)) != NULL) {
-                j++;
-                if ((expr->op == SEARCH_OP_CONTAINS && utf8casestr(value, expr->value) == NULL) ||
-                    (expr->op == SEARCH_OP_STARTS_WITH && utf8ncasecmp(expr->value, value, sdslen(expr->value)) != 0) ||
-                    (expr->op == SEARCH_OP_EQUAL && utf8casecmp(value, expr->value) != 0) ||
-                    (expr->op == SEARCH_OP_REGEX && cmp_regex(expr->re_compiled, value) == false))
-                {
-                    //expression does not match
-                    rc = false;
-                }
-                else if ((expr->op == SEARCH_OP_NOT_EQUAL && utf8casecmp(value, expr->value) == 0) ||
-                         (expr->op == SEARCH_OP_NOT_REGEX && cmp_regex(expr->re_compiled, value) == true))
-                {
-                    //negated match operator - exit instantly
-                    rc = false;
-                    break;
-                }
-                else {
-                    //tag value matched
-                    rc = true;
-                    if (expr->op != SEARCH_OP_NOT_EQUAL &&
-                        expr->op != SEARCH_OP_NOT_REGEX)
-                    {
-                        //exit only for positive match operators
-                        break;
-                    }
+static bool search_node_eval(struct t_search_filter *filter, const struct t_search_node *node,
+        const void *entity, tag_value_getter getter, const struct t_tags *tag_types)
+{
+    switch(node->type) {
+        case SEARCH_NODE_MATCH:
+            return search_match_eval(filter, &node->match, entity, getter, tag_types);
+        case SEARCH_NODE_AND:
+            for (unsigned i = 0; i < node->children_len; i++) {
+                if (search_node_eval(filter, node->children[i], entity, getter, tag_types) == false) {
+                    return false;
                 }
             }
-            if (j == 0) {
-                //no tag value found
-                rc = expr->op == SEARCH_OP_NOT_EQUAL || expr->op == SEARCH_OP_NOT_REGEX
-                    ? true
-                    : false;
+            return true;
+        case SEARCH_NODE_OR:
+            for (unsigned i = 0; i < node->children_len; i++) {
+                if (search_node_eval(filter, node->children[i], entity, getter, tag_types) == true) {
+                    return true;
+                }
             }
-            if (rc == true) {
-                //exit on first tag value match
+            return false;
+        case SEARCH_NODE_NOT:
+            return !search_node_eval(filter, node->children[0], entity, getter, tag_types);
+    }
+    return false;
+}
+
+/**
+ * Evaluates a search expression triple.
+ * Positive operators match if any value matches,
+ * negated operators match if no value matches.
+ * @param filter the compiled search expression
+ * @param match the search expression triple
+ * @param entity pointer to a mpd song or album
+ * @param getter callback to get the tag values from the entity
+ * @param tag_types tags for special "any" tag in expression
+ * @return expression result
+ */
+static bool search_match_eval(struct t_search_filter *filter, const struct t_search_match *match,
+        const void *entity, tag_value_getter getter, const struct t_tags *tag_types)
+{
+    struct t_tags one_tag;
+    one_tag.tags_len = 1;
+    one_tag.tags[0] = (enum mpd_tag_type)match->tag;
+    const struct t_tags *tags = match->tag == -2
+        ? tag_types  //any - use all browse tags
+        : &one_tag;  //use only selected tag
+
+    for (size_t i = 0; i < tags->tags_len; i++) {
+        bool found = false;
+        unsigned j = 0;
+        const char *value;
+        while ((value = getter(entity, tags->tags[i], j)) != NULL) {
+            j++;
+            filter->scratch = casefold_value(filter->scratch, value);
+            if (match->cmp(match, filter->scratch, sdslen(filter->scratch)) == true) {
+                found = true;
                 break;
             }
         }
-        if (rc == false) {
-            //exit on first expression mismatch
-            return false;
+        if (found != match->negated) {
+            //exit on first tag match
+            return true;
         }
-        current = current->next;
     }
-    //complete expression has matched
-    return true;
+    return false;
 }
 
 /**
- * Private functions
+ * Copies the lower cased value to the buffer.
+ * ASCII strings are lower cased while copying, other strings are
+ * lower cased codepoint by codepoint.
+ * @param buffer already allocated sds string to replace
+ * @param value value to lower case
+ * @return pointer to buffer
  */
+static sds casefold_value(sds buffer, const char *value) {
+    size_t len = strlen(value);
+    sdsclear(buffer);
+    buffer = sdsMakeRoomFor(buffer, len);
+    bool ascii = true;
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)value[i];
+        if (c >= 0x80) {
+            ascii = false;
+        }
+        buffer[i] = (c >= 'A' && c <= 'Z')
+            ? (char)(c + 32)
+            : (char)c;
+    }
+    buffer[len] = '\0';
+    sdssetlen(buffer, len);
+    if (ascii == false) {
+        utf8lwr(buffer);
+    }
+    return buffer;
+}
 
 /**
- * Frees the t_search_expression struct
- * @param expr pointer to t_search_expression struct
+ * Compare function for the == and != operators
+ * @param match the compiled search expression triple
+ * @param value the lower cased tag value
+ * @param value_len length of the tag value
+ * @return true if the value matches, else false
  */
-void *free_search_expression(struct t_search_expression *expr) {
-    FREE_SDS(expr->value);
-    FREE_PTR(expr->re_compiled);
-    FREE_PTR(expr);
-    return NULL;
+static bool cmp_equal(const struct t_search_match *match, const char *value, size_t value_len) {
+    return value_len == sdslen(match->value) &&
+        memcmp(value, match->value, value_len) == 0;
 }
 
 /**
- * Callback function for freeing a list node with t_search_expression user_data
- * @param current pointer to list node
+ * Compare function for the starts_with operator
+ * @param match the compiled search expression triple
+ * @param value the lower cased tag value
+ * @param value_len length of the tag value
+ * @return true if the value matches, else false
  */
-static void free_search_expression_node(struct t_list_node *current) {
-    struct t_search_expression *expr = (struct t_search_expression *)current->user_data;
-    free_search_expression(expr);
+static bool cmp_starts_with(const struct t_search_match *match, const char *value, size_t value_len) {
+    return value_len >= sdslen(match->value) &&
+        memcmp(value, match->value, sdslen(match->value)) == 0;
 }
 
 /**
- * Compiles a string to regex code
- * @param regex_str regex string
- * @return regex code
+ * Compare function for the contains operator
+ * @param match the compiled search expression triple
+ * @param value the lower cased tag value
+ * @param value_len length of the tag value
+ * @return true if the value matches, else false
  */
-static pcre2_code *compile_regex(char *regex_str) {
-    MYMPD_LOG_DEBUG(NULL, "Compiling regex: \"%s\"", regex_str);
-    utf8lwr(regex_str);
-    PCRE2_SIZE erroroffset;
-    int rc;
-    pcre2_code *re_compiled = pcre2_compile(
-        (PCRE2_SPTR)regex_str, /* the pattern */
-        PCRE2_ZERO_TERMINATED, /* indicates pattern is zero-terminated */
-        0,                     /* default options */
-        &rc,		           /* for error number */
-        &erroroffset,          /* for error offset */
-        NULL                   /* use default compile context */
-    );
-    if (re_compiled == NULL){
-        //Compilation failed
-        PCRE2_UCHAR buffer[256];
-        pcre2_get_error_message(rc, buffer, sizeof(buffer));
-        MYMPD_LOG_ERROR(NULL, "PCRE2 compilation failed at offset %d: \"%s\"", (int)erroroffset, buffer);
-        return NULL;
-    }
-    return re_compiled;
+static bool cmp_contains(const struct t_search_match *match, const char *value, size_t value_len) {
+    (void)value_len;
+    return strstr(value, match->value) != NULL;
 }
 
 /**
- * Matches the regex against a string
- * @param re_compiled the compiled regex from compile_regex
- * @param value string to match against
- * @return true if regex matches else false
+ * Compare function for the =~ and !~ operators
+ * @param match the compiled search expression triple
+ * @param value the lower cased tag value
+ * @param value_len length of the tag value
+ * @return true if regex matches, else false
  */
-static bool cmp_regex(pcre2_code *re_compiled, const char *value) {
-    if (re_compiled == NULL) {
+static bool cmp_regex(const struct t_search_match *match, const char *value, size_t value_len) {
+    if (match->re_compiled == NULL) {
         return false;
     }
-    char *lower = strdup(value);
-    utf8lwr(lower);
-    pcre2_match_data *match_data = pcre2_match_data_create_from_pattern(re_compiled, NULL);
     int rc = pcre2_match(
-        re_compiled,          /* the compiled pattern */
-        (PCRE2_SPTR)lower,    /* the subject string */
-        strlen(value),        /* the length of the subject */
+        match->re_compiled,   /* the compiled pattern */
+        (PCRE2_SPTR)value,    /* the subject string */
+        value_len,            /* the length of the subject */
         0,                    /* start at offset 0 in the subject */
         0,                    /* default options */
-        match_data,           /* block for storing the result */
+        match->match_data,    /* block for storing the result */
         NULL                  /* use default match context */
     );
-    pcre2_match_data_free(match_data);
-    FREE_PTR(lower);
     if (rc >= 0) {
         return true;
     }
     //Matching failed: handle error cases
     switch(rc) {
-        case PCRE2_ERROR_NOMATCH: 
+        case PCRE2_ERROR_NOMATCH:
             break;
         default: {
             PCRE2_UCHAR buffer[256];
@@ -358,3 +737,31 @@ static bool cmp_regex(pcre2_code *re_compiled, const char *value) {
     }
     return false;
 }
+
+/**
+ * Compiles a string to regex code
+ * @param regex_str regex string
+ * @return regex code
+ */
+static pcre2_code *compile_regex(char *regex_str) {
+    MYMPD_LOG_DEBUG(NULL, "Compiling regex: \"%s\"", regex_str);
+    utf8lwr(regex_str);
+    PCRE2_SIZE erroroffset;
+    int rc;
+    pcre2_code *re_compiled = pcre2_compile(
+        (PCRE2_SPTR)regex_str, /* the pattern */
+        PCRE2_ZERO_TERMINATED, /* indicates pattern is zero-terminated */
+        0,                     /* default options */
+        &rc,		           /* for error number */
+        &erroroffset,          /* for error offset */
+        NULL                   /* use default compile context */
+    );
+    if (re_compiled == NULL){
+        //Compilation failed
+        PCRE2_UCHAR buffer[256];
+        pcre2_get_error_message(rc, buffer, sizeof(buffer));
+        MYMPD_LOG_ERROR(NULL, "PCRE2 compilation failed at offset %d: \"%s\"", (int)erroroffset, buffer);
+        return NULL;
+    }
+    return re_compiled;
+}
@@ -7,10 +7,39 @@
 #ifndef MYMPD_MPD_CLIENT_SEARCH_LOCAL_H
 #define MYMPD_MPD_CLIENT_SEARCH_LOCAL_H
 
+#include "src/lib/album_cache.h"
 #include "src/lib/mympd_state.h"
 
+/**
+ * Number of compiled search expressions in the cache
+ */
+#define SEARCH_FILTER_CACHE_SIZE 16
+
+struct t_search_node;
+
+/**
+ * Compiled search expression
+ */
+struct t_search_filter {
+    sds expression;              //!< the source expression
+    struct t_search_node *root;  //!< root node of the compiled expression, NULL matches all
+    sds scratch;                 //!< buffer for the lower cased tag values
+};
+
+/**
+ * Cache of compiled search expressions, the oldest entry is replaced
+ */
+struct t_search_filter_cache {
+    struct t_search_filter *filters[SEARCH_FILTER_CACHE_SIZE];  //!< compiled search expressions
+    unsigned next;                                              //!< next entry to replace
+};
+
 bool search_mpd_song(const struct mpd_song *song, sds searchstr, const struct t_tags *tags);
-struct t_list *parse_search_expression_to_list(sds expression);
-void *free_search_expression_list(struct t_list *expr_list);
-bool search_song_expression(const struct mpd_song *song, const struct t_list *expr_list, const struct t_tags *browse_tag_types);
+struct t_search_filter *search_filter_new(const char *expression);
+void *search_filter_free(struct t_search_filter *filter);
+struct t_search_filter_cache *search_filter_cache_new(void);
+void *search_filter_cache_free(struct t_search_filter_cache *cache);
+struct t_search_filter *search_filter_cache_get(struct t_search_filter_cache *cache, const char *expression);
+bool search_song_expression(const struct mpd_song *song, struct t_search_filter *filter, const struct t_tags *browse_tag_types);
+bool search_album_expression(const struct t_album *album, struct t_search_filter *filter, const struct t_tags *browse_tag_types);
 #endif
@@ -12,10 +12,15 @@
 #include "src/lib/log.h"
 #include "src/lib/mympd_state.h"
 #include "src/lib/sds_extras.h"
+#include "src/lib/msg_queue.h"
 #include "src/lib/sticker.h"
+#include "src/lib/sticker_cache.h"
 #include "src/lib/utility.h"
 #include "src/mpd_client/connection.h"
 #include "src/mpd_client/errorhandler.h"
+#include "src/mpd_client/jukebox_pool.h"
+#include "src/mympd_api/timer.h"
+#include "src/mympd_api/timer_handlers.h"
 #include "src/mympd_api/trigger.h"
 
 #include <inttypes.h>
@@ -32,6 +37,10 @@ static long long get_sticker_llong(struct t_partition_state *partition_state, co
 static bool set_sticker_value(struct t_partition_state *partition_state, const char *uri, const char *name, const char *value);
 static bool set_sticker_llong(struct t_partition_state *partition_state, const char *uri, const char *name, long long value);
 static bool inc_sticker(struct t_partition_state *partition_state, const char *uri, const char *name);
+static struct t_sticker_cache *get_sticker_cache(struct t_partition_state *partition_state);
+static bool sticker_cache_available(struct t_partition_state *partition_state);
+static void sticker_cache_own_write(struct t_partition_state *partition_state, const char *uri, const char *name, const char *value);
+static void handle_idle_events(struct t_partition_state *partition_state, enum mpd_idle idle_bitmask);
 
 // Public functions
 
@@ -97,13 +106,17 @@ bool stickerdb_connect(struct t_partition_state *partition_state) {
             return false;
         }
         MYMPD_LOG_DEBUG("stickerdb", "MPD connected and waiting for commands");
+        if (get_sticker_cache(partition_state) != NULL) {
+            // sticker changes could have been missed while disconnected
+            stickerdb_cache_update(partition_state->mympd_state);
+        }
         return true;
     }
     return false;
 }
 
 /**
- * Discards waiting idle events for the stickerdb connection
+ * Handles waiting idle events for the stickerdb connection
  * @param partition_state pointer to the partition state
  */
 bool stickerdb_idle(struct t_partition_state *partition_state) {
@@ -116,19 +129,25 @@ bool stickerdb_idle(struct t_partition_state *partition_state) {
     struct pollfd fd[1];
     fd->fd = mpd_connection_get_fd(partition_state->conn);
     fd->events = POLLIN;
-    int pollrc = poll(fd, 1, 50);
+    //the mympd_api thread waits in mpd_client_idle for stickerdb events
+    int pollrc = poll(fd, 1, 0);
     if (pollrc < 0) {
         MYMPD_LOG_ERROR(NULL, "Error polling mpd connection");
         partition_state->conn_state = MPD_FAILURE;
         return false;
     }
     if (fd[0].revents & POLLIN) {
-        // exit and reenter the idle mode to discard waiting events
+        // read the idle events and reenter the idle mode
         // this prevents the connection to timeout
-        MYMPD_LOG_DEBUG("stickerdb", "Discarding idle events");
+        MYMPD_LOG_DEBUG("stickerdb", "Reading idle events");
+        enum mpd_idle idle_bitmask = mpd_recv_idle(partition_state->conn, false);
+        mpd_response_finish(partition_state->conn);
+        if (mympd_check_error_and_recover(partition_state, NULL, "mpd_recv_idle") == false) {
+            return false;
+        }
         mympd_api_trigger_execute(&partition_state->mympd_state->trigger_list, TRIGGER_MPD_STICKER, partition_state->name);
-        return stickerdb_exit_idle(partition_state) &&
-            stickerdb_enter_idle(partition_state);
+        handle_idle_events(partition_state, idle_bitmask);
+        return stickerdb_enter_idle(partition_state);
     }
     return true;
 }
@@ -150,17 +169,79 @@ bool stickerdb_enter_idle(struct t_partition_state *partition_state) {
 }
 
 /**
- * Exits the idle mode, ignoring all idle events
+ * Exits the idle mode, idle events are only evaluated for the sticker cache
  * @param partition_state pointer to the partition state
  * @return true on success, else false
  */
 bool stickerdb_exit_idle(struct t_partition_state *partition_state) {
     MYMPD_LOG_DEBUG("stickerdb", "Exiting idle mode");
+    enum mpd_idle idle_bitmask = 0;
     if (mpd_send_noidle(partition_state->conn) == false) {
         MYMPD_LOG_ERROR("stickerdb", "Error exiting idle mode");
     }
+    else {
+        idle_bitmask = mpd_recv_idle(partition_state->conn, false);
+    }
     mpd_response_finish(partition_state->conn);
-    return mympd_check_error_and_recover(partition_state, NULL, "mpd_run_noidle");
+    if (mympd_check_error_and_recover(partition_state, NULL, "mpd_run_noidle") == false) {
+        return false;
+    }
+    handle_idle_events(partition_state, idle_bitmask);
+    return true;
+}
+
+/**
+ * Prepares the stickerdb connection for stickerdb_*_batch calls.
+ * The idle mode is only left, if the stickers can not be served from the sticker cache.
+ * @param partition_state pointer to the partition state
+ * @return true on success, else false
+ */
+bool stickerdb_batch_start(struct t_partition_state *partition_state) {
+    if (sticker_cache_available(partition_state) == true) {
+        return true;
+    }
+    return stickerdb_exit_idle(partition_state);
+}
+
+/**
+ * Reenters the idle mode after stickerdb_*_batch calls, if it was left by stickerdb_batch_start
+ * @param partition_state pointer to the partition state
+ * @return true on success, else false
+ */
+bool stickerdb_batch_end(struct t_partition_state *partition_state) {
+    if (sticker_cache_available(partition_state) == true) {
+        return true;
+    }
+    return stickerdb_enter_idle(partition_state);
+}
+
+/**
+ * Schedules the recreation of the sticker cache.
+ * The timer debounces sticker idle events. If a cache update is already running,
+ * the sticker cache is recreated after it has finished.
+ * @param mympd_state pointer to the central mympd_state struct
+ * @return true on success, else false
+ */
+bool stickerdb_cache_update(struct t_mympd_state *mympd_state) {
+    if (mympd_state->config->stickers == false) {
+        return true;
+    }
+    if (mympd_state->sticker_cache.building == true ||
+        mympd_state->mpd_state->album_cache.building == true)
+    {
+        mympd_state->sticker_cache.outdated = true;
+        return true;
+    }
+    mympd_state->sticker_cache.outdated = false;
+    #ifdef MYMPD_NO_TIMERFD
+        // Workaround for plattforms without timerfd support
+        struct t_work_request *request = create_request(-1, 0, MYMPD_API_CACHES_CREATE, NULL, MPD_PARTITION_DEFAULT);
+        request->data = sdscat(request->data, "\"force\":false}}"); //only update the album cache if database has changed
+        return mympd_queue_push(mympd_api_queue, request, 0);
+    #endif
+    MYMPD_LOG_DEBUG("stickerdb", "Adding timer to update the sticker cache");
+    return mympd_api_timer_replace(&mympd_state->timer_list, 2, TIMER_ONE_SHOT_REMOVE,
+            timer_handler_by_id, TIMER_ID_CACHES_CREATE, NULL);
 }
 
 /**
@@ -248,6 +329,12 @@ struct t_sticker *stickerdb_get_all_batch(struct t_partition_state *partition_st
     if (is_streamuri(uri) == true) {
         return NULL;
     }
+    if (user_defined == false &&
+        sticker_cache_available(partition_state) == true)
+    {
+        sticker_cache_get(get_sticker_cache(partition_state), uri, sticker);
+        return sticker;
+    }
     return get_sticker_all(partition_state, uri, sticker, user_defined);
 }
 
@@ -263,6 +350,12 @@ struct t_sticker *stickerdb_get_all(struct t_partition_state *partition_state, c
     if (is_streamuri(uri) == true) {
         return NULL;
     }
+    if (user_defined == false &&
+        sticker_cache_available(partition_state) == true)
+    {
+        sticker_cache_get(get_sticker_cache(partition_state), uri, sticker);
+        return sticker;
+    }
     if (stickerdb_connect(partition_state) == false) {
         return NULL;
     }
@@ -592,7 +685,11 @@ long long get_sticker_llong(struct t_partition_state *partition_state, const cha
 static bool set_sticker_value(struct t_partition_state *partition_state, const char *uri, const char *name, const char *value) {
     MYMPD_LOG_INFO(partition_state->name, "Setting sticker: \"%s\" -> %s: %s", uri, name, value);
     mpd_run_sticker_set(partition_state->conn, "song", uri, name, value);
-    return mympd_check_error_and_recover(partition_state, NULL, "mpd_run_sticker_set");
+    if (mympd_check_error_and_recover(partition_state, NULL, "mpd_run_sticker_set") == false) {
+        return false;
+    }
+    sticker_cache_own_write(partition_state, uri, name, value);
+    return true;
 }
 
 /**
@@ -624,3 +721,76 @@ static bool inc_sticker(struct t_partition_state *partition_state, const char *u
     }
     return set_sticker_llong(partition_state, uri, name, value);
 }
+
+/**
+ * Returns the sticker cache for the stickerdb connection of the mympd_api thread.
+ * The stickerdb connections of the mpd_worker threads do not use the sticker cache.
+ * @param partition_state pointer to the partition state
+ * @return pointer to the sticker cache or NULL
+ */
+static struct t_sticker_cache *get_sticker_cache(struct t_partition_state *partition_state) {
+    return partition_state == partition_state->mympd_state->stickerdb
+        ? &partition_state->mympd_state->sticker_cache
+        : NULL;
+}
+
+/**
+ * Checks if the stickers can be served from the sticker cache
+ * @param partition_state pointer to the partition state
+ * @return true if the sticker cache is available, else false
+ */
+static bool sticker_cache_available(struct t_partition_state *partition_state) {
+    struct t_sticker_cache *sticker_cache = get_sticker_cache(partition_state);
+    return sticker_cache != NULL &&
+        sticker_cache->cache != NULL;
+}
+
+/**
+ * Applies a sticker write from myMPD to the sticker cache.
+ * MPD notifies also the writing client, the resulting idle event is ignored.
+ * @param partition_state pointer to the partition state
+ * @param uri song uri
+ * @param name sticker name
+ * @param value sticker value
+ */
+static void sticker_cache_own_write(struct t_partition_state *partition_state, const char *uri, const char *name, const char *value) {
+    struct t_sticker_cache *sticker_cache = get_sticker_cache(partition_state);
+    if (sticker_cache == NULL) {
+        return;
+    }
+    sticker_cache->own_writes++;
+    enum mympd_sticker_types sticker_type = sticker_name_parse(name);
+    if (sticker_type != STICKER_UNKNOWN) {
+        sticker_cache_set(sticker_cache, uri, sticker_type, strtoll(value, NULL, 10));
+    }
+}
+
+/**
+ * Evaluates the idle events of the stickerdb connection.
+ * MPD coalesces the sticker events, a change from another client that is coalesced
+ * with an own write is not detected.
+ * @param partition_state pointer to the partition state
+ * @param idle_bitmask received idle events
+ */
+static void handle_idle_events(struct t_partition_state *partition_state, enum mpd_idle idle_bitmask) {
+    // only the stickerdb connection of the mympd_api thread owns the jukebox pool,
+    // the mpd_worker threads use their own stickerdb states
+    if ((idle_bitmask & MPD_IDLE_STICKER) &&
+        partition_state == partition_state->mympd_state->stickerdb)
+    {
+        jukebox_pool_invalidate_stickers(partition_state->mympd_state);
+    }
+    struct t_sticker_cache *sticker_cache = get_sticker_cache(partition_state);
+    if (sticker_cache == NULL ||
+        (idle_bitmask & MPD_IDLE_STICKER) == 0)
+    {
+        return;
+    }
+    if (sticker_cache->own_writes > 0) {
+        // the cache is already up-to-date
+        sticker_cache->own_writes = 0;
+        return;
+    }
+    MYMPD_LOG_INFO("stickerdb", "Stickers were changed by another client");
+    stickerdb_cache_update(partition_state->mympd_state);
+}
@@ -13,6 +13,9 @@ bool stickerdb_connect(struct t_partition_state *partition_state);
 bool stickerdb_idle(struct t_partition_state *partition_state);
 bool stickerdb_enter_idle(struct t_partition_state *partition_state);
 bool stickerdb_exit_idle(struct t_partition_state *partition_state);
+bool stickerdb_batch_start(struct t_partition_state *partition_state);
+bool stickerdb_batch_end(struct t_partition_state *partition_state);
+bool stickerdb_cache_update(struct t_mympd_state *mympd_state);
 
 sds stickerdb_get(struct t_partition_state *partition_state, const char *uri, const char *name);
 long long stickerdb_get_llong(struct t_partition_state *partition_state, const char *uri, const char *name);
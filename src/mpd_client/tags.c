@@ -26,7 +26,7 @@
 
 static sds get_tag_value_string(const struct mpd_song *song, enum mpd_tag_type tag,
         sds tag_values, unsigned *value_count);
-static sds get_tag_values(const struct mpd_song *song, enum mpd_tag_type tag,
+static sds get_tag_values(const void *entity, tag_value_getter getter, enum mpd_tag_type tag,
         sds tag_values, bool multi, unsigned *value_count);
 
 /**
@@ -302,11 +302,11 @@ sds mpd_client_get_tag_value_string(const struct mpd_song *song, enum mpd_tag_ty
 sds mpd_client_get_tag_values(const struct mpd_song *song, enum mpd_tag_type tag, sds tag_values) {
     const bool multi = is_multivalue_tag(tag);
     unsigned value_count = 0;
-    tag_values = get_tag_values(song, tag, tag_values, multi, &value_count);
+    tag_values = get_tag_values(song, mpd_client_song_tag_getter, tag, tag_values, multi, &value_count);
     if (value_count == 0) {
         if (tag == MPD_TAG_TITLE) {
             //title fallback to name
-            tag_values = get_tag_values(song, MPD_TAG_NAME, tag_values, multi, &value_count);
+            tag_values = get_tag_values(song, mpd_client_song_tag_getter, MPD_TAG_NAME, tag_values, multi, &value_count);
             if (value_count == 0) {
                 //title fallback to filename
                 sds filename = sdsnew(mpd_song_get_uri(song));
@@ -366,17 +366,43 @@ sds print_song_tags(sds buffer, bool tags_enabled, const struct t_tags *tagcols,
  * Prints the tag values for an album as json string
  * @param buffer already allocated sds string to append the values
  * @param tagcols pointer to t_tags struct (tags to retrieve)
- * @param album pointer to a mpd_song struct representing the album
- * @param album_config album config
+ * @param album pointer to a t_album struct
  * @return new sds pointer to buffer
  */
-sds print_album_tags(sds buffer, const struct t_tags *tagcols,
-        const struct mpd_song *album, const struct t_albums_config *album_config)
-{
-    buffer = print_song_tags(buffer, true, tagcols, album, album_config);
-    buffer = sdscatlen(buffer, ",", 1);
-    buffer = tojson_uint(buffer, "Discs", album_get_discs(album), true);
-    buffer = tojson_uint(buffer, "SongCount", album_get_song_count(album), false);
+sds print_album_tags(sds buffer, const struct t_tags *tagcols, const struct t_album *album) {
+    for (unsigned tagnr = 0; tagnr < tagcols->tags_len; ++tagnr) {
+        const enum mpd_tag_type tag = tagcols->tags[tagnr];
+        const bool multi = is_multivalue_tag(tag);
+        unsigned value_count = 0;
+        buffer = sdscatfmt(buffer, "\"%s\":", mpd_tag_name(tag));
+        buffer = get_tag_values(album, mpd_client_album_tag_getter, tag, buffer, multi, &value_count);
+        if (value_count == 0 &&
+            tag == MPD_TAG_TITLE)
+        {
+            //title fallback to name
+            buffer = get_tag_values(album, mpd_client_album_tag_getter, MPD_TAG_NAME, buffer, multi, &value_count);
+            if (value_count == 0) {
+                //title fallback to filename
+                sds filename = sdsnew(album->uri);
+                basename_uri(filename);
+                buffer = sds_catjson(buffer, filename, sdslen(filename));
+                FREE_SDS(filename);
+                value_count++;
+            }
+        }
+        if (value_count == 0) {
+            buffer = multi == true
+                ? sdscatlen(buffer, "[]", 2)
+                : sdscatlen(buffer, "\"\"", 2);
+        }
+        buffer = sdscatlen(buffer, ",", 1);
+    }
+    buffer = tojson_char(buffer, "AlbumId", album->id, true);
+    buffer = tojson_uint(buffer, "Duration", album->duration, true);
+    buffer = tojson_time(buffer, "Last-Modified", album->last_modified, true);
+    buffer = tojson_char(buffer, "uri", album->uri, true);
+    buffer = tojson_uint(buffer, "Discs", album->discs, true);
+    buffer = tojson_uint(buffer, "SongCount", album->songs, false);
     return buffer;
 }
 
@@ -444,6 +470,28 @@ bool mpd_client_tag_exists(const struct t_tags *tagtypes, enum mpd_tag_type tag)
     return false;
 }
 
+/**
+ * Tag value getter for mpd_song structs
+ * @param song pointer to mpd song struct
+ * @param tag mpd tag type
+ * @param idx index of the tag value
+ * @return the tag value or NULL if not found
+ */
+const char *mpd_client_song_tag_getter(const void *song, enum mpd_tag_type tag, unsigned idx) {
+    return mpd_song_get_tag((const struct mpd_song *)song, tag, idx);
+}
+
+/**
+ * Tag value getter for t_album structs
+ * @param album pointer to t_album struct
+ * @param tag mpd tag type
+ * @param idx index of the tag value
+ * @return the tag value or NULL if not found
+ */
+const char *mpd_client_album_tag_getter(const void *album, enum mpd_tag_type tag, unsigned idx) {
+    return album_get_tag((const struct t_album *)album, tag, idx);
+}
+
 /**
  * Private functions
  */
@@ -475,14 +523,15 @@ static sds get_tag_value_string(const struct mpd_song *song, enum mpd_tag_type t
 /**
  * Appends a json string or array to tag_values.
  * Nothing is append if value is empty.
- * @param song pointer to mpd song struct
+ * @param entity pointer to a mpd song or album
+ * @param getter callback to get the tag values from the entity
  * @param tag mpd tag type to get values for
  * @param tag_values already allocated sds string to append the values
  * @param value_count the number of values retrieved
  * @param multi true if it is a multi value string
  * @return new sds pointer to tag_values
  */
-static sds get_tag_values(const struct mpd_song *song, enum mpd_tag_type tag,
+static sds get_tag_values(const void *entity, tag_value_getter getter, enum mpd_tag_type tag,
         sds tag_values, bool multi, unsigned *value_count)
 {
     const char *value;
@@ -492,8 +541,8 @@ static sds get_tag_values(const struct mpd_song *song, enum mpd_tag_type tag,
         //return json array
         tag_values = sdscatlen(tag_values, "[", 1);
         if ((tag == MPD_TAG_MUSICBRAINZ_ALBUMARTISTID || tag == MPD_TAG_MUSICBRAINZ_ARTISTID) &&
-            (value = mpd_song_get_tag(song, tag, 0)) != NULL &&
-            mpd_song_get_tag(song, tag, 1) == NULL)
+            (value = getter(entity, tag, 0)) != NULL &&
+            getter(entity, tag, 1) == NULL)
         {
             //support semicolon separated MUSICBRAINZ_ARTISTID, MUSICBRAINZ_ALBUMARTISTID
             //workaround for https://github.com/MusicPlayerDaemon/MPD/issues/687
@@ -509,7 +558,7 @@ static sds get_tag_values(const struct mpd_song *song, enum mpd_tag_type tag,
             sdsfreesplitres(tokens, token_count);
         }
         else {
-            while ((value = mpd_song_get_tag(song, tag, count)) != NULL) {
+            while ((value = getter(entity, tag, count)) != NULL) {
                 if (count++) {
                     tag_values = sdscatlen(tag_values, ",", 1);
                 }
@@ -526,7 +575,7 @@ static sds get_tag_values(const struct mpd_song *song, enum mpd_tag_type tag,
     else {
         //return json string
         tag_values = sdscatlen(tag_values, "\"", 1);
-        while ((value = mpd_song_get_tag(song, tag, count)) != NULL) {
+        while ((value = getter(entity, tag, count)) != NULL) {
             if (count++) {
                 tag_values = sdscatlen(tag_values, ", ", 2);
             }
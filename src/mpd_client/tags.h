@@ -10,6 +10,13 @@
 #include "dist/sds/sds.h"
 #include "src/lib/mympd_state.h"
 
+struct t_album;
+
+/**
+ * Callback to get a tag value from a song or an album
+ */
+typedef const char *(*tag_value_getter)(const void *entity, enum mpd_tag_type tag, unsigned idx);
+
 time_t mpd_client_get_db_mtime(struct t_partition_state *partition_state);
 bool mympd_mpd_song_add_tag_dedup(struct mpd_song *song,
         enum mpd_tag_type type, const char *value);
@@ -21,8 +28,7 @@ bool enable_mpd_tags(struct t_partition_state *partition_state, const struct t_t
 enum mpd_tag_type get_sort_tag(enum mpd_tag_type tag, const struct t_tags *available_tags);
 sds print_song_tags(sds buffer, bool tags_enabled, const struct t_tags *tagcols,
         const struct mpd_song *song, const struct t_albums_config *album_config);
-sds print_album_tags(sds buffer, const struct t_tags *tagcols,
-        const struct mpd_song *album, const struct t_albums_config *album_config);
+sds print_album_tags(sds buffer, const struct t_tags *tagcols, const struct t_album *album);
 void check_tags(sds taglist, const char *taglistname, struct t_tags *tagtypes,
         const struct t_tags *allowed_tag_types);
 bool mpd_client_tag_exists(const struct t_tags *tagtypes, enum mpd_tag_type tag);
@@ -31,5 +37,7 @@ sds mpd_client_get_tag_value_string(const struct mpd_song *song, enum mpd_tag_ty
 sds print_tags_array(sds buffer, const char *tagsname, const struct t_tags *tags);
 sds mpd_client_get_tag_value_padded(const struct mpd_song *song, enum mpd_tag_type tag, const char pad, size_t len, sds tag_values);
 int mpd_client_get_tag_value_int(const struct mpd_song *song, enum mpd_tag_type tag);
+const char *mpd_client_song_tag_getter(const void *song, enum mpd_tag_type tag, unsigned idx);
+const char *mpd_client_album_tag_getter(const void *album, enum mpd_tag_type tag, unsigned idx);
 
 #endif
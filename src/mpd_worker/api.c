@@ -38,6 +38,8 @@ void mpd_worker_api(struct t_mpd_worker_state *mpd_worker_state) {
     struct t_work_response *response = create_response(request);
     //some shortcuts
     struct t_partition_state *partition_state = mpd_worker_state->partition_state;
+    //index the request parameters once
+    json_index_create(request->data);
 
     switch(request->cmd_id) {
         case MYMPD_API_SONG_FINGERPRINT:
@@ -311,6 +313,7 @@ void mpd_worker_api(struct t_mpd_worker_state *mpd_worker_state) {
                 JSONRPC_FACILITY_GENERAL, JSONRPC_SEVERITY_ERROR, "Unknown request");
             MYMPD_LOG_ERROR(MPD_PARTITION_DEFAULT, "Unknown API request: %.*s", (int)sdslen(request->data), request->data);
     }
+    json_index_clear();
     FREE_SDS(sds_buf1);
     FREE_SDS(sds_buf2);
     FREE_SDS(sds_buf3);
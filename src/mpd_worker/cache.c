@@ -10,24 +10,39 @@
 #include "dist/libmympdclient/include/mpd/client.h"
 #include "dist/libmympdclient/src/isong.h"
 #include "src/lib/album_cache.h"
-#include "src/lib/filehandler.h"
 #include "src/lib/jsonrpc.h"
 #include "src/lib/log.h"
+#include "src/lib/mem.h"
 #include "src/lib/msg_queue.h"
 #include "src/lib/sds_extras.h"
+#include "src/lib/sticker_cache.h"
 #include "src/lib/utility.h"
 #include "src/mpd_client/errorhandler.h"
+#include "src/mpd_client/search.h"
+#include "src/mpd_client/stickerdb.h"
 #include "src/mpd_client/tags.h"
 
 #include <inttypes.h>
 #include <stdbool.h>
+#include <stdlib.h>
 #include <string.h>
 
 /**
  * Private definitions
  */
+static bool cache_albums_create(struct t_mpd_worker_state *mpd_worker_state, bool force);
+static bool cache_stickers_create(struct t_mpd_worker_state *mpd_worker_state);
 static bool cache_init(struct t_mpd_worker_state *mpd_worker_state, rax *album_cache);
 static bool cache_init_simple(struct t_mpd_worker_state *mpd_worker_state, rax *album_cache);
+static struct t_cache *cache_create(rax *albums);
+static bool cache_update(struct t_mpd_worker_state *mpd_worker_state, struct t_album_cache_delta *delta, time_t mtime);
+static bool cache_update_get_dirs(struct t_mpd_worker_state *mpd_worker_state, rax *dirs, const char *filter, time_t mtime);
+static bool cache_update_get_root_albums(struct t_mpd_worker_state *mpd_worker_state, rax *expressions);
+static bool cache_update_get_albums(struct t_mpd_worker_state *mpd_worker_state, rax *dirs, rax *expressions);
+static bool cache_update_get_song_count(struct t_mpd_worker_state *mpd_worker_state, unsigned long *song_count);
+static sds cache_get_album_expression(struct t_mpd_worker_state *mpd_worker_state, sds expression, const struct mpd_song *song);
+static void cache_enable_tags(struct t_mpd_worker_state *mpd_worker_state);
+static int cache_add_song(struct t_mpd_worker_state *mpd_worker_state, rax *album_cache, struct mpd_song *song, sds *key);
 
 /**
  * Public functions
@@ -40,12 +55,27 @@ static bool cache_init_simple(struct t_mpd_worker_state *mpd_worker_state, rax *
  * @return true on success else false
  */
 bool mpd_worker_cache_init(struct t_mpd_worker_state *mpd_worker_state, bool force) {
+    bool rc = cache_albums_create(mpd_worker_state, force);
+    // the sticker cache is always recreated, it does not depend on the database
+    // it is created as last cache, the mympd_api thread checks then for pending updates
+    return cache_stickers_create(mpd_worker_state) && rc;
+}
+
+/**
+ * Private functions
+ */
+
+/**
+ * Creates or updates the album cache and returns it to mympd_api thread
+ * @param mpd_worker_state pointer to mpd_worker_state struct
+ * @param force true=force update, false=update only if mpd database is newer then the album cache
+ * @return true on success else false
+ */
+static bool cache_albums_create(struct t_mpd_worker_state *mpd_worker_state, bool force) {
     time_t db_mtime = mpd_client_get_db_mtime(mpd_worker_state->partition_state);
     MYMPD_LOG_DEBUG("default", "Database mtime: %lld", (long long)db_mtime);
-    sds filepath = sdscatfmt(sdsempty(), "%S/%s/%s", mpd_worker_state->config->workdir, DIR_WORK_TAGS, FILENAME_ALBUMCACHE);
-    time_t album_cache_mtime = get_mtime(filepath);
+    time_t album_cache_mtime = mpd_worker_state->mpd_state->album_cache.mtime;
     MYMPD_LOG_DEBUG("default", "Album cache mtime: %lld", (long long)album_cache_mtime);
-    FREE_SDS(filepath);
 
     if (force == false &&
         db_mtime < album_cache_mtime) {
@@ -62,24 +92,49 @@ bool mpd_worker_cache_init(struct t_mpd_worker_state *mpd_worker_state, bool for
 
     bool rc = true;
     if (mpd_worker_state->partition_state->mpd_state->feat_tags == true) {
-        struct t_cache album_cache;
-        album_cache.cache = raxNew();
+        // the timestamp of the database state the new cache reflects
+        time_t start_time = time(NULL);
+        // moved and renamed songs keep their modification time,
+        // they are only found by the time they were added to the database
+        if (force == false &&
+            album_cache_mtime > 0 &&
+            mpd_worker_state->config->albums.mode == ALBUM_MODE_ADV &&
+            mpd_worker_state->mpd_state->feat_db_added == true)
+        {
+            // update only the changed albums
+            struct t_album_cache_delta *delta = album_cache_delta_new();
+            if (cache_update(mpd_worker_state, delta, album_cache_mtime) == true) {
+                struct t_work_request *request = create_request(-1, 0, INTERNAL_API_ALBUMCACHE_UPDATED, NULL, mpd_worker_state->partition_state->name);
+                request->data = tojson_time(request->data, "mtime", start_time, false);
+                request->data = jsonrpc_end(request->data);
+                request->extra = (void *) delta;
+                mympd_queue_push(mympd_api_queue, request, 0);
+                send_jsonrpc_notify(JSONRPC_FACILITY_DATABASE, JSONRPC_SEVERITY_INFO, MPD_PARTITION_ALL, "Updated album cache");
+                send_jsonrpc_event(JSONRPC_EVENT_UPDATE_CACHE_FINISHED, MPD_PARTITION_ALL);
+                return true;
+            }
+            album_cache_delta_free(delta);
+            MYMPD_LOG_INFO("default", "Incremental album cache update not possible, creating album cache from scratch");
+        }
+        rax *albums = raxNew();
         rc = mpd_worker_state->config->albums.mode == ALBUM_MODE_ADV
-            ? cache_init(mpd_worker_state, album_cache.cache)
-            : cache_init_simple(mpd_worker_state, album_cache.cache);
+            ? cache_init(mpd_worker_state, albums)
+            : cache_init_simple(mpd_worker_state, albums);
         if (rc == true) {
+            struct t_cache *album_cache = cache_create(albums);
+            if (mpd_worker_state->config->save_caches == true) {
+                album_cache_write(album_cache, mpd_worker_state->config->workdir,
+                    &mpd_worker_state->mpd_state->tags_album, &mpd_worker_state->config->albums, false);
+            }
             struct t_work_request *request = create_request(-1, 0, INTERNAL_API_ALBUMCACHE_CREATED, NULL, mpd_worker_state->partition_state->name);
+            request->data = tojson_time(request->data, "mtime", start_time, false);
             request->data = jsonrpc_end(request->data);
-            request->extra = (void *) album_cache.cache;
+            request->extra = (void *) album_cache;
             mympd_queue_push(mympd_api_queue, request, 0);
             send_jsonrpc_notify(JSONRPC_FACILITY_DATABASE, JSONRPC_SEVERITY_INFO, MPD_PARTITION_ALL, "Updated album cache");
-            if (mpd_worker_state->config->save_caches == true) {
-                album_cache_write(&album_cache, mpd_worker_state->config->workdir,
-                    &mpd_worker_state->mpd_state->tags_album, &mpd_worker_state->config->albums, false);
-            }
         }
         else {
-            album_cache_free(&album_cache);
+            album_cache_free_songs(albums);
             send_jsonrpc_notify(JSONRPC_FACILITY_DATABASE, JSONRPC_SEVERITY_ERROR, MPD_PARTITION_ALL, "Update of album cache failed");
             struct t_work_request *request = create_request(-1, 0, INTERNAL_API_ALBUMCACHE_ERROR, NULL, mpd_worker_state->partition_state->name);
             request->data = jsonrpc_end(request->data);
@@ -98,8 +153,58 @@ bool mpd_worker_cache_init(struct t_mpd_worker_state *mpd_worker_state, bool for
 }
 
 /**
- * Private functions
+ * Creates the sticker cache and returns it to mympd_api thread.
+ * It fetches each myMPD sticker with one sticker find command.
+ * @param mpd_worker_state pointer to mpd_worker_state struct
+ * @return true on success else false
  */
+static bool cache_stickers_create(struct t_mpd_worker_state *mpd_worker_state) {
+    if (mpd_worker_state->config->stickers == false ||
+        mpd_worker_state->mpd_state->feat_stickers == false)
+    {
+        MYMPD_LOG_INFO("default", "Skipped sticker cache creation, stickers are disabled");
+        struct t_work_request *request = create_request(-1, 0, INTERNAL_API_STICKERCACHE_SKIPPED, NULL, mpd_worker_state->partition_state->name);
+        request->data = jsonrpc_end(request->data);
+        mympd_queue_push(mympd_api_queue, request, 0);
+        return true;
+    }
+    rax *stickers = raxNew();
+    bool rc = true;
+    for (unsigned i = 0; i < STICKER_COUNT; i++) {
+        enum mympd_sticker_types sticker_type = (enum mympd_sticker_types)i;
+        rax *found = stickerdb_find_stickers_by_name(mpd_worker_state->stickerdb, sticker_name_lookup(sticker_type));
+        if (found == NULL) {
+            rc = false;
+            break;
+        }
+        raxIterator iter;
+        raxStart(&iter, found);
+        raxSeek(&iter, "^", NULL, 0);
+        while (raxNext(&iter)) {
+            sticker_cache_insert(stickers, (char *)iter.key, iter.key_len, sticker_type, strtoll((sds)iter.data, NULL, 10));
+        }
+        raxStop(&iter);
+        stickerdb_free_find_result(found);
+    }
+    if (rc == true) {
+        MYMPD_LOG_INFO("default", "Created sticker cache with %llu song(s)", (unsigned long long)stickers->numele);
+        if (mpd_worker_state->config->save_caches == true) {
+            sticker_cache_write(stickers, mpd_worker_state->config->workdir);
+        }
+        struct t_work_request *request = create_request(-1, 0, INTERNAL_API_STICKERCACHE_CREATED, NULL, mpd_worker_state->partition_state->name);
+        request->data = jsonrpc_end(request->data);
+        request->extra = (void *) stickers;
+        mympd_queue_push(mympd_api_queue, request, 0);
+    }
+    else {
+        sticker_cache_free_rax(stickers);
+        send_jsonrpc_notify(JSONRPC_FACILITY_STICKER, JSONRPC_SEVERITY_ERROR, MPD_PARTITION_ALL, "Update of sticker cache failed");
+        struct t_work_request *request = create_request(-1, 0, INTERNAL_API_STICKERCACHE_ERROR, NULL, mpd_worker_state->partition_state->name);
+        request->data = jsonrpc_end(request->data);
+        mympd_queue_push(mympd_api_queue, request, 0);
+    }
+    return rc;
+}
 
 /**
  * Initializes the album cache
@@ -116,14 +221,7 @@ static bool cache_init(struct t_mpd_worker_state *mpd_worker_state, rax *album_c
     int album_count = 0;
     int skip_count = 0;
 
-    //set interesting tags - add additional tags: disc
-    if (mpd_client_tag_exists(&mpd_worker_state->mpd_state->tags_mympd, MPD_TAG_DISC) == true) {
-        mpd_worker_state->mpd_state->tags_album.tags[mpd_worker_state->mpd_state->tags_album.tags_len++] = MPD_TAG_DISC;
-    }
-    else {
-        MYMPD_LOG_WARN("default", "Disc tag is not enabled");
-    }
-    enable_mpd_tags(mpd_worker_state->partition_state, &mpd_worker_state->mpd_state->tags_album);
+    cache_enable_tags(mpd_worker_state);
 
     //get all songs and set albums
     #ifdef MYMPD_DEBUG
@@ -143,44 +241,15 @@ static bool cache_init(struct t_mpd_worker_state *mpd_worker_state, rax *album_c
         if (mpd_search_commit(mpd_worker_state->partition_state->conn)) {
             struct mpd_song *song;
             while ((song = mpd_recv_song(mpd_worker_state->partition_state->conn)) != NULL) {
-                // set initial song and disc count to 1
-                album_cache_set_song_count(song, 1);
-                if (mpd_worker_state->tag_disc_empty_is_first == true) {
-                    // handle empty disc tag as disc one
-                    album_cache_set_disc_count(song, 1);
-                }
-                // construct the key
-                key = album_cache_get_key(key, song, &mpd_worker_state->config->albums);
-                if (sdslen(key) > 0) {
-                    if (mpd_worker_state->partition_state->mpd_state->tag_albumartist == MPD_TAG_ALBUM_ARTIST &&
-                        mpd_song_get_tag(song, MPD_TAG_ALBUM_ARTIST, 0) == NULL)
-                    {
-                        // Copy Artist tag to AlbumArtist tag
-                        // for filters mpd falls back from AlbumArtist to Artist if AlbumArtist does not exist
-                        album_cache_copy_tags(song, MPD_TAG_ARTIST, MPD_TAG_ALBUM_ARTIST);
-                    }
-                    void *old_data;
-                    if (raxTryInsert(album_cache, (unsigned char *)key, sdslen(key), (void *)song, &old_data) == 0) {
-                        // existing album: append song data
-                        struct mpd_song *album = (struct mpd_song *) old_data;
-                        // append tags
-                        album_cache_append_tags(album, song, &mpd_worker_state->partition_state->mpd_state->tags_mympd);
-                        // set album data
-                        album_cache_set_last_modified(album, song); // use latest last_modified
-                        album_cache_inc_total_time(album, song);    // sum duration
-                        album_cache_set_discs(album, song);         // use max disc value
-                        album_cache_inc_song_count(album);          // inc song count by one
-                        // free song data
-                        mpd_song_free(song);
-                    }
-                    else {
-                        // new album: use song data as initial album data
+                switch (cache_add_song(mpd_worker_state, album_cache, song, &key)) {
+                    case 1:
                         album_count++;
-                    }
-                }
-                else {
-                    skip_count++;
-                    mpd_song_free(song);
+                        break;
+                    case -1:
+                        skip_count++;
+                        break;
+                    default:
+                        break;
                 }
                 i++;
             }
@@ -306,3 +375,364 @@ static bool cache_init_simple(struct t_mpd_worker_state *mpd_worker_state, rax *
     MYMPD_LOG_INFO("default", "Cache updated successfully");
     return true;
 }
+
+/**
+ * Creates the album cache from the aggregated albums
+ * @param albums rax with mpd_song structs representing the albums, it is freed by this function
+ * @return allocated album cache
+ */
+static struct t_cache *cache_create(rax *albums) {
+    #ifdef MYMPD_DEBUG
+        MEASURE_INIT
+        MEASURE_START
+    #endif
+    struct t_cache *album_cache = malloc_assert(sizeof(struct t_cache));
+    album_cache->building = false;
+    album_cache->mtime = 0;
+    album_cache_init(album_cache);
+    raxIterator iter;
+    raxStart(&iter, albums);
+    raxSeek(&iter, "^", NULL, 0);
+    while (raxNext(&iter)) {
+        album_cache_insert(album_cache, (char *)iter.key, iter.key_len, (struct mpd_song *)iter.data);
+    }
+    raxStop(&iter);
+    album_cache_free_songs(albums);
+    #ifdef MYMPD_DEBUG
+        MEASURE_END
+        MEASURE_PRINT("default", "Compact album cache")
+    #endif
+    return album_cache;
+}
+
+/**
+ * Updates only the albums with changed songs
+ * @param mpd_worker_state pointer to mpd_worker_state struct
+ * @param delta pointer to empty album cache delta to populate
+ * @param mtime timestamp of the database state the current album cache reflects
+ * @return true on success, false on error or if too many songs were changed
+ */
+static bool cache_update(struct t_mpd_worker_state *mpd_worker_state, struct t_album_cache_delta *delta, time_t mtime) {
+    MYMPD_LOG_INFO("default", "Updating album cache");
+    #ifdef MYMPD_DEBUG
+        MEASURE_INIT
+        MEASURE_START
+    #endif
+    cache_enable_tags(mpd_worker_state);
+    copy_tag_types(&mpd_worker_state->mpd_state->tags_album, &delta->tags);
+    // get the directories of the changed, moved and added songs
+    if (cache_update_get_dirs(mpd_worker_state, delta->dirs, "modified-since", mtime) == false ||
+        cache_update_get_dirs(mpd_worker_state, delta->dirs, "added-since", mtime) == false)
+    {
+        return false;
+    }
+    // get the albums in the changed directories
+    rax *expressions = raxNew();
+    if (cache_update_get_albums(mpd_worker_state, delta->dirs, expressions) == false) {
+        raxFree(expressions);
+        return false;
+    }
+    // re-aggregate the complete albums
+    bool rc = true;
+    sds key = sdsempty();
+    raxIterator iter;
+    raxStart(&iter, expressions);
+    raxSeek(&iter, "^", NULL, 0);
+    while (raxNext(&iter)) {
+        sds expression = sdsnewlen(iter.key, iter.key_len);
+        if (mpd_search_db_songs(mpd_worker_state->partition_state->conn, false) == false ||
+            mpd_search_add_expression(mpd_worker_state->partition_state->conn, expression) == false)
+        {
+            mpd_search_cancel(mpd_worker_state->partition_state->conn);
+            FREE_SDS(expression);
+            rc = false;
+            break;
+        }
+        FREE_SDS(expression);
+        if (mpd_search_commit(mpd_worker_state->partition_state->conn)) {
+            struct mpd_song *song;
+            while ((song = mpd_recv_song(mpd_worker_state->partition_state->conn)) != NULL) {
+                cache_add_song(mpd_worker_state, delta->albums, song, &key);
+            }
+        }
+        mpd_response_finish(mpd_worker_state->partition_state->conn);
+        if (mympd_check_error_and_recover(mpd_worker_state->partition_state, NULL, "mpd_search_commit") == false) {
+            rc = false;
+            break;
+        }
+    }
+    raxStop(&iter);
+    raxFree(expressions);
+    FREE_SDS(key);
+    if (rc == false) {
+        MYMPD_LOG_ERROR("default", "Cache update failed");
+        return false;
+    }
+    // get the song count to validate the updated cache
+    if (cache_update_get_song_count(mpd_worker_state, &delta->song_count) == false) {
+        return false;
+    }
+    #ifdef MYMPD_DEBUG
+        MEASURE_END
+        MEASURE_PRINT("default", "Update album cache")
+    #endif
+    MYMPD_LOG_INFO("default", "Re-aggregated %lld albums from %lld directories",
+        (long long)delta->albums->numele, (long long)delta->dirs->numele);
+    return true;
+}
+
+/**
+ * Populates the directories of all songs that are modified or added since mtime
+ * @param mpd_worker_state pointer to mpd_worker_state struct
+ * @param dirs rax to populate with the directories
+ * @param filter filter expression: modified-since or added-since
+ * @param mtime timestamp of the database state the current album cache reflects
+ * @return true on success, false on error or if too many songs were changed
+ */
+static bool cache_update_get_dirs(struct t_mpd_worker_state *mpd_worker_state, rax *dirs, const char *filter, time_t mtime) {
+    sds expression = sdscatfmt(sdsempty(), "(%s '%I')", filter, (int64_t)mtime);
+    if (mpd_search_db_songs(mpd_worker_state->partition_state->conn, false) == false ||
+        mpd_search_add_expression(mpd_worker_state->partition_state->conn, expression) == false ||
+        mpd_search_add_window(mpd_worker_state->partition_state->conn, 0, MPD_RESULTS_MAX) == false)
+    {
+        MYMPD_LOG_ERROR("default", "Cache update failed");
+        mpd_search_cancel(mpd_worker_state->partition_state->conn);
+        FREE_SDS(expression);
+        return false;
+    }
+    FREE_SDS(expression);
+    unsigned song_count = 0;
+    if (mpd_search_commit(mpd_worker_state->partition_state->conn)) {
+        struct mpd_song *song;
+        sds dir = sdsempty();
+        while ((song = mpd_recv_song(mpd_worker_state->partition_state->conn)) != NULL) {
+            dir = sds_replace(dir, mpd_song_get_uri(song));
+            dir = sds_dirname(dir);
+            raxTryInsert(dirs, (unsigned char *)dir, sdslen(dir), NULL, NULL);
+            mpd_song_free(song);
+            song_count++;
+        }
+        FREE_SDS(dir);
+    }
+    mpd_response_finish(mpd_worker_state->partition_state->conn);
+    if (mympd_check_error_and_recover(mpd_worker_state->partition_state, NULL, "mpd_search_commit") == false) {
+        MYMPD_LOG_ERROR("default", "Cache update failed");
+        return false;
+    }
+    if (song_count >= MPD_RESULTS_MAX) {
+        // rebuilding the cache is faster
+        MYMPD_LOG_INFO("default", "Too many changed songs for an incremental album cache update");
+        return false;
+    }
+    MYMPD_LOG_DEBUG("default", "Found %u songs with %s in %lld directories", song_count, filter, (long long)dirs->numele);
+    return true;
+}
+
+/**
+ * Populates the search expressions for all albums in the directories
+ * @param mpd_worker_state pointer to mpd_worker_state struct
+ * @param dirs rax with directories
+ * @param expressions rax to populate with the album search expressions
+ * @return true on success, else false
+ */
+static bool cache_update_get_albums(struct t_mpd_worker_state *mpd_worker_state, rax *dirs, rax *expressions) {
+    bool rc = true;
+    sds expression = sdsempty();
+    raxIterator iter;
+    raxStart(&iter, dirs);
+    raxSeek(&iter, "^", NULL, 0);
+    while (raxNext(&iter)) {
+        if (iter.key_len == 1 &&
+            iter.key[0] == '.')
+        {
+            // a base search for the music root would return the whole database
+            if (cache_update_get_root_albums(mpd_worker_state, expressions) == false) {
+                rc = false;
+                break;
+            }
+            continue;
+        }
+        sdsclear(expression);
+        expression = sdscat(expression, "((base '");
+        sds dir = sdsnewlen(iter.key, iter.key_len);
+        expression = escape_mpd_search_value(expression, dir);
+        FREE_SDS(dir);
+        expression = sdscat(expression, "') AND (Album != '') AND (AlbumArtist != ''))");
+        if (mpd_search_db_songs(mpd_worker_state->partition_state->conn, false) == false ||
+            mpd_search_add_expression(mpd_worker_state->partition_state->conn, expression) == false)
+        {
+            mpd_search_cancel(mpd_worker_state->partition_state->conn);
+            rc = false;
+            break;
+        }
+        if (mpd_search_commit(mpd_worker_state->partition_state->conn)) {
+            struct mpd_song *song;
+            while ((song = mpd_recv_song(mpd_worker_state->partition_state->conn)) != NULL) {
+                expression = cache_get_album_expression(mpd_worker_state, expression, song);
+                raxTryInsert(expressions, (unsigned char *)expression, sdslen(expression), NULL, NULL);
+                mpd_song_free(song);
+            }
+        }
+        mpd_response_finish(mpd_worker_state->partition_state->conn);
+        if (mympd_check_error_and_recover(mpd_worker_state->partition_state, NULL, "mpd_search_commit") == false) {
+            rc = false;
+            break;
+        }
+    }
+    raxStop(&iter);
+    FREE_SDS(expression);
+    if (rc == false) {
+        MYMPD_LOG_ERROR("default", "Cache update failed");
+    }
+    return rc;
+}
+
+/**
+ * Populates the search expressions for all albums of the songs in the music root
+ * @param mpd_worker_state pointer to mpd_worker_state struct
+ * @param expressions rax to populate with the album search expressions
+ * @return true on success, else false
+ */
+static bool cache_update_get_root_albums(struct t_mpd_worker_state *mpd_worker_state, rax *expressions) {
+    if (mpd_send_list_meta(mpd_worker_state->partition_state->conn, "") == false) {
+        mympd_set_mpd_failure(mpd_worker_state->partition_state, "Error sending lsinfo command");
+        return false;
+    }
+    sds expression = sdsempty();
+    struct mpd_entity *entity;
+    while ((entity = mpd_recv_entity(mpd_worker_state->partition_state->conn)) != NULL) {
+        if (mpd_entity_get_type(entity) == MPD_ENTITY_TYPE_SONG) {
+            const struct mpd_song *song = mpd_entity_get_song(entity);
+            // same as the filter ((Album != '') AND (AlbumArtist != ''))
+            if (mpd_song_get_tag(song, MPD_TAG_ALBUM, 0) != NULL &&
+                (mpd_song_get_tag(song, MPD_TAG_ALBUM_ARTIST, 0) != NULL ||
+                 mpd_song_get_tag(song, MPD_TAG_ARTIST, 0) != NULL))
+            {
+                expression = cache_get_album_expression(mpd_worker_state, expression, song);
+                raxTryInsert(expressions, (unsigned char *)expression, sdslen(expression), NULL, NULL);
+            }
+        }
+        mpd_entity_free(entity);
+    }
+    mpd_response_finish(mpd_worker_state->partition_state->conn);
+    FREE_SDS(expression);
+    return mympd_check_error_and_recover(mpd_worker_state->partition_state, NULL, "mpd_send_list_meta");
+}
+
+/**
+ * Gets the number of songs that belong to an album
+ * @param mpd_worker_state pointer to mpd_worker_state struct
+ * @param song_count pointer to set the song count
+ * @return true on success, else false
+ */
+static bool cache_update_get_song_count(struct t_mpd_worker_state *mpd_worker_state, unsigned long *song_count) {
+    if (mpd_count_db_songs(mpd_worker_state->partition_state->conn) == false ||
+        mpd_search_add_expression(mpd_worker_state->partition_state->conn, "((Album != '') AND (AlbumArtist !=''))") == false)
+    {
+        MYMPD_LOG_ERROR("default", "Cache update failed");
+        mpd_search_cancel(mpd_worker_state->partition_state->conn);
+        return false;
+    }
+    if (mpd_search_commit(mpd_worker_state->partition_state->conn)) {
+        struct mpd_pair *pair = mpd_recv_pair_named(mpd_worker_state->partition_state->conn, "songs");
+        if (pair != NULL) {
+            *song_count = strtoul(pair->value, NULL, 10);
+            mpd_return_pair(mpd_worker_state->partition_state->conn, pair);
+        }
+    }
+    mpd_response_finish(mpd_worker_state->partition_state->conn);
+    if (mympd_check_error_and_recover(mpd_worker_state->partition_state, NULL, "mpd_count_db_songs") == false) {
+        MYMPD_LOG_ERROR("default", "Cache update failed");
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Creates the search expression to get all songs of the album the song belongs to
+ * @param mpd_worker_state pointer to mpd_worker_state struct
+ * @param expression already allocated sds string to replace
+ * @param song pointer to mpd_song struct
+ * @return pointer to expression
+ */
+static sds cache_get_album_expression(struct t_mpd_worker_state *mpd_worker_state, sds expression, const struct mpd_song *song) {
+    sdsclear(expression);
+    const char *mb_album_id = mpd_song_get_tag(song, MPD_TAG_MUSICBRAINZ_ALBUMID, 0);
+    if (mb_album_id != NULL &&
+        strlen(mb_album_id) == MBID_LENGTH)
+    {
+        // the MusicBrainz album id is the album key
+        return escape_mpd_search_expression(expression, mpd_tag_name(MPD_TAG_MUSICBRAINZ_ALBUMID), "==", mb_album_id);
+    }
+    sds album_expression = get_search_expression_song_album(mpd_worker_state->partition_state->mpd_state->tag_albumartist,
+        song, &mpd_worker_state->config->albums);
+    expression = sdscatsds(expression, album_expression);
+    FREE_SDS(album_expression);
+    return expression;
+}
+
+/**
+ * Enables the tags for the album cache: album tags and disc
+ * @param mpd_worker_state pointer to mpd_worker_state struct
+ */
+static void cache_enable_tags(struct t_mpd_worker_state *mpd_worker_state) {
+    //set interesting tags - add additional tags: disc
+    if (mpd_client_tag_exists(&mpd_worker_state->mpd_state->tags_mympd, MPD_TAG_DISC) == false) {
+        MYMPD_LOG_WARN("default", "Disc tag is not enabled");
+    }
+    else if (mpd_client_tag_exists(&mpd_worker_state->mpd_state->tags_album, MPD_TAG_DISC) == false) {
+        //this function is called for the incremental update and the fallback to the full rebuild
+        mpd_worker_state->mpd_state->tags_album.tags[mpd_worker_state->mpd_state->tags_album.tags_len++] = MPD_TAG_DISC;
+    }
+    enable_mpd_tags(mpd_worker_state->partition_state, &mpd_worker_state->mpd_state->tags_album);
+}
+
+/**
+ * Adds a song to the album it belongs to.
+ * The song is used as initial album data or appended to an existing album and freed.
+ * @param mpd_worker_state pointer to mpd_worker_state struct
+ * @param album_cache rax to add the song
+ * @param song pointer to mpd_song struct, it is consumed by this function
+ * @param key pointer to already allocated sds string for the album key
+ * @return 1 if a new album was created,
+ *         0 if the song was appended to an existing album,
+ *         -1 if the song was skipped
+ */
+static int cache_add_song(struct t_mpd_worker_state *mpd_worker_state, rax *album_cache, struct mpd_song *song, sds *key) {
+    // set initial song and disc count to 1
+    album_cache_set_song_count(song, 1);
+    if (mpd_worker_state->tag_disc_empty_is_first == true) {
+        // handle empty disc tag as disc one
+        album_cache_set_disc_count(song, 1);
+    }
+    // construct the key
+    *key = album_cache_get_key(*key, song, &mpd_worker_state->config->albums);
+    if (sdslen(*key) == 0) {
+        mpd_song_free(song);
+        return -1;
+    }
+    if (mpd_worker_state->partition_state->mpd_state->tag_albumartist == MPD_TAG_ALBUM_ARTIST &&
+        mpd_song_get_tag(song, MPD_TAG_ALBUM_ARTIST, 0) == NULL)
+    {
+        // Copy Artist tag to AlbumArtist tag
+        // for filters mpd falls back from AlbumArtist to Artist if AlbumArtist does not exist
+        album_cache_copy_tags(song, MPD_TAG_ARTIST, MPD_TAG_ALBUM_ARTIST);
+    }
+    void *old_data;
+    if (raxTryInsert(album_cache, (unsigned char *)*key, sdslen(*key), (void *)song, &old_data) == 0) {
+        // existing album: append song data
+        struct mpd_song *album = (struct mpd_song *) old_data;
+        // append tags
+        album_cache_append_tags(album, song, &mpd_worker_state->partition_state->mpd_state->tags_mympd);
+        // set album data
+        album_cache_set_last_modified(album, song); // use latest last_modified
+        album_cache_inc_total_time(album, song);    // sum duration
+        album_cache_set_discs(album, song);         // use max disc value
+        album_cache_inc_song_count(album);          // inc song count by one
+        // free song data
+        mpd_song_free(song);
+        return 0;
+    }
+    // new album: use song data as initial album data
+    return 1;
+}
@@ -7,9 +7,12 @@
 #include "compile_time.h"
 #include "src/mpd_worker/mpd_worker.h"
 
+#include "dist/mjson/mjson.h"
 #include "dist/sds/sds.h"
+#include "src/lib/jsonrpc.h"
 #include "src/lib/log.h"
 #include "src/lib/mem.h"
+#include "src/lib/msg_queue.h"
 #include "src/lib/mympd_state.h"
 #include "src/lib/sds_extras.h"
 #include "src/lib/thread.h"
@@ -17,36 +20,254 @@
 #include "src/mpd_worker/api.h"
 
 #include <pthread.h>
+#include <string.h>
 
 /**
  * Private definitions
  */
 
+/**
+ * Reuse pooled mpd connections only if they were used in this interval (seconds),
+ * MPD closes idle client connections after connection_timeout (default 60s)
+ */
+#define MPD_WORKER_CONN_REUSE 30
+
+/**
+ * Priorities for mpd_worker jobs
+ */
+enum mpd_worker_job_prio {
+    MPD_WORKER_PRIO_LOW = 0,     //!< background jobs, e.g. cache updates
+    MPD_WORKER_PRIO_NORMAL,      //!< jobs for all playlists
+    MPD_WORKER_PRIO_HIGH         //!< interactive jobs for a single song or playlist
+};
+
+/**
+ * A queued or running mpd_worker job
+ */
+struct t_mpd_worker_job {
+    struct t_mpd_worker_state *mpd_worker_state;  //!< the state for the job, includes the request
+    enum mympd_cmd_ids cmd_id;                    //!< api method of the job
+    sds partition;                                //!< partition of the request
+    sds params;                                   //!< jsonrpc params of the request, used for coalescing
+    enum mpd_worker_job_prio prio;                //!< job priority
+    time_t timestamp;                             //!< queue time or start time of the job
+    struct t_mpd_worker_job *next;                //!< next job in the queue
+};
+
+/**
+ * Pooled mpd connection of a worker thread
+ */
+struct t_mpd_worker_conn {
+    struct mpd_connection *conn;  //!< the connection or NULL
+    sds host;                     //!< mpd host of the connection
+    unsigned port;                //!< mpd port of the connection
+    sds pass;                     //!< mpd password of the connection
+    time_t last_used;             //!< time of last usage
+};
+
+/**
+ * Worker thread of the pool
+ */
+struct t_mpd_worker_thread {
+    pthread_t thread;                     //!< thread id
+    struct t_mpd_worker_job *job;         //!< running job or NULL
+    struct t_mpd_worker_conn mpd;         //!< pooled mpd connection
+    struct t_mpd_worker_conn stickerdb;   //!< pooled stickerdb connection
+};
+
+/**
+ * The mpd_worker thread pool.
+ * Jobs are submitted only from the mympd_api thread.
+ */
+struct t_mpd_worker_pool {
+    pthread_mutex_t mutex;                                  //!< protects the pool
+    pthread_cond_t wakeup;                                  //!< signals new jobs and the stop condition
+    struct t_mpd_worker_job *head;                          //!< job queue ordered by priority
+    unsigned queued;                                        //!< number of queued jobs
+    unsigned idle;                                          //!< number of idle threads
+    struct t_mpd_worker_thread threads[MAX_WORKER_THREADS]; //!< worker threads
+    unsigned threads_len;                                   //!< number of started threads
+    bool stop;                                              //!< stop condition for the threads
+};
+
+static struct t_mpd_worker_pool pool = {
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+    .wakeup = PTHREAD_COND_INITIALIZER,
+    .head = NULL,
+    .queued = 0,
+    .idle = 0,
+    .threads_len = 0,
+    .stop = false
+};
+
+static struct t_mpd_worker_state *mpd_worker_state_new(struct t_mympd_state *mympd_state, struct t_work_request *request);
+static enum mpd_worker_job_prio get_job_prio(enum mympd_cmd_ids cmd_id);
+static sds get_job_params(struct t_work_request *request);
+static struct t_mpd_worker_job *find_queued_job(enum mympd_cmd_ids cmd_id, const char *partition, const char *params);
+static void job_queue_insert(struct t_mpd_worker_job *job);
+static void job_queue_unlink(struct t_mpd_worker_job *job);
+static void job_free(struct t_mpd_worker_job *job);
+static bool start_thread(void);
 static void *mpd_worker_run(void *arg);
+static void mpd_worker_run_job(struct t_mpd_worker_thread *thread, struct t_mpd_worker_state *mpd_worker_state);
+static bool conn_acquire(struct t_mpd_worker_conn *pooled, struct t_partition_state *partition_state, bool stickerdb);
+static void conn_release(struct t_mpd_worker_conn *pooled, struct t_partition_state *partition_state);
+static void conn_close(struct t_mpd_worker_conn *pooled);
 
 /**
  * Public functions
  */
 
 /**
- * Starts the worker thread in detached state.
+ * Queues a job for the mpd_worker thread pool.
+ * A job equal to an already queued job is coalesced with it.
  * @param mympd_state pointer to mympd_state struct
  * @param request the work request
  * @return true on success, else false
  */
 bool mpd_worker_start(struct t_mympd_state *mympd_state, struct t_work_request *request) {
-    MYMPD_LOG_NOTICE(NULL, "Starting mpd_worker thread for %s", get_cmd_id_method_name(request->cmd_id));
-    pthread_t mpd_worker_thread;
-    pthread_attr_t attr;
-    if (pthread_attr_init(&attr) != 0) {
-        MYMPD_LOG_ERROR(NULL, "Can not init mpd_worker thread attribute");
-        return false;
+    sds params = get_job_params(request);
+    enum mpd_worker_job_prio prio = get_job_prio(request->cmd_id);
+    pthread_mutex_lock(&pool.mutex);
+    struct t_mpd_worker_job *queued = find_queued_job(request->cmd_id, request->partition, params);
+    if (queued != NULL) {
+        MYMPD_LOG_NOTICE(NULL, "Coalescing mpd_worker job for %s", get_cmd_id_method_name(request->cmd_id));
+        if (prio > queued->prio) {
+            job_queue_unlink(queued);
+            queued->prio = prio;
+            job_queue_insert(queued);
+        }
+        pthread_mutex_unlock(&pool.mutex);
+        FREE_SDS(params);
+        if (request->conn_id > -1) {
+            struct t_work_response *response = create_response(request);
+            response->data = jsonrpc_respond_message(response->data, request->cmd_id, request->id,
+                JSONRPC_FACILITY_GENERAL, JSONRPC_SEVERITY_INFO, "Job is already queued");
+            mympd_queue_push(web_server_queue, response, 0);
+        }
+        free_request(request);
+        return true;
     }
-    if (pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED) != 0) {
-        MYMPD_LOG_ERROR(NULL, "Can not set mpd_worker thread to detached");
-        return false;
+    if (pool.idle <= pool.queued &&
+        pool.threads_len < MAX_WORKER_THREADS &&
+        start_thread() == false)
+    {
+        if (pool.threads_len == 0) {
+            pthread_mutex_unlock(&pool.mutex);
+            FREE_SDS(params);
+            return false;
+        }
+        //the job waits for a running thread
+    }
+    MYMPD_LOG_NOTICE(NULL, "Queuing mpd_worker job for %s", get_cmd_id_method_name(request->cmd_id));
+    struct t_mpd_worker_job *job = malloc_assert(sizeof(struct t_mpd_worker_job));
+    job->mpd_worker_state = mpd_worker_state_new(mympd_state, request);
+    job->cmd_id = request->cmd_id;
+    job->partition = sdsnew(request->partition);
+    job->params = params;
+    job->prio = prio;
+    job->timestamp = time(NULL);
+    job_queue_insert(job);
+    pthread_cond_signal(&pool.wakeup);
+    pthread_mutex_unlock(&pool.mutex);
+    return true;
+}
+
+/**
+ * Returns the number of queued jobs
+ * @return number of queued jobs
+ */
+unsigned mpd_worker_queue_length(void) {
+    pthread_mutex_lock(&pool.mutex);
+    unsigned queued = pool.queued;
+    pthread_mutex_unlock(&pool.mutex);
+    return queued;
+}
+
+/**
+ * Lists the running and queued mpd_worker jobs
+ * @param buffer already allocated sds string to append the response
+ * @param request_id jsonrpc request id
+ * @return pointer to buffer
+ */
+sds mpd_worker_list(sds buffer, long request_id) {
+    enum mympd_cmd_ids cmd_id = MYMPD_API_WORKER_LIST;
+    buffer = jsonrpc_respond_start(buffer, cmd_id, request_id);
+    buffer = sdscat(buffer, "\"data\":[");
+    unsigned entities_returned = 0;
+    pthread_mutex_lock(&pool.mutex);
+    for (unsigned i = 0; i < pool.threads_len; i++) {
+        struct t_mpd_worker_job *job = pool.threads[i].job;
+        if (job == NULL) {
+            continue;
+        }
+        if (entities_returned++) {
+            buffer = sdscatlen(buffer, ",", 1);
+        }
+        buffer = sdscatlen(buffer, "{", 1);
+        buffer = tojson_char(buffer, "method", get_cmd_id_method_name(job->cmd_id), true);
+        buffer = tojson_sds(buffer, "partition", job->partition, true);
+        buffer = tojson_int(buffer, "priority", job->prio, true);
+        buffer = tojson_char(buffer, "state", "running", true);
+        buffer = tojson_time(buffer, "since", job->timestamp, false);
+        buffer = sdscatlen(buffer, "}", 1);
+    }
+    for (struct t_mpd_worker_job *job = pool.head; job != NULL; job = job->next) {
+        if (entities_returned++) {
+            buffer = sdscatlen(buffer, ",", 1);
+        }
+        buffer = sdscatlen(buffer, "{", 1);
+        buffer = tojson_char(buffer, "method", get_cmd_id_method_name(job->cmd_id), true);
+        buffer = tojson_sds(buffer, "partition", job->partition, true);
+        buffer = tojson_int(buffer, "priority", job->prio, true);
+        buffer = tojson_char(buffer, "state", "queued", true);
+        buffer = tojson_time(buffer, "since", job->timestamp, false);
+        buffer = sdscatlen(buffer, "}", 1);
+    }
+    unsigned threads = pool.threads_len;
+    pthread_mutex_unlock(&pool.mutex);
+    buffer = sdscatlen(buffer, "],", 2);
+    buffer = tojson_uint(buffer, "threads", threads, true);
+    buffer = tojson_uint(buffer, "returnedEntities", entities_returned, false);
+    buffer = jsonrpc_end(buffer);
+    return buffer;
+}
+
+/**
+ * Stops the mpd_worker thread pool.
+ * Discards the queued jobs and waits for the running jobs.
+ */
+void mpd_worker_pool_stop(void) {
+    pthread_mutex_lock(&pool.mutex);
+    pool.stop = true;
+    while (pool.head != NULL) {
+        struct t_mpd_worker_job *job = pool.head;
+        job_queue_unlink(job);
+        MYMPD_LOG_WARN(NULL, "Discarding mpd_worker job for %s", get_cmd_id_method_name(job->cmd_id));
+        free_request(job->mpd_worker_state->request);
+        job_free(job);
     }
-    //create mpd worker state from mympd_state
+    pthread_cond_broadcast(&pool.wakeup);
+    unsigned threads_len = pool.threads_len;
+    pthread_mutex_unlock(&pool.mutex);
+    for (unsigned i = 0; i < threads_len; i++) {
+        pthread_join(pool.threads[i].thread, NULL);
+    }
+    pool.threads_len = 0;
+    pool.idle = 0;
+}
+
+/**
+ * Private functions
+ */
+
+/**
+ * Creates the state for a mpd_worker job from mympd_state
+ * @param mympd_state pointer to mympd_state struct
+ * @param request the work request
+ * @return newly allocated mpd_worker state
+ */
+static struct t_mpd_worker_state *mpd_worker_state_new(struct t_mympd_state *mympd_state, struct t_work_request *request) {
     struct t_mpd_worker_state *mpd_worker_state = malloc_assert(sizeof(struct t_mpd_worker_state));
     mpd_worker_state->request = request;
     mpd_worker_state->smartpls = mympd_state->smartpls == true ?
@@ -57,77 +278,291 @@ bool mpd_worker_start(struct t_mympd_state *mympd_state, struct t_work_request *
     mpd_worker_state->tag_disc_empty_is_first = mympd_state->tag_disc_empty_is_first;
     copy_tag_types(&mympd_state->smartpls_generate_tag_types, &mpd_worker_state->smartpls_generate_tag_types);
     mpd_worker_state->config = mympd_state->config;
-    //mpd state
-    mpd_worker_state->mpd_state = malloc_assert(sizeof(struct t_mpd_state));
-    mpd_state_default(mpd_worker_state->mpd_state, mympd_state);
-    mpd_worker_state->partition_state = malloc_assert(sizeof(struct t_partition_state));
     //worker runs always in default partition
-    partition_state_default(mpd_worker_state->partition_state, mympd_state->partition_state->name, mympd_state);
-    mpd_worker_state->partition_state->mpd_state = mpd_worker_state->mpd_state;
-    //copy some mpd_state settings
-    mpd_worker_state->mpd_state->mpd_keepalive = mympd_state->mpd_state->mpd_keepalive;
-    mpd_worker_state->mpd_state->mpd_timeout = mympd_state->mpd_state->mpd_timeout;
-    mpd_worker_state->mpd_state->mpd_host = sds_replace(mpd_worker_state->partition_state->mpd_state->mpd_host, mympd_state->mpd_state->mpd_host);
-    mpd_worker_state->mpd_state->mpd_port = mympd_state->mpd_state->mpd_port;
-    mpd_worker_state->mpd_state->mpd_pass = sds_replace(mpd_worker_state->partition_state->mpd_state->mpd_pass, mympd_state->mpd_state->mpd_pass);
-    mpd_worker_state->mpd_state->feat_tags = mympd_state->mpd_state->feat_tags;
-    mpd_worker_state->mpd_state->feat_stickers = mympd_state->mpd_state->feat_stickers;
-    mpd_worker_state->mpd_state->feat_playlists = mympd_state->mpd_state->feat_playlists;
-    mpd_worker_state->mpd_state->feat_whence = mympd_state->mpd_state->feat_whence;
-    mpd_worker_state->mpd_state->feat_fingerprint = mympd_state->mpd_state->feat_fingerprint;
-    mpd_worker_state->mpd_state->tag_albumartist = mympd_state->partition_state->mpd_state->tag_albumartist;
-    copy_tag_types(&mympd_state->mpd_state->tags_mympd, &mpd_worker_state->mpd_state->tags_mympd);
-    copy_tag_types(&mympd_state->mpd_state->tags_album, &mpd_worker_state->mpd_state->tags_album);
-
-    //stickerdb
-    mpd_worker_state->stickerdb = malloc_assert(sizeof(struct t_partition_state));
-    //worker runs always in default partition
-    partition_state_default(mpd_worker_state->stickerdb, mympd_state->partition_state->name, mympd_state);
-    // do not use the shared mpd_state - we can connect to another mpd server for stickers
-    mpd_worker_state->stickerdb->mpd_state = malloc_assert(sizeof(struct t_mpd_state));
-    mpd_state_default(mpd_worker_state->stickerdb->mpd_state, mympd_state);
-    //copy some mpd_state settings
-    mpd_worker_state->stickerdb->mpd_state->mpd_keepalive = mympd_state->stickerdb->mpd_state->mpd_keepalive;
-    mpd_worker_state->stickerdb->mpd_state->mpd_timeout = mympd_state->stickerdb->mpd_state->mpd_timeout;
-    mpd_worker_state->stickerdb->mpd_state->mpd_host = sds_replace(mpd_worker_state->stickerdb->mpd_state->mpd_host, mympd_state->stickerdb->mpd_state->mpd_host);
-    mpd_worker_state->stickerdb->mpd_state->mpd_port = mympd_state->mpd_state->mpd_port;
-    mpd_worker_state->stickerdb->mpd_state->mpd_pass = sds_replace(mpd_worker_state->stickerdb->mpd_state->mpd_pass, mympd_state->stickerdb->mpd_state->mpd_pass);
-
-    //create the worker thread
-    if (pthread_create(&mpd_worker_thread, &attr, mpd_worker_run, mpd_worker_state) != 0) {
-        MYMPD_LOG_ERROR(NULL, "Can not create mpd_worker thread");
-        mpd_worker_state_free(mpd_worker_state);
-        return false;
+    mpd_worker_state->partition_state = mpd_worker_partition_state_new(mympd_state,
+        mympd_state->partition_state->name, mympd_state->mpd_state, true);
+    mpd_worker_state->mpd_state = mpd_worker_state->partition_state->mpd_state;
+    //stickerdb - do not use the shared mpd_state, we can connect to another mpd server for stickers
+    mpd_worker_state->stickerdb = mpd_worker_partition_state_new(mympd_state,
+        mympd_state->partition_state->name, mympd_state->stickerdb->mpd_state, false);
+    return mpd_worker_state;
+}
+
+/**
+ * Maps the api method to a job priority
+ * @param cmd_id api method
+ * @return the job priority
+ */
+static enum mpd_worker_job_prio get_job_prio(enum mympd_cmd_ids cmd_id) {
+    switch(cmd_id) {
+        case MYMPD_API_SONG_FINGERPRINT:
+        case MYMPD_API_PLAYLIST_CONTENT_DEDUP:
+        case MYMPD_API_PLAYLIST_CONTENT_SHUFFLE:
+        case MYMPD_API_PLAYLIST_CONTENT_SORT:
+        case MYMPD_API_PLAYLIST_CONTENT_VALIDATE:
+        case MYMPD_API_PLAYLIST_CONTENT_VALIDATE_DEDUP:
+            return MPD_WORKER_PRIO_HIGH;
+        case MYMPD_API_CACHES_CREATE:
+        case MYMPD_API_SMARTPLS_UPDATE_ALL:
+            return MPD_WORKER_PRIO_LOW;
+        default:
+            return MPD_WORKER_PRIO_NORMAL;
     }
-    worker_threads++;
-    return true;
 }
 
 /**
- * Private functions
+ * Extracts the jsonrpc params from the request
+ * @param request the work request
+ * @return newly allocated sds string with the params
  */
+static sds get_job_params(struct t_work_request *request) {
+    const char *p;
+    int n;
+    if (request->data != NULL &&
+        mjson_find(request->data, (int)sdslen(request->data), "$.params", &p, &n) == MJSON_TOK_OBJECT)
+    {
+        return sdsnewlen(p, (size_t)n);
+    }
+    return sdsempty();
+}
+
+/**
+ * Finds a queued job with the same method, partition and params.
+ * The pool mutex must be locked.
+ * @param cmd_id api method
+ * @param partition partition name
+ * @param params jsonrpc params
+ * @return the job or NULL if not found
+ */
+static struct t_mpd_worker_job *find_queued_job(enum mympd_cmd_ids cmd_id, const char *partition, const char *params) {
+    for (struct t_mpd_worker_job *job = pool.head; job != NULL; job = job->next) {
+        if (job->cmd_id == cmd_id &&
+            strcmp(job->partition, partition) == 0 &&
+            strcmp(job->params, params) == 0)
+        {
+            return job;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Inserts the job after all jobs with the same or a higher priority.
+ * The pool mutex must be locked.
+ * @param job the job to insert
+ */
+static void job_queue_insert(struct t_mpd_worker_job *job) {
+    struct t_mpd_worker_job **current = &pool.head;
+    while (*current != NULL &&
+        (*current)->prio >= job->prio)
+    {
+        current = &(*current)->next;
+    }
+    job->next = *current;
+    *current = job;
+    pool.queued++;
+}
+
+/**
+ * Removes the job from the queue.
+ * The pool mutex must be locked.
+ * @param job the job to remove
+ */
+static void job_queue_unlink(struct t_mpd_worker_job *job) {
+    struct t_mpd_worker_job **current = &pool.head;
+    while (*current != NULL) {
+        if (*current == job) {
+            *current = job->next;
+            job->next = NULL;
+            pool.queued--;
+            return;
+        }
+        current = &(*current)->next;
+    }
+}
+
+/**
+ * Frees the job and its mpd_worker state, the request is not freed
+ * @param job the job to free
+ */
+static void job_free(struct t_mpd_worker_job *job) {
+    mpd_worker_state_free(job->mpd_worker_state);
+    FREE_SDS(job->partition);
+    FREE_SDS(job->params);
+    FREE_PTR(job);
+}
+
+/**
+ * Starts a new worker thread.
+ * The pool mutex must be locked.
+ * @return true on success, else false
+ */
+static bool start_thread(void) {
+    struct t_mpd_worker_thread *thread = &pool.threads[pool.threads_len];
+    thread->job = NULL;
+    thread->mpd.conn = NULL;
+    thread->mpd.host = sdsempty();
+    thread->mpd.pass = sdsempty();
+    thread->mpd.port = 0;
+    thread->mpd.last_used = 0;
+    thread->stickerdb.conn = NULL;
+    thread->stickerdb.host = sdsempty();
+    thread->stickerdb.pass = sdsempty();
+    thread->stickerdb.port = 0;
+    thread->stickerdb.last_used = 0;
+    if (pthread_create(&thread->thread, NULL, mpd_worker_run, thread) != 0) {
+        MYMPD_LOG_ERROR(NULL, "Can not create mpd_worker thread");
+        FREE_SDS(thread->mpd.host);
+        FREE_SDS(thread->mpd.pass);
+        FREE_SDS(thread->stickerdb.host);
+        FREE_SDS(thread->stickerdb.pass);
+        return false;
+    }
+    MYMPD_LOG_NOTICE(NULL, "Started mpd_worker thread %u", pool.threads_len);
+    pool.threads_len++;
+    //the new thread is idle until it takes the job
+    pool.idle++;
+    return true;
+}
 
 /**
- * This is the main function of the worker thread.
- * @param arg void pointer to the mpd_worker_state
+ * This is the main function of the worker threads.
+ * It runs the queued jobs until the pool is stopped.
+ * @param arg void pointer to the t_mpd_worker_thread struct
+ * @return NULL
  */
 static void *mpd_worker_run(void *arg) {
     thread_logname = sds_replace(thread_logname, "mpdworker");
     set_threadname(thread_logname);
-    struct t_mpd_worker_state *mpd_worker_state = (struct t_mpd_worker_state *) arg;
+    struct t_mpd_worker_thread *thread = (struct t_mpd_worker_thread *) arg;
 
-    if (mpd_client_connect(mpd_worker_state->partition_state, false) == true) {
-        //call api handler
-        mpd_worker_api(mpd_worker_state);
-        //disconnect
-        mpd_client_disconnect_silent(mpd_worker_state->partition_state, MPD_REMOVED);
-    }
-    if (mpd_worker_state->stickerdb->conn != NULL) {
-        mpd_client_disconnect_silent(mpd_worker_state->stickerdb, MPD_DISCONNECT_INSTANT);
+    pthread_mutex_lock(&pool.mutex);
+    while (true) {
+        while (pool.head == NULL &&
+            pool.stop == false)
+        {
+            pthread_cond_wait(&pool.wakeup, &pool.mutex);
+        }
+        if (pool.stop == true) {
+            break;
+        }
+        struct t_mpd_worker_job *job = pool.head;
+        job_queue_unlink(job);
+        job->timestamp = time(NULL);
+        thread->job = job;
+        pool.idle--;
+        pthread_mutex_unlock(&pool.mutex);
+
+        MYMPD_LOG_NOTICE(NULL, "Running mpd_worker job for %s", get_cmd_id_method_name(job->cmd_id));
+        mpd_worker_run_job(thread, job->mpd_worker_state);
+
+        pthread_mutex_lock(&pool.mutex);
+        thread->job = NULL;
+        pool.idle++;
+        job_free(job);
     }
+    pthread_mutex_unlock(&pool.mutex);
+
+    conn_close(&thread->mpd);
+    conn_close(&thread->stickerdb);
+    FREE_SDS(thread->mpd.host);
+    FREE_SDS(thread->mpd.pass);
+    FREE_SDS(thread->stickerdb.host);
+    FREE_SDS(thread->stickerdb.pass);
     MYMPD_LOG_NOTICE(NULL, "Stopping mpd_worker thread");
-    mpd_worker_state_free(mpd_worker_state);
-    worker_threads--;
     FREE_SDS(thread_logname);
     return NULL;
 }
+
+/**
+ * Runs a job with the pooled connections of the thread
+ * @param thread the worker thread
+ * @param mpd_worker_state the state of the job
+ */
+static void mpd_worker_run_job(struct t_mpd_worker_thread *thread, struct t_mpd_worker_state *mpd_worker_state) {
+    if (conn_acquire(&thread->mpd, mpd_worker_state->partition_state, false) == false) {
+        MYMPD_LOG_ERROR(NULL, "Can not connect to MPD, discarding mpd_worker job");
+        free_request(mpd_worker_state->request);
+        return;
+    }
+    conn_acquire(&thread->stickerdb, mpd_worker_state->stickerdb, true);
+    //call api handler
+    mpd_worker_api(mpd_worker_state);
+    //give the connections back to the pool
+    conn_release(&thread->mpd, mpd_worker_state->partition_state);
+    conn_release(&thread->stickerdb, mpd_worker_state->stickerdb);
+}
+
+/**
+ * Moves the pooled connection to the partition state or connects to mpd.
+ * The stickerdb connection is only reused, stickerdb functions connect on demand.
+ * @param pooled the pooled connection
+ * @param partition_state partition state of the job
+ * @param stickerdb true for the stickerdb connection
+ * @return true on success, else false
+ */
+static bool conn_acquire(struct t_mpd_worker_conn *pooled, struct t_partition_state *partition_state, bool stickerdb) {
+    if (pooled->conn != NULL) {
+        if (time(NULL) - pooled->last_used < MPD_WORKER_CONN_REUSE &&
+            pooled->port == partition_state->mpd_state->mpd_port &&
+            strcmp(pooled->host, partition_state->mpd_state->mpd_host) == 0 &&
+            strcmp(pooled->pass, partition_state->mpd_state->mpd_pass) == 0)
+        {
+            MYMPD_LOG_DEBUG(partition_state->name, "Reusing pooled mpd connection");
+            partition_state->conn = pooled->conn;
+            partition_state->conn_state = MPD_CONNECTED;
+            pooled->conn = NULL;
+            if (stickerdb == true) {
+                //stickerdb_connect leaves the idle mode and checks the connection
+                return true;
+            }
+            //reapply the options, this also checks the connection
+            if (mpd_client_set_connection_options(partition_state) == true) {
+                return true;
+            }
+            mpd_client_disconnect_silent(partition_state, MPD_DISCONNECTED);
+        }
+        else {
+            conn_close(pooled);
+        }
+    }
+    if (stickerdb == true) {
+        return true;
+    }
+    return mpd_client_connect(partition_state, false);
+}
+
+/**
+ * Moves a healthy connection from the partition state back to the pool
+ * @param pooled the pooled connection
+ * @param partition_state partition state of the job
+ */
+static void conn_release(struct t_mpd_worker_conn *pooled, struct t_partition_state *partition_state) {
+    if (partition_state->conn == NULL) {
+        return;
+    }
+    if (partition_state->conn_state == MPD_CONNECTED &&
+        mpd_connection_get_error(partition_state->conn) == MPD_ERROR_SUCCESS)
+    {
+        pooled->conn = partition_state->conn;
+        pooled->host = sds_replace(pooled->host, partition_state->mpd_state->mpd_host);
+        pooled->port = partition_state->mpd_state->mpd_port;
+        pooled->pass = sds_replace(pooled->pass, partition_state->mpd_state->mpd_pass);
+        pooled->last_used = time(NULL);
+        partition_state->conn = NULL;
+        partition_state->conn_state = MPD_DISCONNECTED;
+        return;
+    }
+    mpd_client_disconnect_silent(partition_state, MPD_DISCONNECT_INSTANT);
+}
+
+/**
+ * Closes the pooled connection
+ * @param pooled the pooled connection
+ */
+static void conn_close(struct t_mpd_worker_conn *pooled) {
+    if (pooled->conn != NULL) {
+        mpd_connection_free(pooled->conn);
+        pooled->conn = NULL;
+    }
+}
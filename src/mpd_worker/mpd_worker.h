@@ -11,4 +11,7 @@
 #include "src/lib/mympd_state.h"
 
 bool mpd_worker_start(struct t_mympd_state *mympd_state, struct t_work_request *request);
+unsigned mpd_worker_queue_length(void);
+sds mpd_worker_list(sds buffer, long request_id);
+void mpd_worker_pool_stop(void);
 #endif
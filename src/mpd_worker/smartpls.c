@@ -10,10 +10,13 @@
 #include "src/lib/filehandler.h"
 #include "src/lib/jsonrpc.h"
 #include "src/lib/log.h"
+#include "src/lib/mem.h"
 #include "src/lib/sds_extras.h"
 #include "src/lib/smartpls.h"
+#include "src/lib/thread.h"
 #include "src/lib/utility.h"
 #include "src/lib/validate.h"
+#include "src/mpd_client/connection.h"
 #include "src/mpd_client/errorhandler.h"
 #include "src/mpd_client/playlists.h"
 #include "src/mpd_client/search.h"
@@ -23,20 +26,45 @@
 #include <dirent.h>
 #include <errno.h>
 #include <inttypes.h>
+#include <pthread.h>
 #include <string.h>
 
 /**
  * Private definitions
  */
+
+/**
+ * Smart playlists to update, shared by the update threads
+ */
+struct t_smartpls_queue {
+    pthread_mutex_t mutex;      //!< protects the todo list
+    struct t_list todo;         //!< smart playlists to update
+    struct t_list *playlists;   //!< snapshot of all playlists with their mtime, read only
+    time_t db_mtime;            //!< last modification time of the database
+};
+
+/**
+ * Additional thread to update smart playlists
+ */
+struct t_smartpls_thread {
+    pthread_t thread;                             //!< thread id
+    struct t_mpd_worker_state *mpd_worker_state;  //!< copy of the mpd_worker_state with own connections
+    struct t_smartpls_queue *queue;               //!< the shared queue
+};
+
+static void mpd_worker_smartpls_update_queue(struct t_mpd_worker_state *mpd_worker_state,
+        struct t_smartpls_queue *queue);
+static void *mpd_worker_smartpls_update_thread(void *arg);
+static bool mpd_worker_smartpls_update_playlist(struct t_mpd_worker_state *mpd_worker_state, const char *playlist,
+        struct t_list *playlists, time_t db_mtime);
 static bool mpd_worker_smartpls_per_tag(struct t_mpd_worker_state *mpd_worker_state);
-static bool mpd_worker_smartpls_delete(struct t_mpd_worker_state *mpd_worker_state,
-        const char *playlist);
-static bool mpd_worker_smartpls_update_search(struct t_mpd_worker_state *mpd_worker_state,
-        const char *playlist, const char *expression, const char *sort, bool sortdesc);
-static bool mpd_worker_smartpls_update_sticker_ge(struct t_mpd_worker_state *mpd_worker_state,
-        const char *playlist, const char *sticker, int maxentries, int minvalue);
-static bool mpd_worker_smartpls_update_newest(struct t_mpd_worker_state *mpd_worker_state,
-        const char *playlist, int timerange, const char *sort, bool sortdesc);
+static bool mpd_worker_smartpls_rebuild(struct t_mpd_worker_state *mpd_worker_state, const char *playlist,
+        bool exists, const char *expression, const char *sort, bool sortdesc, const struct t_list *target);
+static bool mpd_worker_smartpls_edit(struct t_mpd_worker_state *mpd_worker_state, const char *playlist,
+        const char *expression, const char *sort, bool sortdesc, const struct t_list *target);
+static bool mpd_worker_smartpls_get_sticker_uris(struct t_mpd_worker_state *mpd_worker_state,
+        const char *sticker, int maxentries, int minvalue, struct t_list *uris);
+static sds mpd_worker_smartpls_get_newest_expression(struct t_mpd_worker_state *mpd_worker_state, int timerange);
 
 /**
  * Public functions
@@ -60,6 +88,18 @@ bool mpd_worker_smartpls_update_all(struct t_mpd_worker_state *mpd_worker_state,
     time_t db_mtime = mpd_client_get_db_mtime(mpd_worker_state->partition_state);
     MYMPD_LOG_DEBUG(NULL, "Database mtime: %lld", (long long)db_mtime);
 
+    // one snapshot of all playlists for the existence and mtime checks
+    struct t_list playlists;
+    list_init(&playlists);
+    if (mpd_client_get_all_playlists_mtime(mpd_worker_state->partition_state, &playlists, NULL) == false) {
+        list_clear(&playlists);
+        return false;
+    }
+    struct t_smartpls_queue queue;
+    list_init(&queue.todo);
+    queue.playlists = &playlists;
+    queue.db_mtime = db_mtime;
+
     sds dirname = sdscatfmt(sdsempty(), "%S/%s", mpd_worker_state->config->workdir, DIR_WORK_SMARTPLS);
     errno = 0;
     DIR *dir = opendir (dirname);
@@ -67,24 +107,26 @@ bool mpd_worker_smartpls_update_all(struct t_mpd_worker_state *mpd_worker_state,
         MYMPD_LOG_ERROR(NULL, "Can't open smart playlist directory \"%s\"", dirname);
         MYMPD_LOG_ERRNO(NULL, errno);
         FREE_SDS(dirname);
+        list_clear(&playlists);
         return false;
     }
     struct dirent *next_file;
-    int updated = 0;
     int skipped = 0;
     while ((next_file = readdir(dir)) != NULL) {
         if (next_file->d_type != DT_REG) {
             continue;
         }
-        time_t playlist_mtime = mpd_client_get_playlist_mtime(mpd_worker_state->partition_state, next_file->d_name);
+        struct t_list_node *node = list_get_node(&playlists, next_file->d_name);
+        time_t playlist_mtime = node != NULL
+            ? (time_t)node->value_i
+            : 0;
         time_t smartpls_mtime = smartpls_get_mtime(mpd_worker_state->config->workdir, next_file->d_name);
         MYMPD_LOG_DEBUG(NULL, "Playlist %s: playlist mtime %lld, smartpls mtime %lld", next_file->d_name, (long long)playlist_mtime, (long long)smartpls_mtime);
         if (force == true ||
             db_mtime > playlist_mtime ||
             smartpls_mtime > playlist_mtime)
         {
-            mpd_worker_smartpls_update(mpd_worker_state, next_file->d_name);
-            updated++;
+            list_push(&queue.todo, next_file->d_name, 0, NULL, NULL);
         }
         else {
             MYMPD_LOG_INFO(NULL, "Update of smart playlist %s skipped, already up to date", next_file->d_name);
@@ -93,7 +135,39 @@ bool mpd_worker_smartpls_update_all(struct t_mpd_worker_state *mpd_worker_state,
     }
     closedir (dir);
     FREE_SDS(dirname);
-    MYMPD_LOG_NOTICE(NULL, "%d smart playlists updated, %d already up-to-date", updated, skipped);
+    long updated = queue.todo.length;
+
+    // distribute the smart playlists across additional mpd connections
+    unsigned threads_len = (unsigned)mpd_worker_state->config->smartpls_threads;
+    if ((long)threads_len > updated) {
+        threads_len = (unsigned)updated;
+    }
+    struct t_smartpls_thread *threads = NULL;
+    unsigned started = 0;
+    pthread_mutex_init(&queue.mutex, NULL);
+    if (threads_len > 1) {
+        threads = malloc_assert(sizeof(struct t_smartpls_thread) * (threads_len - 1));
+        for (unsigned i = 0; i < threads_len - 1; i++) {
+            threads[started].mpd_worker_state = mpd_worker_state_dup(mpd_worker_state);
+            threads[started].queue = &queue;
+            if (pthread_create(&threads[started].thread, NULL, mpd_worker_smartpls_update_thread, &threads[started]) != 0) {
+                MYMPD_LOG_ERROR(NULL, "Can not create smart playlist update thread");
+                mpd_worker_state_free(threads[started].mpd_worker_state);
+                break;
+            }
+            started++;
+        }
+        MYMPD_LOG_DEBUG(NULL, "Updating %ld smart playlists with %u connections", updated, started + 1);
+    }
+    // this thread works with the connection of the job
+    mpd_worker_smartpls_update_queue(mpd_worker_state, &queue);
+    for (unsigned i = 0; i < started; i++) {
+        pthread_join(threads[i].thread, NULL);
+    }
+    FREE_PTR(threads);
+    pthread_mutex_destroy(&queue.mutex);
+    list_clear(&playlists);
+    MYMPD_LOG_NOTICE(NULL, "%ld smart playlists updated, %d already up-to-date", updated, skipped);
     return true;
 }
 
@@ -108,7 +182,74 @@ bool mpd_worker_smartpls_update(struct t_mpd_worker_state *mpd_worker_state, con
         MYMPD_LOG_WARN(NULL, "Playlists are disabled");
         return true;
     }
+    time_t db_mtime = mpd_client_get_db_mtime(mpd_worker_state->partition_state);
+    struct t_list playlists;
+    list_init(&playlists);
+    bool rc = mpd_client_get_all_playlists_mtime(mpd_worker_state->partition_state, &playlists, NULL) &&
+        mpd_worker_smartpls_update_playlist(mpd_worker_state, playlist, &playlists, db_mtime);
+    list_clear(&playlists);
+    return rc;
+}
 
+/**
+ * Private functions
+ */
+
+/**
+ * Updates the smart playlists from the queue until it is empty
+ * @param mpd_worker_state pointer to the t_mpd_worker_state struct
+ * @param queue the shared queue
+ */
+static void mpd_worker_smartpls_update_queue(struct t_mpd_worker_state *mpd_worker_state,
+        struct t_smartpls_queue *queue)
+{
+    while (true) {
+        pthread_mutex_lock(&queue->mutex);
+        struct t_list_node *current = list_shift_first(&queue->todo);
+        pthread_mutex_unlock(&queue->mutex);
+        if (current == NULL) {
+            return;
+        }
+        mpd_worker_smartpls_update_playlist(mpd_worker_state, current->key, queue->playlists, queue->db_mtime);
+        list_node_free(current);
+    }
+}
+
+/**
+ * Main function of the additional smart playlist update threads.
+ * Connects to mpd and updates smart playlists from the queue.
+ * @param arg void pointer to the t_smartpls_thread struct
+ * @return NULL
+ */
+static void *mpd_worker_smartpls_update_thread(void *arg) {
+    thread_logname = sds_replace(thread_logname, "smartpls");
+    set_threadname(thread_logname);
+    struct t_smartpls_thread *thread = (struct t_smartpls_thread *) arg;
+    struct t_mpd_worker_state *mpd_worker_state = thread->mpd_worker_state;
+    if (mpd_client_connect(mpd_worker_state->partition_state, false) == true) {
+        mpd_worker_smartpls_update_queue(mpd_worker_state, thread->queue);
+    }
+    else {
+        MYMPD_LOG_ERROR(NULL, "Can not connect to MPD, leaving the smart playlists to the other connections");
+    }
+    mpd_client_disconnect_silent(mpd_worker_state->partition_state, MPD_DISCONNECTED);
+    mpd_client_disconnect_silent(mpd_worker_state->stickerdb, MPD_DISCONNECTED);
+    mpd_worker_state_free(mpd_worker_state);
+    FREE_SDS(thread_logname);
+    return NULL;
+}
+
+/**
+ * Updates a smart playlist by applying the minimal edits to the existing playlist
+ * @param mpd_worker_state pointer to the t_mpd_worker_state struct
+ * @param playlist smart playlist to update
+ * @param playlists snapshot of all playlists with their mtime
+ * @param db_mtime last modification time of the database
+ * @return true on success, else false
+ */
+static bool mpd_worker_smartpls_update_playlist(struct t_mpd_worker_state *mpd_worker_state, const char *playlist,
+        struct t_list *playlists, time_t db_mtime)
+{
     sds filename = sdscatfmt(sdsempty(), "%S/%s/%s", mpd_worker_state->config->workdir, DIR_WORK_SMARTPLS, playlist);
     sds content = sdsempty();
     int rc_get = sds_getfile(&content, filename, SMARTPLS_SIZE_MAX, true, true);
@@ -139,11 +280,16 @@ bool mpd_worker_smartpls_update(struct t_mpd_worker_state *mpd_worker_state, con
     {
         json_get_bool(content, "$.sortdesc", &sortdesc, NULL);
     }
+    bool shuffle = strcmp(sort, "shuffle") == 0;
+    const char *r_sort = shuffle == true
+        ? NULL
+        : sort;
 
-    // delete existing mpd playlist
-    mpd_worker_smartpls_delete(mpd_worker_state, playlist);
-
-    // recreate the mpd playlist
+    // search and newest smart playlists are defined by an expression,
+    // the songs of sticker smart playlists are fetched directly
+    struct t_list target;
+    list_init(&target);
+    sds expression = NULL;
     if (strcmp(smartpltype, "sticker") == 0 &&
         mpd_worker_state->mpd_state->feat_stickers == true)
     {
@@ -151,10 +297,7 @@ bool mpd_worker_smartpls_update(struct t_mpd_worker_state *mpd_worker_state, con
             json_get_int(content, "$.maxentries", 0, MPD_PLAYLIST_LENGTH_MAX, &int_buf1, NULL) == true &&
             json_get_int(content, "$.minvalue", 0, 100, &int_buf2, NULL) == true)
         {
-            rc = mpd_worker_smartpls_update_sticker_ge(mpd_worker_state, playlist, sds_buf1, int_buf1, int_buf2);
-            if (rc == false) {
-                MYMPD_LOG_ERROR(NULL, "Update of smart playlist \"%s\" (sticker) failed.", playlist);
-            }
+            rc = mpd_worker_smartpls_get_sticker_uris(mpd_worker_state, sds_buf1, int_buf1, int_buf2, &target);
         }
         else {
             MYMPD_LOG_ERROR(NULL, "Can't parse smart playlist file \"%s\" (sticker)", filename);
@@ -163,10 +306,8 @@ bool mpd_worker_smartpls_update(struct t_mpd_worker_state *mpd_worker_state, con
     }
     else if (strcmp(smartpltype, "newest") == 0) {
         if (json_get_int(content, "$.timerange", 0, JSONRPC_INT_MAX, &int_buf1, NULL) == true) {
-            rc = mpd_worker_smartpls_update_newest(mpd_worker_state, playlist, int_buf1, sort, sortdesc);
-            if (rc == false) {
-                MYMPD_LOG_ERROR(NULL, "Update of smart playlist \"%s\" failed (newest)", playlist);
-            }
+            expression = mpd_worker_smartpls_get_newest_expression(mpd_worker_state, int_buf1);
+            rc = expression != NULL;
         }
         else {
             MYMPD_LOG_ERROR(NULL, "Can't parse smart playlist file \"%s\" (newest)", filename);
@@ -174,26 +315,72 @@ bool mpd_worker_smartpls_update(struct t_mpd_worker_state *mpd_worker_state, con
         }
     }
     else if (strcmp(smartpltype, "search") == 0) {
-        if (json_get_string(content, "$.expression", 1, 200, &sds_buf1, vcb_isname, NULL) == true) {
-            rc = mpd_worker_smartpls_update_search(mpd_worker_state, playlist, sds_buf1, sort, sortdesc);
-            if (rc == false) {
-                MYMPD_LOG_ERROR(NULL, "Update of smart playlist \"%s\" (search) failed", playlist);
-            }
-        }
-        else {
+        if (json_get_string(content, "$.expression", 1, 200, &expression, vcb_isname, NULL) == false) {
             MYMPD_LOG_ERROR(NULL, "Can't parse smart playlist file \"%s\" (search)", filename);
             rc = false;
         }
     }
+    else {
+        // do not empty sticker smart playlists if stickers are not supported
+        MYMPD_LOG_WARN(NULL, "Skipping update of smart playlist \"%s\" (%s)", playlist, smartpltype);
+        rc = false;
+    }
+
     if (rc == true) {
-        if (strcmp(sort, "shuffle") == 0) {
-            rc = mpd_client_playlist_shuffle(mpd_worker_state->partition_state, playlist, NULL);
+        struct t_list_node *node = list_get_node(playlists, playlist);
+        bool exists = node != NULL;
+        // only sticker based smart playlists must be sorted after creation
+        bool sort_after = expression == NULL &&
+            sort[0] != '\0';
+        if (exists == false ||
+            shuffle == true)
+        {
+            rc = mpd_worker_smartpls_rebuild(mpd_worker_state, playlist, exists, expression, r_sort, sortdesc, &target);
+            if (rc == true &&
+                shuffle == true)
+            {
+                rc = mpd_client_playlist_shuffle(mpd_worker_state->partition_state, playlist, NULL);
+            }
+            else if (rc == true &&
+                sort_after == true)
+            {
+                rc = mpd_client_playlist_sort(mpd_worker_state->partition_state, playlist, sort, sortdesc, NULL);
+            }
         }
-        else if (strcmp(smartpltype, "sticker") == 0) {
-            // only sticker based smart playlists must be sorted after creation
-            rc = mpd_client_playlist_sort(mpd_worker_state->partition_state, playlist, sort, sortdesc, NULL);
+        else if (sort_after == true) {
+            // the sort order can only change with the songs, the tags or the definition
+            time_t smartpls_mtime = smartpls_get_mtime(mpd_worker_state->config->workdir, playlist);
+            struct t_list current;
+            list_init(&current);
+            rc = mpd_client_get_playlist_uris(mpd_worker_state->partition_state, playlist, &current, NULL);
+            if (rc == true &&
+                (db_mtime > node->value_i ||
+                 smartpls_mtime > node->value_i ||
+                 playlist_same_songs(&current, &target) == false))
+            {
+                rc = mpd_worker_smartpls_rebuild(mpd_worker_state, playlist, exists, NULL, NULL, false, &target) &&
+                    mpd_client_playlist_sort(mpd_worker_state->partition_state, playlist, sort, sortdesc, NULL);
+            }
+            list_clear(&current);
+        }
+        else {
+            // the result of the expression is needed to diff it against the playlist
+            if (expression != NULL) {
+                rc = mpd_client_search_uris(mpd_worker_state->partition_state, expression, r_sort, sortdesc, &target, NULL);
+            }
+            if (rc == true) {
+                rc = mpd_worker_smartpls_edit(mpd_worker_state, playlist, expression, r_sort, sortdesc, &target);
+            }
         }
     }
+    if (rc == true) {
+        MYMPD_LOG_INFO(NULL, "Updated smart playlist \"%s\"", playlist);
+    }
+    else {
+        MYMPD_LOG_ERROR(NULL, "Update of smart playlist \"%s\" (%s) failed", playlist, smartpltype);
+    }
+    list_clear(&target);
+    FREE_SDS(expression);
     FREE_SDS(smartpltype);
     FREE_SDS(sds_buf1);
     FREE_SDS(content);
@@ -202,10 +389,6 @@ bool mpd_worker_smartpls_update(struct t_mpd_worker_state *mpd_worker_state, con
     return rc;
 }
 
-/**
- * Private functions
- */
-
 /**
  * Generates smart playlists for tag values, e.g. one smart playlist for each genre
  * @param mpd_worker_state pointer to the t_mpd_worker_state struct
@@ -267,80 +450,106 @@ static bool mpd_worker_smartpls_per_tag(struct t_mpd_worker_state *mpd_worker_st
 }
 
 /**
- * Deletes playlists if it exists
+ * Recreates a playlist from scratch.
+ * Smart playlists with an expression are rebuilt with searchaddpl on the server side.
  * @param mpd_worker_state pointer to the t_mpd_worker_state struct
- * @param playlist playlist to update
+ * @param playlist playlist to rebuild
+ * @param exists true if the playlist exists
+ * @param expression mpd search expression, NULL to add the songs from target
+ * @param sort sort by tag, only used for expression
+ * @param sortdesc sort descending?, only used for expression
+ * @param target list of the song uris, only used if expression is NULL
  * @return true on success, else false
  */
-static bool mpd_worker_smartpls_delete(struct t_mpd_worker_state *mpd_worker_state, const char *playlist) {
-    struct mpd_playlist *pl;
-    bool exists = false;
-
-    //first check if playlist exists
-    if (mpd_send_list_playlists(mpd_worker_state->partition_state->conn)) {
-        while ((pl = mpd_recv_playlist(mpd_worker_state->partition_state->conn)) != NULL) {
-            const char *plpath = mpd_playlist_get_path(pl);
-            if (strcmp(playlist, plpath) == 0) {
-                exists = true;
-            }
-            mpd_playlist_free(pl);
-            if (exists == true) {
-                break;
-            }
+static bool mpd_worker_smartpls_rebuild(struct t_mpd_worker_state *mpd_worker_state, const char *playlist,
+        bool exists, const char *expression, const char *sort, bool sortdesc, const struct t_list *target)
+{
+    if (exists == true) {
+        mpd_run_rm(mpd_worker_state->partition_state->conn, playlist);
+        if (mympd_check_error_and_recover(mpd_worker_state->partition_state, NULL, "mpd_run_rm") == false) {
+            return false;
         }
     }
-    mpd_response_finish(mpd_worker_state->partition_state->conn);
-    if (mympd_check_error_and_recover(mpd_worker_state->partition_state, NULL, "mpd_send_list_playlists") == false) {
-        return false;
+    sds error = sdsempty();
+    bool rc;
+    if (expression != NULL) {
+        rc = mpd_client_search_add_to_plist(mpd_worker_state->partition_state, expression,
+            playlist, UINT_MAX, sort, sortdesc, &error);
     }
-
-    //delete playlist if exists
-    if (exists == true) {
-        mpd_run_rm(mpd_worker_state->partition_state->conn, playlist);
-        return mympd_check_error_and_recover(mpd_worker_state->partition_state, NULL, "mpd_run_rm");
+    else {
+        // diffing against an empty playlist appends all songs
+        struct t_list current;
+        list_init(&current);
+        struct t_playlist_edits edits;
+        playlist_edits_init(&edits);
+        playlist_diff(&current, target, SIZE_MAX, &edits);
+        rc = mpd_client_playlist_apply_edits(mpd_worker_state->partition_state, playlist, &edits, 0, &error);
+        playlist_edits_clear(&edits);
     }
-    return true;
+    if (rc == false) {
+        MYMPD_LOG_ERROR(NULL, "Rebuilding smart playlist \"%s\" failed: %s", playlist, error);
+    }
+    FREE_SDS(error);
+    return rc;
 }
 
 /**
- * Updates a search based smart playlist
+ * Transforms an existing playlist into the target with minimal edits.
+ * Positional edits rewrite the playlist file in MPD, therefore
+ * the playlist is rebuilt if too many edits are needed.
  * @param mpd_worker_state pointer to the t_mpd_worker_state struct
- * @param playlist playlist to updaate
- * @param expression mpd search expression
- * @param sort sort by tag
- * @param sortdesc sort descending?
+ * @param playlist playlist to update
+ * @param expression mpd search expression of the smart playlist or NULL
+ * @param sort sort by tag, only used for expression
+ * @param sortdesc sort descending?, only used for expression
+ * @param target list of the song uris
  * @return true on success, else false
  */
-static bool mpd_worker_smartpls_update_search(struct t_mpd_worker_state *mpd_worker_state,
-        const char *playlist, const char *expression, const char *sort, bool sortdesc)
+static bool mpd_worker_smartpls_edit(struct t_mpd_worker_state *mpd_worker_state, const char *playlist,
+        const char *expression, const char *sort, bool sortdesc, const struct t_list *target)
 {
-    sds error = sdsempty();
-    const char *r_sort = strcmp(sort, "shuffle") == 0
-        ? NULL
-        : sort;
-    bool rc = mpd_client_search_add_to_plist(mpd_worker_state->partition_state,
-        expression, playlist, UINT_MAX, r_sort, sortdesc, &error);
-    if (rc == true) {
-        MYMPD_LOG_INFO(NULL, "Updated smart playlist \"%s\"", playlist);
+    struct t_list current;
+    list_init(&current);
+    if (mpd_client_get_playlist_uris(mpd_worker_state->partition_state, playlist, &current, NULL) == false) {
+        list_clear(&current);
+        return false;
+    }
+    size_t max_edits = (size_t)target->length / 2 + 1;
+    if (max_edits > SMARTPLS_EDITS_MAX) {
+        max_edits = SMARTPLS_EDITS_MAX;
+    }
+    struct t_playlist_edits edits;
+    playlist_edits_init(&edits);
+    bool rc;
+    if (playlist_diff(&current, target, max_edits, &edits) == true) {
+        MYMPD_LOG_DEBUG(NULL, "Applying %lu edits to smart playlist \"%s\"", (unsigned long)edits.len, playlist);
+        sds error = sdsempty();
+        rc = mpd_client_playlist_apply_edits(mpd_worker_state->partition_state, playlist, &edits, current.length, &error);
+        if (rc == false) {
+            MYMPD_LOG_ERROR(NULL, "Editing smart playlist \"%s\" failed: %s", playlist, error);
+        }
+        FREE_SDS(error);
     }
     else {
-        MYMPD_LOG_ERROR(NULL, "Updating smart playlist \"%s\" failed: %s", playlist, error);
+        MYMPD_LOG_DEBUG(NULL, "Too many changes for smart playlist \"%s\", rebuilding it", playlist);
+        rc = mpd_worker_smartpls_rebuild(mpd_worker_state, playlist, true, expression, sort, sortdesc, target);
     }
-    FREE_SDS(error);
+    playlist_edits_clear(&edits);
+    list_clear(&current);
     return rc;
 }
 
 /**
- * Updates a sticker based smart playlist (numeric stickers only)
+ * Gets the songs for a sticker based smart playlist (numeric stickers only)
  * @param mpd_worker_state pointer to the t_mpd_worker_state struct
- * @param playlist playlist to update
  * @param sticker sticker evaluate
  * @param maxentries maximum entries
  * @param minvalue minimum sticker value
+ * @param uris already initialized list to populate with the song uris
  * @return true on success, else false
  */
-static bool mpd_worker_smartpls_update_sticker_ge(struct t_mpd_worker_state *mpd_worker_state,
-        const char *playlist, const char *sticker, int maxentries, int minvalue)
+static bool mpd_worker_smartpls_get_sticker_uris(struct t_mpd_worker_state *mpd_worker_state,
+        const char *sticker, int maxentries, int minvalue, struct t_list *uris)
 {
     rax *add_list = stickerdb_find_stickers_by_name(mpd_worker_state->stickerdb, sticker);
     if (add_list == NULL) {
@@ -370,50 +579,29 @@ static bool mpd_worker_smartpls_update_sticker_ge(struct t_mpd_worker_state *mpd
         MYMPD_LOG_DEBUG(NULL, "Setting minimum value to %d", value_min);
     }
 
-    int i = 0;
-    sds uri = sdsempty();
-    if (mpd_command_list_begin(mpd_worker_state->partition_state->conn, false)) {
-        raxStart(&iter, add_list);
-        raxSeek(&iter, "^", NULL, 0);
-        while (raxNext(&iter)) {
-            int data = (int)strtoimax((sds)iter.data, NULL, 10);
-            if (data >= value_min &&
-                i < maxentries)
-            {
-                uri = sds_replacelen(uri, (char *)iter.key, iter.key_len);
-                if (mpd_send_playlist_add(mpd_worker_state->partition_state->conn, playlist, uri) == false) {
-                    mympd_set_mpd_failure(mpd_worker_state->partition_state, "Error adding command to command list mpd_send_playlist_add");
-                    break;
-                }
-                i++;
-            }
+    raxStart(&iter, add_list);
+    raxSeek(&iter, "^", NULL, 0);
+    while (raxNext(&iter) &&
+        uris->length < maxentries)
+    {
+        int data = (int)strtoimax((sds)iter.data, NULL, 10);
+        if (data >= value_min) {
+            list_push_len(uris, (char *)iter.key, iter.key_len, 0, NULL, 0, NULL);
         }
-        mpd_command_list_end(mpd_worker_state->partition_state->conn);
-        raxStop(&iter);
     }
-    FREE_SDS(uri);
+    raxStop(&iter);
     stickerdb_free_find_result(add_list);
-    mpd_response_finish(mpd_worker_state->partition_state->conn);
-    if (mympd_check_error_and_recover(mpd_worker_state->partition_state, NULL, "mpd_send_playlist_add") == true) {
-        MYMPD_LOG_INFO(NULL, "Updated smart playlist \"%s\" with %d songs, minimum value: %d",
-            playlist, i, value_min);
-        return true;
-    }
-    return false;
+    MYMPD_LOG_DEBUG(NULL, "Found %ld songs for sticker \"%s\", minimum value: %d", uris->length, sticker, value_min);
+    return true;
 }
 
 /**
- * Updates a newest song smart playlist
+ * Creates the search expression for a newest song smart playlist
  * @param mpd_worker_state pointer to the t_mpd_worker_state struct
- * @param playlist playlist to delete
  * @param timerange timerange in seconds since last database update
- * @param sort sort by tag
- * @param sortdesc sort descending?
- * @return true on success, else false
+ * @return newly allocated search expression or NULL on error
  */
-static bool mpd_worker_smartpls_update_newest(struct t_mpd_worker_state *mpd_worker_state,
-        const char *playlist, int timerange, const char *sort, bool sortdesc)
-{
+static sds mpd_worker_smartpls_get_newest_expression(struct t_mpd_worker_state *mpd_worker_state, int timerange) {
     unsigned long value_max = 0;
     struct mpd_stats *stats = mpd_run_stats(mpd_worker_state->partition_state->conn);
     if (stats != NULL) {
@@ -422,31 +610,14 @@ static bool mpd_worker_smartpls_update_newest(struct t_mpd_worker_state *mpd_wor
     }
     mpd_response_finish(mpd_worker_state->partition_state->conn);
     if (mympd_check_error_and_recover(mpd_worker_state->partition_state, NULL, "mpd_run_stats") == false) {
-        return false;
+        return NULL;
     }
 
     //prevent overflow
     if (timerange < 0 ||
         (unsigned long)timerange > value_max) {
-        return false;
+        return NULL;
     }
     value_max = value_max - (unsigned long)timerange;
-
-    sds error = sdsempty();
-    const char *r_sort = strcmp(sort, "shuffle") == 0
-        ? NULL
-        : sort;
-    sds expression = sdscatfmt(sdsempty(), "(modified-since '%U')", value_max);
-    bool rc = mpd_client_search_add_to_plist(mpd_worker_state->partition_state, expression,
-        playlist, UINT_MAX, r_sort, sortdesc, &error);
-    FREE_SDS(expression);
-    
-    if (rc == true) {
-        MYMPD_LOG_INFO(NULL, "Updated smart playlist \"%s\"", playlist);
-    }
-    else {
-        MYMPD_LOG_ERROR(NULL, "Updating smart playlist \"%s\" failed: %s", playlist, error);
-    }
-    FREE_SDS(error);
-    return rc;
+    return sdscatfmt(sdsempty(), "(modified-since '%U')", value_max);
 }
@@ -9,6 +9,74 @@
 
 #include "src/lib/mem.h"
 #include "src/lib/sds_extras.h"
+#include "src/lib/tags.h"
+
+/**
+ * Public functions
+ */
+
+/**
+ * Creates a partition state with its own mpd state for a mpd_worker connection
+ * @param mympd_state pointer to central myMPD state
+ * @param name partition name
+ * @param src mpd state to copy the settings from
+ * @param features true = copy also the feature flags and tags
+ * @return newly allocated partition state
+ */
+struct t_partition_state *mpd_worker_partition_state_new(struct t_mympd_state *mympd_state,
+        const char *name, struct t_mpd_state *src, bool features)
+{
+    struct t_partition_state *partition_state = malloc_assert(sizeof(struct t_partition_state));
+    partition_state_default(partition_state, name, mympd_state);
+    struct t_mpd_state *mpd_state = malloc_assert(sizeof(struct t_mpd_state));
+    mpd_state_default(mpd_state, mympd_state);
+    partition_state->mpd_state = mpd_state;
+    //copy the connection settings
+    mpd_state->mpd_keepalive = src->mpd_keepalive;
+    mpd_state->mpd_timeout = src->mpd_timeout;
+    mpd_state->mpd_host = sds_replace(mpd_state->mpd_host, src->mpd_host);
+    mpd_state->mpd_port = src->mpd_port;
+    mpd_state->mpd_pass = sds_replace(mpd_state->mpd_pass, src->mpd_pass);
+    if (features == false) {
+        return partition_state;
+    }
+    //copy some mpd_state settings
+    mpd_state->feat_tags = src->feat_tags;
+    mpd_state->feat_stickers = src->feat_stickers;
+    mpd_state->feat_playlists = src->feat_playlists;
+    mpd_state->feat_whence = src->feat_whence;
+    mpd_state->feat_fingerprint = src->feat_fingerprint;
+    mpd_state->feat_playlist_rm_range = src->feat_playlist_rm_range;
+    mpd_state->feat_db_added = src->feat_db_added;
+    mpd_state->tag_albumartist = src->tag_albumartist;
+    copy_tag_types(&src->tags_mympd, &mpd_state->tags_mympd);
+    copy_tag_types(&src->tags_album, &mpd_state->tags_album);
+    mpd_state->album_cache.mtime = src->album_cache.mtime;
+    return partition_state;
+}
+
+/**
+ * Copies the mpd_worker_state struct for an additional mpd connection.
+ * The copy has its own partition states and no request.
+ * @param mpd_worker_state pointer to the t_mpd_worker_state struct to copy
+ * @return newly allocated mpd_worker state
+ */
+struct t_mpd_worker_state *mpd_worker_state_dup(struct t_mpd_worker_state *mpd_worker_state) {
+    struct t_mpd_worker_state *copy = malloc_assert(sizeof(struct t_mpd_worker_state));
+    copy->request = NULL;
+    copy->smartpls = mpd_worker_state->smartpls;
+    copy->smartpls_sort = sdsdup(mpd_worker_state->smartpls_sort);
+    copy->smartpls_prefix = sdsdup(mpd_worker_state->smartpls_prefix);
+    copy->tag_disc_empty_is_first = mpd_worker_state->tag_disc_empty_is_first;
+    copy_tag_types(&mpd_worker_state->smartpls_generate_tag_types, &copy->smartpls_generate_tag_types);
+    copy->config = mpd_worker_state->config;
+    copy->partition_state = mpd_worker_partition_state_new(mpd_worker_state->partition_state->mympd_state,
+        mpd_worker_state->partition_state->name, mpd_worker_state->mpd_state, true);
+    copy->mpd_state = copy->partition_state->mpd_state;
+    copy->stickerdb = mpd_worker_partition_state_new(mpd_worker_state->stickerdb->mympd_state,
+        mpd_worker_state->stickerdb->name, mpd_worker_state->stickerdb->mpd_state, false);
+    return copy;
+}
 
 /**
  * Frees the mpd_worker_state struct
@@ -26,5 +26,8 @@ struct t_mpd_worker_state {
     struct t_partition_state *stickerdb;          //!< pointer to the partition state for stickers
 };
 
+struct t_partition_state *mpd_worker_partition_state_new(struct t_mympd_state *mympd_state,
+        const char *name, struct t_mpd_state *src, bool features);
+struct t_mpd_worker_state *mpd_worker_state_dup(struct t_mpd_worker_state *mpd_worker_state);
 void *mpd_worker_state_free(struct t_mpd_worker_state *mpd_worker_state);
 #endif
@@ -32,16 +32,16 @@
 sds mympd_api_albumart_getcover_by_album_id(struct t_partition_state *partition_state, sds buffer, long request_id,
         sds albumid, unsigned size)
 {
-    struct mpd_song *album = album_cache_get_album(&partition_state->mpd_state->album_cache, albumid);
+    struct t_album *album = album_cache_get_album(&partition_state->mpd_state->album_cache, albumid);
     if (album == NULL) {
         return jsonrpc_respond_message(buffer, INTERNAL_API_ALBUMART_BY_ALBUMID, request_id, JSONRPC_FACILITY_MPD, JSONRPC_SEVERITY_WARN, "No albumart found by mpd");
     }
 
     // check album cache for uri
-    if (strcmp(mpd_song_get_uri(album), "albumid") != 0) {
+    if (strcmp(album->uri, "albumid") != 0) {
         // uri is cached - send redirect to albumart by uri
         buffer = jsonrpc_respond_start(buffer, INTERNAL_API_ALBUMART_BY_ALBUMID, request_id);
-        buffer = tojson_char(buffer, "uri", mpd_song_get_uri(album), true);
+        buffer = tojson_char(buffer, "uri", album->uri, true);
         buffer = tojson_uint(buffer, "size", size, false);
         buffer = jsonrpc_end(buffer);
         return buffer;
@@ -71,7 +71,7 @@ sds mympd_api_albumart_getcover_by_album_id(struct t_partition_state *partition_
         buffer = tojson_uint(buffer, "size", size, false);
         buffer = jsonrpc_end(buffer);
         // update album cache with uri
-        album_cache_set_uri(album, mpd_song_get_uri(song));
+        album_cache_set_uri(&partition_state->mpd_state->album_cache, album, mpd_song_get_uri(song));
         mpd_song_free(song);
         FREE_SDS(expression);
         return buffer;
@@ -94,11 +94,12 @@ sds mympd_api_albumart_getcover_by_album_id(struct t_partition_state *partition_
  * @param buffer already allocated sds string for the jsonrpc response
  * @param request_id request id
  * @param uri uri to get cover from
+ * @param size requested albumart size
  * @param binary pointer to an already allocated sds string for the binary response
  * @return jsonrpc response
  */
 sds mympd_api_albumart_getcover_by_uri(struct t_partition_state *partition_state, sds buffer, long request_id,
-        const char *uri, sds *binary)
+        const char *uri, unsigned size, sds *binary)
 {
     unsigned offset = 0;
     void *binary_buffer = malloc_assert(partition_state->mpd_state->mpd_binarylimit);
@@ -163,6 +164,10 @@ sds mympd_api_albumart_getcover_by_uri(struct t_partition_state *partition_state
     }
     else {
         MYMPD_LOG_INFO(partition_state->name, "No albumart found by mpd for uri \"%s\"", uri);
+        if (mpd_connection_get_error(partition_state->conn) == MPD_ERROR_SUCCESS) {
+            //remember that no image is available
+            covercache_lookup_set(uri, 0, size, NULL);
+        }
         buffer = jsonrpc_respond_message(buffer, INTERNAL_API_ALBUMART_BY_URI, request_id, JSONRPC_FACILITY_MPD, JSONRPC_SEVERITY_WARN, "No albumart found by mpd");
     }
     return buffer;
@@ -12,5 +12,5 @@
 sds mympd_api_albumart_getcover_by_album_id(struct t_partition_state *partition_state, sds buffer, long request_id,
         sds albumid, unsigned size);
 sds mympd_api_albumart_getcover_by_uri(struct t_partition_state *partition_state, sds buffer, long request_id,
-        const char *uri, sds *binary);
+        const char *uri, unsigned size, sds *binary);
 #endif
@@ -44,13 +44,13 @@ sds mympd_api_browse_album_detail(struct t_partition_state *partition_state, sds
 {
     enum mympd_cmd_ids cmd_id = MYMPD_API_DATABASE_ALBUM_DETAIL;
 
-    struct mpd_song *mpd_album = album_cache_get_album(&partition_state->mpd_state->album_cache, albumid);
-    if (mpd_album == NULL) {
+    struct t_album *album = album_cache_get_album(&partition_state->mpd_state->album_cache, albumid);
+    if (album == NULL) {
         return jsonrpc_respond_message(buffer, cmd_id, request_id,
             JSONRPC_FACILITY_DATABASE, JSONRPC_SEVERITY_ERROR, "Could not find album");
     }
 
-    sds expression = get_search_expression_album(partition_state->mpd_state->tag_albumartist, mpd_album,
+    sds expression = get_search_expression_album(partition_state->mpd_state->tag_albumartist, album,
         &partition_state->mympd_state->config->albums);
 
     if (mpd_search_db_songs(partition_state->conn, true) == false ||
@@ -70,9 +70,9 @@ sds mympd_api_browse_album_detail(struct t_partition_state *partition_state, sds
     sds last_played_song_uri = sdsempty();
     if (partition_state->mympd_state->config->albums.mode == ALBUM_MODE_SIMPLE) {
         // reset album values for simple album mode
-        album_cache_set_total_time(mpd_album, 0);
-        album_cache_set_disc_count(mpd_album, 0);
-        album_cache_set_song_count(mpd_album, 0);
+        album->duration = 0;
+        album->discs = 0;
+        album->songs = 0;
     }
     if (mpd_search_commit(partition_state->conn)) {
         buffer = jsonrpc_respond_start(buffer, cmd_id, request_id);
@@ -82,7 +82,7 @@ sds mympd_api_browse_album_detail(struct t_partition_state *partition_state, sds
         if (partition_state->mpd_state->feat_stickers == true &&
             tagcols->stickers_len > 0)
         {
-            stickerdb_exit_idle(partition_state->mympd_state->stickerdb);
+            stickerdb_batch_start(partition_state->mympd_state->stickerdb);
         }
         while ((song = mpd_recv_song(partition_state->conn)) != NULL) {
             if (entities_returned++) {
@@ -110,9 +110,15 @@ sds mympd_api_browse_album_detail(struct t_partition_state *partition_state, sds
             buffer = sdscatlen(buffer, "}", 1);
             if (partition_state->mympd_state->config->albums.mode == ALBUM_MODE_SIMPLE) {
                 // calculate some album values for simple album mode
-                album_cache_inc_total_time(mpd_album, song);
-                album_cache_set_discs(mpd_album, song);
-                album_cache_inc_song_count(mpd_album);
+                album->duration += mpd_song_get_duration(song);
+                const char *disc = mpd_song_get_tag(song, MPD_TAG_DISC, 0);
+                if (disc != NULL) {
+                    unsigned d = (unsigned)strtoumax(disc, NULL, 10);
+                    if (d > album->discs) {
+                        album->discs = d;
+                    }
+                }
+                album->songs++;
             }
             mpd_song_free(song);
         }
@@ -121,7 +127,7 @@ sds mympd_api_browse_album_detail(struct t_partition_state *partition_state, sds
     if (partition_state->mpd_state->feat_stickers == true &&
         tagcols->stickers_len > 0)
     {
-        stickerdb_enter_idle(partition_state->mympd_state->stickerdb);
+        stickerdb_batch_end(partition_state->mympd_state->stickerdb);
     }
     if (mympd_check_error_and_recover_respond(partition_state, &buffer, cmd_id, request_id, "mpd_search_commit") == false) {
         FREE_SDS(first_song_uri);
@@ -133,7 +139,7 @@ sds mympd_api_browse_album_detail(struct t_partition_state *partition_state, sds
     buffer = mympd_api_get_extra_media(partition_state->mpd_state, buffer, first_song_uri, false);
     buffer = sdscatlen(buffer, ",", 1);
     buffer = tojson_int(buffer, "returnedEntities", entities_returned, true);
-    buffer = print_album_tags(buffer, &partition_state->mpd_state->tags_album, mpd_album, &partition_state->mympd_state->config->albums);
+    buffer = print_album_tags(buffer, &partition_state->mpd_state->tags_album, album);
     buffer = sdscat(buffer, ",\"lastPlayedSong\":{");
     buffer = tojson_time(buffer, "time", last_played_max, true);
     buffer = tojson_sds(buffer, "uri", last_played_song_uri, false);
@@ -190,50 +196,16 @@ sds mympd_api_browse_album_list(struct t_partition_state *partition_state, sds b
         }
     }
     //parse mpd search expression
-    struct t_list *expr_list = parse_search_expression_to_list(expression);
-    
-    //search and sort albumlist
-    long real_limit = offset + limit;
-    rax *albums = raxNew();
-    raxIterator iter;
-    raxStart(&iter, partition_state->mpd_state->album_cache.cache);
-    raxSeek(&iter, "^", NULL, 0);
-    sds key = sdsempty();
-    while (raxNext(&iter)) {
-        struct mpd_song *album = (struct mpd_song *)iter.data;
-        if (expr_list->length == 0 ||
-            search_song_expression(album, expr_list, &partition_state->mpd_state->tags_browse) == true)
-        {
-            if (sort_by_last_modified == true) {
-                key = sdscatprintf(key, "%020lld::%s", (long long)mpd_song_get_last_modified(album), mpd_song_get_uri(album));
-            }
-            else {
-                key = mpd_client_get_tag_value_string(album, sort_tag, key);
-                if (sdslen(key) > 0) {
-                    key = sdscatfmt(key, "::%s", mpd_song_get_uri(album));
-                }
-                else {
-                    //sort tag not present, append to end of the list
-                    MYMPD_LOG_WARN(partition_state->name, "Sort tag \"%s\" not set for \"%.*s\"", mpd_tag_name(sort_tag), (int)iter.key_len, (char *)iter.key);
-                    key = sdscatfmt(key, "zzzzzzzzzz::%s", mpd_song_get_uri(album));
-                }
-            }
-            sds_utf8_tolower(key);
-            while (raxTryInsert(albums, (unsigned char*)key, sdslen(key), iter.data, NULL) == 0) {
-                //duplicate - add chars until it is uniq
-                key = sdscatlen(key, ":", 1);
-            }
-            sdsclear(key);
-        }
-    }
-    raxStop(&iter);
-    free_search_expression_list(expr_list);
-    FREE_SDS(key);
+    struct t_search_filter *filter = search_filter_cache_get(partition_state->mpd_state->search_filter_cache, expression);
 
-    //print album list
+    //walk the sort index and filter the albums
+    rax *sort_index = album_cache_get_sort_index(&partition_state->mpd_state->album_cache,
+        (sort_by_last_modified == true ? MPD_TAG_UNKNOWN : sort_tag));
+    long real_limit = offset + limit;
     long entity_count = 0;
     long entities_returned = 0;
-    raxStart(&iter, albums);
+    raxIterator iter;
+    raxStart(&iter, sort_index);
     int (*iterator)(struct raxIterator *iter);
     if (sortdesc == false) {
         raxSeek(&iter, "^", NULL, 0);
@@ -244,26 +216,37 @@ sds mympd_api_browse_album_list(struct t_partition_state *partition_state, sds b
         iterator = &raxPrev;
     }
     while (iterator(&iter)) {
-        if (entity_count >= offset) {
+        struct t_album *album = (struct t_album *)iter.data;
+        if (filter->root != NULL &&
+            search_album_expression(album, filter, &partition_state->mpd_state->tags_browse) == false)
+        {
+            continue;
+        }
+        if (entity_count >= offset &&
+            entity_count < real_limit)
+        {
             if (entities_returned++) {
                 buffer = sdscatlen(buffer, ",", 1);
             }
-            struct mpd_song *album = (struct mpd_song *)iter.data;
             buffer = sdscat(buffer, "{\"Type\": \"album\",");
-            buffer = print_album_tags(buffer, tagcols, album, &partition_state->mympd_state->config->albums);
+            buffer = print_album_tags(buffer, tagcols, album);
             buffer = sdscatlen(buffer, ",", 1);
-            buffer = tojson_char(buffer, "FirstSongUri", mpd_song_get_uri(album), false);
+            buffer = tojson_char(buffer, "FirstSongUri", album->uri, false);
             buffer = sdscatlen(buffer, "}", 1);
         }
         entity_count++;
-        if (entity_count == real_limit) {
+        if (entity_count == real_limit &&
+            filter->root == NULL)
+        {
+            //without filter the total is the size of the index
+            entity_count = (long)sort_index->numele;
             break;
         }
     }
     raxStop(&iter);
 
     buffer = sdscatlen(buffer, "],", 2);
-    buffer = tojson_llong(buffer, "totalEntities", (long long)albums->numele, true);
+    buffer = tojson_long(buffer, "totalEntities", entity_count, true);
     buffer = tojson_long(buffer, "returnedEntities", entities_returned, true);
     buffer = tojson_long(buffer, "offset", offset, true);
     buffer = tojson_sds(buffer, "expression", expression, true);
@@ -271,7 +254,6 @@ sds mympd_api_browse_album_list(struct t_partition_state *partition_state, sds b
     buffer = tojson_bool(buffer, "sortdesc", sortdesc, true);
     buffer = tojson_char(buffer, "tag", "Album", false);
     buffer = jsonrpc_end(buffer);
-    raxFree(albums);
     return buffer;
 }
 
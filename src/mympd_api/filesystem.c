@@ -129,7 +129,7 @@ sds mympd_api_browse_filesystem(struct t_partition_state *partition_state, sds b
     if (partition_state->mpd_state->feat_stickers == true &&
         tagcols->stickers_len > 0)
     {
-        stickerdb_exit_idle(partition_state->mympd_state->stickerdb);
+        stickerdb_batch_start(partition_state->mympd_state->stickerdb);
     }
     while (raxNext(&iter)) {
         struct t_dir_entry *entry_data = (struct t_dir_entry *)iter.data;
@@ -189,7 +189,7 @@ sds mympd_api_browse_filesystem(struct t_partition_state *partition_state, sds b
     if (partition_state->mpd_state->feat_stickers == true &&
         tagcols->stickers_len > 0)
     {
-        stickerdb_enter_idle(partition_state->mympd_state->stickerdb);
+        stickerdb_batch_end(partition_state->mympd_state->stickerdb);
     }
     buffer = sdscatlen(buffer, "],", 2);
     buffer = mympd_api_get_extra_media(partition_state->mpd_state, buffer, path, true);
@@ -75,7 +75,7 @@ sds mympd_api_jukebox_list(struct t_partition_state *partition_state, sds buffer
     long entities_returned = 0;
     long entities_found = 0;
     long real_limit = offset + limit;
-    struct t_list *expr_list = parse_search_expression_to_list(expression);
+    struct t_search_filter *filter = search_filter_cache_get(partition_state->mpd_state->search_filter_cache, expression);
     buffer = jsonrpc_respond_start(buffer, cmd_id, request_id);
     buffer = sdscat(buffer, "\"data\":[");
     if (partition_state->jukebox_mode == JUKEBOX_ADD_SONG) {
@@ -83,13 +83,13 @@ sds mympd_api_jukebox_list(struct t_partition_state *partition_state, sds buffer
         if (partition_state->mpd_state->feat_stickers == true &&
             tagcols->stickers_len > 0)
         {
-            stickerdb_exit_idle(partition_state->mympd_state->stickerdb);
+            stickerdb_batch_start(partition_state->mympd_state->stickerdb);
         }
         while (current != NULL) {
             if (mpd_send_list_meta(partition_state->conn, current->key)) {
                 struct mpd_song *song;
                 if ((song = mpd_recv_song(partition_state->conn)) != NULL) {
-                    if (search_song_expression(song, expr_list, tagcols) == true) {
+                    if (search_song_expression(song, filter, tagcols) == true) {
                         if (entities_found >= offset &&
                             entities_found < real_limit)
                         {
@@ -119,14 +119,14 @@ sds mympd_api_jukebox_list(struct t_partition_state *partition_state, sds buffer
         if (partition_state->mpd_state->feat_stickers == true &&
             tagcols->stickers_len > 0)
         {
-            stickerdb_enter_idle(partition_state->mympd_state->stickerdb);
+            stickerdb_batch_end(partition_state->mympd_state->stickerdb);
         }
     }
     else if (partition_state->jukebox_mode == JUKEBOX_ADD_ALBUM) {
         struct t_list_node *current = partition_state->jukebox_queue.head;
         while (current != NULL) {
-            struct mpd_song *album = (struct mpd_song *)current->user_data;
-            if (search_song_expression(album, expr_list, tagcols) == true) {
+            struct t_album *album = (struct t_album *)current->user_data;
+            if (search_album_expression(album, filter, tagcols) == true) {
                 if (entities_found >= offset &&
                     entities_found < real_limit)
                 {
@@ -135,7 +135,7 @@ sds mympd_api_jukebox_list(struct t_partition_state *partition_state, sds buffer
                     }
                     buffer = sdscat(buffer, "{\"Type\": \"album\",");
                     buffer = tojson_long(buffer, "Pos", entity_count, true);
-                    buffer = print_album_tags(buffer, &partition_state->mpd_state->tags_album, album, &partition_state->mympd_state->config->albums);
+                    buffer = print_album_tags(buffer, &partition_state->mpd_state->tags_album, album);
                     buffer = sdscatlen(buffer, "}", 1);
                 }
                 entities_found++;
@@ -144,7 +144,6 @@ sds mympd_api_jukebox_list(struct t_partition_state *partition_state, sds buffer
             current = current->next;
         }
     }
-    free_search_expression_list(expr_list);
     buffer = sdscatlen(buffer, "],", 2);
     const char *jukebox_mode_str = jukebox_mode_lookup(partition_state->jukebox_mode);
     buffer = tojson_char(buffer, "jukeboxMode", jukebox_mode_str, true);
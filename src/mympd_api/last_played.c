@@ -7,6 +7,8 @@
 #include "compile_time.h"
 #include "src/mympd_api/last_played.h"
 
+#include "dist/libmympdclient/src/isong.h"
+#include "dist/rax/rax.h"
 #include "dist/sds/sds.h"
 #include "src/lib/filehandler.h"
 #include "src/lib/jsonrpc.h"
@@ -15,20 +17,52 @@
 #include "src/lib/utility.h"
 #include "src/lib/validate.h"
 #include "src/mpd_client/errorhandler.h"
+#include "src/mpd_client/playlists.h"
 #include "src/mpd_client/search_local.h"
 #include "src/mpd_client/stickerdb.h"
 #include "src/mpd_client/tags.h"
+#include "src/mpd_client/shortcuts.h"
 #include "src/mympd_api/sticker.h"
 
 #include <errno.h>
+#include <stdint.h>
 #include <string.h>
+#include <sys/stat.h>
 
 /**
  * Private definitions
  */
 
-static sds get_last_played_obj(struct t_partition_state *partition_state, sds buffer, long entity_count,
-        long long last_played, const char *uri, struct t_list *expr_list, const struct t_tags *tagcols);
+/**
+ * Last played entry waiting for the song lookup
+ */
+struct t_last_played_entry {
+    sds uri;                 //!< song uri
+    long long last_played;   //!< last played time as unix timestamp
+    long pos;                //!< position in the last played list
+};
+
+/**
+ * State of the last played list page that is printed
+ */
+struct t_last_played_page {
+    sds buffer;                         //!< jsonrpc response
+    struct t_search_filter *filter;     //!< compiled search expression
+    const struct t_tags *tagcols;       //!< columns to print
+    long offset;                        //!< offset of the page
+    long real_limit;                    //!< offset + limit
+    long entities_found;                //!< number of matching entries
+    long entities_returned;             //!< number of printed entries
+    struct t_last_played_entry entries[LAST_PLAYED_BATCH_MAX];  //!< entries for the next batch lookup
+    unsigned entries_len;               //!< number of entries in the batch
+};
+
+static bool page_add(struct t_partition_state *partition_state, struct t_last_played_page *page,
+        const char *uri, long long last_played, long pos);
+static bool page_lookup(struct t_partition_state *partition_state, struct t_last_played_page *page);
+static bool entry_is_missing(rax *missing, const struct t_last_played_entry *entry);
+static void page_print(struct t_partition_state *partition_state, struct t_last_played_page *page,
+        struct mpd_song *song, const struct t_last_played_entry *entry);
 
 /**
  * Public functions
@@ -48,6 +82,13 @@ bool mympd_api_last_played_file_save(struct t_partition_state *partition_state)
         FREE_SDS(tmp_file);
         return false;
     }
+    //the index holds the size of the last played file followed by the byte offset of each line
+    sds tmp_index_file = sdscatfmt(sdsempty(), "%S/%S/%s.XXXXXX",
+        partition_state->mympd_state->config->workdir, partition_state->state_dir, FILENAME_LAST_PLAYED_INDEX);
+    FILE *fp_index = open_tmp_file(tmp_index_file);
+    bool index_rc = fp_index != NULL &&
+        mympd_api_last_played_index_write(fp_index, 0);
+    uint64_t file_size = 0;
 
     int count = 0;
     //save last_played from mem to disc
@@ -66,6 +107,10 @@ bool mympd_api_last_played_file_save(struct t_partition_state *partition_state)
             list_node_free(current);
             break;
         }
+        if (index_rc == true) {
+            index_rc = mympd_api_last_played_index_write(fp_index, file_size);
+        }
+        file_size += sdslen(line);
         count++;
         list_node_free(current);
         sdsclear(line);
@@ -86,6 +131,10 @@ bool mympd_api_last_played_file_save(struct t_partition_state *partition_state)
                     write_rc = false;
                     break;
                 }
+                if (index_rc == true) {
+                    index_rc = mympd_api_last_played_index_write(fp_index, file_size);
+                }
+                file_size += sdslen(line);
                 count++;
             }
             (void) fclose(fi);
@@ -102,6 +151,17 @@ bool mympd_api_last_played_file_save(struct t_partition_state *partition_state)
     FREE_SDS(filepath);
     bool rc = rename_tmp_file(fp, tmp_file, write_rc);
     FREE_SDS(tmp_file);
+    if (fp_index != NULL) {
+        //write the size of the last played file to the header
+        if (index_rc == true) {
+            index_rc = fseek(fp_index, 0, SEEK_SET) == 0 &&
+                mympd_api_last_played_index_write(fp_index, file_size);
+        }
+        if (rename_tmp_file(fp_index, tmp_index_file, rc && index_rc) == false) {
+            MYMPD_LOG_WARN(partition_state->name, "Could not write last played index, falling back to sequential reads");
+        }
+    }
+    FREE_SDS(tmp_index_file);
     return rc;
 }
 
@@ -147,7 +207,10 @@ bool mympd_api_last_played_add_song(struct t_partition_state *partition_state, i
 }
 
 /**
- * Prints a jsonrpc response with the last played songs (memory and disc)
+ * Prints a jsonrpc response with the last played songs (memory and disc).
+ * The songs are looked up in batches of LAST_PLAYED_BATCH_MAX entries, each batch is sent as one command list.
+ * Without a search expression the entries before offset are skipped without lookups
+ * and the index of the last played file is used to seek to the first entry on disc.
  * @param partition_state pointer to partition state
  * @param buffer already allocated sds string to append the response
  * @param request_id jsonrpc request id
@@ -162,82 +225,96 @@ sds mympd_api_last_played_list(struct t_partition_state *partition_state, sds bu
 {
     enum mympd_cmd_ids cmd_id = MYMPD_API_LAST_PLAYED_LIST;
     long entity_count = 0;
-    long entities_returned = 0;
-    long entities_found = 0;
+    long total_entities = -1;
 
     buffer = jsonrpc_respond_start(buffer, cmd_id, request_id);
     buffer = sdscat(buffer, "\"data\":[");
-    sds obj = sdsempty();
 
-    long real_limit = offset + limit;
-    struct t_list *expr_list = parse_search_expression_to_list(expression);
-    // first get entries from memory
+    struct t_last_played_page page = {
+        .buffer = buffer,
+        .filter = search_filter_cache_get(partition_state->mpd_state->search_filter_cache, expression),
+        .tagcols = tagcols,
+        .offset = offset,
+        .real_limit = offset + limit,
+        .entities_found = 0,
+        .entities_returned = 0,
+        .entries_len = 0
+    };
+    //without a search expression each entry is found, the offset is the position in the list
+    bool seekable = page.filter->root == NULL;
     if (partition_state->mpd_state->feat_stickers == true &&
         tagcols->stickers_len > 0)
     {
-        stickerdb_exit_idle(partition_state->mympd_state->stickerdb);
+        stickerdb_batch_start(partition_state->mympd_state->stickerdb);
     }
-    if (offset < partition_state->last_played.length) {
-        struct t_list_node *current = partition_state->last_played.head;
-        while (current != NULL) {
-            obj = get_last_played_obj(partition_state, obj, entity_count, current->value_i,
-                current->key, expr_list, tagcols);
-            if (sdslen(obj) > 0) {
-                if (entities_found >= offset) {
-                    if (entities_returned++) {
-                        buffer = sdscatlen(buffer, ",", 1);
-                    }
-                    buffer = sdscatsds(buffer, obj);
-                }
-                sdsclear(obj);
-                entities_found++;
-                if (entities_returned == real_limit) {
-                    break;
-                }
-            }
-            entity_count++;
+    // first get entries from memory
+    bool more = true;
+    struct t_list_node *current = partition_state->last_played.head;
+    if (seekable == true) {
+        while (current != NULL &&
+            entity_count < offset)
+        {
             current = current->next;
+            entity_count++;
         }
+        page.entities_found = entity_count;
     }
-    else {
-        entity_count = partition_state->last_played.length;
+    while (current != NULL &&
+        more == true)
+    {
+        more = page_add(partition_state, &page, current->key, current->value_i, entity_count);
+        entity_count++;
+        current = current->next;
     }
+    entity_count = partition_state->last_played.length;
 
     // get entries from disk
-    if (entities_returned < real_limit) {
+    if (more == true) {
         sds lp_file = sdscatfmt(sdsempty(), "%S/%S/%s",
             partition_state->mympd_state->config->workdir, partition_state->state_dir, FILENAME_LAST_PLAYED);
         errno = 0;
         FILE *fp = fopen(lp_file, OPEN_FLAGS_READ);
         if (fp != NULL) {
+            long skip = 0;
+            if (seekable == true) {
+                if (offset > entity_count) {
+                    //all entries from memory were skipped
+                    skip = offset - entity_count;
+                }
+                sds index_file = sdscatfmt(sdsempty(), "%S/%S/%s",
+                    partition_state->mympd_state->config->workdir, partition_state->state_dir, FILENAME_LAST_PLAYED_INDEX);
+                long disc_count;
+                if (mympd_api_last_played_index_seek(index_file, fp, skip, &disc_count) == true) {
+                    total_entities = entity_count + disc_count;
+                    entity_count += skip;
+                    page.entities_found += skip;
+                    skip = 0;
+                }
+                FREE_SDS(index_file);
+            }
             sds line = sdsempty();
-            while (sds_getline(&line, fp, LINE_LENGTH_MAX) >= 0) {
+            while (more == true &&
+                sds_getline(&line, fp, LINE_LENGTH_MAX) >= 0)
+            {
+                if (skip > 0) {
+                    // fallback if the index is not usable
+                    skip--;
+                    entity_count++;
+                    page.entities_found++;
+                    continue;
+                }
                 sds uri = NULL;
                 long long last_played = 0;
                 if (json_get_string_max(line, "$.uri", &uri, vcb_isfilepath, NULL) == true &&
                     json_get_llong_max(line, "$.LastPlayed", &last_played, NULL) == true)
                 {
-                    obj = get_last_played_obj(partition_state, obj, entity_count, last_played, uri, expr_list, tagcols);
-                    FREE_SDS(uri);
-                    if (sdslen(obj) > 0) {
-                        if (entities_found >= offset) {
-                            if (entities_returned++) {
-                                buffer = sdscatlen(buffer, ",", 1);
-                            }
-                            buffer = sdscatsds(buffer, obj);
-                        }
-                        sdsclear(obj);
-                        entities_found++;
-                        if (entities_returned == real_limit) {
-                            break;
-                        }
-                    }
+                    more = page_add(partition_state, &page, uri, last_played, entity_count);
                 }
                 else {
                     MYMPD_LOG_ERROR(partition_state->name, "Reading last_played line failed");
                     MYMPD_LOG_DEBUG(partition_state->name, "Erroneous line: %s", line);
-                    FREE_SDS(uri);
                 }
+                FREE_SDS(uri);
                 entity_count++;
             }
             (void) fclose(fp);
@@ -249,62 +326,271 @@ sds mympd_api_last_played_list(struct t_partition_state *partition_state, sds bu
                 //ignore missing last_played file
                 MYMPD_LOG_ERRNO(partition_state->name, errno);
             }
+            if (seekable == true) {
+                total_entities = entity_count;
+            }
         }
         FREE_SDS(lp_file);
     }
-    FREE_SDS(obj);
+    // lookup the remaining entries
+    page_lookup(partition_state, &page);
     if (partition_state->mpd_state->feat_stickers == true &&
         tagcols->stickers_len > 0)
     {
-        stickerdb_enter_idle(partition_state->mympd_state->stickerdb);
+        stickerdb_batch_end(partition_state->mympd_state->stickerdb);
     }
-    free_search_expression_list(expr_list);
+    buffer = page.buffer;
     buffer = sdscatlen(buffer, "],", 2);
-    buffer = tojson_long(buffer, "totalEntities", -1, true);
+    buffer = tojson_long(buffer, "totalEntities", total_entities, true);
     buffer = tojson_long(buffer, "offset", offset, true);
-    buffer = tojson_long(buffer, "returnedEntities", entities_returned, false);
+    buffer = tojson_long(buffer, "returnedEntities", page.entities_returned, false);
     buffer = jsonrpc_end(buffer);
 
     return buffer;
 }
 
+/**
+ * Seeks the last played file to an entry with the help of the index file
+ * @param index_file path of the index file
+ * @param fp opened last played file
+ * @param entry entry to seek to, it is counted from the first line of the file
+ * @param count pointer to long to set with the number of entries in the file
+ * @return true on success, false if the index is missing or outdated
+ */
+bool mympd_api_last_played_index_seek(const char *index_file, FILE *fp, long entry, long *count) {
+    errno = 0;
+    FILE *fp_index = fopen(index_file, OPEN_FLAGS_READ_BIN);
+    if (fp_index == NULL) {
+        if (errno != ENOENT) {
+            MYMPD_LOG_ERROR(NULL, "Can not open file \"%s\"", index_file);
+            MYMPD_LOG_ERRNO(NULL, errno);
+        }
+        return false;
+    }
+    bool rc = false;
+    uint64_t file_size;
+    uint64_t pos;
+    struct stat st_file;
+    struct stat st_index;
+    if (fstat(fileno(fp), &st_file) == 0 &&
+        fstat(fileno(fp_index), &st_index) == 0 &&
+        st_index.st_size >= (off_t)sizeof(uint64_t) &&
+        (st_index.st_size % (off_t)sizeof(uint64_t)) == 0 &&
+        fread(&file_size, sizeof(uint64_t), 1, fp_index) == 1 &&
+        file_size == (uint64_t)st_file.st_size)
+    {
+        *count = (long)(st_index.st_size / (off_t)sizeof(uint64_t)) - 1;
+        if (entry >= *count) {
+            rc = fseek(fp, 0, SEEK_END) == 0;
+        }
+        else if (fseek(fp_index, (long)sizeof(uint64_t) * (entry + 1), SEEK_SET) == 0 &&
+            fread(&pos, sizeof(uint64_t), 1, fp_index) == 1 &&
+            pos < file_size)
+        {
+            rc = fseek(fp, (long)pos, SEEK_SET) == 0;
+        }
+    }
+    if (rc == false) {
+        MYMPD_LOG_WARN(NULL, "Last played index \"%s\" is outdated", index_file);
+        rewind(fp);
+    }
+    (void) fclose(fp_index);
+    return rc;
+}
+
+/**
+ * Writes a value to the index file
+ * @param fp opened index file
+ * @param value value to write
+ * @return true on success, else false
+ */
+bool mympd_api_last_played_index_write(FILE *fp, uint64_t value) {
+    return fwrite(&value, sizeof(uint64_t), 1, fp) == 1;
+}
+
 /**
  * Private functions
  */
 
 /**
- * Gets the song and searches for searchstr and prints it as json object
+ * Adds an entry to the batch and looks up the batch if it is full
  * @param partition_state pointer to partition state
- * @param buffer already allocated buffer to append the result
- * @param entity_count position in the list
- * @param last_played songs last played time as unix timestamp
+ * @param page pointer to the page struct
  * @param uri uri of the song
- * @param expr_list list of search expressions
- * @param tagcols columns to print
- * @return pointer to buffer
+ * @param last_played songs last played time as unix timestamp
+ * @param pos position in the last played list
+ * @return true if more entries are needed, else false
  */
-static sds get_last_played_obj(struct t_partition_state *partition_state, sds buffer, long entity_count,
-        long long last_played, const char *uri, struct t_list *expr_list, const struct t_tags *tagcols)
+static bool page_add(struct t_partition_state *partition_state, struct t_last_played_page *page,
+        const char *uri, long long last_played, long pos)
 {
-    if (mpd_send_list_meta(partition_state->conn, uri)) {
-        struct mpd_song *song;
-        if ((song = mpd_recv_song(partition_state->conn)) != NULL) {
-            if (search_song_expression(song, expr_list, tagcols) == true) {
-                buffer = sdscat(buffer, "{\"Type\": \"song\",");
-                buffer = tojson_long(buffer, "Pos", entity_count, true);
-                buffer = tojson_llong(buffer, "LastPlayed", last_played, true);
-                buffer = print_song_tags(buffer, partition_state->mpd_state->feat_tags, tagcols, song, &partition_state->mympd_state->config->albums);
-                if (partition_state->mpd_state->feat_stickers == true &&
-                    tagcols->stickers_len > 0)
-                {
-                    buffer = mympd_api_sticker_get_print_batch(buffer, partition_state->mympd_state->stickerdb, mpd_song_get_uri(song), tagcols);
+    struct t_last_played_entry *entry = &page->entries[page->entries_len];
+    entry->uri = sdsnew(uri);
+    entry->last_played = last_played;
+    entry->pos = pos;
+    page->entries_len++;
+    if (page->entries_len == LAST_PLAYED_BATCH_MAX ||
+        (page->filter->root == NULL &&
+         page->entities_found + (long)page->entries_len == page->real_limit))
+    {
+        //batch is full or the entries for this page are complete
+        if (page_lookup(partition_state, page) == false) {
+            return false;
+        }
+    }
+    return page->entities_found < page->real_limit;
+}
+
+/**
+ * Gets the songs of all entries in the batch with one command list and prints them.
+ * MPD aborts the command list on the first missing song, then the remaining uris are checked
+ * against one listing of the database and only the existing songs are sent again.
+ * @param partition_state pointer to partition state
+ * @param page pointer to the page struct
+ * @return true on success, false on a connection error
+ */
+static bool page_lookup(struct t_partition_state *partition_state, struct t_last_played_page *page) {
+    bool rc = true;
+    rax *missing = NULL;
+    unsigned start = 0;
+    while (start < page->entries_len) {
+        unsigned i = start;
+        if (mpd_command_list_begin(partition_state->conn, true)) {
+            for (unsigned j = start; j < page->entries_len; j++) {
+                if (entry_is_missing(missing, &page->entries[j]) == true) {
+                    continue;
+                }
+                if (mpd_send_list_meta(partition_state->conn, page->entries[j].uri) == false) {
+                    mympd_set_mpd_failure(partition_state, "Error adding command to command list mpd_send_list_meta");
+                    break;
+                }
+            }
+            if (mpd_client_command_list_end_check(partition_state)) {
+                for (; i < page->entries_len; i++) {
+                    if (entry_is_missing(missing, &page->entries[i]) == true) {
+                        page_print(partition_state, page, NULL, &page->entries[i]);
+                        continue;
+                    }
+                    struct mpd_song *song;
+                    bool found = false;
+                    while ((song = mpd_recv_song(partition_state->conn)) != NULL) {
+                        if (found == false) {
+                            page_print(partition_state, page, song, &page->entries[i]);
+                            found = true;
+                        }
+                        mpd_song_free(song);
+                    }
+                    if (found == false ||
+                        mpd_response_next(partition_state->conn) == false)
+                    {
+                        break;
+                    }
                 }
-                buffer = sdscatlen(buffer, "}", 1);
             }
-            mpd_song_free(song);
         }
+        mpd_response_finish(partition_state->conn);
+        if (i < page->entries_len &&
+            mpd_connection_get_error(partition_state->conn) == MPD_ERROR_SERVER &&
+            mpd_connection_get_server_error(partition_state->conn) == MPD_SERVER_ERROR_NO_EXIST)
+        {
+            //song was removed from the database, this is not an error
+            MYMPD_LOG_DEBUG(partition_state->name, "Song \"%s\" not found in the database", page->entries[i].uri);
+            if (mpd_connection_clear_error(partition_state->conn) == false) {
+                mympd_set_mpd_failure(partition_state, "Unrecoverable MPD error");
+            }
+        }
+        enum mpd_error error = mpd_connection_get_error(partition_state->conn);
+        mympd_check_error_and_recover(partition_state, NULL, "mpd_send_list_meta");
+        if (partition_state->conn_state != MPD_CONNECTED ||
+            (error != MPD_ERROR_SUCCESS && error != MPD_ERROR_SERVER))
+        {
+            rc = false;
+            break;
+        }
+        if (i < page->entries_len) {
+            //song not found in the database
+            page_print(partition_state, page, NULL, &page->entries[i]);
+            i++;
+            if (missing == NULL &&
+                i < page->entries_len)
+            {
+                //check the remaining entries at once instead of resending them after each miss
+                missing = raxNew();
+                for (unsigned j = i; j < page->entries_len; j++) {
+                    raxTryInsert(missing, (unsigned char *)page->entries[j].uri, sdslen(page->entries[j].uri), NULL, NULL);
+                }
+                if (mpd_client_filter_existing_songs(partition_state, missing, NULL, NULL) == false) {
+                    //resend the remaining entries
+                    raxFree(missing);
+                    missing = raxNew();
+                }
+            }
+        }
+        start = i;
+    }
+    if (missing != NULL) {
+        raxFree(missing);
+    }
+    for (unsigned j = 0; j < page->entries_len; j++) {
+        FREE_SDS(page->entries[j].uri);
+    }
+    page->entries_len = 0;
+    return rc;
+}
+
+/**
+ * Checks if the uri of the entry is in the set of missing songs
+ * @param missing set of missing song uris or NULL
+ * @param entry the last played entry
+ * @return true if the song is missing, else false
+ */
+static bool entry_is_missing(rax *missing, const struct t_last_played_entry *entry) {
+    return missing != NULL &&
+        raxFind(missing, (unsigned char *)entry->uri, sdslen(entry->uri)) != raxNotFound;
+}
+
+/**
+ * Searches the song with the search expression and prints it as json object
+ * @param partition_state pointer to partition state
+ * @param page pointer to the page struct
+ * @param song the song or NULL if it is not in the database anymore
+ * @param entry the last played entry
+ */
+static void page_print(struct t_partition_state *partition_state, struct t_last_played_page *page,
+        struct mpd_song *song, const struct t_last_played_entry *entry)
+{
+    struct mpd_song *removed_song = NULL;
+    if (song == NULL) {
+        if (page->filter->root != NULL) {
+            //removed songs do not match search expressions
+            return;
+        }
+        //print the uri of removed songs to keep the positions in sync
+        removed_song = mpd_song_new(entry->uri);
+        song = removed_song;
+    }
+    else if (search_song_expression(song, page->filter, page->tagcols) == false) {
+        return;
+    }
+    if (page->entities_found >= page->offset &&
+        page->entities_found < page->real_limit)
+    {
+        if (page->entities_returned++) {
+            page->buffer = sdscatlen(page->buffer, ",", 1);
+        }
+        page->buffer = sdscat(page->buffer, "{\"Type\": \"song\",");
+        page->buffer = tojson_long(page->buffer, "Pos", entry->pos, true);
+        page->buffer = tojson_llong(page->buffer, "LastPlayed", entry->last_played, true);
+        page->buffer = print_song_tags(page->buffer, partition_state->mpd_state->feat_tags, page->tagcols, song, &partition_state->mympd_state->config->albums);
+        if (partition_state->mpd_state->feat_stickers == true &&
+            page->tagcols->stickers_len > 0)
+        {
+            page->buffer = mympd_api_sticker_get_print_batch(page->buffer, partition_state->mympd_state->stickerdb, mpd_song_get_uri(song), page->tagcols);
+        }
+        page->buffer = sdscatlen(page->buffer, "}", 1);
+    }
+    page->entities_found++;
+    if (removed_song != NULL) {
+        mpd_song_free(removed_song);
     }
-    mpd_response_finish(partition_state->conn);
-    mympd_check_error_and_recover(partition_state, NULL, "mpd_send_list_meta");
-    return buffer;
 }
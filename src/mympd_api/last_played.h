@@ -9,8 +9,13 @@
 
 #include "src/lib/mympd_state.h"
 
+#include <stdint.h>
+#include <stdio.h>
+
 bool mympd_api_last_played_add_song(struct t_partition_state *partition_state, int song_id);
 bool mympd_api_last_played_file_save(struct t_partition_state *partition_state);
 sds mympd_api_last_played_list(struct t_partition_state *partition_state, sds buffer,
         long request_id, long offset, long limit, sds expression, const struct t_tags *tagcols);
+bool mympd_api_last_played_index_seek(const char *index_file, FILE *fp, long entry, long *count);
+bool mympd_api_last_played_index_write(FILE *fp, uint64_t value);
 #endif
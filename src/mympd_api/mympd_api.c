@@ -13,12 +13,15 @@
 #include "src/lib/mem.h"
 #include "src/lib/msg_queue.h"
 #include "src/lib/sds_extras.h"
+#include "src/lib/sticker_cache.h"
 #include "src/lib/thread.h"
 #include "src/mpd_client/autoconf.h"
 #include "src/mpd_client/connection.h"
 #include "src/mpd_client/idle.h"
 #include "src/mpd_client/stickerdb.h"
+#include "src/mpd_worker/mpd_worker.h"
 #include "src/mympd_api/home.h"
+#include "src/mympd_api/scripts.h"
 #include "src/mympd_api/settings.h"
 #include "src/mympd_api/timer.h"
 #include "src/mympd_api/timer_handlers.h"
@@ -58,6 +61,11 @@ void *mympd_api_loop(void *arg_config) {
         //album cache
         MYMPD_LOG_INFO(NULL, "Reading album cache from disc");
         album_cache_read(&mympd_state->mpd_state->album_cache, mympd_state->config->workdir, &mympd_state->config->albums);
+        //sticker cache
+        if (mympd_state->config->stickers == true) {
+            MYMPD_LOG_INFO(NULL, "Reading sticker cache from disc");
+            sticker_cache_read(&mympd_state->sticker_cache, mympd_state->config->workdir);
+        }
     }
     //set timers
     if (mympd_state->config->covercache_keep_days > 0) {
@@ -95,6 +103,9 @@ void *mympd_api_loop(void *arg_config) {
     }
     MYMPD_LOG_DEBUG(NULL, "Stopping mympd_api thread");
 
+    //wait for running mpd_worker jobs
+    mpd_worker_pool_stop();
+
     //stop trigger
     mympd_api_trigger_execute(&mympd_state->trigger_list, TRIGGER_MYMPD_STOP, MPD_PARTITION_ALL);
 
@@ -113,6 +124,18 @@ void *mympd_api_loop(void *arg_config) {
             &mympd_state->mpd_state->tags_album, &mympd_state->config->albums, true);
     }
 
+    // write sticker cache to disc to save the own writes since the last creation
+    if (mympd_state->config->save_caches == true &&
+        mympd_state->config->stickers == true)
+    {
+        sticker_cache_write(mympd_state->sticker_cache.cache, mympd_state->config->workdir);
+    }
+
+    #ifdef MYMPD_ENABLE_LUA
+        //free pooled lua states
+        mympd_api_script_vm_pool_free();
+    #endif
+
     //save and free states
     mympd_state_save(mympd_state, true);
 
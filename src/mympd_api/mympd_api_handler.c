@@ -14,9 +14,11 @@
 #include "src/lib/list.h"
 #include "src/lib/log.h"
 #include "src/lib/mem.h"
+#include "src/lib/msg_queue.h"
 #include "src/lib/mympd_state.h"
 #include "src/lib/sds_extras.h"
 #include "src/lib/smartpls.h"
+#include "src/lib/sticker_cache.h"
 #include "src/lib/utility.h"
 #include "src/lib/validate.h"
 #include "src/mpd_client/connection.h"
@@ -109,6 +111,9 @@ void mympd_api_handler(struct t_partition_state *partition_state, struct t_work_
     //create response struct
     struct t_work_response *response = create_response(request);
 
+    //index the request parameters once
+    json_index_create(request->data);
+
     switch(request->cmd_id) {
     // methods that are delegated to a new worker thread
         case MYMPD_API_CACHES_CREATE:
@@ -123,10 +128,10 @@ void mympd_api_handler(struct t_partition_state *partition_state, struct t_work_
         case MYMPD_API_SMARTPLS_UPDATE:
         case MYMPD_API_SMARTPLS_UPDATE_ALL:
         case MYMPD_API_SONG_FINGERPRINT:
-            if (worker_threads > MAX_WORKER_THREADS) {
+            if (mpd_worker_queue_length() >= MAX_WORKER_JOBS) {
                 response->data = jsonrpc_respond_message(response->data, request->cmd_id, request->id,
-                    JSONRPC_FACILITY_GENERAL, JSONRPC_SEVERITY_ERROR, "Too many worker threads are already running");
-                MYMPD_LOG_ERROR(partition_state->name, "Too many worker threads are already running");
+                    JSONRPC_FACILITY_GENERAL, JSONRPC_SEVERITY_ERROR, "Too many worker jobs are already queued");
+                MYMPD_LOG_ERROR(partition_state->name, "Too many worker jobs are already queued");
                 break;
             }
             if (request->cmd_id == MYMPD_API_CACHES_CREATE ||
@@ -138,19 +143,23 @@ void mympd_api_handler(struct t_partition_state *partition_state, struct t_work_
                 }
             }
             if (request->cmd_id == MYMPD_API_CACHES_CREATE) {
-                if (mympd_state->mpd_state->album_cache.building == true) {
+                if (mympd_state->mpd_state->album_cache.building == true ||
+                    mympd_state->sticker_cache.building == true)
+                {
                     response->data = jsonrpc_respond_message(response->data, request->cmd_id, request->id,
                             JSONRPC_FACILITY_GENERAL, JSONRPC_SEVERITY_WARN, "Cache update is already running");
                     MYMPD_LOG_WARN(partition_state->name, "Cache update is already running");
                     break;
                 }
                 mympd_state->mpd_state->album_cache.building = mympd_state->mpd_state->feat_tags;
+                mympd_state->sticker_cache.building = mympd_state->mpd_state->feat_stickers;
             }
             async = mpd_worker_start(mympd_state, request);
             if (async == false) {
                 response->data = jsonrpc_respond_message(response->data, request->cmd_id, request->id,
                         JSONRPC_FACILITY_GENERAL, JSONRPC_SEVERITY_ERROR, "Error starting worker thread");
                 mympd_state->mpd_state->album_cache.building = false;
+                mympd_state->sticker_cache.building = false;
             }
             break;
     // Async responses from the worker thread
@@ -170,7 +179,15 @@ void mympd_api_handler(struct t_partition_state *partition_state, struct t_work_
                 jukebox_clear_all(mympd_state);
                 //free the old album cache and replace it with the freshly generated one
                 album_cache_free(&mympd_state->mpd_state->album_cache);
-                mympd_state->mpd_state->album_cache.cache = (rax *) request->extra;
+                struct t_cache *album_cache = (struct t_cache *) request->extra;
+                mympd_state->mpd_state->album_cache.cache = album_cache->cache;
+                mympd_state->mpd_state->album_cache.strings = album_cache->strings;
+                mympd_state->mpd_state->album_cache.strings_released = album_cache->strings_released;
+                mympd_state->mpd_state->album_cache.sort_indexes = album_cache->sort_indexes;
+                FREE_PTR(album_cache);
+                if (json_get_time_max(request->data, "$.params.mtime", &mympd_state->mpd_state->album_cache.mtime, &parse_error) == false) {
+                    mympd_state->mpd_state->album_cache.mtime = 0;
+                }
                 response->data = jsonrpc_respond_ok(response->data, request->cmd_id, request->id, JSONRPC_FACILITY_DATABASE);
                 MYMPD_LOG_INFO(partition_state->name, "Album cache was replaced");
             }
@@ -181,6 +198,75 @@ void mympd_api_handler(struct t_partition_state *partition_state, struct t_work_
             }
             mympd_state->mpd_state->album_cache.building = false;
             break;
+        case INTERNAL_API_STICKERCACHE_SKIPPED:
+        case INTERNAL_API_STICKERCACHE_ERROR:
+            mympd_state->sticker_cache.building = false;
+            list_clear(&mympd_state->sticker_cache.pending);
+            response->data = request->cmd_id == INTERNAL_API_STICKERCACHE_SKIPPED
+                ? jsonrpc_respond_ok(response->data, request->cmd_id, request->id, JSONRPC_FACILITY_STICKER)
+                : jsonrpc_respond_message(response->data, request->cmd_id, request->id,
+                    JSONRPC_FACILITY_STICKER, JSONRPC_SEVERITY_ERROR, "Error creating sticker cache");
+            if (mympd_state->sticker_cache.outdated == true) {
+                stickerdb_cache_update(mympd_state);
+            }
+            break;
+        case INTERNAL_API_STICKERCACHE_CREATED:
+            if (request->extra != NULL) {
+                //replace the sticker cache and apply the own writes while it was created
+                sticker_cache_replace(&mympd_state->sticker_cache, (rax *) request->extra);
+                response->data = jsonrpc_respond_ok(response->data, request->cmd_id, request->id, JSONRPC_FACILITY_STICKER);
+                MYMPD_LOG_INFO(partition_state->name, "Sticker cache was replaced");
+            }
+            else {
+                MYMPD_LOG_ERROR(partition_state->name, "Sticker cache is NULL");
+                list_clear(&mympd_state->sticker_cache.pending);
+                response->data = jsonrpc_respond_message(response->data, request->cmd_id, request->id,
+                        JSONRPC_FACILITY_STICKER, JSONRPC_SEVERITY_ERROR, "Sticker cache is NULL");
+            }
+            mympd_state->sticker_cache.building = false;
+            if (mympd_state->sticker_cache.outdated == true) {
+                stickerdb_cache_update(mympd_state);
+            }
+            break;
+        case INTERNAL_API_ALBUMCACHE_UPDATED:
+            if (request->extra != NULL) {
+                struct t_album_cache_delta *delta = (struct t_album_cache_delta *) request->extra;
+                if (delta->albums->numele > 0 ||
+                    delta->dirs->numele > 0)
+                {
+                    //first clear the jukebox queues - it has references to the album cache
+                    MYMPD_LOG_INFO(partition_state->name, "Clearing jukebox queues");
+                    jukebox_clear_all(mympd_state);
+                }
+                //move the changed albums to the album cache
+                if (album_cache_delta_apply(&mympd_state->mpd_state->album_cache, delta) == true) {
+                    if (json_get_time_max(request->data, "$.params.mtime", &mympd_state->mpd_state->album_cache.mtime, &parse_error) == false) {
+                        mympd_state->mpd_state->album_cache.mtime = 0;
+                    }
+                    if (mympd_state->config->save_caches == true) {
+                        album_cache_write(&mympd_state->mpd_state->album_cache, mympd_state->config->workdir,
+                            &delta->tags, &mympd_state->config->albums, false);
+                    }
+                    MYMPD_LOG_INFO(partition_state->name, "Album cache was updated");
+                }
+                else {
+                    //the changes could not be detected completely, e.g. for removed songs
+                    MYMPD_LOG_WARN(partition_state->name, "Album cache is inconsistent, recreating it");
+                    mympd_state->mpd_state->album_cache.mtime = 0;
+                    struct t_work_request *cache_request = create_request(-1, 0, MYMPD_API_CACHES_CREATE, NULL, partition_state->name);
+                    cache_request->data = sdscat(cache_request->data, "\"force\":true}}");
+                    mympd_queue_push(mympd_api_queue, cache_request, 0);
+                }
+                album_cache_delta_free(delta);
+                response->data = jsonrpc_respond_ok(response->data, request->cmd_id, request->id, JSONRPC_FACILITY_DATABASE);
+            }
+            else {
+                MYMPD_LOG_ERROR(partition_state->name, "Album cache delta is NULL");
+                response->data = jsonrpc_respond_message(response->data, request->cmd_id, request->id,
+                        JSONRPC_FACILITY_DATABASE, JSONRPC_SEVERITY_ERROR, "Album cache delta is NULL");
+            }
+            mympd_state->mpd_state->album_cache.building = false;
+            break;
     // Misc
         case MYMPD_API_LOGLEVEL:
             if (json_get_int(request->data, "$.params.loglevel", 0, 7, &int_buf1, &parse_error) == true) {
@@ -205,9 +291,14 @@ void mympd_api_handler(struct t_partition_state *partition_state, struct t_work_
         case MYMPD_API_STATS:
             response->data = mympd_api_stats_get(partition_state, response->data, request->id);
             break;
+        case MYMPD_API_WORKER_LIST:
+            response->data = mpd_worker_list(response->data, request->id);
+            break;
         case INTERNAL_API_ALBUMART_BY_URI:
-            if (json_get_string(request->data, "$.params.uri", 1, FILEPATH_LEN_MAX, &sds_buf1, vcb_isfilepath, &parse_error) == true) {
-                response->data = mympd_api_albumart_getcover_by_uri(partition_state, response->data, request->id, sds_buf1, &response->binary);
+            if (json_get_string(request->data, "$.params.uri", 1, FILEPATH_LEN_MAX, &sds_buf1, vcb_isfilepath, &parse_error) == true &&
+                json_get_uint(request->data, "$.params.size", 0, 1, &uint_buf1, &parse_error) == true)
+            {
+                response->data = mympd_api_albumart_getcover_by_uri(partition_state, response->data, request->id, sds_buf1, uint_buf1, &response->binary);
             }
             break;
         case INTERNAL_API_ALBUMART_BY_ALBUMID:
@@ -461,6 +552,9 @@ void mympd_api_handler(struct t_partition_state *partition_state, struct t_work_
                         // reconnect
                         MYMPD_LOG_DEBUG("stickerdb", "MPD host has changed, reconnecting");
                         mpd_client_disconnect_silent(mympd_state->stickerdb, MPD_DISCONNECTED);
+                        // the sticker cache is recreated after connecting
+                        sticker_cache_free(&mympd_state->sticker_cache);
+                        sticker_cache_remove(config->workdir);
                         // connect to stickerdb
                         if (stickerdb_connect(mympd_state->stickerdb) == true) {
                             stickerdb_enter_idle(mympd_state->stickerdb);
@@ -1382,6 +1476,8 @@ void mympd_api_handler(struct t_partition_state *partition_state, struct t_work_
         case MYMPD_API_DATABASE_SEARCH: {
             struct t_tags tagcols;
             reset_t_tags(&tagcols);
+            struct t_response_stream stream;
+            response_stream_init(&stream, request);
             if (json_get_string(request->data, "$.params.expression", 0, EXPRESSION_LEN_MAX, &sds_buf1, vcb_issearchexpression, &parse_error) == true &&
                 json_get_string(request->data, "$.params.sort", 0, NAME_LEN_MAX, &sds_buf2, vcb_ismpdsort, &parse_error) == true &&
                 json_get_bool(request->data, "$.params.sortdesc", &bool_buf1, &parse_error) == true &&
@@ -1390,7 +1486,8 @@ void mympd_api_handler(struct t_partition_state *partition_state, struct t_work_
                 json_get_tags(request->data, "$.params.cols", &tagcols, COLS_MAX, &parse_error) == true)
             {
                 response->data = mympd_api_search_songs(partition_state, response->data, request->id,
-                        sds_buf1, sds_buf2, bool_buf1, uint_buf1, uint_buf2, &tagcols, &rc);
+                        sds_buf1, sds_buf2, bool_buf1, uint_buf1, uint_buf2, &tagcols, &stream, &rc);
+                response->chunk = response_stream_end(&stream, rc);
             }
             break;
         }
@@ -1541,6 +1638,7 @@ void mympd_api_handler(struct t_partition_state *partition_state, struct t_work_
                 JSONRPC_FACILITY_GENERAL, JSONRPC_SEVERITY_ERROR, "Unknown request");
             MYMPD_LOG_ERROR(partition_state->name, "Unknown API request: %.*s", (int)sdslen(request->data), request->data);
     }
+    json_index_clear();
 
     FREE_SDS(sds_buf1);
     FREE_SDS(sds_buf2);
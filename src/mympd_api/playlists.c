@@ -351,7 +351,7 @@ bool mympd_api_playlist_content_insert_albums(struct t_partition_state *partitio
     struct t_list_node *current = albumids->head;
     bool rc = true;
     while (current != NULL) {
-        struct mpd_song *mpd_album = album_cache_get_album(&partition_state->mpd_state->album_cache, current->key);
+        struct t_album *mpd_album = album_cache_get_album(&partition_state->mpd_state->album_cache, current->key);
         if (mpd_album == NULL) {
             rc = false;
             break;
@@ -412,7 +412,7 @@ bool mympd_api_playlist_content_insert_album_disc(struct t_partition_state *part
         *error = sdscat(*error, "Method not supported");
         return false;
     }
-    struct mpd_song *mpd_album = album_cache_get_album(&partition_state->mpd_state->album_cache, albumid);
+    struct t_album *mpd_album = album_cache_get_album(&partition_state->mpd_state->album_cache, albumid);
     if (mpd_album == NULL) {
         return false;
     }
@@ -671,9 +671,9 @@ sds mympd_api_playlist_content_list(struct t_partition_state *partition_state, s
 
         struct mpd_song *song;
         long real_limit = offset + limit;
-        struct t_list *expr_list = parse_search_expression_to_list(expression);
+        struct t_search_filter *filter = search_filter_cache_get(partition_state->mpd_state->search_filter_cache, expression);
         while ((song = mpd_recv_song(partition_state->conn)) != NULL) {
-            if (search_song_expression(song, expr_list, tagcols) == true) {
+            if (search_song_expression(song, filter, tagcols) == true) {
                 total_time += mpd_song_get_duration(song);
                 if (entities_found >= offset &&
                     entities_found < real_limit)
@@ -707,7 +707,6 @@ sds mympd_api_playlist_content_list(struct t_partition_state *partition_state, s
             entity_count++;
             mpd_song_free(song);
         }
-        free_search_expression_list(expr_list);
     }
     mpd_response_finish(partition_state->conn);
     if (mympd_check_error_and_recover_respond(partition_state, &buffer, cmd_id, request_id, "mpd_send_list_playlist_meta") == false) {
@@ -343,7 +343,7 @@ bool mympd_api_queue_insert_albums(struct t_partition_state *partition_state, st
     struct t_list_node *current = albumids->head;
     bool rc = true;
     while (current != NULL) {
-        struct mpd_song *mpd_album = album_cache_get_album(&partition_state->mpd_state->album_cache, current->key);
+        struct t_album *mpd_album = album_cache_get_album(&partition_state->mpd_state->album_cache, current->key);
         if (mpd_album == NULL) {
             *error = sdscat(*error, "Album not found");
             return false;
@@ -402,7 +402,7 @@ bool mympd_api_queue_insert_album_disc(struct t_partition_state *partition_state
         *error = sdscat(*error, "Method not supported");
         return false;
     }
-    struct mpd_song *mpd_album = album_cache_get_album(&partition_state->mpd_state->album_cache, albumid);
+    struct t_album *mpd_album = album_cache_get_album(&partition_state->mpd_state->album_cache, albumid);
     if (mpd_album == NULL) {
         *error = sdscat(*error, "Album not found");
         return false;
@@ -593,7 +593,7 @@ sds mympd_api_queue_list(struct t_partition_state *partition_state, sds buffer,
     if (partition_state->mpd_state->feat_stickers == true &&
         tagcols->stickers_len > 0)
     {
-        stickerdb_exit_idle(partition_state->mympd_state->stickerdb);
+        stickerdb_batch_start(partition_state->mympd_state->stickerdb);
     }
     unsigned real_limit = offset + limit;
     if (mpd_send_list_queue_range_meta(partition_state->conn, offset, real_limit) == true) {
@@ -622,7 +622,7 @@ sds mympd_api_queue_list(struct t_partition_state *partition_state, sds buffer,
     if (partition_state->mpd_state->feat_stickers == true &&
         tagcols->stickers_len > 0)
     {
-        stickerdb_enter_idle(partition_state->mympd_state->stickerdb);
+        stickerdb_batch_end(partition_state->mympd_state->stickerdb);
     }
     mympd_check_error_and_recover_respond(partition_state, &buffer, cmd_id, request_id, "mpd_send_list_queue_range_meta");
     return buffer;
@@ -666,7 +666,7 @@ sds mympd_api_queue_search(struct t_partition_state *partition_state, sds buffer
     if (partition_state->mpd_state->feat_stickers == true &&
         tagcols->stickers_len > 0)
     {
-        stickerdb_exit_idle(partition_state->mympd_state->stickerdb);
+        stickerdb_batch_start(partition_state->mympd_state->stickerdb);
     }
     if (mpd_search_commit(partition_state->conn)) {
         buffer = jsonrpc_respond_start(buffer, cmd_id, request_id);
@@ -713,7 +713,7 @@ sds mympd_api_queue_search(struct t_partition_state *partition_state, sds buffer
     if (partition_state->mpd_state->feat_stickers == true &&
         tagcols->stickers_len > 0)
     {
-        stickerdb_enter_idle(partition_state->mympd_state->stickerdb);
+        stickerdb_batch_end(partition_state->mympd_state->stickerdb);
     }
     if (mympd_check_error_and_recover_respond(partition_state, &buffer, cmd_id, request_id, "mpd_search_queue_songs") == false) {
         return buffer;
@@ -7,6 +7,7 @@
 #include "compile_time.h"
 #include "src/mympd_api/scripts.h"
 
+#include "dist/rax/rax.h"
 #include "src/lib/api.h"
 #include "src/lib/filehandler.h"
 #include "src/lib/http_client.h"
@@ -25,6 +26,8 @@
 #include <limits.h>
 #include <pthread.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <time.h>
 #include <unistd.h>
 
 #ifdef MYMPD_ENABLE_LUA
@@ -54,7 +57,45 @@ struct t_script_thread_arg {
     struct t_list *arguments;  //!< argumentlist
 };
 
-static lua_State *script_load(struct t_script_thread_arg *script_arg, int *rc);
+/**
+ * Compiled script
+ */
+struct t_script_chunk {
+    sds bytecode;   //!< dumped lua function
+    time_t mtime;   //!< modification time of the script file
+    off_t size;     //!< size of the script file
+};
+
+/**
+ * Pool of pre-initialized lua states and cache of compiled scripts.
+ * A lua state is used only for one script execution to not leak globals
+ * between scripts, finished scripts create a new state for the pool.
+ */
+struct t_script_vm_pool {
+    pthread_mutex_t mutex;                    //!< protects the pool
+    lua_State *vms[SCRIPTS_VM_POOL_MAX];      //!< pre-initialized lua states
+    unsigned vms_len;                         //!< number of pooled lua states
+    sds lualibs;                              //!< lua libraries of the pooled states
+    rax *chunks;                              //!< script path -> t_script_chunk
+    bool stop;                                //!< stop condition for the pool
+};
+
+static struct t_script_vm_pool pool = {
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+    .vms_len = 0,
+    .lualibs = NULL,
+    .chunks = NULL,
+    .stop = false
+};
+
+static lua_State *script_load(struct t_script_thread_arg *script_arg, int *rc, bool use_pool);
+static lua_State *script_vm_new(const char *lualibs);
+static lua_State *vm_pool_get(const char *lualibs);
+static void vm_pool_refill(const char *lualibs);
+static int chunk_load(lua_State *lua_vm, const char *filepath, bool *cached);
+static void chunk_invalidate(const char *filepath);
+static void chunk_free(struct t_script_chunk *chunk);
+static int chunk_writer(lua_State *lua_vm, const void *p, size_t sz, void *ud);
 static void *script_execute(void *script_thread_arg);
 static sds script_get_result(lua_State *lua_vm, int rc);
 const char *lua_err_to_str(int rc);
@@ -150,6 +191,7 @@ sds mympd_api_script_list(sds workdir, sds buffer, long request_id, bool all) {
 bool mympd_api_script_delete(sds workdir, sds script) {
     sds filepath = sdscatfmt(sdsempty(), "%S/%s/%S.lua", workdir, DIR_WORK_SCRIPTS, script);
     bool rc = rm_file(filepath);
+    chunk_invalidate(filepath);
     FREE_SDS(filepath);
     return rc;
 }
@@ -170,6 +212,7 @@ bool mympd_api_script_save(sds workdir, sds script, sds oldscript, int order, sd
     sds argstr = list_to_json_array(sdsempty(), arguments);
     sds script_content = sdscatfmt(sdsempty(), "-- {\"order\":%i,\"arguments\":%S}\n%S", order, argstr, content);
     bool rc = write_data_to_file(filepath, script_content, sdslen(script_content));
+    chunk_invalidate(filepath);
     //delete old scriptfile
     if (rc == true &&
         sdslen(oldscript) > 0 &&
@@ -177,6 +220,7 @@ bool mympd_api_script_save(sds workdir, sds script, sds oldscript, int order, sd
     {
         sds old_filepath = sdscatfmt(sdsempty(), "%S/%s/%S.lua", workdir, DIR_WORK_SCRIPTS, oldscript);
         rc = rm_file(old_filepath);
+        chunk_invalidate(old_filepath);
         FREE_SDS(old_filepath);
     }
     FREE_SDS(argstr);
@@ -207,7 +251,7 @@ bool mympd_api_script_validate(sds name, sds content, sds lualibs, sds *error) {
     script_arg.script_fullpath = NULL;
 
     int rc = 0;
-    lua_State *lua_vm = script_load(&script_arg, &rc);
+    lua_State *lua_vm = script_load(&script_arg, &rc, false);
     if (lua_vm == NULL) {
         return false;
     }
@@ -322,10 +366,35 @@ bool mympd_api_script_start(sds workdir, sds script, sds lualibs, struct t_list
         free_t_script_thread_arg(script_thread_arg);
         return false;
     }
-    mympd_queue_expire(mympd_script_queue, 120);
     return true;
 }
 
+/**
+ * Frees the pooled lua states and the compiled scripts.
+ * Running scripts do not add new states to the pool after this call.
+ */
+void mympd_api_script_vm_pool_free(void) {
+    pthread_mutex_lock(&pool.mutex);
+    pool.stop = true;
+    while (pool.vms_len > 0) {
+        pool.vms_len--;
+        lua_close(pool.vms[pool.vms_len]);
+    }
+    FREE_SDS(pool.lualibs);
+    if (pool.chunks != NULL) {
+        raxIterator iter;
+        raxStart(&iter, pool.chunks);
+        raxSeek(&iter, "^", NULL, 0);
+        while (raxNext(&iter)) {
+            chunk_free(iter.data);
+        }
+        raxStop(&iter);
+        raxFree(pool.chunks);
+        pool.chunks = NULL;
+    }
+    pthread_mutex_unlock(&pool.mutex);
+}
+
 /**
  * Private functions
  */
@@ -373,18 +442,55 @@ static sds parse_script_metadata(sds buffer, const char *scriptfilename, int *or
 }
 
 /**
- * Creates the lua instance and loads the script
+ * Gets a lua instance and loads the script
  * @param script_arg pointer to t_script_thread_arg struct
  * @param rc loading script return value
+ * @param use_pool true = use a pre-initialized lua state and the cache of compiled scripts
  * @return lua instance or NULL on error
  */
-static lua_State *script_load(struct t_script_thread_arg *script_arg, int *rc) {
+static lua_State *script_load(struct t_script_thread_arg *script_arg, int *rc, bool use_pool) {
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    lua_State *lua_vm = use_pool == true
+        ? vm_pool_get(script_arg->lualibs)
+        : NULL;
+    bool pooled = lua_vm != NULL;
+    if (lua_vm == NULL) {
+        lua_vm = script_vm_new(script_arg->lualibs);
+        if (lua_vm == NULL) {
+            MYMPD_LOG_ERROR(script_arg->partition, "Memory allocation error in luaL_newstate");
+            return NULL;
+        }
+    }
+    bool cached = false;
+    if (script_arg->localscript == false) {
+        *rc = luaL_loadstring(lua_vm, script_arg->script_content);
+    }
+    else if (use_pool == true) {
+        *rc = chunk_load(lua_vm, script_arg->script_fullpath, &cached);
+    }
+    else {
+        *rc = luaL_loadfilex(lua_vm, script_arg->script_fullpath, "t");
+    }
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    long long usec = (long long)(end.tv_sec - start.tv_sec) * 1000000 + (end.tv_nsec - start.tv_nsec) / 1000;
+    MYMPD_LOG_INFO(script_arg->partition, "Script \"%s\" loaded in %lld us (pooled lua state: %s, cached bytecode: %s)",
+        script_arg->script_name, usec, (pooled == true ? "true" : "false"), (cached == true ? "true" : "false"));
+    return lua_vm;
+}
+
+/**
+ * Creates a new lua instance with the lua libraries and myMPD functions
+ * @param lualibs comma separated list of lua libraries to open or "all"
+ * @return lua instance or NULL on error
+ */
+static lua_State *script_vm_new(const char *lualibs) {
     lua_State *lua_vm = luaL_newstate();
     if (lua_vm == NULL) {
-        MYMPD_LOG_ERROR(script_arg->partition, "Memory allocation error in luaL_newstate");
         return NULL;
     }
-    if (strcmp(script_arg->lualibs, "all") == 0) {
+    if (strcmp(lualibs, "all") == 0) {
         MYMPD_LOG_DEBUG(NULL, "Open all standard lua libs");
         luaL_openlibs(lua_vm);
         mympd_luaopen(lua_vm, "json");
@@ -392,7 +498,7 @@ static lua_State *script_load(struct t_script_thread_arg *script_arg, int *rc) {
     }
     else {
         int count = 0;
-        sds *tokens = sdssplitlen(script_arg->lualibs, (ssize_t)sdslen(script_arg->lualibs), ",", 1, &count);
+        sds *tokens = sdssplitlen(lualibs, (ssize_t)strlen(lualibs), ",", 1, &count);
         for (int i = 0; i < count; i++) {
             sdstrim(tokens[i], " ");
             MYMPD_LOG_DEBUG(NULL, "Open lua library %s", tokens[i]);
@@ -417,12 +523,182 @@ static lua_State *script_load(struct t_script_thread_arg *script_arg, int *rc) {
         sdsfreesplitres(tokens,count);
     }
     register_lua_functions(lua_vm);
-    *rc = script_arg->localscript == true
-        ? luaL_loadfilex(lua_vm, script_arg->script_fullpath, "t")
-        : luaL_loadstring(lua_vm, script_arg->script_content);
     return lua_vm;
 }
 
+/**
+ * Takes a pre-initialized lua state from the pool
+ * @param lualibs lua libraries the state must have opened
+ * @return lua instance or NULL if the pool is empty
+ */
+static lua_State *vm_pool_get(const char *lualibs) {
+    lua_State *lua_vm = NULL;
+    pthread_mutex_lock(&pool.mutex);
+    if (pool.vms_len > 0 &&
+        strcmp(pool.lualibs, lualibs) == 0)
+    {
+        pool.vms_len--;
+        lua_vm = pool.vms[pool.vms_len];
+    }
+    pthread_mutex_unlock(&pool.mutex);
+    return lua_vm;
+}
+
+/**
+ * Creates a new lua state for the pool if it is not full
+ * @param lualibs lua libraries to open
+ */
+static void vm_pool_refill(const char *lualibs) {
+    pthread_mutex_lock(&pool.mutex);
+    bool full = pool.stop == true ||
+        (pool.vms_len == SCRIPTS_VM_POOL_MAX &&
+         strcmp(pool.lualibs, lualibs) == 0);
+    pthread_mutex_unlock(&pool.mutex);
+    if (full == true) {
+        return;
+    }
+    //create the state outside the lock
+    lua_State *lua_vm = script_vm_new(lualibs);
+    if (lua_vm == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&pool.mutex);
+    if (pool.lualibs == NULL ||
+        strcmp(pool.lualibs, lualibs) != 0)
+    {
+        //lua libraries have changed, discard the pooled states
+        while (pool.vms_len > 0) {
+            pool.vms_len--;
+            lua_close(pool.vms[pool.vms_len]);
+        }
+        pool.lualibs = sds_replace(pool.lualibs, lualibs);
+    }
+    if (pool.stop == false &&
+        pool.vms_len < SCRIPTS_VM_POOL_MAX)
+    {
+        pool.vms[pool.vms_len] = lua_vm;
+        pool.vms_len++;
+        lua_vm = NULL;
+    }
+    pthread_mutex_unlock(&pool.mutex);
+    if (lua_vm != NULL) {
+        lua_close(lua_vm);
+    }
+}
+
+/**
+ * Loads a script file, the compiled bytecode is cached
+ * and used as long as the script file is unchanged.
+ * @param lua_vm lua instance
+ * @param filepath script file to load
+ * @param cached set to true if the cached bytecode was used
+ * @return lua load return value
+ */
+static int chunk_load(lua_State *lua_vm, const char *filepath, bool *cached) {
+    struct stat st;
+    if (stat(filepath, &st) != 0) {
+        //let lua report the error
+        return luaL_loadfilex(lua_vm, filepath, "t");
+    }
+    size_t filepath_len = strlen(filepath);
+    sds chunkname = sdscatfmt(sdsempty(), "@%s", filepath);
+    int rc;
+    pthread_mutex_lock(&pool.mutex);
+    if (pool.chunks != NULL) {
+        void *data = raxFind(pool.chunks, (unsigned char *)filepath, filepath_len);
+        if (data != raxNotFound) {
+            struct t_script_chunk *chunk = (struct t_script_chunk *)data;
+            if (chunk->mtime == st.st_mtime &&
+                chunk->size == st.st_size)
+            {
+                rc = luaL_loadbufferx(lua_vm, chunk->bytecode, sdslen(chunk->bytecode), chunkname, "b");
+                pthread_mutex_unlock(&pool.mutex);
+                FREE_SDS(chunkname);
+                *cached = true;
+                return rc;
+            }
+        }
+    }
+    pthread_mutex_unlock(&pool.mutex);
+    FREE_SDS(chunkname);
+    rc = luaL_loadfilex(lua_vm, filepath, "t");
+    if (rc != 0) {
+        return rc;
+    }
+    //dump the compiled function on top of the stack
+    sds bytecode = sdsempty();
+    if (lua_dump(lua_vm, chunk_writer, &bytecode, 0) != 0) {
+        FREE_SDS(bytecode);
+        return rc;
+    }
+    struct t_script_chunk *chunk = malloc_assert(sizeof(struct t_script_chunk));
+    chunk->bytecode = bytecode;
+    chunk->mtime = st.st_mtime;
+    chunk->size = st.st_size;
+    void *old = NULL;
+    pthread_mutex_lock(&pool.mutex);
+    if (pool.chunks == NULL &&
+        pool.stop == false)
+    {
+        pool.chunks = raxNew();
+    }
+    if (pool.stop == false &&
+        (pool.chunks->numele < SCRIPTS_CHUNKS_MAX ||
+         raxFind(pool.chunks, (unsigned char *)filepath, filepath_len) != raxNotFound))
+    {
+        raxInsert(pool.chunks, (unsigned char *)filepath, filepath_len, chunk, &old);
+        chunk = NULL;
+    }
+    pthread_mutex_unlock(&pool.mutex);
+    if (chunk != NULL) {
+        chunk_free(chunk);
+    }
+    if (old != NULL) {
+        chunk_free(old);
+    }
+    return rc;
+}
+
+/**
+ * Removes a script from the cache of compiled scripts
+ * @param filepath script file
+ */
+static void chunk_invalidate(const char *filepath) {
+    void *old = NULL;
+    pthread_mutex_lock(&pool.mutex);
+    if (pool.chunks != NULL) {
+        raxRemove(pool.chunks, (unsigned char *)filepath, strlen(filepath), &old);
+    }
+    pthread_mutex_unlock(&pool.mutex);
+    if (old != NULL) {
+        chunk_free(old);
+    }
+}
+
+/**
+ * Frees a compiled script
+ * @param chunk pointer to t_script_chunk struct
+ */
+static void chunk_free(struct t_script_chunk *chunk) {
+    FREE_SDS(chunk->bytecode);
+    FREE_PTR(chunk);
+}
+
+/**
+ * Writer function for lua_dump that appends to a sds string
+ * @param lua_vm lua instance
+ * @param p data to write
+ * @param sz length of data
+ * @param ud pointer to the sds string
+ * @return 0 on success
+ */
+static int chunk_writer(lua_State *lua_vm, const void *p, size_t sz, void *ud) {
+    (void)lua_vm;
+    sds *bytecode = (sds *)ud;
+    *bytecode = sdscatlen(*bytecode, p, sz);
+    return 0;
+}
+
 /**
  * Gets the result from script loading or execution
  * @param lua_vm lua instance
@@ -467,7 +743,7 @@ static void *script_execute(void *script_thread_arg) {
     struct t_script_thread_arg *script_arg = (struct t_script_thread_arg *) script_thread_arg;
 
     int rc = 0;
-    lua_State *lua_vm = script_load(script_arg, &rc);
+    lua_State *lua_vm = script_load(script_arg, &rc, true);
     if (lua_vm == NULL) {
         sds buffer = jsonrpc_notify_phrase(sdsempty(), JSONRPC_FACILITY_SCRIPT, JSONRPC_SEVERITY_ERROR,
             "Error executing script %{script}: Memory allocation error", 2, "script", script_arg->script_name);
@@ -520,6 +796,8 @@ static void *script_execute(void *script_thread_arg) {
     }
     lua_close(lua_vm);
     FREE_SDS(result);
+    //prepare a lua state for the next script
+    vm_pool_refill(script_arg->lualibs);
     free_t_script_thread_arg(script_arg);
     FREE_SDS(thread_logname);
     return NULL;
@@ -717,13 +995,17 @@ static int lua_mympd_api(lua_State *lua_vm) {
         request->data = sdscat(request->data, params);
     }
     request->data = sdscatlen(request->data, "}", 1);
+    //open the mailbox for the response before sending the request
+    struct t_mympd_mailbox mailbox;
+    mympd_mailbox_open(mympd_script_mailboxes, &mailbox, request_id);
     mympd_queue_push(mympd_api_queue, request, request_id);
 
     int i = 0;
     while (s_signal_received == 0 && i < 60) {
         i++;
-        struct t_work_response *response = mympd_queue_shift(mympd_script_queue, 1000000, request_id);
+        struct t_work_response *response = mympd_mailbox_wait(mympd_script_mailboxes, &mailbox, 1000);
         if (response != NULL) {
+            mympd_mailbox_close(mympd_script_mailboxes, &mailbox);
             MYMPD_LOG_DEBUG(NULL, "Got response: %s", response->data);
             if (response->cmd_id == INTERNAL_API_SCRIPT_INIT) {
                 //this populates a lua table with some MPD and myMPD states
@@ -745,6 +1027,7 @@ static int lua_mympd_api(lua_State *lua_vm) {
             return 2;
         }
     }
+    mympd_mailbox_close(mympd_script_mailboxes, &mailbox);
     return luaL_error(lua_vm, "No API response, timeout after 60s");
 }
 
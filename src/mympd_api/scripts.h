@@ -20,5 +20,6 @@
     sds mympd_api_script_list(sds workdir, sds buffer, long request_id, bool all);
     bool mympd_api_script_start(sds workdir, sds script, sds lualibs, struct t_list *arguments,
             const char *partition, bool localscript);
+    void mympd_api_script_vm_pool_free(void);
 #endif
 #endif
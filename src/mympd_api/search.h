@@ -7,10 +7,11 @@
 #ifndef MYMPD_API_SEARCH_H
 #define MYMPD_API_SEARCH_H
 
+#include "src/lib/api.h"
 #include "src/lib/mympd_state.h"
 
 sds mympd_api_search_songs(struct t_partition_state *partition_state, sds buffer, long request_id,
         const char *expression, const char *sort, bool sortdesc, unsigned offset, unsigned limit,
-        const struct t_tags *tagcols, bool *result);
+        const struct t_tags *tagcols, struct t_response_stream *stream, bool *result);
 
 #endif
@@ -21,6 +21,7 @@
 #include "src/lib/validate.h"
 #include "src/mpd_client/errorhandler.h"
 #include "src/mpd_client/jukebox.h"
+#include "src/mpd_client/jukebox_pool.h"
 #include "src/mpd_client/presets.h"
 #include "src/mpd_client/shortcuts.h"
 #include "src/mpd_client/tags.h"
@@ -587,6 +588,20 @@ bool mympd_api_settings_mpd_options_set(const char *path, sds key, sds value, in
         sdsclear(value);
         value = sdscatfmt(value, "%i", jukebox_mode);
     }
+    else if (strcmp(key, "jukeboxWeight") == 0 && vtype == MJSON_TOK_STRING) {
+        enum jukebox_weights jukebox_weight = jukebox_weight_parse(value);
+
+        if (jukebox_weight == JUKEBOX_WEIGHT_UNKNOWN) {
+            set_invalid_value(error, path, key, value, "Invalid jukebox weight");
+            return false;
+        }
+        if (partition_state->jukebox_weight != jukebox_weight) {
+            partition_state->jukebox_weight = jukebox_weight;
+            jukebox_changed = true;
+        }
+        sdsclear(value);
+        value = sdscatfmt(value, "%i", jukebox_weight);
+    }
     else if (strcmp(key, "jukeboxPlaylist") == 0 && vtype == MJSON_TOK_STRING) {
         if (vcb_isfilename(value) == false) {
             set_invalid_value(error, path, key, value, "Must be valid MPD playlist");
@@ -755,6 +770,9 @@ bool mympd_api_settings_mpd_options_set(const char *path, sds key, sds value, in
         MYMPD_LOG_WARN(partition_state->name, "Unknown setting \"%s\": \"%s\"", key, value);
         return false;
     }
+    if (jukebox_changed == true) {
+        partition_state->jukebox_pool = jukebox_pool_free(partition_state->jukebox_pool);
+    }
     if (jukebox_changed == true && partition_state->jukebox_queue.length > 0) {
         MYMPD_LOG_INFO(partition_state->name, "Jukebox options changed, clearing jukebox queue");
         mympd_api_jukebox_clear(&partition_state->jukebox_queue, partition_state->name);
@@ -845,6 +863,7 @@ void mympd_api_settings_statefiles_partition_read(struct t_partition_state *part
     MYMPD_LOG_NOTICE(partition_state->name, "Reading partition states from directory \"%s/%s\"", workdir, partition_state->state_dir);
     partition_state->auto_play = state_file_rw_bool(workdir, partition_state->state_dir, "auto_play", partition_state->auto_play, true);
     partition_state->jukebox_mode = state_file_rw_uint(workdir, partition_state->state_dir, "jukebox_mode", partition_state->jukebox_mode, JUKEBOX_MODE_MIN, JUKEBOX_MODE_MAX, true);
+    partition_state->jukebox_weight = state_file_rw_uint(workdir, partition_state->state_dir, "jukebox_weight", partition_state->jukebox_weight, JUKEBOX_WEIGHT_MIN, JUKEBOX_WEIGHT_MAX, true);
     partition_state->jukebox_playlist = state_file_rw_string_sds(workdir, partition_state->state_dir, "jukebox_playlist", partition_state->jukebox_playlist, vcb_isfilename, true);
     partition_state->jukebox_queue_length = state_file_rw_long(workdir, partition_state->state_dir, "jukebox_queue_length", partition_state->jukebox_queue_length, JUKEBOX_QUEUE_MIN, JUKEBOX_QUEUE_MAX, true);
     partition_state->jukebox_last_played = state_file_rw_long(workdir, partition_state->state_dir, "jukebox_last_played", partition_state->jukebox_last_played, JUKEBOX_LAST_PLAYED_MIN, JUKEBOX_LAST_PLAYED_MAX, true);
@@ -933,6 +952,7 @@ sds mympd_api_settings_get(struct t_partition_state *partition_state, sds buffer
     buffer = sdscat(buffer, "\"partition\":{");
     const char *jukebox_mode_str = jukebox_mode_lookup(partition_state->jukebox_mode);
     buffer = tojson_char(buffer, "jukeboxMode", jukebox_mode_str, true);
+    buffer = tojson_char(buffer, "jukeboxWeight", jukebox_weight_lookup(partition_state->jukebox_weight), true);
     buffer = tojson_sds(buffer, "jukeboxPlaylist", partition_state->jukebox_playlist, true);
     buffer = tojson_long(buffer, "jukeboxQueueLength", partition_state->jukebox_queue_length, true);
     buffer = tojson_char(buffer, "jukeboxUniqueTag", mpd_tag_name(partition_state->jukebox_unique_tag.tags[0]), true);
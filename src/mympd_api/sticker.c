@@ -58,7 +58,7 @@ sds mympd_api_sticker_get_print(sds buffer, struct t_partition_state *partition_
 /**
  * Gets the stickers from sticker cache and returns a json list.
  * Shortcut for stickerdb_get_all_batch and print_sticker.
- * You must exit the stickerdb idle mode before.
+ * You must call stickerdb_batch_start before.
  * @param buffer already allocated sds string to append the list
  * @param partition_state pointer to partition state
  * @param uri song uri
@@ -17,11 +17,16 @@
 #include "src/mympd_api/timer_handlers.h"
 
 #include <errno.h>
-#include <poll.h>
 #include <stdbool.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 
+/**
+ * Clock for the timer deadlines, it continues to run while the system is suspended
+ */
+#define TIMER_CLOCK CLOCK_BOOTTIME
+
 #ifdef MYMPD_NO_TIMERFD
     #define timerfd_create(a, b) -1
     #define timerfd_settime(a, b, c, d) -1
@@ -33,9 +38,16 @@
  * Private definitions
  */
 
-static void set_timerfds(struct t_timer_list *l);
+static time_t get_boottime(void);
+static bool timer_is_due(struct t_list_node *node);
+static void heap_push(struct t_timer_list *l, struct t_list_node *node);
+static void heap_remove(struct t_timer_list *l, struct t_timer_node *timer);
+static void heap_sift_up(struct t_timer_list *l, size_t pos);
+static void heap_sift_down(struct t_timer_list *l, size_t pos);
+static void heap_set(struct t_timer_list *l, size_t pos, struct t_list_node *node);
+static time_t heap_expire(struct t_timer_list *l, size_t pos);
+static void arm_timerfd(struct t_timer_list *l);
 static void mympd_api_timer_free_node(struct t_list_node *node);
-static struct t_list_node *get_timer_from_fd(struct t_timer_list *l, int fd);
 static sds print_timer_node(sds buffer, long long timer_id, struct t_timer_node *current);
 
 /**
@@ -50,78 +62,70 @@ void mympd_api_timer_timerlist_init(struct t_timer_list *l) {
     l->active = 0;
     l->last_id = USER_TIMER_ID_START;
     list_init(&l->list);
-    set_timerfds(l);
+    l->fd = -1;
+    l->heap = NULL;
+    l->heap_len = 0;
+    l->heap_size = 0;
 }
 
 /**
- * Checks for timers and executes the callback function
+ * Checks for expired timers and executes the callback functions.
+ * The timerfd is always armed for the top of the timer heap,
+ * this function is cheap if no timer is expired.
  * @param l timer list
  */
 void mympd_api_timer_check(struct t_timer_list *l) {
-    errno = 0;
-    int read_fds = poll(l->ufds, l->ufds_len, 100);
-    if (read_fds < 0) {
-        MYMPD_LOG_ERROR(NULL, "Error polling timerfd");
-        MYMPD_LOG_ERRNO(NULL, errno);
+    if (l->heap_len == 0) {
         return;
     }
-    if (read_fds == 0) {
+    time_t now = get_boottime();
+    struct t_timer_node *top = (struct t_timer_node *)l->heap[0]->user_data;
+    if (top->expire > now) {
         //no timer triggered
         return;
     }
-
-    for (unsigned i = 0; i < l->ufds_len; i++) {
-        if (l->ufds[i].revents & POLLIN) {
-            uint64_t exp;
-            ssize_t s = read(l->ufds[i].fd, &exp, sizeof(uint64_t));
-            if (s != sizeof(uint64_t)) {
-                continue;
-            }
-            struct t_list_node *current = get_timer_from_fd(l, l->ufds[i].fd);
-            if (current == NULL) {
-                MYMPD_LOG_ERROR(NULL, "Could not get timer from fd");
-                continue;
-            }
-            struct t_timer_node *current_timer = (struct t_timer_node *)current->user_data;
-            if (current_timer->definition != NULL) {
-                //user defined timers
-                if (current_timer->definition->enabled == false) {
-                    MYMPD_LOG_DEBUG(NULL, "Skipping timer with id %lld, not enabled", current->value_i);
-                    continue;
-                }
-                time_t t = time(NULL);
-                struct tm now;
-                if (localtime_r(&t, &now) == NULL) {
-                    MYMPD_LOG_ERROR(NULL, "Localtime is NULL");
-                    continue;
-                }
-                int wday = now.tm_wday;
-                wday = wday > 0 ? wday - 1 : 6;
-                if (current_timer->definition->weekdays[wday] == false) {
-                    MYMPD_LOG_DEBUG(NULL, "Skipping timer with id %lld, not enabled on this weekday", current->value_i);
-                    continue;
-                }
-            }
-            //execute callback function
-            MYMPD_LOG_DEBUG(NULL, "Timer with id %lld triggered", current->value_i);
-            if (current_timer->callback) {
-                current_timer->callback(current->value_i, current_timer->definition);
-            }
-            //handle one shot timers
-            if (current_timer->interval == TIMER_ONE_SHOT_DISABLE &&
-                current_timer->definition != NULL)
-            {
-                //user defined "one shot and disable" timers
-                MYMPD_LOG_DEBUG(NULL, "One shot timer disabled: %lld", current->value_i);
-                current_timer->definition->enabled = false;
-            }
-            else if (current_timer->interval <= TIMER_ONE_SHOT_REMOVE) {
-                //"one shot and remove" timers
-                MYMPD_LOG_DEBUG(NULL, "One shot timer removed: %lld", current->value_i);
-                mympd_api_timer_remove(l, current->value_i);
+    //reset the timerfd
+    uint64_t exp;
+    if (read(l->fd, &exp, sizeof(uint64_t)) != sizeof(uint64_t)) {
+        MYMPD_LOG_DEBUG(NULL, "Timerfd not yet triggered");
+    }
+    while (l->heap_len > 0) {
+        struct t_list_node *current = l->heap[0];
+        struct t_timer_node *current_timer = (struct t_timer_node *)current->user_data;
+        if (current_timer->expire > now) {
+            break;
+        }
+        heap_remove(l, current_timer);
+        if (current_timer->interval > 0) {
+            //reschedule periodic timers, missed runs are skipped
+            while (current_timer->expire <= now) {
+                current_timer->expire += current_timer->interval;
             }
+            heap_push(l, current);
+        }
+        if (timer_is_due(current) == false) {
+            continue;
+        }
+        //execute callback function
+        MYMPD_LOG_DEBUG(NULL, "Timer with id %lld triggered", current->value_i);
+        if (current_timer->callback) {
+            current_timer->callback(current->value_i, current_timer->definition);
+        }
+        //handle one shot timers
+        if (current_timer->interval == TIMER_ONE_SHOT_DISABLE &&
+            current_timer->definition != NULL)
+        {
+            //user defined "one shot and disable" timers
+            MYMPD_LOG_DEBUG(NULL, "One shot timer disabled: %lld", current->value_i);
+            current_timer->definition->enabled = false;
+        }
+        else if (current_timer->interval <= TIMER_ONE_SHOT_REMOVE) {
+            //"one shot and remove" timers
+            MYMPD_LOG_DEBUG(NULL, "One shot timer removed: %lld", current->value_i);
+            mympd_api_timer_remove(l, current->value_i);
         }
     }
+    arm_timerfd(l);
 }
 
 /**
@@ -210,59 +214,38 @@ bool mympd_api_timer_add(struct t_timer_list *l, time_t timeout, int interval, t
         MYMPD_LOG_DEBUG(NULL, "Timers are not supported by platform");
         return true;
     #endif
+    if (l->fd == -1) {
+        errno = 0;
+        l->fd = timerfd_create(TIMER_CLOCK, TFD_NONBLOCK | TFD_CLOEXEC);
+        if (l->fd == -1) {
+            MYMPD_LOG_ERROR(NULL, "Can't create timerfd");
+            MYMPD_LOG_ERRNO(NULL, errno);
+            return false;
+        }
+    }
     struct t_timer_node *new_node = malloc_assert(sizeof(struct t_timer_node));
     new_node->callback = handler;
     new_node->definition = definition;
     new_node->timeout = timeout;
     new_node->interval = interval;
+    new_node->expire = get_boottime() + timeout;
+    new_node->scheduled = false;
+    new_node->heap_pos = 0;
+    list_push(&l->list, "", timer_id, NULL, new_node);
 
     if (definition == NULL ||           // internal timers
         definition->enabled == true)    // user defined timers
-    {
-        errno = 0;
-        new_node->fd = timerfd_create(CLOCK_REALTIME, TFD_NONBLOCK | TFD_CLOEXEC);
-        if (new_node->fd == -1) {
-            FREE_PTR(new_node);
-            MYMPD_LOG_ERROR(NULL, "Can't create timerfd");
-            MYMPD_LOG_ERRNO(NULL, errno);
-            return false;
-        }
-
-        struct itimerspec new_value;
-        //timeout
-        new_value.it_value.tv_sec = timeout;
-        new_value.it_value.tv_nsec = 0;
-        //interval
-        //0 = oneshot and deactivate
-        //-1 = oneshot and remove
-        new_value.it_interval.tv_sec = interval > 0
-            ? interval
-            : 0;
-        new_value.it_interval.tv_nsec = 0;
-
-        #ifdef MYMPD_NO_TIMERFD
-            (void) new_value;
-        #endif
-
-        errno = 0;
-        if (timerfd_settime(new_node->fd, 0, &new_value, NULL) == -1) {
-            FREE_PTR(new_node);
-            MYMPD_LOG_ERROR(NULL, "Can't set expiration for timer");
-            MYMPD_LOG_ERRNO(NULL, errno);
-            return false;
-        }
-    }
-    else {
-        new_node->fd = -1;
-    }
-    list_push(&l->list, "", timer_id, NULL, new_node);
-    if (definition == NULL ||
-        definition->enabled == true)
     {
         l->active++;
+        heap_push(l, l->list.tail);
+        if (new_node->scheduled == true &&
+            new_node->heap_pos == 0)
+        {
+            //new timer is the next to expire
+            arm_timerfd(l);
+        }
     }
     MYMPD_LOG_DEBUG(NULL, "Added timer with id %lld, start time in %llds", timer_id, (long long)timeout);
-    set_timerfds(l);
     return true;
 }
 
@@ -289,8 +272,14 @@ bool mympd_api_timer_remove(struct t_timer_list *l, long long timer_id) {
         {
             l->active--;
         }
+        if (timer_node->scheduled == true) {
+            bool was_next = timer_node->heap_pos == 0;
+            heap_remove(l, timer_node);
+            if (was_next == true) {
+                arm_timerfd(l);
+            }
+        }
         list_remove_node_user_data(&l->list, idx, mympd_api_timer_free_node);
-        set_timerfds(l);
         return true;
     }
     return false;
@@ -327,6 +316,10 @@ bool mympd_api_timer_toggle(struct t_timer_list *l, long long timer_id, sds *err
  */
 void mympd_api_timer_timerlist_clear(struct t_timer_list *l) {
     list_clear_user_data(&l->list, mympd_api_timer_free_node);
+    FREE_PTR(l->heap);
+    if (l->fd > -1) {
+        close(l->fd);
+    }
     mympd_api_timer_timerlist_init(l);
 }
 
@@ -603,57 +596,187 @@ bool mympd_api_timer_file_save(struct t_timer_list *timer_list, sds workdir) {
  */
 
 /**
- * Sets the timerfds to poll
- * @param l timer list
+ * Gets the current time of the timer clock in seconds,
+ * it includes the time the system was suspended
+ * @return boottime
  */
-static void set_timerfds(struct t_timer_list *l) {
-    l->ufds_len = 0;
-    memset(l->ufds, 0, sizeof(struct pollfd) * LIST_TIMER_MAX);
-    struct t_list_node *current = l->list.head;
-    while (current != NULL &&
-           l->ufds_len <= LIST_TIMER_MAX)
-    {
-        struct t_timer_node *current_timer = (struct t_timer_node *)current->user_data;
-        if (current_timer->fd > -1) {
-            l->ufds[l->ufds_len].fd = current_timer->fd;
-            l->ufds[l->ufds_len].events = POLLIN;
-            l->ufds_len++;
-        }
-        current = current->next;
+static time_t get_boottime(void) {
+    struct timespec ts;
+    clock_gettime(TIMER_CLOCK, &ts);
+    return ts.tv_sec;
+}
+
+/**
+ * Checks if a triggered user defined timer should run
+ * @param node timer node
+ * @return true if the timer should run, else false
+ */
+static bool timer_is_due(struct t_list_node *node) {
+    struct t_timer_node *timer = (struct t_timer_node *)node->user_data;
+    if (timer->definition == NULL) {
+        //internal timers
+        return true;
+    }
+    if (timer->definition->enabled == false) {
+        MYMPD_LOG_DEBUG(NULL, "Skipping timer with id %lld, not enabled", node->value_i);
+        return false;
     }
+    time_t t = time(NULL);
+    struct tm now;
+    if (localtime_r(&t, &now) == NULL) {
+        MYMPD_LOG_ERROR(NULL, "Localtime is NULL");
+        return false;
+    }
+    int wday = now.tm_wday;
+    wday = wday > 0 ? wday - 1 : 6;
+    if (timer->definition->weekdays[wday] == false) {
+        MYMPD_LOG_DEBUG(NULL, "Skipping timer with id %lld, not enabled on this weekday", node->value_i);
+        return false;
+    }
+    return true;
 }
 
 /**
- * Frees a timer node
- * @param node timer node to free
+ * Adds a timer to the timer heap
+ * @param l timer list
+ * @param node timer node to schedule
  */
-static void mympd_api_timer_free_node(struct t_list_node *node) {
+static void heap_push(struct t_timer_list *l, struct t_list_node *node) {
+    if (l->heap_len == l->heap_size) {
+        l->heap_size = l->heap_size == 0
+            ? 16
+            : l->heap_size * 2;
+        l->heap = realloc_assert(l->heap, l->heap_size * sizeof(struct t_list_node *));
+    }
     struct t_timer_node *timer = (struct t_timer_node *)node->user_data;
-    if (timer->fd > -1) {
-        close(timer->fd);
+    timer->scheduled = true;
+    heap_set(l, l->heap_len, node);
+    l->heap_len++;
+    heap_sift_up(l, timer->heap_pos);
+}
+
+/**
+ * Removes a timer from the timer heap
+ * @param l timer list
+ * @param timer timer to remove
+ */
+static void heap_remove(struct t_timer_list *l, struct t_timer_node *timer) {
+    size_t pos = timer->heap_pos;
+    timer->scheduled = false;
+    l->heap_len--;
+    if (pos == l->heap_len) {
+        return;
     }
-    if (timer->definition != NULL) {
-        mympd_api_timer_free_definition(timer->definition);
+    //move the last timer in the free slot and restore the heap order
+    struct t_list_node *last = l->heap[l->heap_len];
+    heap_set(l, pos, last);
+    heap_sift_up(l, pos);
+    heap_sift_down(l, ((struct t_timer_node *)last->user_data)->heap_pos);
+}
+
+/**
+ * Returns the expiration time of the timer at given heap position
+ * @param l timer list
+ * @param pos heap position
+ * @return expiration time of the timer clock
+ */
+static time_t heap_expire(struct t_timer_list *l, size_t pos) {
+    return ((struct t_timer_node *)l->heap[pos]->user_data)->expire;
+}
+
+/**
+ * Moves a timer up in the heap until its parent expires earlier
+ * @param l timer list
+ * @param pos heap position
+ */
+static void heap_sift_up(struct t_timer_list *l, size_t pos) {
+    struct t_list_node *node = l->heap[pos];
+    time_t expire = heap_expire(l, pos);
+    while (pos > 0) {
+        size_t parent = (pos - 1) / 2;
+        if (heap_expire(l, parent) <= expire) {
+            break;
+        }
+        heap_set(l, pos, l->heap[parent]);
+        pos = parent;
     }
-    FREE_PTR(timer);
+    heap_set(l, pos, node);
 }
 
 /**
- * Gets the timer associated with the fd
+ * Moves a timer down in the heap until its children expire later
  * @param l timer list
- * @param fd timer fd
- * @return timer for the fd
+ * @param pos heap position
  */
-static struct t_list_node *get_timer_from_fd(struct t_timer_list *l, int fd) {
-    struct t_list_node *current = l->list.head;
-    while (current != NULL) {
-        struct t_timer_node *current_timer = (struct t_timer_node *)current->user_data;
-        if (current_timer->fd == fd) {
-            return current;
+static void heap_sift_down(struct t_timer_list *l, size_t pos) {
+    struct t_list_node *node = l->heap[pos];
+    time_t expire = heap_expire(l, pos);
+    while (true) {
+        size_t child = 2 * pos + 1;
+        if (child >= l->heap_len) {
+            break;
         }
-        current = current->next;
+        if (child + 1 < l->heap_len &&
+            heap_expire(l, child + 1) < heap_expire(l, child))
+        {
+            child++;
+        }
+        if (expire <= heap_expire(l, child)) {
+            break;
+        }
+        heap_set(l, pos, l->heap[child]);
+        pos = child;
     }
-    return NULL;
+    heap_set(l, pos, node);
+}
+
+/**
+ * Sets the heap slot and updates the position of the timer
+ * @param l timer list
+ * @param pos heap position
+ * @param node timer node
+ */
+static void heap_set(struct t_timer_list *l, size_t pos, struct t_list_node *node) {
+    l->heap[pos] = node;
+    ((struct t_timer_node *)node->user_data)->heap_pos = pos;
+}
+
+/**
+ * Arms the timerfd for the next expiring timer or disarms it
+ * @param l timer list
+ */
+static void arm_timerfd(struct t_timer_list *l) {
+    if (l->fd == -1) {
+        return;
+    }
+    struct itimerspec new_value;
+    //absolute expiration time of the next timer, 0 disarms the timerfd
+    new_value.it_value.tv_sec = l->heap_len > 0
+        ? heap_expire(l, 0)
+        : 0;
+    new_value.it_value.tv_nsec = 0;
+    new_value.it_interval.tv_sec = 0;
+    new_value.it_interval.tv_nsec = 0;
+    #ifdef MYMPD_NO_TIMERFD
+        (void) new_value;
+    #endif
+    errno = 0;
+    if (timerfd_settime(l->fd, TFD_TIMER_ABSTIME, &new_value, NULL) == -1) {
+        MYMPD_LOG_ERROR(NULL, "Can't set expiration for timer");
+        MYMPD_LOG_ERRNO(NULL, errno);
+    }
+}
+
+/**
+ * Frees a timer node
+ * @param node timer node to free
+ */
+static void mympd_api_timer_free_node(struct t_list_node *node) {
+    struct t_timer_node *timer = (struct t_timer_node *)node->user_data;
+    if (timer->definition != NULL) {
+        mympd_api_timer_free_definition(timer->definition);
+    }
+    FREE_PTR(timer);
 }
 
 /**
@@ -25,11 +25,13 @@ typedef void (*timer_handler)(long long timer_id, struct t_timer_definition *def
  * Timer node
  */
 struct t_timer_node {
-    int fd;                                 //!< holds the timerfd
     timer_handler callback;                 //!< timer callback function
     struct t_timer_definition *definition;  //!< optional pointer to timer definition (GUI)
     time_t timeout;                         //!< seconds when timer will run
     int interval;                           //!< reschedule timer interval
+    time_t expire;                          //!< CLOCK_BOOTTIME in seconds of the next run
+    bool scheduled;                         //!< true if the timer is in the timer heap
+    size_t heap_pos;                        //!< position in the timer heap
 };
 
 void mympd_api_timer_timerlist_init(struct t_timer_list *l);
@@ -18,25 +18,10 @@
 #include "src/lib/sds_extras.h"
 #include "src/lib/utility.h"
 #include "src/lib/validate.h"
+#include "src/web_server/coverextract.h"
 
 #include <libgen.h>
 
-//optional includes
-#ifdef MYMPD_ENABLE_LIBID3TAG
-    #include <id3tag.h>
-#endif
-
-#ifdef MYMPD_ENABLE_FLAC
-    #include <FLAC/metadata.h>
-#endif
-
-/**
- * Privat definitions
- */
-static bool handle_coverextract(struct mg_connection *nc, sds cachedir, const char *uri, const char *media_file, bool covercache, int offset);
-static bool handle_coverextract_id3(sds cachedir, const char *uri, const char *media_file, sds *binary, bool covercache, int offset);
-static bool handle_coverextract_flac(sds cachedir, const char *uri, const char *media_file, sds *binary, bool is_ogg, bool covercache, int offset);
-
 /**
  * Public functions
  */
@@ -118,7 +103,8 @@ void request_handler_albumart_by_album_id(struct mg_http_message *hm, long long
  * @param conn_id connection id
  * @param size albumart size
  * @return true: an image was served,
- *         false: request was sent to the mympd_api thread to get the image by MPD
+ *         false: request was sent to the coverextract threads or
+ *                to the mympd_api thread to get the image by MPD
  */
 bool request_handler_albumart_by_uri(struct mg_connection *nc, struct mg_http_message *hm,
         struct t_mg_user_data *mg_user_data, long long conn_id, enum albumart_sizes size)
@@ -222,8 +208,59 @@ bool request_handler_albumart_by_uri(struct mg_connection *nc, struct mg_http_me
         return true;
     }
 
+    //thumbnails are created in the covercache
+    bool create_thumbnail = size == ALBUMART_THUMBNAIL &&
+        config->covercache_keep_days > 0;
+
+    //check covercache for the thumbnail
+    if (create_thumbnail == true &&
+        check_covercache(nc, hm, mg_user_data, uri_decoded, offset, true) == true)
+    {
+        FREE_SDS(uri_decoded);
+        return true;
+    }
+
+    //check the results of previous lookups
+    sds lookup_file = sdsempty();
+    switch (covercache_lookup_get(uri_decoded, offset, size, &lookup_file)) {
+        case COVERCACHE_LOOKUP_FOUND: {
+            const char *mime_type = get_mime_type_by_ext(lookup_file);
+            MYMPD_LOG_DEBUG(NULL, "Serving file %s (%s)", lookup_file, mime_type);
+            static struct mg_http_serve_opts s_http_server_opts;
+            s_http_server_opts.root_dir = mg_user_data->browse_directory;
+            s_http_server_opts.extra_headers = EXTRA_HEADERS_IMAGE;
+            s_http_server_opts.mime_types = EXTRA_MIME_TYPES;
+            mg_http_serve_file(nc, hm, lookup_file, &s_http_server_opts);
+            webserver_handle_connection_close(nc);
+            FREE_SDS(lookup_file);
+            FREE_SDS(uri_decoded);
+            return true;
+        }
+        case COVERCACHE_LOOKUP_MISSING:
+            MYMPD_LOG_DEBUG(NULL, "No coverimage available for \"%s\" (cached)", uri_decoded);
+            webserver_serve_na_image(nc);
+            FREE_SDS(lookup_file);
+            FREE_SDS(uri_decoded);
+            return true;
+        case COVERCACHE_LOOKUP_UNKNOWN:
+            break;
+    }
+    FREE_SDS(lookup_file);
+
     //check covercache
-    if (check_covercache(nc, hm, mg_user_data, uri_decoded, offset) == true) {
+    if (create_thumbnail == true) {
+        //create the thumbnail from the cached image
+        sds covercachefile = sdsempty();
+        if (covercache_index_get(uri_decoded, offset, false, &covercachefile) == true &&
+            coverextract_queue_thumbnail(conn_id, uri_decoded, covercachefile, offset, config->cachedir) == true)
+        {
+            FREE_SDS(covercachefile);
+            FREE_SDS(uri_decoded);
+            return false;
+        }
+        FREE_SDS(covercachefile);
+    }
+    if (check_covercache(nc, hm, mg_user_data, uri_decoded, offset, false) == true) {
         FREE_SDS(uri_decoded);
         return true;
     }
@@ -243,6 +280,7 @@ bool request_handler_albumart_by_uri(struct mg_connection *nc, struct mg_http_me
                 path = sds_dirname(path);
             }
             bool found = false;
+            bool found_thumbnail = false;
             sds coverfile = sdsempty();
             if (size == ALBUMART_THUMBNAIL) {
                 //thumbnail images
@@ -256,6 +294,7 @@ bool request_handler_albumart_by_uri(struct mg_connection *nc, struct mg_http_me
                         testfile_read(coverfile) == true)
                     {
                         found = true;
+                        found_thumbnail = true;
                         break;
                     }
                     sdsclear(coverfile);
@@ -277,7 +316,20 @@ bool request_handler_albumart_by_uri(struct mg_connection *nc, struct mg_http_me
                     sdsclear(coverfile);
                 }
             }
+            if (found == true &&
+                found_thumbnail == false &&
+                create_thumbnail == true &&
+                coverextract_queue_thumbnail(conn_id, uri_decoded, coverfile, offset, config->cachedir) == true)
+            {
+                //the coverextract thread sends the thumbnail
+                FREE_SDS(uri_decoded);
+                FREE_SDS(coverfile);
+                FREE_SDS(mediafile);
+                FREE_SDS(path);
+                return false;
+            }
             if (found == true) {
+                covercache_lookup_set(uri_decoded, offset, size, coverfile);
                 const char *mime_type = get_mime_type_by_ext(coverfile);
                 MYMPD_LOG_DEBUG(NULL, "Serving file %s (%s)", coverfile, mime_type);
                 static struct mg_http_serve_opts s_http_server_opts;
@@ -300,13 +352,15 @@ bool request_handler_albumart_by_uri(struct mg_connection *nc, struct mg_http_me
 
         if (testfile_read(mediafile) == true)
         {
-            //try to extract albumart from media file
+            //try to extract albumart from media file in the coverextract threads,
+            //they send the response or ask mpd
             bool covercache = mg_user_data->config->covercache_keep_days > 0 ? true : false;
-            bool rc = handle_coverextract(nc, config->cachedir, uri_decoded, mediafile, covercache, offset);
-            if (rc == true) {
+            if (coverextract_queue(conn_id, uri_decoded, mediafile, offset, size,
+                    config->cachedir, covercache, mg_user_data->feat_albumart) == true)
+            {
                 FREE_SDS(uri_decoded);
                 FREE_SDS(mediafile);
-                return true;
+                return false;
             }
         }
         FREE_SDS(mediafile);
@@ -318,7 +372,8 @@ bool request_handler_albumart_by_uri(struct mg_connection *nc, struct mg_http_me
     {
         MYMPD_LOG_DEBUG(NULL, "Sending getalbumart to mpd_client_queue");
         struct t_work_request *request = create_request(conn_id, 0, INTERNAL_API_ALBUMART_BY_URI, NULL, MPD_PARTITION_DEFAULT);
-        request->data = tojson_sds(request->data, "uri", uri_decoded, false);
+        request->data = tojson_sds(request->data, "uri", uri_decoded, true);
+        request->data = tojson_uint(request->data, "size", size, false);
         request->data = jsonrpc_end(request->data);
         mympd_queue_push(mympd_api_queue, request, 0);
         FREE_SDS(uri_decoded);
@@ -326,197 +381,8 @@ bool request_handler_albumart_by_uri(struct mg_connection *nc, struct mg_http_me
     }
 
     MYMPD_LOG_INFO(NULL, "No coverimage found for \"%s\"", uri_decoded);
+    covercache_lookup_set(uri_decoded, offset, size, NULL);
     FREE_SDS(uri_decoded);
     webserver_serve_na_image(nc);
     return true;
 }
-
-/**
- * Extracts albumart from media files
- * @param nc mongoose connection
- * @param cachedir covercache directory
- * @param uri song uri
- * @param media_file full path to the song
- * @param covercache true = covercache is enabled
- * @param offset number of embedded image to extract
- * @return true on success, else false
- */
-static bool handle_coverextract(struct mg_connection *nc, sds cachedir,
-        const char *uri, const char *media_file, bool covercache, int offset)
-{
-    bool rc = false;
-    const char *mime_type_media_file = get_mime_type_by_ext(media_file);
-    MYMPD_LOG_DEBUG(NULL, "Handle coverextract for uri \"%s\"", uri);
-    MYMPD_LOG_DEBUG(NULL, "Mimetype of %s is %s", media_file, mime_type_media_file);
-    sds binary = sdsempty();
-    if (strcmp(mime_type_media_file, "audio/mpeg") == 0) {
-        rc = handle_coverextract_id3(cachedir, uri, media_file, &binary, covercache, offset);
-    }
-    else if (strcmp(mime_type_media_file, "audio/ogg") == 0) {
-        rc = handle_coverextract_flac(cachedir, uri, media_file, &binary, true, covercache, offset);
-    }
-    else if (strcmp(mime_type_media_file, "audio/flac") == 0) {
-        rc = handle_coverextract_flac(cachedir, uri, media_file, &binary, false, covercache, offset);
-    }
-    if (rc == true) {
-        const char *mime_type = get_mime_type_by_magic_stream(binary);
-        MYMPD_LOG_DEBUG(NULL, "Serving coverimage for \"%s\" (%s)", media_file, mime_type);
-        sds headers = sdscatfmt(sdsempty(), "Content-Type: %s\r\n", mime_type);
-        headers = sdscat(headers, EXTRA_HEADERS_IMAGE);
-        webserver_send_data(nc, binary,  sdslen(binary), headers);
-        FREE_SDS(headers);
-    }
-    FREE_SDS(binary);
-    return rc;
-}
-
-/**
- * Extracts albumart from id3v2 tagged files
- * @param cachedir covercache directory
- * @param uri song uri
- * @param media_file full path to the song
- * @param binary pointer to already allocates sds string to hold the image
- * @param covercache true = covercache is enabled
- * @param offset number of embedded image to extract
- * @return true on success, else false
- */
-static bool handle_coverextract_id3(sds cachedir, const char *uri, const char *media_file,
-        sds *binary, bool covercache, int offset)
-{
-    bool rc = false;
-    #ifdef MYMPD_ENABLE_LIBID3TAG
-    MYMPD_LOG_DEBUG(NULL, "Exctracting coverimage from %s", media_file);
-    struct id3_file *file_struct = id3_file_open(media_file, ID3_FILE_MODE_READONLY);
-    if (file_struct == NULL) {
-        MYMPD_LOG_ERROR(NULL, "Can't parse id3_file: %s", media_file);
-        return false;
-    }
-    struct id3_tag *tags = id3_file_tag(file_struct);
-    if (tags == NULL) {
-        MYMPD_LOG_ERROR(NULL, "Can't read id3 tags from file: %s", media_file);
-        return false;
-    }
-    struct id3_frame *frame = id3_tag_findframe(tags, "APIC", (unsigned)offset);
-    if (frame != NULL) {
-        id3_length_t length = 0;
-        const id3_byte_t *pic = id3_field_getbinarydata(id3_frame_field(frame, 4), &length);
-        if (length > 0) {
-            *binary = sdscatlen(*binary, pic, length);
-            const char *mime_type = get_mime_type_by_magic_stream(*binary);
-            if (mime_type != NULL) {
-                if (covercache == true) {
-                    covercache_write_file(cachedir, uri, mime_type, *binary, offset);
-                }
-                else {
-                    MYMPD_LOG_DEBUG(NULL, "Covercache is disabled");
-                }
-                MYMPD_LOG_DEBUG(NULL, "Coverimage successfully extracted (%lu bytes)", (unsigned long)sdslen(*binary));
-                rc = true;
-            }
-            else {
-                MYMPD_LOG_WARN(NULL, "Could not determine mimetype, discarding image");
-                sdsclear(*binary);
-            }
-        }
-        else {
-            MYMPD_LOG_WARN(NULL, "Embedded picture size is zero");
-        }
-    }
-    else {
-        MYMPD_LOG_DEBUG(NULL, "No embedded picture detected");
-    }
-    id3_file_close(file_struct);
-    #else
-    (void) cachedir;
-    (void) uri;
-    (void) media_file;
-    (void) binary;
-    (void) covercache;
-    (void) offset;
-    #endif
-    return rc;
-}
-
-/**
- * Extracts albumart from vorbis tagged files
- * @param cachedir covercache directory
- * @param uri song uri
- * @param media_file full path to the song
- * @param binary pointer to already allocates sds string to hold the image
- * @param is_ogg true if it is a ogg file, false if it is a flac file
- * @param covercache true = covercache is enabled
- * @param offset number of embedded image to extract
- * @return true on success, else false
- */
-static bool handle_coverextract_flac(sds cachedir, const char *uri, const char *media_file,
-        sds *binary, bool is_ogg, bool covercache, int offset)
-{
-    bool rc = false;
-    #ifdef MYMPD_ENABLE_FLAC
-    MYMPD_LOG_DEBUG(NULL, "Exctracting coverimage from %s", media_file);
-    FLAC__StreamMetadata *metadata = NULL;
-
-    FLAC__Metadata_Chain *chain = FLAC__metadata_chain_new();
-
-    if(! (is_ogg? FLAC__metadata_chain_read_ogg(chain, media_file) : FLAC__metadata_chain_read(chain, media_file)) ) {
-        MYMPD_LOG_ERROR(NULL, "Error reading metadata from \"%s\"", media_file);
-        FLAC__metadata_chain_delete(chain);
-        return false;
-    }
-
-    FLAC__Metadata_Iterator *iterator = FLAC__metadata_iterator_new();
-    FLAC__metadata_iterator_init(iterator, chain);
-    if (iterator == NULL) {
-        MYMPD_LOG_ERROR(NULL, "Error initializing iterator for \"%s\"", media_file);
-        FLAC__metadata_chain_delete(chain);
-        return false;
-    }
-    int i = 0;
-    do {
-        FLAC__StreamMetadata *block = FLAC__metadata_iterator_get_block(iterator);
-        if (block->type == FLAC__METADATA_TYPE_PICTURE) {
-            if (i == offset) {
-                metadata = block;
-                break;
-            }
-            i++;
-        }
-    } while (FLAC__metadata_iterator_next(iterator) && metadata == NULL);
-
-    if (metadata == NULL) {
-        MYMPD_LOG_DEBUG(NULL, "No embedded picture detected");
-    }
-    else if (metadata->data.picture.data_length > 0) {
-        *binary = sdscatlen(*binary, metadata->data.picture.data, metadata->data.picture.data_length);
-        const char *mime_type = get_mime_type_by_magic_stream(*binary);
-        if (mime_type != NULL) {
-            if (covercache == true) {
-                covercache_write_file(cachedir, uri, mime_type, *binary, offset);
-            }
-            else {
-                MYMPD_LOG_DEBUG(NULL, "Covercache is disabled");
-            }
-            MYMPD_LOG_DEBUG(NULL, "Coverimage successfully extracted (%lu bytes)", (unsigned long)sdslen(*binary));
-            rc = true;
-        }
-        else {
-            MYMPD_LOG_WARN(NULL, "Could not determine mimetype, discarding image");
-            sdsclear(*binary);
-        }
-    }
-    else {
-        MYMPD_LOG_WARN(NULL, "Embedded picture size is zero");
-    }
-    FLAC__metadata_iterator_delete(iterator);
-    FLAC__metadata_chain_delete(chain);
-    #else
-    (void) cachedir;
-    (void) uri;
-    (void) media_file;
-    (void) binary;
-    (void) is_ogg;
-    (void) covercache;
-    (void) offset;
-    #endif
-    return rc;
-}
@@ -0,0 +1,644 @@
+/*
+ SPDX-License-Identifier: GPL-3.0-or-later
+ myMPD (c) 2018-2023 Juergen Mang <mail@jcgames.de>
+ https://github.com/jcorporation/mympd
+*/
+
+#include "compile_time.h"
+#include "src/web_server/coverextract.h"
+
+#include "src/lib/api.h"
+#include "src/lib/covercache.h"
+#include "src/lib/jsonrpc.h"
+#include "src/lib/list.h"
+#include "src/lib/log.h"
+#include "src/lib/mem.h"
+#include "src/lib/mimetype.h"
+#include "src/lib/msg_queue.h"
+#include "src/lib/sds_extras.h"
+#include "src/lib/thread.h"
+#include "src/lib/thumbnail.h"
+#include "src/web_server/albumart.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <string.h>
+
+//optional includes
+#ifdef MYMPD_ENABLE_LIBID3TAG
+    #include <id3tag.h>
+#endif
+
+#ifdef MYMPD_ENABLE_FLAC
+    #include <FLAC/metadata.h>
+#endif
+
+/**
+ * Private definitions
+ */
+
+/**
+ * Job types
+ */
+enum coverextract_types {
+    COVEREXTRACT_EMBEDDED,   //!< extract an embedded image from a media file
+    COVEREXTRACT_THUMBNAIL   //!< create a thumbnail from an image file
+};
+
+/**
+ * Extraction job for an embedded image or a thumbnail
+ */
+struct t_coverextract_job {
+    enum coverextract_types type;     //!< job type
+    sds uri;                          //!< song uri
+    sds media_file;                   //!< full path to the song or the image file
+    int offset;                       //!< number of the embedded image
+    unsigned size;                    //!< requested albumart size
+    sds cachedir;                     //!< covercache directory
+    bool covercache;                  //!< true = covercache is enabled
+    bool feat_albumart;               //!< true = ask mpd if no image is found
+    bool running;                     //!< a thread is extracting the image
+    struct t_list conn_ids;           //!< waiting http connections
+    struct t_coverextract_job *next;  //!< next job
+};
+
+/**
+ * Thread pool for the cover extraction and thumbnail creation.
+ * Jobs are queued from the webserver thread, the threads send the
+ * images as responses through the web_server_queue.
+ */
+struct t_coverextract_pool {
+    pthread_mutex_t mutex;                          //!< protects the pool
+    pthread_cond_t wakeup;                          //!< signals new jobs and the stop condition
+    struct t_coverextract_job *head;                //!< queued and running jobs
+    pthread_t threads[COVEREXTRACT_THREADS];        //!< the threads
+    unsigned threads_len;                           //!< number of started threads
+    bool stop;                                      //!< stop condition for the threads
+};
+
+static struct t_coverextract_pool pool = {
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+    .wakeup = PTHREAD_COND_INITIALIZER,
+    .head = NULL,
+    .threads_len = 0,
+    .stop = false
+};
+
+static bool queue_job(enum coverextract_types type, long long conn_id, const char *uri, const char *media_file,
+        int offset, unsigned size, sds cachedir, bool covercache, bool feat_albumart);
+static bool is_supported_mime_type(const char *mime_type);
+static struct t_coverextract_job *find_job(enum coverextract_types type, const char *media_file, int offset, unsigned size);
+static struct t_coverextract_job *get_queued_job(void);
+static void unlink_job(struct t_coverextract_job *job);
+static void free_job(struct t_coverextract_job *job);
+static void *coverextract_run(void *arg);
+static void send_result(struct t_coverextract_job *job, bool rc, sds binary);
+static bool coverextract(struct t_coverextract_job *job, sds *binary);
+static bool read_image_file(const char *image_file, sds *binary);
+static void create_thumbnail(struct t_coverextract_job *job, sds *binary);
+static bool coverextract_id3(sds cachedir, const char *uri, const char *media_file, sds *binary, bool covercache, int offset);
+static bool coverextract_flac(sds cachedir, const char *uri, const char *media_file, sds *binary, bool is_ogg, bool covercache, int offset);
+
+/**
+ * Public functions
+ */
+
+/**
+ * Queues the extraction of an embedded image.
+ * Requests for the same image are coalesced and answered together.
+ * @param conn_id http connection id to send the response
+ * @param uri song uri
+ * @param media_file full path to the song
+ * @param offset number of embedded image to extract
+ * @param size requested albumart size
+ * @param cachedir covercache directory
+ * @param covercache true = covercache is enabled
+ * @param feat_albumart true = ask mpd if no image is found
+ * @return true if the extraction was queued,
+ *         false if the file type is not supported
+ */
+bool coverextract_queue(long long conn_id, const char *uri, const char *media_file, int offset,
+        unsigned size, sds cachedir, bool covercache, bool feat_albumart)
+{
+    if (is_supported_mime_type(get_mime_type_by_ext(media_file)) == false) {
+        return false;
+    }
+    return queue_job(COVEREXTRACT_EMBEDDED, conn_id, uri, media_file, offset, size, cachedir, covercache, feat_albumart);
+}
+
+/**
+ * Queues the creation of a thumbnail from an image file.
+ * The thumbnail is written to the covercache and sent to the client.
+ * @param conn_id http connection id to send the response
+ * @param uri song uri
+ * @param image_file full path to the image
+ * @param offset number of the image
+ * @param cachedir covercache directory
+ * @return true if the thumbnail creation was queued,
+ *         false if the image type is not supported
+ */
+bool coverextract_queue_thumbnail(long long conn_id, const char *uri, const char *image_file, int offset,
+        sds cachedir)
+{
+    if (thumbnail_is_supported(get_mime_type_by_ext(image_file)) == false) {
+        return false;
+    }
+    return queue_job(COVEREXTRACT_THUMBNAIL, conn_id, uri, image_file, offset, ALBUMART_THUMBNAIL, cachedir, true, false);
+}
+
+/**
+ * Stops the coverextract threads.
+ * Discards the queued jobs and waits for the running extractions.
+ */
+void coverextract_stop(void) {
+    pthread_mutex_lock(&pool.mutex);
+    pool.stop = true;
+    pthread_cond_broadcast(&pool.wakeup);
+    unsigned threads_len = pool.threads_len;
+    pthread_mutex_unlock(&pool.mutex);
+    for (unsigned i = 0; i < threads_len; i++) {
+        pthread_join(pool.threads[i], NULL);
+    }
+    pool.threads_len = 0;
+    while (pool.head != NULL) {
+        struct t_coverextract_job *job = pool.head;
+        pool.head = job->next;
+        free_job(job);
+    }
+}
+
+/**
+ * Private functions
+ */
+
+/**
+ * Queues a job, requests for the same image are coalesced
+ * @param type job type
+ * @param conn_id http connection id to send the response
+ * @param uri song uri
+ * @param media_file full path to the song or the image
+ * @param offset number of the image
+ * @param size requested albumart size
+ * @param cachedir covercache directory
+ * @param covercache true = covercache is enabled
+ * @param feat_albumart true = ask mpd if no image is found
+ * @return true if the job was queued, else false
+ */
+static bool queue_job(enum coverextract_types type, long long conn_id, const char *uri, const char *media_file,
+        int offset, unsigned size, sds cachedir, bool covercache, bool feat_albumart)
+{
+    pthread_mutex_lock(&pool.mutex);
+    struct t_coverextract_job *job = find_job(type, media_file, offset, size);
+    if (job != NULL) {
+        MYMPD_LOG_DEBUG(NULL, "Coalescing coverextract for \"%s\"", uri);
+        list_push(&job->conn_ids, "", conn_id, NULL, NULL);
+        pthread_mutex_unlock(&pool.mutex);
+        return true;
+    }
+    if (pool.threads_len < COVEREXTRACT_THREADS) {
+        if (pthread_create(&pool.threads[pool.threads_len], NULL, coverextract_run, NULL) == 0) {
+            pool.threads_len++;
+        }
+        else {
+            MYMPD_LOG_ERROR(NULL, "Can not create coverextract thread");
+            if (pool.threads_len == 0) {
+                pthread_mutex_unlock(&pool.mutex);
+                return false;
+            }
+        }
+    }
+    MYMPD_LOG_DEBUG(NULL, "Queuing coverextract for \"%s\"", uri);
+    job = malloc_assert(sizeof(struct t_coverextract_job));
+    job->type = type;
+    job->uri = sdsnew(uri);
+    job->media_file = sdsnew(media_file);
+    job->offset = offset;
+    job->size = size;
+    job->cachedir = sdsdup(cachedir);
+    job->covercache = covercache;
+    job->feat_albumart = feat_albumart;
+    job->running = false;
+    list_init(&job->conn_ids);
+    list_push(&job->conn_ids, "", conn_id, NULL, NULL);
+    job->next = pool.head;
+    pool.head = job;
+    pthread_cond_signal(&pool.wakeup);
+    pthread_mutex_unlock(&pool.mutex);
+    return true;
+}
+
+/**
+ * Checks if embedded images can be extracted from this file type
+ * @param mime_type mime type of the media file
+ * @return true if supported, else false
+ */
+static bool is_supported_mime_type(const char *mime_type) {
+    #ifdef MYMPD_ENABLE_LIBID3TAG
+    if (strcmp(mime_type, "audio/mpeg") == 0) {
+        return true;
+    }
+    #endif
+    #ifdef MYMPD_ENABLE_FLAC
+    if (strcmp(mime_type, "audio/ogg") == 0 ||
+        strcmp(mime_type, "audio/flac") == 0)
+    {
+        return true;
+    }
+    #endif
+    (void) mime_type;
+    return false;
+}
+
+/**
+ * Finds a queued or running job for the image.
+ * The pool mutex must be locked.
+ * @param type job type
+ * @param media_file full path to the song or the image
+ * @param offset number of the embedded image
+ * @param size requested albumart size
+ * @return the job or NULL if not found
+ */
+static struct t_coverextract_job *find_job(enum coverextract_types type, const char *media_file, int offset, unsigned size) {
+    for (struct t_coverextract_job *job = pool.head; job != NULL; job = job->next) {
+        if (job->type == type &&
+            job->offset == offset &&
+            job->size == size &&
+            strcmp(job->media_file, media_file) == 0)
+        {
+            return job;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Gets the oldest job that is not running.
+ * The pool mutex must be locked.
+ * @return the job or NULL if no job is waiting
+ */
+static struct t_coverextract_job *get_queued_job(void) {
+    struct t_coverextract_job *queued = NULL;
+    //new jobs are prepended, the last waiting job is the oldest
+    for (struct t_coverextract_job *job = pool.head; job != NULL; job = job->next) {
+        if (job->running == false) {
+            queued = job;
+        }
+    }
+    return queued;
+}
+
+/**
+ * Removes the job from the pool.
+ * The pool mutex must be locked.
+ * @param job the job to remove
+ */
+static void unlink_job(struct t_coverextract_job *job) {
+    struct t_coverextract_job **current = &pool.head;
+    while (*current != NULL) {
+        if (*current == job) {
+            *current = job->next;
+            job->next = NULL;
+            return;
+        }
+        current = &(*current)->next;
+    }
+}
+
+/**
+ * Frees the job
+ * @param job the job to free
+ */
+static void free_job(struct t_coverextract_job *job) {
+    FREE_SDS(job->uri);
+    FREE_SDS(job->media_file);
+    FREE_SDS(job->cachedir);
+    list_clear(&job->conn_ids);
+    FREE_PTR(job);
+}
+
+/**
+ * Main function of the coverextract threads
+ * @param arg not used
+ * @return NULL
+ */
+static void *coverextract_run(void *arg) {
+    (void) arg;
+    thread_logname = sds_replace(thread_logname, "coverextract");
+    set_threadname(thread_logname);
+    pthread_mutex_lock(&pool.mutex);
+    while (true) {
+        struct t_coverextract_job *job;
+        while ((job = get_queued_job()) == NULL &&
+            pool.stop == false)
+        {
+            pthread_cond_wait(&pool.wakeup, &pool.mutex);
+        }
+        if (pool.stop == true) {
+            break;
+        }
+        job->running = true;
+        pthread_mutex_unlock(&pool.mutex);
+
+        sds binary = sdsempty();
+        bool rc = job->type == COVEREXTRACT_EMBEDDED
+            ? coverextract(job, &binary)
+            : read_image_file(job->media_file, &binary);
+        if (rc == true &&
+            job->covercache == true &&
+            job->size == ALBUMART_THUMBNAIL)
+        {
+            create_thumbnail(job, &binary);
+        }
+
+        pthread_mutex_lock(&pool.mutex);
+        //no more requests can join the job
+        unlink_job(job);
+        pthread_mutex_unlock(&pool.mutex);
+        send_result(job, rc, binary);
+        FREE_SDS(binary);
+        free_job(job);
+        pthread_mutex_lock(&pool.mutex);
+    }
+    pthread_mutex_unlock(&pool.mutex);
+    FREE_SDS(thread_logname);
+    return NULL;
+}
+
+/**
+ * Sends the extracted image to all waiting connections.
+ * If no image was found, the requests are sent to the mympd_api thread to ask mpd
+ * or the webserver serves the not available image.
+ * @param job the finished job
+ * @param rc true if an image was extracted, else false
+ * @param binary the image
+ */
+static void send_result(struct t_coverextract_job *job, bool rc, sds binary) {
+    const char *mime_type = rc == true
+        ? get_mime_type_by_magic_stream(binary)
+        : NULL;
+    if (rc == false &&
+        job->type == COVEREXTRACT_EMBEDDED &&
+        (job->feat_albumart == false || job->offset > 0))
+    {
+        //remember that no image is available
+        covercache_lookup_set(job->uri, job->offset, job->size, NULL);
+    }
+    struct t_list_node *current = job->conn_ids.head;
+    while (current != NULL) {
+        if (rc == false &&
+            job->type == COVEREXTRACT_EMBEDDED &&
+            job->feat_albumart == true &&
+            job->offset == 0)
+        {
+            //ask mpd - mpd can read only first image
+            MYMPD_LOG_DEBUG(NULL, "Sending getalbumart to mpd_client_queue");
+            struct t_work_request *request = create_request(current->value_i, 0, INTERNAL_API_ALBUMART_BY_URI, NULL, MPD_PARTITION_DEFAULT);
+            request->data = tojson_sds(request->data, "uri", job->uri, true);
+            request->data = tojson_uint(request->data, "size", job->size, false);
+            request->data = jsonrpc_end(request->data);
+            mympd_queue_push(mympd_api_queue, request, 0);
+        }
+        else {
+            struct t_work_response *response = create_response_new(current->value_i, 0, INTERNAL_API_ALBUMART_BY_URI, MPD_PARTITION_DEFAULT);
+            if (rc == true) {
+                response->data = jsonrpc_respond_start(response->data, INTERNAL_API_ALBUMART_BY_URI, 0);
+                response->data = tojson_char(response->data, "mime_type", mime_type, false);
+                response->data = jsonrpc_end(response->data);
+                response->binary = sdscatsds(response->binary, binary);
+            }
+            else {
+                //the webserver serves the not available image
+                MYMPD_LOG_INFO(NULL, "No coverimage found for \"%s\"", job->uri);
+            }
+            mympd_queue_push(web_server_queue, response, 0);
+        }
+        current = current->next;
+    }
+}
+
+/**
+ * Extracts albumart from media files
+ * @param job the job
+ * @param binary pointer to already allocated sds string to hold the image
+ * @return true on success, else false
+ */
+static bool coverextract(struct t_coverextract_job *job, sds *binary) {
+    const char *mime_type_media_file = get_mime_type_by_ext(job->media_file);
+    MYMPD_LOG_DEBUG(NULL, "Handle coverextract for uri \"%s\"", job->uri);
+    MYMPD_LOG_DEBUG(NULL, "Mimetype of %s is %s", job->media_file, mime_type_media_file);
+    if (strcmp(mime_type_media_file, "audio/mpeg") == 0) {
+        return coverextract_id3(job->cachedir, job->uri, job->media_file, binary, job->covercache, job->offset);
+    }
+    if (strcmp(mime_type_media_file, "audio/ogg") == 0) {
+        return coverextract_flac(job->cachedir, job->uri, job->media_file, binary, true, job->covercache, job->offset);
+    }
+    if (strcmp(mime_type_media_file, "audio/flac") == 0) {
+        return coverextract_flac(job->cachedir, job->uri, job->media_file, binary, false, job->covercache, job->offset);
+    }
+    return false;
+}
+
+/**
+ * Reads an image file
+ * @param image_file full path to the image
+ * @param binary pointer to already allocated sds string to hold the image
+ * @return true on success, else false
+ */
+static bool read_image_file(const char *image_file, sds *binary) {
+    errno = 0;
+    FILE *fp = fopen(image_file, OPEN_FLAGS_READ);
+    if (fp == NULL) {
+        MYMPD_LOG_ERROR(NULL, "Error opening file \"%s\"", image_file);
+        MYMPD_LOG_ERRNO(NULL, errno);
+        return false;
+    }
+    char buffer[BUFSIZ];
+    size_t read;
+    while ((read = fread(buffer, 1, sizeof(buffer), fp)) > 0) {
+        *binary = sdscatlen(*binary, buffer, read);
+        if (sdslen(*binary) > COVERCACHE_THUMBNAIL_SOURCE_MAX) {
+            MYMPD_LOG_WARN(NULL, "Image \"%s\" is too large", image_file);
+            sdsclear(*binary);
+            break;
+        }
+    }
+    (void) fclose(fp);
+    return sdslen(*binary) > 0;
+}
+
+/**
+ * Creates a thumbnail and writes it to the covercache.
+ * The image is replaced by the thumbnail.
+ * If no thumbnail can be created, the original image file is
+ * remembered to serve it directly for following requests.
+ * @param job the job
+ * @param binary pointer to the image
+ */
+static void create_thumbnail(struct t_coverextract_job *job, sds *binary) {
+    const char *mime_type = get_mime_type_by_magic_stream(*binary);
+    sds thumbnail = sdsempty();
+    if (thumbnail_is_supported(mime_type) == true &&
+        thumbnail_create(*binary, mime_type, COVERCACHE_THUMBNAIL_SIZE, &thumbnail) == true)
+    {
+        MYMPD_LOG_DEBUG(NULL, "Created thumbnail for \"%s\": %lu bytes", job->uri, (unsigned long)sdslen(thumbnail));
+        covercache_write_thumbnail(job->cachedir, job->uri, get_mime_type_by_magic_stream(thumbnail), thumbnail, job->offset);
+        FREE_SDS(*binary);
+        *binary = thumbnail;
+        return;
+    }
+    if (job->type == COVEREXTRACT_THUMBNAIL) {
+        covercache_lookup_set(job->uri, job->offset, job->size, job->media_file);
+    }
+    FREE_SDS(thumbnail);
+}
+
+/**
+ * Extracts albumart from id3v2 tagged files
+ * @param cachedir covercache directory
+ * @param uri song uri
+ * @param media_file full path to the song
+ * @param binary pointer to already allocates sds string to hold the image
+ * @param covercache true = covercache is enabled
+ * @param offset number of embedded image to extract
+ * @return true on success, else false
+ */
+static bool coverextract_id3(sds cachedir, const char *uri, const char *media_file,
+        sds *binary, bool covercache, int offset)
+{
+    bool rc = false;
+    #ifdef MYMPD_ENABLE_LIBID3TAG
+    MYMPD_LOG_DEBUG(NULL, "Exctracting coverimage from %s", media_file);
+    struct id3_file *file_struct = id3_file_open(media_file, ID3_FILE_MODE_READONLY);
+    if (file_struct == NULL) {
+        MYMPD_LOG_ERROR(NULL, "Can't parse id3_file: %s", media_file);
+        return false;
+    }
+    struct id3_tag *tags = id3_file_tag(file_struct);
+    if (tags == NULL) {
+        MYMPD_LOG_ERROR(NULL, "Can't read id3 tags from file: %s", media_file);
+        return false;
+    }
+    struct id3_frame *frame = id3_tag_findframe(tags, "APIC", (unsigned)offset);
+    if (frame != NULL) {
+        id3_length_t length = 0;
+        const id3_byte_t *pic = id3_field_getbinarydata(id3_frame_field(frame, 4), &length);
+        if (length > 0) {
+            *binary = sdscatlen(*binary, pic, length);
+            const char *mime_type = get_mime_type_by_magic_stream(*binary);
+            if (mime_type != NULL) {
+                if (covercache == true) {
+                    covercache_write_file(cachedir, uri, mime_type, *binary, offset);
+                }
+                else {
+                    MYMPD_LOG_DEBUG(NULL, "Covercache is disabled");
+                }
+                MYMPD_LOG_DEBUG(NULL, "Coverimage successfully extracted (%lu bytes)", (unsigned long)sdslen(*binary));
+                rc = true;
+            }
+            else {
+                MYMPD_LOG_WARN(NULL, "Could not determine mimetype, discarding image");
+                sdsclear(*binary);
+            }
+        }
+        else {
+            MYMPD_LOG_WARN(NULL, "Embedded picture size is zero");
+        }
+    }
+    else {
+        MYMPD_LOG_DEBUG(NULL, "No embedded picture detected");
+    }
+    id3_file_close(file_struct);
+    #else
+    (void) cachedir;
+    (void) uri;
+    (void) media_file;
+    (void) binary;
+    (void) covercache;
+    (void) offset;
+    #endif
+    return rc;
+}
+
+/**
+ * Extracts albumart from vorbis tagged files
+ * @param cachedir covercache directory
+ * @param uri song uri
+ * @param media_file full path to the song
+ * @param binary pointer to already allocates sds string to hold the image
+ * @param is_ogg true if it is a ogg file, false if it is a flac file
+ * @param covercache true = covercache is enabled
+ * @param offset number of embedded image to extract
+ * @return true on success, else false
+ */
+static bool coverextract_flac(sds cachedir, const char *uri, const char *media_file,
+        sds *binary, bool is_ogg, bool covercache, int offset)
+{
+    bool rc = false;
+    #ifdef MYMPD_ENABLE_FLAC
+    MYMPD_LOG_DEBUG(NULL, "Exctracting coverimage from %s", media_file);
+    FLAC__StreamMetadata *metadata = NULL;
+
+    FLAC__Metadata_Chain *chain = FLAC__metadata_chain_new();
+
+    if(! (is_ogg? FLAC__metadata_chain_read_ogg(chain, media_file) : FLAC__metadata_chain_read(chain, media_file)) ) {
+        MYMPD_LOG_ERROR(NULL, "Error reading metadata from \"%s\"", media_file);
+        FLAC__metadata_chain_delete(chain);
+        return false;
+    }
+
+    FLAC__Metadata_Iterator *iterator = FLAC__metadata_iterator_new();
+    FLAC__metadata_iterator_init(iterator, chain);
+    if (iterator == NULL) {
+        MYMPD_LOG_ERROR(NULL, "Error initializing iterator for \"%s\"", media_file);
+        FLAC__metadata_chain_delete(chain);
+        return false;
+    }
+    int i = 0;
+    do {
+        FLAC__StreamMetadata *block = FLAC__metadata_iterator_get_block(iterator);
+        if (block->type == FLAC__METADATA_TYPE_PICTURE) {
+            if (i == offset) {
+                metadata = block;
+                break;
+            }
+            i++;
+        }
+    } while (FLAC__metadata_iterator_next(iterator) && metadata == NULL);
+
+    if (metadata == NULL) {
+        MYMPD_LOG_DEBUG(NULL, "No embedded picture detected");
+    }
+    else if (metadata->data.picture.data_length > 0) {
+        *binary = sdscatlen(*binary, metadata->data.picture.data, metadata->data.picture.data_length);
+        const char *mime_type = get_mime_type_by_magic_stream(*binary);
+        if (mime_type != NULL) {
+            if (covercache == true) {
+                covercache_write_file(cachedir, uri, mime_type, *binary, offset);
+            }
+            else {
+                MYMPD_LOG_DEBUG(NULL, "Covercache is disabled");
+            }
+            MYMPD_LOG_DEBUG(NULL, "Coverimage successfully extracted (%lu bytes)", (unsigned long)sdslen(*binary));
+            rc = true;
+        }
+        else {
+            MYMPD_LOG_WARN(NULL, "Could not determine mimetype, discarding image");
+            sdsclear(*binary);
+        }
+    }
+    else {
+        MYMPD_LOG_WARN(NULL, "Embedded picture size is zero");
+    }
+    FLAC__metadata_iterator_delete(iterator);
+    FLAC__metadata_chain_delete(chain);
+    #else
+    (void) cachedir;
+    (void) uri;
+    (void) media_file;
+    (void) binary;
+    (void) is_ogg;
+    (void) covercache;
+    (void) offset;
+    #endif
+    return rc;
+}
@@ -0,0 +1,19 @@
+/*
+ SPDX-License-Identifier: GPL-3.0-or-later
+ myMPD (c) 2018-2023 Juergen Mang <mail@jcgames.de>
+ https://github.com/jcorporation/mympd
+*/
+
+#ifndef MYMPD_WEB_SERVER_COVEREXTRACT_H
+#define MYMPD_WEB_SERVER_COVEREXTRACT_H
+
+#include "dist/sds/sds.h"
+
+#include <stdbool.h>
+
+bool coverextract_queue(long long conn_id, const char *uri, const char *media_file, int offset,
+        unsigned size, sds cachedir, bool covercache, bool feat_albumart);
+bool coverextract_queue_thumbnail(long long conn_id, const char *uri, const char *image_file, int offset,
+        sds cachedir);
+void coverextract_stop(void);
+#endif
@@ -8,6 +8,7 @@
 #include "src/web_server/utility.h"
 
 #include "src/lib/config_def.h"
+#include "src/lib/covercache.h"
 #include "src/lib/filehandler.h"
 #include "src/lib/log.h"
 #include "src/lib/mem.h"
@@ -117,18 +118,16 @@ void *mg_user_data_free(struct t_mg_user_data *mg_user_data) {
  * @param mg_user_data pointer to mongoose configuration
  * @param uri_decoded image uri
  * @param offset embedded image offset
+ * @param thumbnail true = check for the thumbnail
  * @return true if an image is served,
  *         false if waiting for mpd_client to handle request
  */
 bool check_covercache(struct mg_connection *nc, struct mg_http_message *hm,
-        struct t_mg_user_data *mg_user_data, sds uri_decoded, int offset)
+        struct t_mg_user_data *mg_user_data, sds uri_decoded, int offset, bool thumbnail)
 {
     if (mg_user_data->config->covercache_keep_days > 0) {
-        sds filename = sds_hash_sha1(uri_decoded);
-        sds covercachefile = sdscatfmt(sdsempty(), "%S/%s/%S-%i", mg_user_data->config->cachedir, DIR_CACHE_COVER, filename, offset);
-        FREE_SDS(filename);
-        covercachefile = webserver_find_image_file(covercachefile);
-        if (sdslen(covercachefile) > 0) {
+        sds covercachefile = sdsempty();
+        if (covercache_index_get(uri_decoded, offset, thumbnail, &covercachefile) == true) {
             const char *mime_type = get_mime_type_by_ext(covercachefile);
             MYMPD_LOG_DEBUG(NULL, "Serving file %s (%s)", covercachefile, mime_type);
             static struct mg_http_serve_opts s_http_server_opts;
@@ -212,6 +211,31 @@ void webserver_send_header_ok(struct mg_connection *nc, size_t len, const char *
         headers, len);
 }
 
+/**
+ * Sends a http OK reply for a response with chunked transfer encoding
+ * @param nc mongoose connection
+ * @param headers extra headers to add
+ */
+void webserver_send_header_chunked(struct mg_connection *nc, const char *headers) {
+    mg_printf(nc, "HTTP/1.1 200 OK\r\n"
+        "%s"
+        "Transfer-Encoding: chunked\r\n\r\n",
+        headers);
+}
+
+/**
+ * Sends a http OK reply without content-length header,
+ * the end of the response is signaled by closing the connection
+ * @param nc mongoose connection
+ * @param headers extra headers to add
+ */
+void webserver_send_header_close(struct mg_connection *nc, const char *headers) {
+    mg_printf(nc, "HTTP/1.1 200 OK\r\n"
+        "%s"
+        "Connection: close\r\n\r\n",
+        headers);
+}
+
 /**
  * Sends binary data
  * @param nc mongoose connection
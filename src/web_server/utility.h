@@ -50,6 +50,9 @@ struct t_frontend_nc_data {
     //for websocket connections only
     sds partition;                     //!< partition
     long id;                           //!< jsonrpc id (client id)
+    //for streamed api responses only
+    struct t_response_stream_flow *stream_flow; //!< flow control of the streamed response
+    unsigned stream_pending;           //!< fragments in the send buffer that are not released
 };
 
 #ifdef MYMPD_EMBEDDED_ASSETS
@@ -60,7 +63,7 @@ long mg_str_to_long(struct mg_str *str);
 sds print_ip(sds s, struct mg_addr *addr);
 bool get_partition_from_uri(struct mg_connection *nc, struct mg_http_message *hm, struct t_frontend_nc_data *frontend_nc_data);
 bool check_covercache(struct mg_connection *nc, struct mg_http_message *hm,
-        struct t_mg_user_data *mg_user_data, sds uri_decoded, int offset);
+        struct t_mg_user_data *mg_user_data, sds uri_decoded, int offset, bool thumbnail);
 sds webserver_find_image_file(sds basefilename);
 void webserver_send_error(struct mg_connection *nc, int code, const char *msg);
 void webserver_serve_na_image(struct mg_connection *nc);
@@ -68,6 +71,8 @@ void webserver_serve_stream_image(struct mg_connection *nc);
 void webserver_serve_mympd_image(struct mg_connection *nc);
 void webserver_serve_booklet_image(struct mg_connection *nc);
 void webserver_send_header_ok(struct mg_connection *nc, size_t len, const char *headers);
+void webserver_send_header_chunked(struct mg_connection *nc, const char *headers);
+void webserver_send_header_close(struct mg_connection *nc, const char *headers);
 void webserver_send_header_redirect(struct mg_connection *nc, const char *location);
 void webserver_send_header_found(struct mg_connection *nc, const char *location);
 void webserver_send_cors_reply(struct mg_connection *nc);
@@ -8,6 +8,7 @@
 #include "src/web_server/web_server.h"
 
 #include "src/lib/api.h"
+#include "src/lib/covercache.h"
 #include "src/lib/filehandler.h"
 #include "src/lib/http_client.h"
 #include "src/lib/jsonrpc.h"
@@ -17,12 +18,14 @@
 #include "src/lib/sds_extras.h"
 #include "src/lib/thread.h"
 #include "src/web_server/albumart.h"
+#include "src/web_server/coverextract.h"
 #include "src/web_server/proxy.h"
 #include "src/web_server/request_handler.h"
 #include "src/web_server/tagart.h"
 
 #include <inttypes.h>
 #include <libgen.h>
+#include <unistd.h>
 
 /**
  * Private definitions
@@ -32,9 +35,14 @@ static void get_placeholder_image(sds workdir, const char *name, sds *result);
 static bool parse_internal_message(struct t_work_response *response, struct t_mg_user_data *mg_user_data);
 static void ev_handler(struct mg_connection *nc, int ev, void *ev_data, void *fn_data);
 static void ev_handler_redirect(struct mg_connection *nc_http, int ev, void *ev_data, void *fn_data);
+static void ev_handler_queue(struct mg_connection *nc, int ev, void *ev_data, void *fn_data);
+static void handle_response(struct mg_mgr *mgr, struct t_work_response *response);
 static void send_ws_notify(struct mg_mgr *mgr, struct t_work_response *response);
 static void send_ws_notify_client(struct mg_mgr *mgr, struct t_work_response *response);
 static void send_api_response(struct mg_mgr *mgr, struct t_work_response *response);
+static void send_api_response_chunk(struct mg_connection *nc, struct t_work_response *response);
+static void send_api_response_fragment(struct mg_connection *nc, const char *data, size_t len, bool chunked);
+static void send_api_response_stream_end(struct t_frontend_nc_data *frontend_nc_data);
 static bool enforce_acl(struct mg_connection *nc, sds acl);
 static bool enforce_conn_limit(struct mg_connection *nc, int connection_count);
 static void mongoose_log(char ch, void *param);
@@ -175,41 +183,22 @@ void *web_server_loop(void *arg_mgr) {
         MYMPD_LOG_DEBUG(NULL, "Using certificate: %s", mg_user_data->config->ssl_cert);
         MYMPD_LOG_DEBUG(NULL, "Using private key: %s", mg_user_data->config->ssl_key);
     }
-    while (s_signal_received == 0) {
-        //poll webserver response queue
-        struct t_work_response *response = mympd_queue_shift(web_server_queue, 50, 0);
-        if (response != NULL) {
-            switch(response->conn_id) {
-                case CONN_ID_NOTIFY_CLIENT:
-                    //websocket notify for specific clients
-                    send_ws_notify_client(mgr, response);
-                    break;
-                case CONN_ID_CONFIG_TO_WEBSERVER:
-                    //internal message
-                    if (response->cmd_id == INTERNAL_API_WEBSERVER_READY) {
-                        mg_user_data->mympd_api_started = true;
-                        free_response(response);
-                    }
-                    else if (response->cmd_id == INTERNAL_API_WEBSERVER_SETTINGS){
-                        parse_internal_message(response, mg_user_data);
-                    }
-                    else {
-                        MYMPD_LOG_ERROR(response->partition, "Invalid API method: %s", get_cmd_id_method_name(response->cmd_id));
-                    }
-                    break;
-                case CONN_ID_NOTIFY_ALL:
-                    //websocket notify for all clients
-                    send_ws_notify(mgr, response);
-                    break;
-                default:
-                    //api response
-                    MYMPD_LOG_DEBUG(response->partition, "Got API response for id \"%lld\"", response->conn_id);
-                    send_api_response(mgr, response);
-            }
+    //add the webserver response queue to the mongoose poll set,
+    //mongoose owns the duplicated file descriptor
+    int queue_fd = dup(mympd_queue_event_fd(web_server_queue));
+    if (queue_fd == -1 ||
+        mg_wrapfd(mgr, queue_fd, ev_handler_queue, NULL) == NULL)
+    {
+        MYMPD_LOG_ERROR(NULL, "Can not add the response queue to the webserver");
+        if (queue_fd > -1) {
+            close(queue_fd);
         }
-        //webserver polling
-        mg_mgr_poll(mgr, 50);
     }
+    while (s_signal_received == 0) {
+        //webserver polling, responses wake up the poll
+        mg_mgr_poll(mgr, 1000);
+    }
+    coverextract_stop();
     MYMPD_LOG_DEBUG(NULL, "Stopping web_server thread");
     FREE_SDS(thread_logname);
     return NULL;
@@ -219,6 +208,64 @@ void *web_server_loop(void *arg_mgr) {
  * Private functions
  */
 
+/**
+ * Event handler for the webserver response queue.
+ * The connection becomes readable if responses are waiting.
+ * @param nc mongoose connection wrapping the queue event file descriptor
+ * @param ev connection event
+ * @param ev_data event data
+ * @param fn_data not used
+ */
+static void ev_handler_queue(struct mg_connection *nc, int ev, void *ev_data, void *fn_data) {
+    (void)ev_data;
+    (void)fn_data;
+    if (ev != MG_EV_READ) {
+        return;
+    }
+    //discard the wakeup bytes
+    nc->recv.len = 0;
+    struct t_work_response *response;
+    while ((response = mympd_queue_shift(web_server_queue, -1, 0)) != NULL) {
+        handle_response(nc->mgr, response);
+    }
+}
+
+/**
+ * Handles a response from the webserver queue
+ * @param mgr mongoose mgr
+ * @param response the response
+ */
+static void handle_response(struct mg_mgr *mgr, struct t_work_response *response) {
+    struct t_mg_user_data *mg_user_data = (struct t_mg_user_data *) mgr->userdata;
+    switch(response->conn_id) {
+        case CONN_ID_NOTIFY_CLIENT:
+            //websocket notify for specific clients
+            send_ws_notify_client(mgr, response);
+            break;
+        case CONN_ID_CONFIG_TO_WEBSERVER:
+            //internal message
+            if (response->cmd_id == INTERNAL_API_WEBSERVER_READY) {
+                mg_user_data->mympd_api_started = true;
+                free_response(response);
+            }
+            else if (response->cmd_id == INTERNAL_API_WEBSERVER_SETTINGS){
+                parse_internal_message(response, mg_user_data);
+            }
+            else {
+                MYMPD_LOG_ERROR(response->partition, "Invalid API method: %s", get_cmd_id_method_name(response->cmd_id));
+            }
+            break;
+        case CONN_ID_NOTIFY_ALL:
+            //websocket notify for all clients
+            send_ws_notify(mgr, response);
+            break;
+        default:
+            //api response
+            MYMPD_LOG_DEBUG(response->partition, "Got API response for id \"%lld\"", response->conn_id);
+            send_api_response(mgr, response);
+    }
+}
+
 /**
  * Sets the mg_user_data values from set_mg_user_data_request.
  * Message is sent from the mympd_api thread.
@@ -269,6 +316,9 @@ static bool parse_internal_message(struct t_work_response *response, struct t_mg
 
         mg_user_data->feat_albumart = new_mg_user_data->feat_albumart;
 
+        //cover settings could have changed
+        covercache_lookup_clear();
+
         //set per partition stream uris
         list_clear(&mg_user_data->stream_uris);
         struct t_list_node *current = new_mg_user_data->partitions.head;
@@ -404,17 +454,110 @@ static void send_api_response(struct mg_mgr *mgr, struct t_work_response *respon
             else if (response->cmd_id == INTERNAL_API_ALBUMART_BY_ALBUMID) {
                 webserver_send_albumart_redirect(nc, response->data);
             }
+            else if (response->chunk != RESPONSE_CHUNK_NONE) {
+                send_api_response_chunk(nc, response);
+            }
             else {
                 MYMPD_LOG_DEBUG(response->partition, "Sending response to conn_id %lu (length: %lu): %s", nc->id, (unsigned long)sdslen(response->data), response->data);
                 webserver_send_data(nc, response->data, sdslen(response->data), EXTRA_HEADERS_JSON_CONTENT);
             }
-            break;
+            free_response(response);
+            return;
         }
         nc = nc->next;
     }
+    if (response->flow != NULL) {
+        //connection is gone, stop the producer of the streamed response
+        response_stream_flow_release(response->flow, 1, true);
+    }
     free_response(response);
 }
 
+/**
+ * Sends a fragment of an api response with chunked transfer encoding.
+ * HTTP/1.0 clients do not support chunked transfer encoding,
+ * the body is sent as is and the end of the response is signaled by closing the connection.
+ * @param nc mongoose connection
+ * @param response jsonrpc response fragment
+ */
+static void send_api_response_chunk(struct mg_connection *nc, struct t_work_response *response) {
+    MYMPD_LOG_DEBUG(response->partition, "Sending response chunk to conn_id %lu (length: %lu)", nc->id, (unsigned long)sdslen(response->data));
+    struct t_frontend_nc_data *frontend_nc_data = (struct t_frontend_nc_data *)nc->fn_data;
+    bool chunked = nc->data[3] != '0';
+    switch(response->chunk) {
+        case RESPONSE_CHUNK_FIRST:
+            if (chunked == true) {
+                webserver_send_header_chunked(nc, EXTRA_HEADERS_JSON_CONTENT);
+            }
+            else {
+                webserver_send_header_close(nc, EXTRA_HEADERS_JSON_CONTENT);
+            }
+            // fall through
+        case RESPONSE_CHUNK_NEXT:
+            send_api_response_fragment(nc, response->data, sdslen(response->data), chunked);
+            //the fragment is released after it is written to the socket
+            if (response->flow != NULL) {
+                if (frontend_nc_data->stream_flow == NULL) {
+                    frontend_nc_data->stream_flow = response_stream_flow_ref(response->flow);
+                }
+                frontend_nc_data->stream_pending++;
+            }
+            break;
+        case RESPONSE_CHUNK_LAST:
+            if (sdslen(response->data) > 0) {
+                send_api_response_fragment(nc, response->data, sdslen(response->data), chunked);
+            }
+            if (chunked == true) {
+                //empty chunk terminates the response
+                mg_http_write_chunk(nc, "", 0);
+                webserver_handle_connection_close(nc);
+            }
+            else {
+                nc->is_draining = 1;
+            }
+            send_api_response_stream_end(frontend_nc_data);
+            break;
+        case RESPONSE_CHUNK_ABORT:
+            //the response can not be completed, the client gets an incomplete transfer
+            MYMPD_LOG_ERROR(response->partition, "Aborting chunked response for conn_id %lu", nc->id);
+            nc->is_draining = 1;
+            send_api_response_stream_end(frontend_nc_data);
+            break;
+        case RESPONSE_CHUNK_NONE:
+            break;
+    }
+}
+
+/**
+ * Writes a fragment of a streamed api response to the send buffer
+ * @param nc mongoose connection
+ * @param data fragment to send
+ * @param len length of the fragment
+ * @param chunked true to use chunked transfer encoding
+ */
+static void send_api_response_fragment(struct mg_connection *nc, const char *data, size_t len, bool chunked) {
+    if (chunked == true) {
+        mg_http_write_chunk(nc, data, len);
+    }
+    else {
+        mg_send(nc, data, len);
+    }
+}
+
+/**
+ * Releases the flow control of a finished streamed response
+ * @param frontend_nc_data connection specific data
+ */
+static void send_api_response_stream_end(struct t_frontend_nc_data *frontend_nc_data) {
+    if (frontend_nc_data->stream_flow == NULL) {
+        return;
+    }
+    response_stream_flow_release(frontend_nc_data->stream_flow, frontend_nc_data->stream_pending, false);
+    response_stream_flow_unref(frontend_nc_data->stream_flow);
+    frontend_nc_data->stream_flow = NULL;
+    frontend_nc_data->stream_pending = 0;
+}
+
 /**
  * Matches the acl against the client ip and
  * sends an error response / drains the connection if acl is not matched
@@ -492,11 +635,14 @@ static void ev_handler(struct mg_connection *nc, int ev, void *ev_data, void *fn
             frontend_nc_data->partition = NULL;  // populated on websocket handshake
             frontend_nc_data->id = 0;            // populated through websocket message
             frontend_nc_data->backend_nc = NULL; // used for reverse proxy function
+            frontend_nc_data->stream_flow = NULL; // used for streamed api responses
+            frontend_nc_data->stream_pending = 0;
             nc->fn_data = frontend_nc_data;
             //set labels
             nc->data[0] = 'F'; // connection type
             nc->data[1] = '-'; // http method
             nc->data[2] = 'C'; // connection header
+            nc->data[3] = '1'; // http minor version
             break;
         }
         case MG_EV_ACCEPT:
@@ -607,6 +753,10 @@ static void ev_handler(struct mg_connection *nc, int ev, void *ev_data, void *fn
                     nc->data[2] = 'K';
                 }
             }
+            //http version, chunked transfer encoding is not supported by HTTP/1.0
+            nc->data[3] = mg_vcasecmp(&hm->proto, "HTTP/1.0") == 0
+                ? '0'
+                : '1';
             //handle uris
             if (mg_http_match_uri(hm, "/api/*") == true) {
                 //api request
@@ -772,11 +922,27 @@ static void ev_handler(struct mg_connection *nc, int ev, void *ev_data, void *fn
                 //close backend connection
                 frontend_nc_data->backend_nc->is_closing = 1;
             }
+            if (frontend_nc_data->stream_flow != NULL) {
+                //stop the producer of the streamed response
+                response_stream_flow_release(frontend_nc_data->stream_flow, frontend_nc_data->stream_pending, true);
+                response_stream_flow_unref(frontend_nc_data->stream_flow);
+            }
             FREE_SDS(frontend_nc_data->partition);
             FREE_PTR(frontend_nc_data);
             nc->fn_data = NULL;
             break;
         }
+        case MG_EV_POLL:
+        case MG_EV_WRITE:
+            //release the fragments of a streamed response if the send buffer is drained
+            if (frontend_nc_data != NULL &&
+                frontend_nc_data->stream_pending > 0 &&
+                nc->send.len < JSONRPC_CHUNK_SIZE)
+            {
+                response_stream_flow_release(frontend_nc_data->stream_flow, frontend_nc_data->stream_pending, false);
+                frontend_nc_data->stream_pending = 0;
+            }
+            break;
     }
 }
 
@@ -16,7 +16,7 @@
 //message queues
 struct t_mympd_queue *web_server_queue;
 struct t_mympd_queue *mympd_api_queue;
-struct t_mympd_queue *mympd_script_queue;
+struct t_mympd_mailboxes *mympd_script_mailboxes;
 
 UTEST_STATE();
 
@@ -9,6 +9,7 @@
 
 #include "dist/utest/utest.h"
 #include "src/lib/api.h"
+#include "src/lib/msg_queue.h"
 
 UTEST(api, test_get_cmd_id) {
     enum mympd_cmd_ids cmd_id = get_cmd_id("MYMPD_API_COLS_SAVE");
@@ -59,3 +60,85 @@ UTEST(api, test_request_result) {
     free_request(request);
     free_response(response);
 }
+
+UTEST(api, test_response_stream) {
+    web_server_queue = mympd_queue_create("web_server_queue", QUEUE_TYPE_RESPONSE);
+    struct t_work_request *request = create_request(1, 1, MYMPD_API_DATABASE_SEARCH, "test", MPD_PARTITION_DEFAULT);
+    struct t_response_stream stream;
+    response_stream_init(&stream, request);
+
+    // small buffers are not sent
+    sds buffer = sdsnew("small");
+    buffer = response_stream_push(&stream, buffer);
+    ASSERT_STREQ("small", buffer);
+    ASSERT_TRUE(response_stream_end(&stream, true) == RESPONSE_CHUNK_NONE);
+
+    // large buffers are sent as fragments
+    buffer = sdsgrowzero(buffer, JSONRPC_CHUNK_SIZE);
+    buffer = response_stream_push(&stream, buffer);
+    ASSERT_EQ(0U, sdslen(buffer));
+    buffer = sdsgrowzero(buffer, JSONRPC_CHUNK_SIZE);
+    buffer = response_stream_push(&stream, buffer);
+    ASSERT_EQ(0U, sdslen(buffer));
+    ASSERT_EQ(2, web_server_queue->length);
+    ASSERT_EQ(2U, stream.flow->in_flight);
+    response_stream_flow_release(stream.flow, 2, false);
+    ASSERT_EQ(0U, stream.flow->in_flight);
+    ASSERT_TRUE(response_stream_end(&stream, true) == RESPONSE_CHUNK_LAST);
+    ASSERT_TRUE(response_stream_end(&stream, false) == RESPONSE_CHUNK_ABORT);
+
+    struct t_work_response *response = mympd_queue_shift(web_server_queue, -1, 0);
+    ASSERT_TRUE(response->chunk == RESPONSE_CHUNK_FIRST);
+    ASSERT_EQ(1, response->conn_id);
+    ASSERT_EQ((size_t)JSONRPC_CHUNK_SIZE, sdslen(response->data));
+    free_response(response);
+    response = mympd_queue_shift(web_server_queue, -1, 0);
+    ASSERT_TRUE(response->chunk == RESPONSE_CHUNK_NEXT);
+    free_response(response);
+
+    // fragments are discarded after the connection was closed
+    response_stream_init(&stream, request);
+    buffer = sdsgrowzero(buffer, JSONRPC_CHUNK_SIZE);
+    buffer = response_stream_push(&stream, buffer);
+    ASSERT_EQ(1, web_server_queue->length);
+    response_stream_flow_release(stream.flow, 0, true);
+    buffer = sdsgrowzero(buffer, JSONRPC_CHUNK_SIZE);
+    buffer = response_stream_push(&stream, buffer);
+    ASSERT_EQ(0U, sdslen(buffer));
+    ASSERT_EQ(1, web_server_queue->length);
+    ASSERT_TRUE(response_stream_end(&stream, true) == RESPONSE_CHUNK_ABORT);
+    response = mympd_queue_shift(web_server_queue, -1, 0);
+    free_response(response);
+
+    // buffer is held back while the window is full and the stream is aborted if it grows too large
+    response_stream_init(&stream, request);
+    for (int i = 0; i < RESPONSE_STREAM_FRAGMENTS_MAX; i++) {
+        buffer = sdsgrowzero(buffer, JSONRPC_CHUNK_SIZE);
+        buffer = response_stream_push(&stream, buffer);
+    }
+    ASSERT_EQ(RESPONSE_STREAM_FRAGMENTS_MAX, web_server_queue->length);
+    buffer = sdsgrowzero(buffer, JSONRPC_CHUNK_SIZE);
+    buffer = response_stream_push(&stream, buffer);
+    ASSERT_EQ((size_t)JSONRPC_CHUNK_SIZE, sdslen(buffer));
+    ASSERT_EQ(RESPONSE_STREAM_FRAGMENTS_MAX, web_server_queue->length);
+    buffer = sdsgrowzero(buffer, RESPONSE_STREAM_BUFFER_MAX);
+    buffer = response_stream_push(&stream, buffer);
+    ASSERT_EQ(0U, sdslen(buffer));
+    ASSERT_TRUE(response_stream_end(&stream, true) == RESPONSE_CHUNK_ABORT);
+    while ((response = mympd_queue_shift(web_server_queue, -1, 0)) != NULL) {
+        free_response(response);
+    }
+
+    // responses for scripts are not streamed
+    request->conn_id = -2;
+    response_stream_init(&stream, request);
+    buffer = sdsgrowzero(buffer, JSONRPC_CHUNK_SIZE);
+    buffer = response_stream_push(&stream, buffer);
+    ASSERT_EQ((size_t)JSONRPC_CHUNK_SIZE, sdslen(buffer));
+    ASSERT_EQ(0, web_server_queue->length);
+
+    sdsfree(buffer);
+    free_request(request);
+    mympd_queue_free(web_server_queue);
+    web_server_queue = NULL;
+}
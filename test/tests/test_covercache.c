@@ -0,0 +1,115 @@
+/*
+ SPDX-License-Identifier: GPL-3.0-or-later
+ myMPD (c) 2018-2023 Juergen Mang <mail@jcgames.de>
+ https://github.com/jcorporation/mympd
+*/
+
+#include "compile_time.h"
+#include "utility.h"
+
+#include "dist/utest/utest.h"
+#include "src/lib/covercache.h"
+#include "src/lib/sds_extras.h"
+
+#include <sys/stat.h>
+
+UTEST(covercache, test_covercache_index) {
+    init_testenv();
+    mkdir("/tmp/mympd-test/covercache", 0770);
+    sds cachedir = sdsnew("/tmp/mympd-test");
+    sds binary = sdsnew("test");
+
+    //existing files are indexed on init
+    bool rc = covercache_write_file(cachedir, "song1.mp3", "image/png", binary, 0);
+    ASSERT_TRUE(rc);
+    covercache_index_init(cachedir);
+    sds filepath = sdsempty();
+    rc = covercache_index_get("song1.mp3", 0, false, &filepath);
+    ASSERT_TRUE(rc);
+    sds hash = sds_hash_sha1("song1.mp3");
+    sds expected = sdscatfmt(sdsempty(), "/tmp/mympd-test/covercache/%S-0.png", hash);
+    ASSERT_STREQ(expected, filepath);
+    FREE_SDS(hash);
+    FREE_SDS(expected);
+
+    //new files are added to the index
+    sdsclear(filepath);
+    rc = covercache_index_get("song2.mp3", 1, false, &filepath);
+    ASSERT_FALSE(rc);
+    rc = covercache_write_file(cachedir, "song2.mp3", "image/jpeg", binary, 1);
+    ASSERT_TRUE(rc);
+    rc = covercache_index_get("song2.mp3", 1, false, &filepath);
+    ASSERT_TRUE(rc);
+    sdsclear(filepath);
+    rc = covercache_index_get("song2.mp3", 0, false, &filepath);
+    ASSERT_FALSE(rc);
+
+    //thumbnails are separate variants
+    rc = covercache_index_get("song2.mp3", 1, true, &filepath);
+    ASSERT_FALSE(rc);
+    rc = covercache_write_thumbnail(cachedir, "song2.mp3", "image/jpeg", binary, 1);
+    ASSERT_TRUE(rc);
+    rc = covercache_index_get("song2.mp3", 1, true, &filepath);
+    ASSERT_TRUE(rc);
+    hash = sds_hash_sha1("song2.mp3");
+    expected = sdscatfmt(sdsempty(), "/tmp/mympd-test/covercache/%S-1-thumb.jpg", hash);
+    ASSERT_STREQ(expected, filepath);
+    FREE_SDS(hash);
+    FREE_SDS(expected);
+    sdsclear(filepath);
+
+    //deleted files are removed from the index
+    int deleted = covercache_clear(cachedir, -1);
+    ASSERT_EQ(3, deleted);
+    rc = covercache_index_get("song1.mp3", 0, false, &filepath);
+    ASSERT_FALSE(rc);
+    rc = covercache_index_get("song2.mp3", 1, false, &filepath);
+    ASSERT_FALSE(rc);
+    rc = covercache_index_get("song2.mp3", 1, true, &filepath);
+    ASSERT_FALSE(rc);
+
+    covercache_index_free();
+    FREE_SDS(filepath);
+    FREE_SDS(binary);
+    FREE_SDS(cachedir);
+    clean_testenv();
+}
+
+UTEST(covercache, test_covercache_lookup) {
+    init_testenv();
+    mkdir("/tmp/mympd-test/covercache", 0770);
+    sds cachedir = sdsnew("/tmp/mympd-test");
+    covercache_index_init(cachedir);
+
+    sds filepath = sdsempty();
+    enum covercache_lookup_result rc = covercache_lookup_get("song1.mp3", 0, 0, &filepath);
+    ASSERT_TRUE(rc == COVERCACHE_LOOKUP_UNKNOWN);
+
+    //negative result
+    covercache_lookup_set("song1.mp3", 0, 0, NULL);
+    rc = covercache_lookup_get("song1.mp3", 0, 0, &filepath);
+    ASSERT_TRUE(rc == COVERCACHE_LOOKUP_MISSING);
+    //other sizes and offsets are not affected
+    rc = covercache_lookup_get("song1.mp3", 0, 1, &filepath);
+    ASSERT_TRUE(rc == COVERCACHE_LOOKUP_UNKNOWN);
+    rc = covercache_lookup_get("song1.mp3", 1, 0, &filepath);
+    ASSERT_TRUE(rc == COVERCACHE_LOOKUP_UNKNOWN);
+
+    //positive result
+    covercache_lookup_set("song2.mp3", 0, 1, "/music/album/folder.jpg");
+    rc = covercache_lookup_get("song2.mp3", 0, 1, &filepath);
+    ASSERT_TRUE(rc == COVERCACHE_LOOKUP_FOUND);
+    ASSERT_STREQ("/music/album/folder.jpg", filepath);
+
+    //clear all results
+    covercache_lookup_clear();
+    rc = covercache_lookup_get("song1.mp3", 0, 0, &filepath);
+    ASSERT_TRUE(rc == COVERCACHE_LOOKUP_UNKNOWN);
+    rc = covercache_lookup_get("song2.mp3", 0, 1, &filepath);
+    ASSERT_TRUE(rc == COVERCACHE_LOOKUP_UNKNOWN);
+
+    covercache_index_free();
+    FREE_SDS(filepath);
+    FREE_SDS(cachedir);
+    clean_testenv();
+}
@@ -7,11 +7,14 @@
 #include "compile_time.h"
 #include "utility.h"
 
+#include "dist/mjson/mjson.h"
 #include "dist/utest/utest.h"
 #include "src/lib/jsonrpc.h"
 #include "src/lib/list.h"
 #include "src/lib/sds_extras.h"
 
+#include <time.h>
+
 UTEST(jsonrpc, test_json_get_bool) {
     bool result;
     //valid
@@ -286,3 +289,182 @@ UTEST(jsonrpc, test_json_get_cols_as_string) {
     FREE_SDS(cols);
     FREE_SDS(data);
 }
+
+/**
+ * Creates a queue append request with realistic song uris
+ * @param uris_len number of uris
+ * @return newly allocated request
+ */
+static sds create_append_request(unsigned uris_len) {
+    sds request = sdsnew("{\"jsonrpc\":\"2.0\",\"id\":0,\"method\":\"MYMPD_API_QUEUE_APPEND_URIS\",\"params\":{\"uris\":[");
+    for (unsigned i = 0; i < uris_len; i++) {
+        if (i > 0) {
+            request = sdscatlen(request, ",", 1);
+        }
+        request = sdscatfmt(request, "\"Artist %u/Album %u/%u - Title %u.flac\"", i % 100, i % 1000, i, i);
+    }
+    request = sdscat(request, "],\"whence\":0,\"position\":5,\"play\":true}}");
+    return request;
+}
+
+UTEST(jsonrpc, test_json_index) {
+    sds data = sdsnew("{\"jsonrpc\":\"2.0\",\"id\":1,\"method\":\"MYMPD_API_TEST\",\"params\":{"
+        "\"uint\":10,\"string\":\"str\\\"ing\",\"bool\":true,\"obj\":{\"key\":2,\"arr\":[5,6]},"
+        "\"arr\":[\"uri1\",\"uri2\"],\"empty\":[],\"null\":null,\"uint\":20}}");
+    json_index_create(data);
+    unsigned uint_buf;
+    ASSERT_TRUE(json_get_uint_max(data, "$.params.uint", &uint_buf, NULL));
+    //first key wins like in mjson
+    ASSERT_EQ(10U, uint_buf);
+    sds sds_buf = NULL;
+    ASSERT_TRUE(json_get_string_max(data, "$.params.string", &sds_buf, vcb_isname, NULL));
+    ASSERT_STREQ("str\"ing", sds_buf);
+    FREE_SDS(sds_buf);
+    bool bool_buf = false;
+    ASSERT_TRUE(json_get_bool(data, "$.params.bool", &bool_buf, NULL));
+    ASSERT_TRUE(bool_buf);
+    //nested paths are resolved relative to the indexed value
+    ASSERT_TRUE(json_get_uint_max(data, "$.params.obj.key", &uint_buf, NULL));
+    ASSERT_EQ(2U, uint_buf);
+    ASSERT_TRUE(json_get_uint_max(data, "$.params.obj.arr[1]", &uint_buf, NULL));
+    ASSERT_EQ(6U, uint_buf);
+    struct t_list l;
+    list_init(&l);
+    ASSERT_TRUE(json_get_array_string(data, "$.params.arr", &l, vcb_isuri, 10, NULL));
+    ASSERT_EQ(2, l.length);
+    ASSERT_STREQ("uri2", l.tail->key);
+    list_clear(&l);
+    ASSERT_TRUE(json_get_array_string(data, "$.params.empty", &l, vcb_isuri, 10, NULL));
+    ASSERT_EQ(0, l.length);
+    ASSERT_TRUE(json_find_key(data, "$.params.null"));
+    ASSERT_FALSE(json_find_key(data, "$.params.missing"));
+    ASSERT_FALSE(json_find_key(data, "$.params.strin"));
+    //paths outside of params are not indexed
+    ASSERT_TRUE(json_get_string_max(data, "$.method", &sds_buf, vcb_isalnum, NULL));
+    ASSERT_STREQ("MYMPD_API_TEST", sds_buf);
+    FREE_SDS(sds_buf);
+    //the index is not used for other strings
+    sds other = sdsnew("{\"params\":{\"uint\":30}}");
+    ASSERT_TRUE(json_get_uint_max(other, "$.params.uint", &uint_buf, NULL));
+    ASSERT_EQ(30U, uint_buf);
+    FREE_SDS(other);
+    json_index_clear();
+    ASSERT_TRUE(json_get_uint_max(data, "$.params.obj.key", &uint_buf, NULL));
+    ASSERT_EQ(2U, uint_buf);
+    FREE_SDS(data);
+}
+
+/**
+ * Reference copy of the previous parameter parsing:
+ * each parameter is searched with mjson from the start of the request
+ * and the array is walked with mjson_next.
+ */
+static bool parse_append_request_reference(sds request, struct t_list *uris, unsigned *whence, unsigned *position, bool *play) {
+    const char *p;
+    int n;
+    if (mjson_find(request, (int)sdslen(request), "$.params.uris", &p, &n) != MJSON_TOK_ARRAY) {
+        return false;
+    }
+    sds value = sdsempty();
+    int koff = 0;
+    int klen = 0;
+    int voff = 0;
+    int vlen = 0;
+    int vtype = 0;
+    int i = 0;
+    for (int off = 0; (off = mjson_next(p, n, off, &koff, &klen, &voff, &vlen, &vtype)) != 0;) {
+        if (vtype != MJSON_TOK_STRING ||
+            sds_json_unescape(p + voff + 1, (size_t)(vlen - 2), &value) == false ||
+            vcb_isuri(value) == false)
+        {
+            FREE_SDS(value);
+            return false;
+        }
+        list_push(uris, value, 0, NULL, NULL);
+        sdsclear(value);
+        if (++i == MPD_COMMANDS_MAX) {
+            break;
+        }
+    }
+    FREE_SDS(value);
+    double number;
+    if (mjson_get_number(request, (int)sdslen(request), "$.params.whence", &number) == 0 ||
+        number < 0 || number > 2)
+    {
+        return false;
+    }
+    *whence = (unsigned)number;
+    if (mjson_get_number(request, (int)sdslen(request), "$.params.position", &number) == 0) {
+        return false;
+    }
+    *position = (unsigned)number;
+    int v;
+    if (mjson_get_bool(request, (int)sdslen(request), "$.params.play", &v) == 0) {
+        return false;
+    }
+    *play = v == 1 ? true : false;
+    return true;
+}
+
+UTEST(jsonrpc, test_json_parse_benchmark) {
+    unsigned sizes[] = {100, 1000, 10000};
+    //the previous path is quadratic, it takes seconds for 10000 uris
+    const unsigned reference_max = 1000;
+    struct timespec begin;
+    struct timespec end;
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        sds request = create_append_request(sizes[i]);
+        struct t_list uris;
+        list_init(&uris);
+        unsigned whence;
+        unsigned position;
+        bool play;
+        double reference_ms = -1;
+        struct t_list reference_uris;
+        list_init(&reference_uris);
+        if (sizes[i] <= reference_max) {
+            clock_gettime(CLOCK_MONOTONIC, &begin);
+            for (int j = 0; j < 10; j++) {
+                list_clear(&reference_uris);
+                ASSERT_TRUE(parse_append_request_reference(request, &reference_uris, &whence, &position, &play));
+            }
+            clock_gettime(CLOCK_MONOTONIC, &end);
+            reference_ms = elapsed_ms(&begin, &end) / 10;
+            ASSERT_EQ((long)sizes[i], reference_uris.length);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &begin);
+        for (int j = 0; j < 10; j++) {
+            list_clear(&uris);
+            json_index_create(request);
+            ASSERT_TRUE(json_get_array_string(request, "$.params.uris", &uris, vcb_isuri, MPD_COMMANDS_MAX, NULL));
+            ASSERT_TRUE(json_get_uint(request, "$.params.whence", 0, 2, &whence, NULL));
+            ASSERT_TRUE(json_get_uint_max(request, "$.params.position", &position, NULL));
+            ASSERT_TRUE(json_get_bool(request, "$.params.play", &play, NULL));
+            ASSERT_EQ((long)sizes[i], uris.length);
+            json_index_clear();
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double indexed_ms = elapsed_ms(&begin, &end) / 10;
+        if (reference_ms >= 0) {
+            printf("Parsing request with %u uris (%lu bytes): mjson per field %.3f ms, indexed %.3f ms\n", sizes[i], (unsigned long)sdslen(request),
+                reference_ms, indexed_ms);
+            //both paths must return the same uris
+            struct t_list_node *current = uris.head;
+            struct t_list_node *reference = reference_uris.head;
+            while (current != NULL) {
+                ASSERT_STREQ(reference->key, current->key);
+                current = current->next;
+                reference = reference->next;
+            }
+        }
+        else {
+            printf("Parsing request with %u uris (%lu bytes): indexed %.3f ms\n", sizes[i], (unsigned long)sdslen(request),
+                indexed_ms);
+        }
+        ASSERT_EQ(5U, position);
+        ASSERT_TRUE(play);
+        list_clear(&uris);
+        list_clear(&reference_uris);
+        FREE_SDS(request);
+    }
+}
@@ -9,6 +9,9 @@
 
 #include "dist/utest/utest.h"
 #include "src/lib/list.h"
+#include "src/lib/random.h"
+
+#include <time.h>
 
 static void populate_list(struct t_list *l) {
     list_init(l);
@@ -406,3 +409,113 @@ UTEST(list, test_list_sort_by_key) {
 
     list_clear(&test_list);
 }
+
+UTEST(list, test_list_index) {
+    struct t_list test_list;
+    populate_list(&test_list);
+    ASSERT_TRUE(list_has_key(&test_list, "key3"));
+    list_index_create(&test_list);
+    ASSERT_TRUE(test_list.index != NULL);
+    ASSERT_TRUE(list_has_key(&test_list, "key0"));
+    ASSERT_TRUE(list_has_value_p(&test_list, "value5"));
+    ASSERT_FALSE(list_has_key(&test_list, "key6"));
+
+    //duplicate keys are counted
+    list_push(&test_list, "key1", 6, "value6", NULL);
+    list_remove_node(&test_list, 1);
+    ASSERT_TRUE(list_has_key(&test_list, "key1"));
+    ASSERT_FALSE(list_has_value_p(&test_list, "value1"));
+    ASSERT_EQ(6, list_get_node(&test_list, "key1")->value_i);
+
+    list_replace(&test_list, 0, "new", 0, "newvalue", NULL);
+    ASSERT_FALSE(list_has_key(&test_list, "key0"));
+    ASSERT_TRUE(list_has_key(&test_list, "new"));
+    ASSERT_TRUE(list_has_value_p(&test_list, "newvalue"));
+
+    list_move_item_pos(&test_list, 0, 3);
+    ASSERT_TRUE(list_has_key(&test_list, "new"));
+    ASSERT_EQ(3, list_get_node_idx(&test_list, "new"));
+    ASSERT_EQ(-1, list_get_node_idx(&test_list, "key0"));
+
+    struct t_list_node *node = list_shift_first(&test_list);
+    ASSERT_FALSE(list_has_key(&test_list, node->key));
+    list_node_free(node);
+
+    list_clear(&test_list);
+    ASSERT_TRUE(test_list.index == NULL);
+    ASSERT_FALSE(list_has_key(&test_list, "new"));
+}
+
+static void populate_list_random(struct t_list *l, long len) {
+    list_init(l);
+    for (long i = 0; i < len; i++) {
+        // few distinct values to check the stability
+        long long value = (long long)randrange(0, len / 4 + 1);
+        sds key = sdsfromlonglong(value);
+        list_push(l, key, value, NULL, NULL);
+        l->tail->user_data = (void *)(size_t)i;
+        sdsfree(key);
+    }
+}
+
+static bool check_sorted_stable(struct t_list *l, enum list_sort_direction direction) {
+    struct t_list_node *current = l->head;
+    long count = 1;
+    while (current->next != NULL) {
+        struct t_list_node *next = current->next;
+        if ((direction == LIST_SORT_ASC && current->value_i > next->value_i) ||
+            (direction == LIST_SORT_DESC && current->value_i < next->value_i))
+        {
+            return false;
+        }
+        if (current->value_i == next->value_i &&
+            (size_t)current->user_data > (size_t)next->user_data)
+        {
+            return false;
+        }
+        current = next;
+        count++;
+    }
+    return count == l->length &&
+        current == l->tail;
+}
+
+UTEST(list, test_list_sort_stable) {
+    long sizes[] = {1, 2, 3, 100, 1023, 1024, 5000};
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        struct t_list test_list;
+        populate_list_random(&test_list, sizes[i]);
+        list_sort_by_value_i(&test_list, LIST_SORT_ASC);
+        ASSERT_TRUE(check_sorted_stable(&test_list, LIST_SORT_ASC));
+        list_clear(&test_list);
+
+        populate_list_random(&test_list, sizes[i]);
+        list_sort_by_value_i(&test_list, LIST_SORT_DESC);
+        ASSERT_TRUE(check_sorted_stable(&test_list, LIST_SORT_DESC));
+        list_clear(&test_list);
+    }
+}
+
+UTEST(list, test_list_sort_benchmark) {
+    long sizes[] = {10000, 100000};
+    struct timespec begin;
+    struct timespec end;
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        struct t_list test_list;
+        populate_list_random(&test_list, sizes[i]);
+        clock_gettime(CLOCK_MONOTONIC, &begin);
+        list_sort_by_value_i(&test_list, LIST_SORT_ASC);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double value_ms = elapsed_ms(&begin, &end);
+        ASSERT_TRUE(check_sorted_stable(&test_list, LIST_SORT_ASC));
+
+        clock_gettime(CLOCK_MONOTONIC, &begin);
+        list_sort_by_key(&test_list, LIST_SORT_DESC);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double key_ms = elapsed_ms(&begin, &end);
+        ASSERT_EQ(sizes[i], test_list.length);
+
+        printf("Sort %ld nodes: by value %.2f ms, by key %.2f ms\n", sizes[i], value_ms, key_ms);
+        list_clear(&test_list);
+    }
+}
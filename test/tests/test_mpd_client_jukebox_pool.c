@@ -0,0 +1,88 @@
+/*
+ SPDX-License-Identifier: GPL-3.0-or-later
+ myMPD (c) 2018-2023 Juergen Mang <mail@jcgames.de>
+ https://github.com/jcorporation/mympd
+*/
+
+#include "compile_time.h"
+#include "utility.h"
+
+#include "dist/utest/utest.h"
+#include "src/mpd_client/jukebox_pool.h"
+
+#include <string.h>
+
+UTEST(mpd_client_jukebox_pool, test_jukebox_pool_add) {
+    struct t_jukebox_pool *pool = jukebox_pool_new("Database");
+    ASSERT_STREQ("Database", pool->source);
+    jukebox_pool_add(pool, "a.mp3", "Artist1", 100);
+    jukebox_pool_add(pool, "b.mp3", "Artist1", 200);
+    ASSERT_EQ(2U, (unsigned)pool->len);
+    ASSERT_STREQ("b.mp3", pool->candidates[1].uri);
+    ASSERT_EQ(200U, pool->candidates[1].duration);
+    //tag values are interned
+    ASSERT_TRUE(pool->candidates[0].tag_value == pool->candidates[1].tag_value);
+    jukebox_pool_free(pool);
+}
+
+UTEST(mpd_client_jukebox_pool, test_jukebox_pool_pick) {
+    struct t_jukebox_pool *pool = jukebox_pool_new("Database");
+    char uri[16];
+    for (unsigned i = 0; i < 2000; i++) {
+        snprintf(uri, sizeof(uri), "%u.mp3", i);
+        jukebox_pool_add(pool, uri, "", i);
+    }
+    //drawing all songs returns every song exactly once
+    bool seen[2000] = { false };
+    for (size_t i = 0; i < pool->len; i++) {
+        const struct t_jukebox_candidate *candidate = jukebox_pool_pick(pool, i);
+        ASSERT_FALSE(seen[candidate->duration]);
+        seen[candidate->duration] = true;
+        ASSERT_EQ((unsigned)strtoul(candidate->uri, NULL, 10), candidate->duration);
+    }
+    for (unsigned i = 0; i < 2000; i++) {
+        ASSERT_TRUE(seen[i]);
+    }
+    jukebox_pool_clear_stickers(pool);
+    ASSERT_FALSE(pool->stickers_fetched);
+    jukebox_pool_free(pool);
+}
+
+UTEST(mpd_client_jukebox_pool, test_jukebox_pool_pick_weighted) {
+    struct t_jukebox_pool *pool = jukebox_pool_new("Database");
+    char uri[16];
+    for (unsigned i = 0; i < 1000; i++) {
+        snprintf(uri, sizeof(uri), "%u.mp3", i);
+        jukebox_pool_add(pool, uri, "", i);
+        //even songs are nine times more likely, the last song is never preferred
+        double weight = i == 999
+            ? 0
+            : i % 2 == 0
+                ? 9
+                : 1;
+        jukebox_pool_set_weight(pool, i, weight);
+    }
+    jukebox_pool_weighted_init(pool);
+    //drawing all songs returns every song exactly once in descending key order
+    bool seen[1000] = { false };
+    double last_key = 1;
+    unsigned heavy = 0;
+    for (size_t i = 0; i < pool->len; i++) {
+        const struct t_jukebox_candidate *candidate = jukebox_pool_pick_weighted(pool, i);
+        ASSERT_FALSE(seen[candidate->duration]);
+        seen[candidate->duration] = true;
+        ASSERT_LE(candidate->key, last_key);
+        last_key = candidate->key;
+        if (i < 100 &&
+            candidate->duration % 2 == 0)
+        {
+            heavy++;
+        }
+        if (i == pool->len - 1) {
+            ASSERT_EQ(999U, candidate->duration);
+        }
+    }
+    printf("Heavy songs in the first 100 draws: %u\n", heavy);
+    ASSERT_GE(heavy, 75U);
+    jukebox_pool_free(pool);
+}
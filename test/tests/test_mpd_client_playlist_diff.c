@@ -0,0 +1,160 @@
+/*
+ SPDX-License-Identifier: GPL-3.0-or-later
+ myMPD (c) 2018-2023 Juergen Mang <mail@jcgames.de>
+ https://github.com/jcorporation/mympd
+*/
+
+#include "compile_time.h"
+#include "utility.h"
+
+#include "dist/utest/utest.h"
+#include "src/mpd_client/playlist_diff.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_SONGS 64
+
+static void populate(struct t_list *l, const char *songs) {
+    char uri[2] = {0, 0};
+    for (const char *p = songs; *p != '\0'; p++) {
+        uri[0] = *p;
+        list_push(l, uri, 0, NULL, NULL);
+    }
+}
+
+// applies the edits like mpd and returns the songs as string
+static void apply(const char *songs, const struct t_playlist_edits *edits, char *result) {
+    size_t len = strlen(songs);
+    memcpy(result, songs, len + 1);
+    for (size_t i = 0; i < edits->len; i++) {
+        const struct t_playlist_edit *edit = &edits->edits[i];
+        switch(edit->type) {
+            case PLAYLIST_EDIT_DELETE:
+                memmove(&result[edit->pos], &result[edit->pos + 1], len - edit->pos);
+                len--;
+                break;
+            case PLAYLIST_EDIT_MOVE: {
+                char c = result[edit->pos];
+                memmove(&result[edit->pos], &result[edit->pos + 1], len - edit->pos);
+                memmove(&result[edit->to + 1], &result[edit->to], len - edit->to);
+                result[edit->to] = c;
+                break;
+            }
+            case PLAYLIST_EDIT_ADD:
+                memmove(&result[edit->pos + 1], &result[edit->pos], len - edit->pos + 1);
+                result[edit->pos] = edit->uri[0];
+                len++;
+                break;
+        }
+    }
+}
+
+static size_t diff(const char *current_songs, const char *target_songs, char *result) {
+    struct t_list current;
+    struct t_list target;
+    list_init(&current);
+    list_init(&target);
+    populate(&current, current_songs);
+    populate(&target, target_songs);
+    struct t_playlist_edits edits;
+    playlist_edits_init(&edits);
+    bool rc = playlist_diff(&current, &target, MAX_SONGS * 3, &edits);
+    size_t count = edits.len;
+    if (rc == true) {
+        apply(current_songs, &edits, result);
+    }
+    playlist_edits_clear(&edits);
+    list_clear(&current);
+    list_clear(&target);
+    return count;
+}
+
+UTEST(mpd_client_playlist_diff, test_playlist_diff) {
+    char result[MAX_SONGS * 2];
+    //unchanged
+    ASSERT_EQ(0U, (unsigned)diff("abcdef", "abcdef", result));
+    ASSERT_STREQ("abcdef", result);
+    //one new song in the middle
+    ASSERT_EQ(1U, (unsigned)diff("abcdef", "abcxdef", result));
+    ASSERT_STREQ("abcxdef", result);
+    //one removed song
+    ASSERT_EQ(1U, (unsigned)diff("abcdef", "abdef", result));
+    ASSERT_STREQ("abdef", result);
+    //one song moved from the start to the end
+    ASSERT_EQ(1U, (unsigned)diff("dabc", "abcd", result));
+    ASSERT_STREQ("abcd", result);
+    //one song moved from the end to the start
+    ASSERT_EQ(1U, (unsigned)diff("bcda", "abcd", result));
+    ASSERT_STREQ("abcd", result);
+    //reversed
+    ASSERT_EQ(3U, (unsigned)diff("dcba", "abcd", result));
+    ASSERT_STREQ("abcd", result);
+    //new and empty playlists
+    ASSERT_EQ(3U, (unsigned)diff("", "abc", result));
+    ASSERT_STREQ("abc", result);
+    ASSERT_EQ(3U, (unsigned)diff("abc", "", result));
+    ASSERT_STREQ("", result);
+    //duplicates
+    ASSERT_EQ(1U, (unsigned)diff("abab", "abb", result));
+    ASSERT_STREQ("abb", result);
+    ASSERT_EQ(1U, (unsigned)diff("ab", "abb", result));
+    ASSERT_STREQ("abb", result);
+}
+
+UTEST(mpd_client_playlist_diff, test_playlist_diff_random) {
+    char current[MAX_SONGS + 1];
+    char target[MAX_SONGS + 1];
+    char result[MAX_SONGS * 2];
+    srand(42);
+    for (int n = 0; n < 500; n++) {
+        size_t current_len = (size_t)(rand() % MAX_SONGS);
+        size_t target_len = (size_t)(rand() % MAX_SONGS);
+        for (size_t i = 0; i < current_len; i++) {
+            current[i] = (char)('A' + rand() % 40);
+        }
+        current[current_len] = '\0';
+        for (size_t i = 0; i < target_len; i++) {
+            target[i] = (char)('A' + rand() % 40);
+        }
+        target[target_len] = '\0';
+        diff(current, target, result);
+        ASSERT_STREQ(target, result);
+    }
+}
+
+UTEST(mpd_client_playlist_diff, test_playlist_diff_max_edits) {
+    struct t_list current;
+    struct t_list target;
+    list_init(&current);
+    list_init(&target);
+    populate(&current, "abcdef");
+    populate(&target, "fedcba");
+    struct t_playlist_edits edits;
+    playlist_edits_init(&edits);
+    ASSERT_FALSE(playlist_diff(&current, &target, 4, &edits));
+    ASSERT_EQ(0U, (unsigned)edits.len);
+    ASSERT_TRUE(playlist_diff(&current, &target, 5, &edits));
+    ASSERT_EQ(5U, (unsigned)edits.len);
+    playlist_edits_clear(&edits);
+    list_clear(&current);
+    list_clear(&target);
+}
+
+UTEST(mpd_client_playlist_diff, test_playlist_same_songs) {
+    struct t_list current;
+    struct t_list target;
+    list_init(&current);
+    list_init(&target);
+    populate(&current, "abca");
+    populate(&target, "aacb");
+    ASSERT_TRUE(playlist_same_songs(&current, &target));
+    list_clear(&target);
+    populate(&target, "abcc");
+    ASSERT_FALSE(playlist_same_songs(&current, &target));
+    list_clear(&target);
+    populate(&target, "abc");
+    ASSERT_FALSE(playlist_same_songs(&current, &target));
+    list_clear(&current);
+    list_clear(&target);
+}
@@ -0,0 +1,202 @@
+/*
+ SPDX-License-Identifier: GPL-3.0-or-later
+ myMPD (c) 2018-2023 Juergen Mang <mail@jcgames.de>
+ https://github.com/jcorporation/mympd
+*/
+
+#include "compile_time.h"
+#include "utility.h"
+
+#include "dist/utest/utest.h"
+#include "dist/libmympdclient/src/isong.h"
+#include "dist/utf8/utf8.h"
+#include "src/lib/album_cache.h"
+#include "src/lib/mympd_state.h"
+#include "src/mpd_client/search_local.h"
+#include "src/mpd_client/tags.h"
+
+#include <time.h>
+
+static struct mpd_song *search_song(void) {
+    struct mpd_song *song = mpd_song_begin(&(struct mpd_pair){"file", "music/einstuerzende_neubauten/tabula_rasa.mp3"});
+    mympd_mpd_song_add_tag_dedup(song, MPD_TAG_ARTIST, "Einstürzende Neubauten");
+    mympd_mpd_song_add_tag_dedup(song, MPD_TAG_ARTIST, "Blixa Bargeld");
+    mympd_mpd_song_add_tag_dedup(song, MPD_TAG_ALBUM, "Tabula Rasa");
+    mympd_mpd_song_add_tag_dedup(song, MPD_TAG_GENRE, "Industrial");
+    return song;
+}
+
+static bool search_filter(const char *expression) {
+    struct mpd_song *song = search_song();
+    struct t_tags tags;
+    reset_t_tags(&tags);
+    tags.tags[tags.tags_len++] = MPD_TAG_ALBUM;
+    tags.tags[tags.tags_len++] = MPD_TAG_ARTIST;
+    struct t_search_filter *filter = search_filter_new(expression);
+    bool rc = search_song_expression(song, filter, &tags);
+    search_filter_free(filter);
+    mpd_song_free(song);
+    return rc;
+}
+
+UTEST(mpd_client_search_local, test_search_filter_operators) {
+    //empty expression matches all
+    ASSERT_TRUE(search_filter(""));
+    //invalid expression matches nothing
+    ASSERT_FALSE(search_filter("((Album contains 'tabula')"));
+    ASSERT_FALSE(search_filter("((Album like 'tabula'))"));
+    //unicode case folding
+    ASSERT_TRUE(search_filter("((Artist == 'EINSTÜRZENDE NEUBAUTEN'))"));
+    ASSERT_TRUE(search_filter("((any contains 'bargeld'))"));
+    ASSERT_FALSE(search_filter("((any contains 'industrial'))"));
+    //missing tag
+    ASSERT_FALSE(search_filter("((Composer contains 'x'))"));
+    ASSERT_TRUE(search_filter("((Composer != 'x'))"));
+    //values with parenthesis and keywords
+    ASSERT_FALSE(search_filter("((Album == 'Tabula) AND (Rasa'))"));
+}
+
+UTEST(mpd_client_search_local, test_search_filter_and_or_not) {
+    ASSERT_TRUE(search_filter("((Album == 'Tabula Rasa') AND (Genre == 'Industrial'))"));
+    ASSERT_FALSE(search_filter("((Album == 'Tabula Rasa') AND (Genre == 'Pop'))"));
+    ASSERT_TRUE(search_filter("(Album == 'Tabula Rasa') AND (Genre == 'Industrial')"));
+    ASSERT_TRUE(search_filter("((Genre == 'Pop') OR (Genre == 'Industrial'))"));
+    ASSERT_FALSE(search_filter("((Genre == 'Pop') OR (Genre == 'Rock'))"));
+    ASSERT_TRUE(search_filter("(!(Genre == 'Pop'))"));
+    ASSERT_FALSE(search_filter("(!(Genre == 'Industrial'))"));
+    //AND binds stronger than OR
+    ASSERT_TRUE(search_filter("((Genre == 'Pop') AND (Album == 'x') OR (Album contains 'rasa'))"));
+    ASSERT_FALSE(search_filter("((Genre == 'Pop') AND ((Album == 'x') OR (Album contains 'rasa')))"));
+    ASSERT_TRUE(search_filter("((Album contains 'rasa') OR (Genre == 'Pop') AND (Album == 'x'))"));
+}
+
+UTEST(mpd_client_search_local, test_search_filter_cache) {
+    struct t_search_filter_cache *cache = search_filter_cache_new();
+    struct t_search_filter *first = search_filter_cache_get(cache, "((Album == 'Tabula Rasa'))");
+    ASSERT_TRUE(first == search_filter_cache_get(cache, "((Album == 'Tabula Rasa'))"));
+    struct t_search_filter *second = search_filter_cache_get(cache, "((Genre == 'Industrial'))");
+    ASSERT_TRUE(first != second);
+    ASSERT_TRUE(first == search_filter_cache_get(cache, "((Album == 'Tabula Rasa'))"));
+    //fill the cache, the oldest entry is replaced
+    sds expression = sdsempty();
+    for (int i = 0; i < SEARCH_FILTER_CACHE_SIZE - 2; i++) {
+        sdsclear(expression);
+        expression = sdscatfmt(expression, "((Album == '%i'))", i);
+        search_filter_cache_get(cache, expression);
+    }
+    sdsfree(expression);
+    ASSERT_TRUE(second == search_filter_cache_get(cache, "((Genre == 'Industrial'))"));
+    ASSERT_STREQ("((Album == 'Tabula Rasa'))", cache->filters[0]->expression);
+    search_filter_cache_get(cache, "((Album == 'Other'))");
+    ASSERT_STREQ("((Album == 'Other'))", cache->filters[0]->expression);
+    search_filter_cache_free(cache);
+}
+
+/**
+ * Expression triple for the reference implementation
+ */
+struct t_reference_expression {
+    enum mpd_tag_type tag;
+    const char *op;
+    const char *value;
+};
+
+/**
+ * Reference copy of the previous search path:
+ * the expression list is walked for each song and each tag value
+ * is compared case insensitive with the utf8 functions.
+ */
+static bool search_song_reference(const struct mpd_song *song, const struct t_reference_expression *expr_list, size_t expr_len) {
+    for (size_t k = 0; k < expr_len; k++) {
+        const struct t_reference_expression *expr = &expr_list[k];
+        bool rc = false;
+        unsigned j = 0;
+        const char *value = NULL;
+        while ((value = mpd_song_get_tag(song, expr->tag, j)) != NULL) {
+            j++;
+            if ((strcmp(expr->op, "contains") == 0 && utf8casestr(value, expr->value) == NULL) ||
+                (strcmp(expr->op, "starts_with") == 0 && utf8ncasecmp(expr->value, value, strlen(expr->value)) != 0) ||
+                (strcmp(expr->op, "==") == 0 && utf8casecmp(value, expr->value) != 0))
+            {
+                //expression does not match
+                rc = false;
+            }
+            else {
+                //tag value matched
+                rc = true;
+                break;
+            }
+        }
+        if (rc == false) {
+            //exit on first expression mismatch
+            return false;
+        }
+    }
+    return true;
+}
+
+UTEST(mpd_client_search_local, test_search_filter_benchmark) {
+    const int songs_len = 200;
+    const int iterations = 200;
+    struct mpd_song *songs[200];
+    sds album = sdsempty();
+    for (int i = 0; i < songs_len; i++) {
+        songs[i] = search_song();
+        sdsclear(album);
+        album = sdscatfmt(album, "Album Number %i With A Rather Long Title", i);
+        free(songs[i]->tags[MPD_TAG_ALBUM].value);
+        songs[i]->tags[MPD_TAG_ALBUM].value = strdup(album);
+    }
+    sdsfree(album);
+    struct t_tags tags;
+    reset_t_tags(&tags);
+    struct t_search_filter_cache *cache = search_filter_cache_new();
+    struct timespec begin;
+    struct timespec end;
+
+    const struct t_reference_expression expr_list[] = {
+        {MPD_TAG_ARTIST, "contains", "BARGELD"},
+        {MPD_TAG_ALBUM, "contains", "TITLE"},
+        {MPD_TAG_ALBUM, "starts_with", "album number 1"}
+    };
+    long reference_matches = 0;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    for (int j = 0; j < iterations; j++) {
+        for (int i = 0; i < songs_len; i++) {
+            if (search_song_reference(songs[i], expr_list, 3) == true) {
+                reference_matches++;
+            }
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double reference_ms = elapsed_ms(&begin, &end);
+
+    long matches = 0;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    for (int j = 0; j < iterations; j++) {
+        struct t_search_filter *filter = search_filter_cache_get(cache,
+            "((Artist contains 'BARGELD') AND (Album contains 'TITLE') AND (Album starts_with 'album number 1'))");
+        for (int i = 0; i < songs_len; i++) {
+            if (search_song_expression(songs[i], filter, &tags) == true) {
+                matches++;
+            }
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double compiled_ms = elapsed_ms(&begin, &end);
+    printf("Search %d songs %d times: reference %.2f ms, compiled %.2f ms\n", songs_len, iterations, reference_ms, compiled_ms);
+    ASSERT_EQ(reference_matches, matches);
+    ASSERT_EQ((long)iterations * 111, matches);
+
+    //both paths must select the same songs
+    struct t_search_filter *filter = search_filter_cache_get(cache,
+        "((Artist contains 'BARGELD') AND (Album contains 'TITLE') AND (Album starts_with 'album number 1'))");
+    for (int i = 0; i < songs_len; i++) {
+        ASSERT_EQ(search_song_reference(songs[i], expr_list, 3), search_song_expression(songs[i], filter, &tags));
+    }
+
+    search_filter_cache_free(cache);
+    for (int i = 0; i < songs_len; i++) {
+        mpd_song_free(songs[i]);
+    }
+}
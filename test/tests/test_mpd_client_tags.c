@@ -152,6 +152,197 @@ UTEST(album_cache, test_album_cache_inc_song_count) {
     mpd_song_free(album);
 }
 
+static struct mpd_song *new_album(const char *uri, unsigned song_count) {
+    struct mpd_song *album = new_song();
+    free(album->uri);
+    album->uri = strdup(uri);
+    album_cache_set_song_count(album, song_count);
+    return album;
+}
+
+static void insert_album(struct t_cache *album_cache, const char *key, const char *uri, unsigned song_count) {
+    struct mpd_song *album = new_album(uri, song_count);
+    album_cache_set_disc_count(album, 1);
+    album_cache_insert(album_cache, key, strlen(key), album);
+    mpd_song_free(album);
+}
+
+static unsigned get_album_song_count(struct t_cache *album_cache, const char *key) {
+    struct t_album *album = raxFind(album_cache->cache, (unsigned char *)key, strlen(key));
+    return album->songs;
+}
+
+UTEST(album_cache, test_album_cache_insert) {
+    struct t_cache album_cache;
+    album_cache_init(&album_cache);
+    album_cache.mtime = 0;
+    insert_album(&album_cache, "a", "dir1/1.mp3", 2);
+    insert_album(&album_cache, "b", "dir2/1.mp3", 3);
+    struct t_album *a = raxFind(album_cache.cache, (unsigned char *)"a", 1);
+    struct t_album *b = raxFind(album_cache.cache, (unsigned char *)"b", 1);
+    ASSERT_STREQ("dir1/1.mp3", a->uri);
+    ASSERT_EQ(2U, a->songs);
+    ASSERT_EQ(1U, a->discs);
+    ASSERT_EQ(10U, a->duration);
+    ASSERT_EQ(2000, (int)a->last_modified);
+    ASSERT_STREQ("Einstürzende Neubauten", album_get_tag(a, MPD_TAG_ARTIST, 0));
+    ASSERT_STREQ("Blixa Bargeld", album_get_tag(a, MPD_TAG_ARTIST, 1));
+    ASSERT_TRUE(album_get_tag(a, MPD_TAG_ARTIST, 2) == NULL);
+    ASSERT_TRUE(album_get_tag(a, MPD_TAG_GENRE, 0) == NULL);
+    // tag values are interned
+    ASSERT_TRUE(album_get_tag(a, MPD_TAG_ALBUM, 0) == album_get_tag(b, MPD_TAG_ALBUM, 0));
+    ASSERT_TRUE(album_get_tag(a, MPD_TAG_ALBUM, 0) == album_get_tag(a, MPD_TAG_TITLE, 0));
+    sds value = album_get_tag_value_string(a, MPD_TAG_ARTIST, sdsempty());
+    ASSERT_STREQ("Einstürzende Neubauten, Blixa Bargeld", value);
+    sdsfree(value);
+    album_cache_free(&album_cache);
+}
+
+UTEST(album_cache, test_album_cache_delta_apply) {
+    struct t_cache album_cache;
+    album_cache_init(&album_cache);
+    album_cache.mtime = 0;
+    insert_album(&album_cache, "a", "dir1/1.mp3", 2);
+    insert_album(&album_cache, "b", "dir2/1.mp3", 3);
+    insert_album(&album_cache, "c", "dir3/1.mp3", 4);
+    ASSERT_EQ(9UL, album_cache_get_song_count(&album_cache));
+
+    // album a was retagged to d, album b got a new song
+    struct t_album_cache_delta *delta = album_cache_delta_new();
+    raxInsert(delta->dirs, (unsigned char *)"dir1", 4, NULL, NULL);
+    raxInsert(delta->dirs, (unsigned char *)"dir2", 4, NULL, NULL);
+    raxInsert(delta->albums, (unsigned char *)"b", 1, new_album("dir2/1.mp3", 4), NULL);
+    raxInsert(delta->albums, (unsigned char *)"d", 1, new_album("dir1/1.mp3", 2), NULL);
+    delta->song_count = 10;
+    bool rc = album_cache_delta_apply(&album_cache, delta);
+    ASSERT_TRUE(rc);
+    ASSERT_EQ(3, (int)album_cache.cache->numele);
+    ASSERT_TRUE(raxFind(album_cache.cache, (unsigned char *)"a", 1) == raxNotFound);
+    ASSERT_EQ(4U, get_album_song_count(&album_cache, "b"));
+    ASSERT_EQ(4U, get_album_song_count(&album_cache, "c"));
+    ASSERT_EQ(2U, get_album_song_count(&album_cache, "d"));
+    album_cache_delta_free(delta);
+
+    // song of album c was removed, this is not covered by the delta
+    delta = album_cache_delta_new();
+    delta->song_count = 9;
+    rc = album_cache_delta_apply(&album_cache, delta);
+    ASSERT_FALSE(rc);
+    album_cache_delta_free(delta);
+
+    album_cache_free(&album_cache);
+}
+
+UTEST(album_cache, test_album_cache_compact_strings) {
+    struct t_cache album_cache;
+    album_cache_init(&album_cache);
+    album_cache.mtime = 0;
+    insert_album(&album_cache, "a", "dir1/1.mp3", 1);
+
+    // album a is retagged with a new title on each update
+    char title[2000];
+    for (int i = 0; i < 200; i++) {
+        memset(title, 'a', sizeof(title) - 1);
+        snprintf(title, sizeof(title), "%d", i);
+        title[strlen(title)] = 'a';
+        title[sizeof(title) - 1] = '\0';
+        struct mpd_song *album = new_album("dir1/1.mp3", 1);
+        free(album->tags[MPD_TAG_ALBUM].value);
+        album->tags[MPD_TAG_ALBUM].value = strdup(title);
+        struct t_album_cache_delta *delta = album_cache_delta_new();
+        raxInsert(delta->albums, (unsigned char *)"a", 1, album, NULL);
+        delta->song_count = 1;
+        bool rc = album_cache_delta_apply(&album_cache, delta);
+        ASSERT_TRUE(rc);
+        album_cache_delta_free(delta);
+    }
+    // the released titles do not accumulate in the string pool
+    ASSERT_LT(album_cache.strings->bytes, (size_t)ALBUM_CACHE_STRINGS_COMPACT_MIN * 2);
+    struct t_album *a = raxFind(album_cache.cache, (unsigned char *)"a", 1);
+    ASSERT_STREQ(title, album_get_tag(a, MPD_TAG_ALBUM, 0));
+    ASSERT_STREQ("a", a->id);
+    ASSERT_STREQ("dir1/1.mp3", a->uri);
+    ASSERT_STREQ("Einstürzende Neubauten", album_get_tag(a, MPD_TAG_ARTIST, 0));
+
+    album_cache_free(&album_cache);
+}
+
+static void insert_album_title(struct t_cache *album_cache, const char *key, const char *uri, const char *title, time_t last_modified) {
+    struct mpd_song *album = new_album(uri, 1);
+    free(album->tags[MPD_TAG_ALBUM].value);
+    album->tags[MPD_TAG_ALBUM].value = strdup(title);
+    album->last_modified = last_modified;
+    album_cache_insert(album_cache, key, strlen(key), album);
+    mpd_song_free(album);
+}
+
+static sds get_sort_order(rax *sort_index) {
+    sds order = sdsempty();
+    raxIterator iter;
+    raxStart(&iter, sort_index);
+    raxSeek(&iter, "^", NULL, 0);
+    while (raxNext(&iter)) {
+        order = sdscat(order, ((struct t_album *)iter.data)->id);
+    }
+    raxStop(&iter);
+    return order;
+}
+
+UTEST(album_cache, test_album_cache_sort_index) {
+    struct t_cache album_cache;
+    album_cache_init(&album_cache);
+    album_cache.mtime = 0;
+    insert_album_title(&album_cache, "a", "dir1/1.mp3", "Zeichnungen", 3000);
+    insert_album_title(&album_cache, "b", "dir2/1.mp3", "halber Mensch", 1000);
+    insert_album_title(&album_cache, "c", "dir3/1.mp3", "Alles wieder offen", 2000);
+
+    rax *by_album = album_cache_get_sort_index(&album_cache, MPD_TAG_ALBUM);
+    rax *by_last_modified = album_cache_get_sort_index(&album_cache, MPD_TAG_UNKNOWN);
+    ASSERT_TRUE(by_album == album_cache_get_sort_index(&album_cache, MPD_TAG_ALBUM));
+    sds order = get_sort_order(by_album);
+    ASSERT_STREQ("cba", order);
+    sdsfree(order);
+    order = get_sort_order(by_last_modified);
+    ASSERT_STREQ("bca", order);
+    sdsfree(order);
+
+    // indexes are maintained on changes
+    insert_album_title(&album_cache, "a", "dir1/1.mp3", "Ende Neu", 4000);
+    insert_album_title(&album_cache, "d", "dir4/1.mp3", "Alles wieder offen", 500);
+    struct t_album *album = raxFind(album_cache.cache, (unsigned char *)"b", 1);
+    album_cache_set_uri(&album_cache, album, "dir0/1.mp3");
+    order = get_sort_order(by_album);
+    ASSERT_STREQ("cdab", order);
+    sdsfree(order);
+    order = get_sort_order(by_last_modified);
+    ASSERT_STREQ("dbca", order);
+    sdsfree(order);
+    ASSERT_EQ(4, (int)by_album->numele);
+
+    album_cache_free(&album_cache);
+}
+
+UTEST(album_cache, test_print_album_tags) {
+    struct t_cache album_cache;
+    album_cache_init(&album_cache);
+    album_cache.mtime = 0;
+    struct mpd_song *song = new_album("dir1/1.mp3", 1);
+    free(song->tags[MPD_TAG_TITLE].value);
+    song->tags[MPD_TAG_TITLE].value = NULL;
+    album_cache_insert(&album_cache, "a", 1, song);
+    mpd_song_free(song);
+    struct t_album *album = raxFind(album_cache.cache, (unsigned char *)"a", 1);
+    struct t_tags tagcols;
+    reset_t_tags(&tagcols);
+    tagcols.tags[tagcols.tags_len++] = MPD_TAG_TITLE;
+    tagcols.tags[tagcols.tags_len++] = MPD_TAG_PERFORMER;
+    // title falls back to the filename
+    sds s = print_album_tags(sdsempty(), &tagcols, album);
+    ASSERT_TRUE(strncmp(s, "\"Title\":\"1.mp3\",\"Performer\":[],", 30) == 0);
+    sdsfree(s);
+    album_cache_free(&album_cache);
+}
+
 UTEST(mpd_client_tags, test_mympd_mpd_song_add_tag_dedup) {
     struct mpd_song *song = new_song();
     ASSERT_STREQ("Einstürzende Neubauten", mpd_song_get_tag(song, MPD_TAG_ARTIST, 0));
@@ -264,11 +455,9 @@ bool search_by_expression(const char *expr_string) {
     tags.tags_len++;
     tags.tags[1] = MPD_TAG_ARTIST;
 
-    sds expression = sdsnew(expr_string);
-    struct t_list *expr_list = parse_search_expression_to_list(expression);
-    sdsfree(expression);
-    bool rc = search_song_expression(song, expr_list, &tags);
-    free_search_expression_list(expr_list);
+    struct t_search_filter *filter = search_filter_new(expr_string);
+    bool rc = search_song_expression(song, filter, &tags);
+    search_filter_free(filter);
     mpd_song_free(song);
     return rc;
 }
@@ -0,0 +1,95 @@
+/*
+ SPDX-License-Identifier: GPL-3.0-or-later
+ myMPD (c) 2018-2023 Juergen Mang <mail@jcgames.de>
+ https://github.com/jcorporation/mympd
+*/
+
+#include "compile_time.h"
+#include "utility.h"
+
+#include "dist/utest/utest.h"
+#include "src/lib/filehandler.h"
+#include "src/mympd_api/last_played.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+static const char *last_played_file = "/tmp/mympd-test/state/default/" FILENAME_LAST_PLAYED;
+static const char *index_file = "/tmp/mympd-test/state/default/" FILENAME_LAST_PLAYED_INDEX;
+
+static const char *lines[] = {
+    "{\"LastPlayed\":1700000003,\"uri\":\"song3.mp3\"}\n",
+    "{\"LastPlayed\":1700000002,\"uri\":\"dir/song2.mp3\"}\n",
+    "{\"LastPlayed\":1700000001,\"uri\":\"dir/sub/song1.mp3\"}\n",
+    NULL
+};
+
+static bool write_last_played(void) {
+    FILE *fp = fopen(last_played_file, OPEN_FLAGS_WRITE);
+    FILE *fp_index = fopen(index_file, OPEN_FLAGS_WRITE);
+    if (fp == NULL ||
+        fp_index == NULL)
+    {
+        return false;
+    }
+    bool rc = mympd_api_last_played_index_write(fp_index, 0);
+    uint64_t file_size = 0;
+    for (const char **p = lines; *p != NULL; p++) {
+        rc = rc && fputs(*p, fp) != EOF &&
+            mympd_api_last_played_index_write(fp_index, file_size);
+        file_size += strlen(*p);
+    }
+    rc = rc && fseek(fp_index, 0, SEEK_SET) == 0 &&
+        mympd_api_last_played_index_write(fp_index, file_size);
+    (void) fclose(fp);
+    (void) fclose(fp_index);
+    return rc;
+}
+
+UTEST(last_played, test_index_seek) {
+    init_testenv();
+    ASSERT_TRUE(write_last_played());
+
+    FILE *fp = fopen(last_played_file, OPEN_FLAGS_READ);
+    ASSERT_TRUE(fp != NULL);
+    sds line = sdsempty();
+    long count = 0;
+
+    // seek to each entry
+    for (long i = 0; i < 3; i++) {
+        ASSERT_TRUE(mympd_api_last_played_index_seek(index_file, fp, i, &count));
+        ASSERT_EQ(3, count);
+        ASSERT_GE(sds_getline(&line, fp, LINE_LENGTH_MAX), 0);
+        line = sdscatlen(line, "\n", 1);
+        ASSERT_STREQ(lines[i], line);
+    }
+
+    // seeking behind the last entry ends at eof
+    ASSERT_TRUE(mympd_api_last_played_index_seek(index_file, fp, 5, &count));
+    ASSERT_LT(sds_getline(&line, fp, LINE_LENGTH_MAX), 0);
+    (void) fclose(fp);
+
+    // the index is outdated after the last played file was changed
+    fp = fopen(last_played_file, "ae");
+    ASSERT_TRUE(fp != NULL);
+    ASSERT_NE(EOF, fputs(lines[0], fp));
+    (void) fclose(fp);
+    fp = fopen(last_played_file, OPEN_FLAGS_READ);
+    ASSERT_TRUE(fp != NULL);
+    ASSERT_GE(sds_getline(&line, fp, LINE_LENGTH_MAX), 0);
+    ASSERT_FALSE(mympd_api_last_played_index_seek(index_file, fp, 1, &count));
+    // fallback reads the file from the start
+    ASSERT_GE(sds_getline(&line, fp, LINE_LENGTH_MAX), 0);
+    line = sdscatlen(line, "\n", 1);
+    ASSERT_STREQ(lines[0], line);
+
+    // missing index
+    unlink(index_file);
+    ASSERT_FALSE(mympd_api_last_played_index_seek(index_file, fp, 1, &count));
+    (void) fclose(fp);
+
+    sdsfree(line);
+    clean_testenv();
+}
@@ -12,6 +12,38 @@
 #include "src/lib/msg_queue.h"
 #include "src/lib/sds_extras.h"
 
+#include <poll.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+static bool event_fd_readable(struct t_mympd_queue *queue) {
+    struct pollfd fds[1];
+    fds[0].fd = mympd_queue_event_fd(queue);
+    fds[0].events = POLLIN;
+    return poll(fds, 1, 0) == 1 &&
+        (fds[0].revents & POLLIN);
+}
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1000 + (double)ts.tv_nsec / 1000000;
+}
+
+#define BENCH_MESSAGES 20
+
+static void *bench_producer(void *arg) {
+    struct t_mympd_queue *queue = (struct t_mympd_queue *)arg;
+    for (int i = 0; i < BENCH_MESSAGES; i++) {
+        usleep(13000);
+        double *sent = malloc(sizeof(double));
+        *sent = now_ms();
+        mympd_queue_push(queue, sent, 0);
+    }
+    return NULL;
+}
+
 UTEST(mympd_queue, push_shift) {
     struct t_mympd_queue *test_queue = mympd_queue_create("test", QUEUE_TYPE_REQUEST);
     sds test_data_in0 = sdsnew("test0");
@@ -119,3 +151,149 @@ UTEST(mympd_queue, expire) {
 
     mympd_queue_free(test_queue);
 }
+
+UTEST(mympd_queue, event_fd) {
+    struct t_mympd_queue *test_queue = mympd_queue_create("test", QUEUE_TYPE_REQUEST);
+    ASSERT_TRUE(mympd_queue_event_fd(test_queue) > -1);
+    ASSERT_FALSE(event_fd_readable(test_queue));
+    sds test_data_in0 = sdsnew("test0");
+    sds test_data_in1 = sdsnew("test1");
+
+    mympd_queue_push(test_queue, test_data_in0, 0);
+    mympd_queue_push(test_queue, test_data_in1, 0);
+    ASSERT_TRUE(event_fd_readable(test_queue));
+
+    //readable until the queue is empty
+    sds test_data_out = mympd_queue_shift(test_queue, -1, 0);
+    ASSERT_STREQ(test_data_in0, test_data_out);
+    ASSERT_TRUE(event_fd_readable(test_queue));
+    test_data_out = mympd_queue_shift(test_queue, -1, 0);
+    ASSERT_STREQ(test_data_in1, test_data_out);
+    ASSERT_FALSE(event_fd_readable(test_queue));
+
+    //do not wait for an empty queue
+    test_data_out = mympd_queue_shift(test_queue, -1, 0);
+    ASSERT_TRUE(test_data_out == NULL);
+
+    mympd_queue_free(test_queue);
+    sdsfree(test_data_in0);
+    sdsfree(test_data_in1);
+}
+
+UTEST(mympd_queue, test_wakeup_latency_benchmark) {
+    struct t_mympd_queue *test_queue = mympd_queue_create("test", QUEUE_TYPE_REQUEST);
+    pthread_t producer;
+
+    //old pattern: poll other fds with a timeout and check the queue afterwards
+    double poll_latency = 0;
+    int received = 0;
+    ASSERT_EQ(0, pthread_create(&producer, NULL, bench_producer, test_queue));
+    while (received < BENCH_MESSAGES) {
+        poll(NULL, 0, 50);
+        double *sent;
+        while ((sent = mympd_queue_shift(test_queue, -1, 0)) != NULL) {
+            poll_latency += now_ms() - *sent;
+            received++;
+            free(sent);
+        }
+    }
+    pthread_join(producer, NULL);
+
+    //new pattern: the queue wakes up the poll
+    double event_latency = 0;
+    received = 0;
+    ASSERT_EQ(0, pthread_create(&producer, NULL, bench_producer, test_queue));
+    struct pollfd fds[1];
+    fds[0].fd = mympd_queue_event_fd(test_queue);
+    fds[0].events = POLLIN;
+    while (received < BENCH_MESSAGES) {
+        poll(fds, 1, 1000);
+        double *sent;
+        while ((sent = mympd_queue_shift(test_queue, -1, 0)) != NULL) {
+            event_latency += now_ms() - *sent;
+            received++;
+            free(sent);
+        }
+    }
+    pthread_join(producer, NULL);
+
+    printf("Wakeup latency for %d messages: poll timeout %.3f ms, event fd %.3f ms (mean)\n",
+        BENCH_MESSAGES, poll_latency / BENCH_MESSAGES, event_latency / BENCH_MESSAGES);
+    ASSERT_EQ(0, test_queue->length);
+
+    mympd_queue_free(test_queue);
+}
+
+UTEST(mympd_queue, mailbox) {
+    struct t_mympd_mailboxes *mailboxes = mympd_mailboxes_create("test");
+    struct t_mympd_mailbox mailbox1;
+    struct t_mympd_mailbox mailbox2;
+    mympd_mailbox_open(mailboxes, &mailbox1, 1);
+    mympd_mailbox_open(mailboxes, &mailbox2, 2);
+    ASSERT_EQ(2, mailboxes->length);
+
+    struct t_work_response *response = create_response_new(-2, 2, MYMPD_API_COLS_SAVE, MPD_PARTITION_DEFAULT);
+    ASSERT_TRUE(mympd_mailbox_push(mailboxes, response, 2));
+    //nothing for mailbox 1
+    ASSERT_TRUE(mympd_mailbox_wait(mailboxes, &mailbox1, 50) == NULL);
+    struct t_work_response *out = mympd_mailbox_wait(mailboxes, &mailbox2, 50);
+    ASSERT_TRUE(out == response);
+    free_response(out);
+
+    //no mailbox for this id, response is freed
+    response = create_response_new(-2, 3, MYMPD_API_COLS_SAVE, MPD_PARTITION_DEFAULT);
+    ASSERT_FALSE(mympd_mailbox_push(mailboxes, response, 3));
+
+    //undelivered responses are freed on close
+    response = create_response_new(-2, 1, MYMPD_API_COLS_SAVE, MPD_PARTITION_DEFAULT);
+    response->extra = malloc(10);
+    ASSERT_TRUE(mympd_mailbox_push(mailboxes, response, 1));
+    mympd_mailbox_close(mailboxes, &mailbox1);
+    mympd_mailbox_close(mailboxes, &mailbox2);
+    ASSERT_EQ(0, mailboxes->length);
+    ASSERT_TRUE(mailboxes->head == NULL);
+
+    mympd_mailboxes_free(mailboxes);
+}
+
+#define MAILBOX_THREADS 16
+
+struct t_mailbox_waiter {
+    struct t_mympd_mailboxes *mailboxes;
+    struct t_mympd_mailbox mailbox;
+    long received;
+};
+
+static void *mailbox_waiter(void *arg) {
+    struct t_mailbox_waiter *waiter = (struct t_mailbox_waiter *)arg;
+    struct t_work_response *response = mympd_mailbox_wait(waiter->mailboxes, &waiter->mailbox, 5000);
+    if (response != NULL) {
+        waiter->received = response->id;
+        free_response(response);
+    }
+    return NULL;
+}
+
+UTEST(mympd_queue, mailbox_threads) {
+    struct t_mympd_mailboxes *mailboxes = mympd_mailboxes_create("test");
+    struct t_mailbox_waiter waiters[MAILBOX_THREADS];
+    pthread_t threads[MAILBOX_THREADS];
+    for (long i = 0; i < MAILBOX_THREADS; i++) {
+        waiters[i].mailboxes = mailboxes;
+        waiters[i].received = -1;
+        mympd_mailbox_open(mailboxes, &waiters[i].mailbox, i + 100);
+        ASSERT_EQ(0, pthread_create(&threads[i], NULL, mailbox_waiter, &waiters[i]));
+    }
+    //deliver in reverse order, each thread gets only its own response
+    for (long i = MAILBOX_THREADS - 1; i >= 0; i--) {
+        struct t_work_response *response = create_response_new(-2, i + 100, MYMPD_API_COLS_SAVE, MPD_PARTITION_DEFAULT);
+        ASSERT_TRUE(mympd_mailbox_push(mailboxes, response, i + 100));
+    }
+    for (long i = 0; i < MAILBOX_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+        ASSERT_EQ(i + 100, waiters[i].received);
+        mympd_mailbox_close(mailboxes, &waiters[i].mailbox);
+    }
+    ASSERT_EQ(0, mailboxes->length);
+    mympd_mailboxes_free(mailboxes);
+}
@@ -52,3 +52,16 @@ UTEST(random, test_random_larg) {
     ASSERT_LE(l, 30000);
     ASSERT_LE(x, 30000);
 }
+
+UTEST(random, test_random_double) {
+    int low = 0;
+    for (int i = 0; i < 100000; i++) {
+        double r = randdouble();
+        ASSERT_GT(r, 0.0);
+        ASSERT_LE(r, 1.0);
+        if (r <= 0.5) { low++; }
+    }
+    printf("Random double distribution: %d %d\n", low, 100000 - low);
+    ASSERT_GE(low, 45000);
+    ASSERT_LE(low, 55000);
+}
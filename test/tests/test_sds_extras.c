@@ -11,6 +11,7 @@
 #include "src/lib/sds_extras.h"
 
 #include <libgen.h>
+#include <time.h>
 
 const char *test_dirnames[] = {
     "/dir1/file1",
@@ -151,6 +152,89 @@ UTEST(sds_extras, test_sds_catjson) {
     sdsfree(s);
 }
 
+/**
+ * Reference implementation that escapes one char at a time
+ */
+static sds catjson_plain_bytewise(sds s, const char *p, size_t len) {
+    s = sdsMakeRoomFor(s, len + 10);
+    while (len--) {
+        s = sds_catjsonchar(s, *p);
+        p++;
+    }
+    return s;
+}
+
+UTEST(sds_extras, test_sds_catjson_plain_runs) {
+    const char specials[] = {'"', '\\', '\n', '\t', '\b', '\f', '\r', '\v', '\a', 0x01, 0x1f};
+    sds str = sdsempty();
+    sds expected = sdsempty();
+    sds s = sdsempty();
+    // place each special char at every position around the 16 byte blocks
+    for (size_t i = 0; i < sizeof(specials); i++) {
+        for (size_t pos = 0; pos < 40; pos++) {
+            sdsclear(str);
+            for (size_t j = 0; j < 40; j++) {
+                str = sds_catchar(str, j == pos ? specials[i] : (char)('a' + (j % 26)));
+            }
+            // utf8 chars need no escaping
+            str = sdscat(str, "\xc3\xa4\xe2\x82\xac");
+            sdsclear(expected);
+            expected = catjson_plain_bytewise(expected, str, sdslen(str));
+            sdsclear(s);
+            s = sds_catjson_plain(s, str, sdslen(str));
+            ASSERT_EQ(sdslen(expected), sdslen(s));
+            ASSERT_STREQ(expected, s);
+        }
+    }
+    sdsfree(str);
+    sdsfree(expected);
+    sdsfree(s);
+}
+
+UTEST(sds_extras, test_sds_catjson_plain_benchmark) {
+    const char *tags[] = {
+        "The Rather Long Title Of A Song From An Album",
+        "Artist Name",
+        "Album \"Quoted\" Title",
+        "Multi\nLine\tComment with some more text",
+        "Unicode K\xc3\xbcnstler \xe2\x82\xac",
+        "music/Artist Name/Album Title/01 - The Rather Long Title Of A Song.flac"
+    };
+    const size_t tags_len = sizeof(tags) / sizeof(tags[0]);
+    const int iterations = 50000;
+    struct timespec begin;
+    struct timespec end;
+
+    sds ref = sdsempty();
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    for (int j = 0; j < iterations; j++) {
+        sdsclear(ref);
+        for (size_t i = 0; i < tags_len; i++) {
+            ref = catjson_plain_bytewise(ref, tags[i], strlen(tags[i]));
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double ref_ms = elapsed_ms(&begin, &end);
+
+    sds s = sdsempty();
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    for (int j = 0; j < iterations; j++) {
+        sdsclear(s);
+        for (size_t i = 0; i < tags_len; i++) {
+            s = sds_catjson_plain(s, tags[i], strlen(tags[i]));
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double bulk_ms = elapsed_ms(&begin, &end);
+
+    double mb = (double)sdslen(s) * iterations / (1024 * 1024);
+    printf("Escape %.2f MB: bytewise %.2f ms (%.0f MB/s), bulk %.2f ms (%.0f MB/s)\n",
+        mb, ref_ms, mb * 1000 / ref_ms, bulk_ms, mb * 1000 / bulk_ms);
+    ASSERT_STREQ(ref, s);
+    sdsfree(ref);
+    sdsfree(s);
+}
+
 UTEST(sds_extras, test_sds_json_unescape) {
     sds s = sdsempty();
     const char *str = "test\"test";
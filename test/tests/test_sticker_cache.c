@@ -0,0 +1,96 @@
+/*
+ SPDX-License-Identifier: GPL-3.0-or-later
+ myMPD (c) 2018-2023 Juergen Mang <mail@jcgames.de>
+ https://github.com/jcorporation/mympd
+*/
+
+#include "compile_time.h"
+#include "utility.h"
+
+#include "dist/utest/utest.h"
+#include "src/lib/sds_extras.h"
+#include "src/lib/sticker_cache.h"
+
+#include <string.h>
+#include <sys/stat.h>
+
+UTEST(sticker_cache, test_sticker_cache_get_set) {
+    struct t_sticker_cache sticker_cache;
+    sticker_cache_init(&sticker_cache);
+    struct t_sticker sticker;
+    //no cache available
+    ASSERT_FALSE(sticker_cache_get(&sticker_cache, "song1.mp3", &sticker));
+    sticker_cache_set(&sticker_cache, "song1.mp3", STICKER_PLAY_COUNT, 1);
+    ASSERT_EQ(0, sticker_cache.pending.length);
+
+    sticker_cache_replace(&sticker_cache, raxNew());
+    //songs without stickers get the defaults
+    ASSERT_TRUE(sticker_cache_get(&sticker_cache, "song1.mp3", &sticker));
+    ASSERT_EQ(0, sticker.mympd[STICKER_PLAY_COUNT]);
+    ASSERT_EQ(STICKER_LIKE_NEUTRAL, sticker.mympd[STICKER_LIKE]);
+    sticker_struct_clear(&sticker);
+    ASSERT_EQ(STICKER_LIKE_NEUTRAL, sticker_cache_get_value(&sticker_cache, "song1.mp3", STICKER_LIKE));
+
+    sticker_cache_set(&sticker_cache, "song1.mp3", STICKER_PLAY_COUNT, 5);
+    sticker_cache_set(&sticker_cache, "song1.mp3", STICKER_LIKE, STICKER_LIKE_HATE);
+    ASSERT_TRUE(sticker_cache_get(&sticker_cache, "song1.mp3", &sticker));
+    ASSERT_EQ(5, sticker.mympd[STICKER_PLAY_COUNT]);
+    ASSERT_EQ(STICKER_LIKE_HATE, sticker.mympd[STICKER_LIKE]);
+    ASSERT_EQ(0, sticker.mympd[STICKER_SKIP_COUNT]);
+    sticker_struct_clear(&sticker);
+    ASSERT_EQ(5, sticker_cache_get_value(&sticker_cache, "song1.mp3", STICKER_PLAY_COUNT));
+    ASSERT_EQ(0, sticker_cache_get_value(&sticker_cache, "song2.mp3", STICKER_PLAY_COUNT));
+
+    sticker_cache_free(&sticker_cache);
+}
+
+UTEST(sticker_cache, test_sticker_cache_replace) {
+    struct t_sticker_cache sticker_cache;
+    sticker_cache_init(&sticker_cache);
+    sticker_cache_replace(&sticker_cache, raxNew());
+    //own writes while the cache is created are applied to the new cache
+    sticker_cache.building = true;
+    sticker_cache_set(&sticker_cache, "song1.mp3", STICKER_PLAY_COUNT, 2);
+    sticker_cache_set(&sticker_cache, "song1.mp3", STICKER_PLAY_COUNT, 3);
+    ASSERT_EQ(2, sticker_cache.pending.length);
+
+    rax *cache = raxNew();
+    sticker_cache_insert(cache, "song1.mp3", strlen("song1.mp3"), STICKER_PLAY_COUNT, 1);
+    sticker_cache_insert(cache, "song2.mp3", strlen("song2.mp3"), STICKER_SKIP_COUNT, 4);
+    sticker_cache_replace(&sticker_cache, cache);
+    sticker_cache.building = false;
+    ASSERT_EQ(0, sticker_cache.pending.length);
+    ASSERT_EQ(3, sticker_cache_get_value(&sticker_cache, "song1.mp3", STICKER_PLAY_COUNT));
+    ASSERT_EQ(4, sticker_cache_get_value(&sticker_cache, "song2.mp3", STICKER_SKIP_COUNT));
+
+    sticker_cache_free(&sticker_cache);
+}
+
+UTEST(sticker_cache, test_sticker_cache_read_write) {
+    init_testenv();
+    mkdir("/tmp/mympd-test/tags", 0770);
+    sds work_dir = sdsnew("/tmp/mympd-test");
+    rax *cache = raxNew();
+    sticker_cache_insert(cache, "song1.mp3", strlen("song1.mp3"), STICKER_PLAY_COUNT, 10);
+    sticker_cache_insert(cache, "song1.mp3", strlen("song1.mp3"), STICKER_LAST_PLAYED, 1700000000);
+    sticker_cache_insert(cache, "dir/song2.mp3", strlen("dir/song2.mp3"), STICKER_LIKE, STICKER_LIKE_LOVE);
+    bool rc = sticker_cache_write(cache, work_dir);
+    ASSERT_TRUE(rc);
+    sticker_cache_free_rax(cache);
+
+    struct t_sticker_cache sticker_cache;
+    sticker_cache_init(&sticker_cache);
+    rc = sticker_cache_read(&sticker_cache, work_dir);
+    ASSERT_TRUE(rc);
+    ASSERT_EQ(2U, (unsigned)sticker_cache.cache->numele);
+    ASSERT_EQ(10, sticker_cache_get_value(&sticker_cache, "song1.mp3", STICKER_PLAY_COUNT));
+    ASSERT_EQ(1700000000, sticker_cache_get_value(&sticker_cache, "song1.mp3", STICKER_LAST_PLAYED));
+    ASSERT_EQ(STICKER_LIKE_NEUTRAL, sticker_cache_get_value(&sticker_cache, "song1.mp3", STICKER_LIKE));
+    ASSERT_EQ(STICKER_LIKE_LOVE, sticker_cache_get_value(&sticker_cache, "dir/song2.mp3", STICKER_LIKE));
+    sticker_cache_free(&sticker_cache);
+
+    rc = sticker_cache_remove(work_dir);
+    ASSERT_TRUE(rc);
+    FREE_SDS(work_dir);
+    clean_testenv();
+}
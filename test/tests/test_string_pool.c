@@ -0,0 +1,53 @@
+/*
+ SPDX-License-Identifier: GPL-3.0-or-later
+ myMPD (c) 2018-2023 Juergen Mang <mail@jcgames.de>
+ https://github.com/jcorporation/mympd
+*/
+
+#include "compile_time.h"
+#include "utility.h"
+
+#include "dist/utest/utest.h"
+#include "src/lib/string_pool.h"
+
+#include <stdio.h>
+#include <string.h>
+
+UTEST(string_pool, test_string_pool_add) {
+    struct t_string_pool *pool = string_pool_new();
+    const char *a = string_pool_add(pool, "Tabula Rasa");
+    const char *b = string_pool_add(pool, "Tabula Rasa");
+    const char *c = string_pool_add_len(pool, "Tabula Rasa Bonus", 6);
+    const char *d = string_pool_add(pool, "Tabula");
+    ASSERT_STREQ("Tabula Rasa", a);
+    ASSERT_TRUE(a == b);
+    ASSERT_STREQ("Tabula", c);
+    ASSERT_TRUE(c == d);
+    ASSERT_EQ(2U, (unsigned)pool->count);
+    ASSERT_EQ(19U, (unsigned)pool->bytes);
+    string_pool_free(pool);
+}
+
+UTEST(string_pool, test_string_pool_grow) {
+    struct t_string_pool *pool = string_pool_new();
+    const char *values[5000];
+    char buf[32];
+    for (int i = 0; i < 5000; i++) {
+        snprintf(buf, sizeof(buf), "value%d", i);
+        values[i] = string_pool_add(pool, buf);
+    }
+    ASSERT_EQ(5000U, (unsigned)pool->count);
+    for (int i = 0; i < 5000; i++) {
+        snprintf(buf, sizeof(buf), "value%d", i);
+        ASSERT_TRUE(values[i] == string_pool_add(pool, buf));
+    }
+    // large strings get a dedicated block
+    char *large = malloc(100000);
+    memset(large, 'a', 99999);
+    large[99999] = '\0';
+    const char *interned = string_pool_add(pool, large);
+    ASSERT_STREQ(large, interned);
+    ASSERT_TRUE(values[0] == string_pool_add(pool, "value0"));
+    free(large);
+    string_pool_free(pool);
+}
@@ -0,0 +1,148 @@
+/*
+ SPDX-License-Identifier: GPL-3.0-or-later
+ myMPD (c) 2018-2023 Juergen Mang <mail@jcgames.de>
+ https://github.com/jcorporation/mympd
+*/
+
+#include "compile_time.h"
+#include "utility.h"
+
+#include "dist/utest/utest.h"
+#include "src/lib/mem.h"
+#include "src/lib/mimetype.h"
+#include "src/lib/sds_extras.h"
+#include "src/lib/thumbnail.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <jpeglib.h>
+
+#ifdef MYMPD_ENABLE_LIBPNG
+    #include <png.h>
+#endif
+
+static sds create_jpeg(unsigned width, unsigned height) {
+    struct jpeg_compress_struct cinfo;
+    struct jpeg_error_mgr jerr;
+    unsigned char *buffer = NULL;
+    unsigned long buffer_len = 0;
+    cinfo.err = jpeg_std_error(&jerr);
+    jpeg_create_compress(&cinfo);
+    jpeg_mem_dest(&cinfo, &buffer, &buffer_len);
+    cinfo.image_width = width;
+    cinfo.image_height = height;
+    cinfo.input_components = 3;
+    cinfo.in_color_space = JCS_RGB;
+    jpeg_set_defaults(&cinfo);
+    jpeg_start_compress(&cinfo, TRUE);
+    unsigned char *row = malloc_assert((size_t)width * 3);
+    while (cinfo.next_scanline < cinfo.image_height) {
+        for (unsigned x = 0; x < width; x++) {
+            row[x * 3] = (unsigned char)(x % 256);
+            row[x * 3 + 1] = (unsigned char)(cinfo.next_scanline % 256);
+            row[x * 3 + 2] = 128;
+        }
+        jpeg_write_scanlines(&cinfo, &row, 1);
+    }
+    jpeg_finish_compress(&cinfo);
+    jpeg_destroy_compress(&cinfo);
+    FREE_PTR(row);
+    sds jpeg = sdsnewlen(buffer, buffer_len);
+    FREE_PTR(buffer);
+    return jpeg;
+}
+
+static void get_jpeg_size(sds jpeg, unsigned *width, unsigned *height) {
+    struct jpeg_decompress_struct cinfo;
+    struct jpeg_error_mgr jerr;
+    cinfo.err = jpeg_std_error(&jerr);
+    jpeg_create_decompress(&cinfo);
+    jpeg_mem_src(&cinfo, (const unsigned char *)jpeg, (unsigned long)sdslen(jpeg));
+    jpeg_read_header(&cinfo, TRUE);
+    *width = cinfo.image_width;
+    *height = cinfo.image_height;
+    jpeg_destroy_decompress(&cinfo);
+}
+
+UTEST(thumbnail, test_thumbnail_is_supported) {
+    ASSERT_TRUE(thumbnail_is_supported("image/jpeg"));
+    #ifdef MYMPD_ENABLE_LIBPNG
+        ASSERT_TRUE(thumbnail_is_supported("image/png"));
+    #endif
+    ASSERT_FALSE(thumbnail_is_supported("image/webp"));
+    ASSERT_FALSE(thumbnail_is_supported("audio/mpeg"));
+}
+
+UTEST(thumbnail, test_thumbnail_create) {
+    unsigned width;
+    unsigned height;
+
+    //landscape
+    sds image = create_jpeg(1600, 1000);
+    sds thumbnail = sdsempty();
+    bool rc = thumbnail_create(image, "image/jpeg", 400, &thumbnail);
+    ASSERT_TRUE(rc);
+    ASSERT_STREQ("image/jpeg", get_mime_type_by_magic_stream(thumbnail));
+    get_jpeg_size(thumbnail, &width, &height);
+    ASSERT_EQ(400U, width);
+    ASSERT_EQ(250U, height);
+    ASSERT_LT(sdslen(thumbnail), sdslen(image));
+    FREE_SDS(image);
+
+    //portrait
+    image = create_jpeg(500, 1000);
+    sdsclear(thumbnail);
+    rc = thumbnail_create(image, "image/jpeg", 400, &thumbnail);
+    ASSERT_TRUE(rc);
+    get_jpeg_size(thumbnail, &width, &height);
+    ASSERT_EQ(200U, width);
+    ASSERT_EQ(400U, height);
+    FREE_SDS(image);
+
+    //small images are not changed
+    image = create_jpeg(300, 300);
+    sdsclear(thumbnail);
+    rc = thumbnail_create(image, "image/jpeg", 400, &thumbnail);
+    ASSERT_TRUE(rc);
+    ASSERT_EQ(sdslen(image), sdslen(thumbnail));
+    FREE_SDS(image);
+
+    //invalid image
+    image = sdsnew("invalid");
+    sdsclear(thumbnail);
+    rc = thumbnail_create(image, "image/jpeg", 400, &thumbnail);
+    ASSERT_FALSE(rc);
+    FREE_SDS(image);
+
+    FREE_SDS(thumbnail);
+}
+
+#ifdef MYMPD_ENABLE_LIBPNG
+UTEST(thumbnail, test_thumbnail_create_png) {
+    png_image png;
+    memset(&png, 0, sizeof(png));
+    png.version = PNG_IMAGE_VERSION;
+    png.width = 800;
+    png.height = 800;
+    png.format = PNG_FORMAT_RGBA;
+    unsigned char *pixels = malloc_assert(PNG_IMAGE_SIZE(png));
+    memset(pixels, 0x80, PNG_IMAGE_SIZE(png));
+    png_alloc_size_t png_len = 0;
+    ASSERT_NE(0, png_image_write_to_memory(&png, NULL, &png_len, 0, pixels, 0, NULL));
+    sds image = sdsnewlen(NULL, png_len);
+    ASSERT_NE(0, png_image_write_to_memory(&png, image, &png_len, 0, pixels, 0, NULL));
+    FREE_PTR(pixels);
+
+    sds thumbnail = sdsempty();
+    bool rc = thumbnail_create(image, "image/png", 400, &thumbnail);
+    ASSERT_TRUE(rc);
+    ASSERT_STREQ("image/jpeg", get_mime_type_by_magic_stream(thumbnail));
+    unsigned width;
+    unsigned height;
+    get_jpeg_size(thumbnail, &width, &height);
+    ASSERT_EQ(400U, width);
+    ASSERT_EQ(400U, height);
+    FREE_SDS(image);
+    FREE_SDS(thumbnail);
+}
+#endif
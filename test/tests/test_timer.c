@@ -37,6 +37,45 @@ UTEST(timer, test_timer_add_replace_remove) {
     mympd_api_timer_timerlist_clear(&l);
 }
 
+static long long fired[4];
+static int fired_count;
+
+static void test_timer_handler(long long timer_id, struct t_timer_definition *definition) {
+    (void) definition;
+    fired[fired_count++] = timer_id;
+}
+
+UTEST(timer, test_timer_heap) {
+    struct t_timer_list l;
+    mympd_api_timer_timerlist_init(&l);
+    fired_count = 0;
+    mympd_api_timer_add(&l, 30, 0, test_timer_handler, 1, NULL);
+    mympd_api_timer_add(&l, 10, 0, test_timer_handler, 2, NULL);
+    mympd_api_timer_add(&l, 20, 0, test_timer_handler, 3, NULL);
+    mympd_api_timer_add(&l, 0, TIMER_ONE_SHOT_REMOVE, test_timer_handler, 4, NULL);
+    mympd_api_timer_add(&l, 0, 60, test_timer_handler, 5, NULL);
+    ASSERT_EQ(5U, (unsigned)l.heap_len);
+    ASSERT_TRUE(l.fd > -1);
+
+    //only the expired timers are executed
+    mympd_api_timer_check(&l);
+    ASSERT_EQ(2, fired_count);
+    ASSERT_EQ(9, fired[0] + fired[1]);
+    //one shot timer is removed, periodic timer is rescheduled
+    ASSERT_EQ(4, l.list.length);
+    ASSERT_EQ(4U, (unsigned)l.heap_len);
+    ASSERT_EQ(2, l.heap[0]->value_i);
+
+    mympd_api_timer_remove(&l, 2);
+    ASSERT_EQ(3, l.heap[0]->value_i);
+    ASSERT_EQ(3U, (unsigned)l.heap_len);
+    mympd_api_timer_check(&l);
+    ASSERT_EQ(2, fired_count);
+
+    mympd_api_timer_timerlist_clear(&l);
+    ASSERT_EQ(-1, l.fd);
+}
+
 UTEST(timer, test_timer_parse_definition) {
     struct t_timer_list l;
     mympd_api_timer_timerlist_init(&l);
@@ -24,3 +24,8 @@ void clean_testenv(void) {
     }
     unsetenv("TESTVAR");
 }
+
+double elapsed_ms(const struct timespec *begin, const struct timespec *end) {
+    return (double)(end->tv_sec - begin->tv_sec) * 1000.0 +
+        (double)(end->tv_nsec - begin->tv_nsec) / 1000000.0;
+}